@@ -0,0 +1,35 @@
+#include <spiderscript.h>
+#include "export_types.gen.h"
+extern tSpiderClass gExports_class_Lang_StringMap;
+extern tSpiderFunction gExports_fcn_len;
+extern tSpiderFunction gExports_fcn_sizeof;
+extern tSpiderFunction gExports_fcn_exit;
+extern tSpiderFunction gExports_fcn_isnull;
+extern tSpiderFunction gExports_fcn_Lang_SortStrings;
+extern tSpiderFunction gExports_fcn_Lang_Strings_Split;
+extern tSpiderFunction gExports_fcn_Lang_Strings_Join;
+extern tSpiderFunction gExports_fcn_Lang_Strings_Search;
+extern tSpiderFunction gExports_fcn_Lang_Strings_SubStr;
+extern tSpiderFunction gExports_fcn_Lang_Strings_Replace;
+extern tSpiderFunction gExports_fcn_Lang_Strings_Trim;
+int giNumExportedClasses = 1;
+int giNumExportedFunctions = 11;
+tSpiderClass *gapExportedClasses[] = {
+	&gExports_class_Lang_StringMap,
+	NULL
+};
+tSpiderFunction *gapExportedFunctions[] = {
+	&gExports_fcn_len,
+	&gExports_fcn_sizeof,
+	&gExports_fcn_exit,
+	&gExports_fcn_isnull,
+	&gExports_fcn_Lang_SortStrings,
+	&gExports_fcn_Lang_Strings_Split,
+	&gExports_fcn_Lang_Strings_Join,
+	&gExports_fcn_Lang_Strings_Search,
+	&gExports_fcn_Lang_Strings_SubStr,
+	&gExports_fcn_Lang_Strings_Replace,
+	&gExports_fcn_Lang_Strings_Trim,
+	NULL
+};
+
@@ -0,0 +1,425 @@
+#define __SFCN_PROTO(n) int n(tSpiderScript*Script,void*RetData,int NArgs,const tSpiderTypeRef*ArgTypes,const void*const Args[])
+#define __SS_BUGCHECK(cnd)	do{if(!(cnd)){return SpiderScript_ThrowException(Script,SS_EXCEPTION_BUG,"Assertion failure '"#cnd"'");}}while(0)
+#include <spiderscript.h>
+#include <export_types.gen.h>
+#line 1 "exports.ssf"
+/*
+ * Acess2 - SpiderScript
+ * - Script Exports (Lang. Namespace)
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <spiderscript.h>
+#include <ctype.h>	// isblank
+
+__SFCN_PROTO(Exports_fcn_len);
+tSpiderFcnProto gExports_fcnp_len = {
+	.ReturnType={&gSpiderScript_IntegerType, 0},.Args={{&gSpiderScript_AnyType,0}, {NULL,0}},
+	.bVariableArgs = 0,
+};
+tSpiderFunction gExports_fcn_len = {
+	.Next=NULL, .Name = "len",
+	.Handler = Exports_fcn_len, .Prototype = &gExports_fcnp_len
+	};
+__SFCN_PROTO(Exports_fcn_len)
+{
+	const void* Value = Args[0];
+	Value = Value;
+#line 13 "exports.ssf"
+	if( SS_GETARRAYDEPTH( ArgTypes[0] ) )
+	{
+		if( !Value )	do{*(tSpiderInteger*)RetData = ( 0);return 0;}while(0);
+		do{*(tSpiderInteger*)RetData = ( ((const tSpiderArray*)Value)->Length);return 0;}while(0);
+	}
+
+	if( SS_ISTYPEOBJECT( ArgTypes[0] ) )
+	{
+
+		do{*(tSpiderInteger*)RetData = ( 0);return 0;}while(0);
+	}	
+
+	if( SS_ISCORETYPE(ArgTypes[0], SS_DATATYPE_STRING) )
+	{
+		if( !Value )	do{*(tSpiderInteger*)RetData = ( 0);return 0;}while(0);
+		do{*(tSpiderInteger*)RetData = ( ((const tSpiderString*)Value)->Length);return 0;}while(0);
+	}
+
+
+	do{*(tSpiderInteger*)RetData = ( 0);return 0;}while(0);
+}
+
+__SFCN_PROTO(Exports_fcn_sizeof);
+tSpiderFcnProto gExports_fcnp_sizeof = {
+	.ReturnType={&gSpiderScript_IntegerType, 0},.Args={{&gSpiderScript_AnyType,0}, {NULL,0}},
+	.bVariableArgs = 0,
+};
+tSpiderFunction gExports_fcn_sizeof = {
+	.Next=&gExports_fcn_len, .Name = "sizeof",
+	.Handler = Exports_fcn_sizeof, .Prototype = &gExports_fcnp_sizeof
+	};
+__SFCN_PROTO(Exports_fcn_sizeof)
+{
+	const void* Value = Args[0];
+	Value = Value;
+#line 37 "exports.ssf"
+	return Exports_fcn_len(Script, RetData, NArgs, ArgTypes, Args);
+}
+
+__SFCN_PROTO(Exports_fcn_exit);
+tSpiderFcnProto gExports_fcnp_exit = {
+	.ReturnType={NULL,0},.Args={{NULL,0}},
+	.bVariableArgs = 0,
+};
+tSpiderFunction gExports_fcn_exit = {
+	.Next=&gExports_fcn_sizeof, .Name = "exit",
+	.Handler = Exports_fcn_exit, .Prototype = &gExports_fcnp_exit
+	};
+__SFCN_PROTO(Exports_fcn_exit)
+{
+#line 42 "exports.ssf"
+	return SpiderScript_ThrowException_ForceExit(Script, 0);
+	return 0;
+}
+
+__SFCN_PROTO(Exports_fcn_isnull);
+tSpiderFcnProto gExports_fcnp_isnull = {
+	.ReturnType={&gSpiderScript_BoolType, 0},.Args={{&gSpiderScript_AnyType,0}, {NULL,0}},
+	.bVariableArgs = 0,
+};
+tSpiderFunction gExports_fcn_isnull = {
+	.Next=&gExports_fcn_exit, .Name = "isnull",
+	.Handler = Exports_fcn_isnull, .Prototype = &gExports_fcnp_isnull
+	};
+__SFCN_PROTO(Exports_fcn_isnull)
+{
+	const void* Value = Args[0];
+	Value = Value;
+#line 47 "exports.ssf"
+	if( !Value )
+		do{*(tSpiderBool*)RetData = ( 1);return 0;}while(0);
+	do{*(tSpiderBool*)RetData = ( 0);return 0;}while(0);
+}
+
+
+#line 55 "exports.ssf"
+int compare_spiderstring_ptrs(const void *s1, const void *s2)
+{
+	const tSpiderString	* const *strp1 = s1, * const *strp2 = s2;
+
+	if( !*strp1 && !*strp2 )
+		return 0;
+	else if( !*strp1 )
+		return 1;	// NULL sorts to the end
+	else if( !*strp2 )
+		return -1;
+	else
+		return SpiderScript_StringCompare(*strp1, *strp2);
+}
+
+__SFCN_PROTO(Exports_fcn_Lang_SortStrings);
+tSpiderFcnProto gExports_fcnp_Lang_SortStrings = {
+	.ReturnType={&gSpiderScript_StringType, 1},.Args={{&gSpiderScript_StringType, 1}, {NULL,0}},
+	.bVariableArgs = 0,
+};
+tSpiderFunction gExports_fcn_Lang_SortStrings = {
+	.Next=&gExports_fcn_isnull, .Name = "Lang@SortStrings",
+	.Handler = Exports_fcn_Lang_SortStrings, .Prototype = &gExports_fcnp_Lang_SortStrings
+	};
+__SFCN_PROTO(Exports_fcn_Lang_SortStrings)
+{
+	const tSpiderArray* Input = Args[0];
+	Input = Input;
+#line 71 "exports.ssf"
+	if( !Input )
+		do{*(const tSpiderArray**)RetData = ( NULL);return 0;}while(0);
+
+	tSpiderArray	*ret = SpiderScript_CreateArray((tSpiderTypeRef){&gSpiderScript_StringType, 0}, Input->Length);
+	for( int i = 0; i < Input->Length; i ++ ) {
+		ret->Strings[i] = Input->Strings[i];
+		if( ret->Strings[i] )
+			SpiderScript_ReferenceString(ret->Strings[i]);
+	}
+	qsort(ret->Strings, ret->Length, sizeof(ret->Strings[0]), compare_spiderstring_ptrs);
+	do{*(const tSpiderArray**)RetData = ( ret);return 0;}while(0);
+}
+
+
+
+#line 88 "exports.ssf"
+const void *memmem(const void *haystack, size_t haystacklen, const void *needle, size_t needlelen)
+{
+	 int	ofs;
+	if( haystacklen < needlelen )
+		return NULL;
+	for( ofs = 0; ofs < haystacklen - needlelen; ofs ++ )
+	{
+		if( memcmp(haystack + ofs, needle, needlelen) == 0 )
+			return haystack + ofs;
+	}
+	return NULL;
+}
+
+__SFCN_PROTO(Exports_fcn_Lang_Strings_Split);
+tSpiderFcnProto gExports_fcnp_Lang_Strings_Split = {
+	.ReturnType={&gSpiderScript_StringType, 1},.Args={{&gSpiderScript_StringType, 0}, {&gSpiderScript_StringType, 0}, {NULL,0}},
+	.bVariableArgs = 0,
+};
+tSpiderFunction gExports_fcn_Lang_Strings_Split = {
+	.Next=&gExports_fcn_Lang_SortStrings, .Name = "Lang@Strings@Split",
+	.Handler = Exports_fcn_Lang_Strings_Split, .Prototype = &gExports_fcnp_Lang_Strings_Split
+	};
+__SFCN_PROTO(Exports_fcn_Lang_Strings_Split)
+{
+	const tSpiderString * Haystack = Args[0];
+	Haystack = Haystack;
+	const tSpiderString * Needle = Args[1];
+	Needle = Needle;
+#line 103 "exports.ssf"
+	if( !Haystack )	return SpiderScript_ThrowException_NullRef(Script, "Lang.Strings.Split - Haystack");
+	if( !Needle )	return SpiderScript_ThrowException_NullRef(Script, "Lang.Strings.Split - Needle");
+
+	 int	haystack_len, needle_len;
+	const void	*haystack, *needle, *end;
+	 int	ofs, slen;
+	tSpiderString	**strings = NULL;
+	 int	nSubStrs = 0;
+
+
+	haystack_len = Haystack->Length;
+	haystack     = Haystack->Data;
+	needle_len = Needle->Length;
+	needle     = Needle->Data;
+	ofs = 0;
+	do {
+		end = memmem(haystack + ofs, haystack_len - ofs, needle, needle_len);
+		if( end )
+			slen = end - (haystack + ofs);
+		else
+			slen = haystack_len - ofs;
+
+		strings = realloc(strings, (nSubStrs+1)*sizeof(tSpiderString*));
+		strings[nSubStrs] = SpiderScript_CreateString(slen, haystack + ofs);
+		nSubStrs ++;
+
+		ofs += slen + needle_len;
+	} while(end);
+
+
+	tSpiderArray *ret = SpiderScript_CreateArray((tSpiderTypeRef){&gSpiderScript_StringType, 0}, nSubStrs);
+	memcpy(ret->Strings, strings, nSubStrs*sizeof(tSpiderString*));
+	free(strings);
+
+	do{*(const tSpiderArray**)RetData = ( ret);return 0;}while(0);
+}
+
+__SFCN_PROTO(Exports_fcn_Lang_Strings_Join);
+tSpiderFcnProto gExports_fcnp_Lang_Strings_Join = {
+	.ReturnType={&gSpiderScript_StringType, 0},.Args={{&gSpiderScript_StringType, 1}, {&gSpiderScript_StringType, 0}, {NULL,0}},
+	.bVariableArgs = 0,
+};
+tSpiderFunction gExports_fcn_Lang_Strings_Join = {
+	.Next=&gExports_fcn_Lang_Strings_Split, .Name = "Lang@Strings@Join",
+	.Handler = Exports_fcn_Lang_Strings_Join, .Prototype = &gExports_fcnp_Lang_Strings_Join
+	};
+__SFCN_PROTO(Exports_fcn_Lang_Strings_Join)
+{
+	const tSpiderString * Joiner = Args[1];
+	Joiner = Joiner;
+	const tSpiderArray* Array = Args[0];
+	Array = Array;
+#line 142 "exports.ssf"
+	if( !Array ) {
+		return SpiderScript_ThrowException_NullRef(Script, "Join - Input array NULL");
+	}
+	if( !Joiner ) {
+		return SpiderScript_ThrowException_NullRef(Script, "Join - Joiner NULL");
+	}
+
+	if( Array->Length == 0 ) {
+		do{*(const tSpiderString **)RetData = ( SpiderScript_CreateString(0, ""));return 0;}while(0);
+	}
+
+	if( !Array->Strings[0] ) {
+		return SpiderScript_ThrowException_NullRef(Script, "Join - Array[0] NULL");
+	}
+
+	size_t	len = Array->Strings[0]->Length;
+	for( unsigned int i = 1; i < Array->Length; i ++ )
+	{
+		if( !Array->Strings[i] )
+			return SpiderScript_ThrowException_NullRef(Script, "Join - Array[i]");
+		len += Joiner->Length + Array->Strings[i]->Length;
+	}
+
+	tSpiderString	*ret = SpiderScript_CreateString(len, NULL);
+	size_t	ofs = Array->Strings[0]->Length;
+	memcpy(ret->Data, Array->Strings[0]->Data, Array->Strings[0]->Length);
+	for( unsigned int i = 1; i < Array->Length; i ++ )
+	{
+		memcpy(ret->Data + ofs, Joiner->Data, Joiner->Length);
+		ofs += Joiner->Length;
+		memcpy(ret->Data + ofs, Array->Strings[i]->Data, Array->Strings[i]->Length);
+		ofs += Array->Strings[i]->Length;
+	}
+
+	do{*(const tSpiderString **)RetData = ( ret);return 0;}while(0);
+}
+
+__SFCN_PROTO(Exports_fcn_Lang_Strings_Search);
+tSpiderFcnProto gExports_fcnp_Lang_Strings_Search = {
+	.ReturnType={&gSpiderScript_IntegerType, 0},.Args={{&gSpiderScript_StringType, 0}, {&gSpiderScript_StringType, 0}, {NULL,0}},
+	.bVariableArgs = 0,
+};
+tSpiderFunction gExports_fcn_Lang_Strings_Search = {
+	.Next=&gExports_fcn_Lang_Strings_Join, .Name = "Lang@Strings@Search",
+	.Handler = Exports_fcn_Lang_Strings_Search, .Prototype = &gExports_fcnp_Lang_Strings_Search
+	};
+__SFCN_PROTO(Exports_fcn_Lang_Strings_Search)
+{
+	const tSpiderString * Haystack = Args[0];
+	Haystack = Haystack;
+	const tSpiderString * Needle = Args[1];
+	Needle = Needle;
+#line 181 "exports.ssf"
+	if( !Haystack || !Needle )
+		do{*(tSpiderInteger*)RetData = ( -1);return 0;}while(0);
+
+	const char *end = memmem(Haystack->Data, Haystack->Length, Needle->Data, Needle->Length);
+	if( !end )
+		do{*(tSpiderInteger*)RetData = ( -1);return 0;}while(0);
+
+	do{*(tSpiderInteger*)RetData = ( end - Haystack->Data);return 0;}while(0);
+}
+
+__SFCN_PROTO(Exports_fcn_Lang_Strings_SubStr);
+tSpiderFcnProto gExports_fcnp_Lang_Strings_SubStr = {
+	.ReturnType={&gSpiderScript_StringType, 0},.Args={{&gSpiderScript_StringType, 0}, {&gSpiderScript_IntegerType, 0}, {&gSpiderScript_IntegerType, 0}, {NULL,0}},
+	.bVariableArgs = 0,
+};
+tSpiderFunction gExports_fcn_Lang_Strings_SubStr = {
+	.Next=&gExports_fcn_Lang_Strings_Search, .Name = "Lang@Strings@SubStr",
+	.Handler = Exports_fcn_Lang_Strings_SubStr, .Prototype = &gExports_fcnp_Lang_Strings_SubStr
+	};
+__SFCN_PROTO(Exports_fcn_Lang_Strings_SubStr)
+{
+	tSpiderInteger Length = *(const tSpiderInteger*)Args[2];
+	Length = Length;
+	const tSpiderString * Input = Args[0];
+	Input = Input;
+	tSpiderInteger Offset = *(const tSpiderInteger*)Args[1];
+	Offset = Offset;
+#line 193 "exports.ssf"
+	if( !Input )
+		do{*(const tSpiderString **)RetData = ( NULL);return 0;}while(0);
+	if( Offset > Input->Length )
+		do{*(const tSpiderString **)RetData = ( SpiderScript_CreateString(0, NULL));return 0;}while(0);
+	if( Length > Input->Length )
+		Length = Input->Length;
+	if( Offset + Length > Input->Length )
+		Length = Input->Length - Offset;
+	if( Length == 0 )
+		do{*(const tSpiderString **)RetData = ( SpiderScript_CreateString(0, NULL));return 0;}while(0);
+
+	do{*(const tSpiderString **)RetData = ( SpiderScript_CreateString(Length, Input->Data + Offset));return 0;}while(0);
+}
+
+__SFCN_PROTO(Exports_fcn_Lang_Strings_Replace);
+tSpiderFcnProto gExports_fcnp_Lang_Strings_Replace = {
+	.ReturnType={&gSpiderScript_StringType, 0},.Args={{&gSpiderScript_StringType, 0}, {&gSpiderScript_StringType, 0}, {&gSpiderScript_StringType, 0}, {NULL,0}},
+	.bVariableArgs = 0,
+};
+tSpiderFunction gExports_fcn_Lang_Strings_Replace = {
+	.Next=&gExports_fcn_Lang_Strings_SubStr, .Name = "Lang@Strings@Replace",
+	.Handler = Exports_fcn_Lang_Strings_Replace, .Prototype = &gExports_fcnp_Lang_Strings_Replace
+	};
+__SFCN_PROTO(Exports_fcn_Lang_Strings_Replace)
+{
+	const tSpiderString * Haystack = Args[0];
+	Haystack = Haystack;
+	const tSpiderString * Needle = Args[1];
+	Needle = Needle;
+	const tSpiderString * Replacement = Args[2];
+	Replacement = Replacement;
+#line 209 "exports.ssf"
+	if( !Haystack )
+		do{*(const tSpiderString **)RetData = ( NULL);return 0;}while(0);
+	if( !Needle || !Replacement ) {
+		SpiderScript_ReferenceString(Haystack);
+		do{*(const tSpiderString **)RetData = ( Haystack);return 0;}while(0);
+	}
+
+
+	const char *pos;
+	 int	ofs = 0;
+	 int	nMatches = 0;
+	 int	slen;
+	do {
+		pos = memmem(Haystack->Data + ofs, Haystack->Length - ofs, Needle->Data, Needle->Length);
+		if( pos )
+			slen = pos - (Haystack->Data + ofs);
+		else
+			slen = Haystack->Length - ofs;
+
+		if( pos )
+			nMatches ++;	
+
+		ofs += slen + Needle->Length;
+	} while(pos);
+
+
+	size_t	newlen = Haystack->Length - nMatches*Needle->Length + nMatches*Replacement->Length;
+	tSpiderString *ret = SpiderScript_CreateString(newlen, NULL);
+	 int	write_ofs = 0;
+	ofs = 0;
+	do {
+		pos = memmem(Haystack->Data + ofs, Haystack->Length - ofs, Needle->Data, Needle->Length);
+		if( pos )
+			slen = pos - (Haystack->Data + ofs);
+		else
+			slen = Haystack->Length - ofs;
+
+		memcpy(ret->Data + write_ofs, Haystack->Data + ofs, slen);
+		write_ofs += slen;
+		if( pos ) {
+			memcpy(ret->Data + write_ofs, Replacement->Data, Replacement->Length);
+			write_ofs += Replacement->Length;
+		}
+
+		ofs += slen + Needle->Length;
+	} while(pos);
+
+	do{*(const tSpiderString **)RetData = ( ret);return 0;}while(0);
+}
+
+__SFCN_PROTO(Exports_fcn_Lang_Strings_Trim);
+tSpiderFcnProto gExports_fcnp_Lang_Strings_Trim = {
+	.ReturnType={&gSpiderScript_StringType, 0},.Args={{&gSpiderScript_StringType, 0}, {NULL,0}},
+	.bVariableArgs = 0,
+};
+tSpiderFunction gExports_fcn_Lang_Strings_Trim = {
+	.Next=&gExports_fcn_Lang_Strings_Replace, .Name = "Lang@Strings@Trim",
+	.Handler = Exports_fcn_Lang_Strings_Trim, .Prototype = &gExports_fcnp_Lang_Strings_Trim
+	};
+__SFCN_PROTO(Exports_fcn_Lang_Strings_Trim)
+{
+	const tSpiderString * Input = Args[0];
+	Input = Input;
+#line 261 "exports.ssf"
+	if( !Input )	do{*(const tSpiderString **)RetData = ( NULL);return 0;}while(0);
+	const char *base = Input->Data;
+	size_t	len = Input->Length;
+	while( len > 0 && isblank(*base) )
+		base ++, len --;
+
+	while( len > 0 && isblank(base[len-1]) )
+		len --;
+
+	do{*(const tSpiderString **)RetData = ( SpiderScript_CreateString(len, base));return 0;}while(0);
+}
+
+
+
+
+
+
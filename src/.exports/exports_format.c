@@ -0,0 +1,23 @@
+#define __SFCN_PROTO(n) int n(tSpiderScript*Script,void*RetData,int NArgs,const tSpiderTypeRef*ArgTypes,const void*const Args[])
+#define __SS_BUGCHECK(cnd)	do{if(!(cnd)){return SpiderScript_ThrowException(Script,SS_EXCEPTION_BUG,"Assertion failure '"#cnd"'");}}while(0)
+#include <spiderscript.h>
+#include <export_types.gen.h>
+#line 1 "exports_format.ssf"
+/*
+ * Acess2 - SpiderScript
+ * - Script Exports (Lang. Namespace)
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <spiderscript.h>
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,219 @@
+#define __SFCN_PROTO(n) int n(tSpiderScript*Script,void*RetData,int NArgs,const tSpiderTypeRef*ArgTypes,const void*const Args[])
+#define __SS_BUGCHECK(cnd)	do{if(!(cnd)){return SpiderScript_ThrowException(Script,SS_EXCEPTION_BUG,"Assertion failure '"#cnd"'");}}while(0)
+#include <spiderscript.h>
+#include <export_types.gen.h>
+#line 1 "exports_stringmap.ssf"
+/*
+ * Acess2 - SpiderScript
+ * - Script Exports (Lang. Namespace)
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <spiderscript.h>
+
+
+extern tSpiderClass gExports_class_Lang_StringMap;
+#line 15 "exports_stringmap.ssf"
+	typedef struct s_StringMap_Entry	t_StringMap_Entry;
+	struct s_StringMap_Entry
+	{
+		t_StringMap_Entry	*Next;
+		const tSpiderString	*Key;
+		const tSpiderString	*Value;
+	};
+	#define N_STRINGMAP_BUCKETS	256
+	typedef struct
+	{
+		 int	nItems;
+		t_StringMap_Entry	*Buckets[N_STRINGMAP_BUCKETS];
+	} t_StringMap_Info;
+	__SFCN_PROTO(Exports_fcn_Lang_StringMap___construct);
+	tSpiderFcnProto gExports_fcnp_Lang_StringMap___construct = {
+		.ReturnType={TYPE_Lang_z_StringMap,0},.Args={{NULL,0}},
+		.bVariableArgs = 0,
+	};
+	tSpiderFunction gExports_fcn_Lang_StringMap___construct = {
+		.Next=NULL, .Name = "__construct",
+		.Handler = Exports_fcn_Lang_StringMap___construct, .Prototype = &gExports_fcnp_Lang_StringMap___construct
+	};
+	__SFCN_PROTO(Exports_fcn_Lang_StringMap___construct)
+	{
+#line 30 "exports_stringmap.ssf"
+		tSpiderObject	*this;
+
+		this = SpiderScript_AllocateObject(Script, &gExports_class_Lang_StringMap, sizeof(t_StringMap_Info));		
+
+		t_StringMap_Info *info = this->OpaqueData;
+		info->nItems = 0;
+		memset(info->Buckets, 0, sizeof(info->Buckets));
+
+		do{*(tSpiderObject**)RetData = ( this);return 0;}while(0);
+	}
+	void Exports_fcn_Lang_StringMap___destruct(tSpiderObject *this)
+	{
+#line 42 "exports_stringmap.ssf"
+		t_StringMap_Info *info = this->OpaqueData;
+		for( int i = 0; i < N_STRINGMAP_BUCKETS; i ++ )
+		{
+			t_StringMap_Entry	*e, *p;
+
+			for( e = info->Buckets[i]; e; e = p )
+			{
+				p = e->Next;
+				SpiderScript_DereferenceString(e->Key);
+				SpiderScript_DereferenceString(e->Value);
+				free(e);
+			}
+		}
+	}
+
+	__SFCN_PROTO(Exports_fcn_Lang_StringMap__set);
+	tSpiderFcnProto gExports_fcnp_Lang_StringMap__set = {
+		.ReturnType={NULL,0},.Args={{TYPE_Lang_z_StringMap,0}, {&gSpiderScript_StringType, 0}, {&gSpiderScript_StringType, 0}, {NULL,0}},
+		.bVariableArgs = 0,
+	};
+	tSpiderFunction gExports_fcn_Lang_StringMap__set = {
+		.Next=NULL, .Name = "set",
+		.Handler = Exports_fcn_Lang_StringMap__set, .Prototype = &gExports_fcnp_Lang_StringMap__set
+	};
+	__SFCN_PROTO(Exports_fcn_Lang_StringMap__set)
+	{
+		const tSpiderString * Key = Args[1];
+		Key = Key;
+		const tSpiderObject* this = Args[0];
+		this = this;
+		const tSpiderString * Value = Args[2];
+		Value = Value;
+#line 59 "exports_stringmap.ssf"
+		t_StringMap_Info *info = this->OpaqueData;
+		if( !Key )	return 0;
+
+		t_StringMap_Entry	**bucket;
+		if( Key->Length == 0 )
+			bucket = &info->Buckets[0];
+		else
+			bucket = &info->Buckets[ (int)Key->Data[0] ];
+
+		t_StringMap_Entry	*e, *p = NULL;
+		for( e = *bucket; e; p = e, e = e->Next )
+		{
+
+			if( e->Key->Length > Key->Length )	break;
+			if( e->Key->Length < Key->Length )	continue;
+
+			int cmp = memcmp(e->Key->Data, Key->Data, Key->Length);
+			if( cmp > 0 )	break;
+			if( cmp < 0 )	continue ;
+
+
+			SpiderScript_DereferenceString(e->Value);
+			SpiderScript_ReferenceString(Value);
+			e->Value = Value;
+			return 0;
+		}
+
+		e = malloc(sizeof(*e));
+		SpiderScript_ReferenceString(Key);
+		e->Key = Key;
+		SpiderScript_ReferenceString(Value);
+		e->Value = Value;
+		if( p ) {
+			e->Next = p->Next;
+			p->Next = e;
+		}
+		else {
+			e->Next = *bucket;
+			*bucket = e;
+		}
+		info->nItems ++;
+		return 0;
+	}
+
+	__SFCN_PROTO(Exports_fcn_Lang_StringMap__get);
+	tSpiderFcnProto gExports_fcnp_Lang_StringMap__get = {
+		.ReturnType={&gSpiderScript_StringType, 0},.Args={{TYPE_Lang_z_StringMap,0}, {&gSpiderScript_StringType, 0}, {NULL,0}},
+		.bVariableArgs = 0,
+	};
+	tSpiderFunction gExports_fcn_Lang_StringMap__get = {
+		.Next=&gExports_fcn_Lang_StringMap__set, .Name = "get",
+		.Handler = Exports_fcn_Lang_StringMap__get, .Prototype = &gExports_fcnp_Lang_StringMap__get
+	};
+	__SFCN_PROTO(Exports_fcn_Lang_StringMap__get)
+	{
+		const tSpiderObject* this = Args[0];
+		this = this;
+		const tSpiderString * Key = Args[1];
+		Key = Key;
+#line 104 "exports_stringmap.ssf"
+		t_StringMap_Info *info = this->OpaqueData;
+		if( !Key )	do{*(const tSpiderString **)RetData = ( NULL);return 0;}while(0);
+
+		t_StringMap_Entry	**bucket;
+		if( Key->Length == 0 )
+			bucket = &info->Buckets[0];
+		else
+			bucket = &info->Buckets[ (int)Key->Data[0] ];
+
+		t_StringMap_Entry	*e;
+		for( e = *bucket; e; e = e->Next )
+		{
+
+			if( e->Key->Length > Key->Length )	break;
+			if( e->Key->Length < Key->Length )	continue;
+
+			int cmp = memcmp(e->Key->Data, Key->Data, Key->Length);
+			if( cmp > 0 )	break;
+			if( cmp < 0 )	continue ;
+
+
+			SpiderScript_ReferenceString(e->Value);
+			do{*(const tSpiderString **)RetData = ( e->Value);return 0;}while(0);
+		}
+		do{*(const tSpiderString **)RetData = ( NULL);return 0;}while(0);
+	}
+
+	__SFCN_PROTO(Exports_fcn_Lang_StringMap__keys);
+	tSpiderFcnProto gExports_fcnp_Lang_StringMap__keys = {
+		.ReturnType={&gSpiderScript_StringType, 1},.Args={{TYPE_Lang_z_StringMap,0}, {NULL,0}},
+		.bVariableArgs = 0,
+	};
+	tSpiderFunction gExports_fcn_Lang_StringMap__keys = {
+		.Next=&gExports_fcn_Lang_StringMap__get, .Name = "keys",
+		.Handler = Exports_fcn_Lang_StringMap__keys, .Prototype = &gExports_fcnp_Lang_StringMap__keys
+	};
+	__SFCN_PROTO(Exports_fcn_Lang_StringMap__keys)
+	{
+		const tSpiderObject* this = Args[0];
+		this = this;
+#line 133 "exports_stringmap.ssf"
+		t_StringMap_Info *info = this->OpaqueData;
+		tSpiderTypeRef	strtype = {&gSpiderScript_StringType, 0};
+		tSpiderArray	*ret = SpiderScript_CreateArray(strtype, info->nItems);
+		 int	j = 0;		
+
+		for( int i = 0; i < N_STRINGMAP_BUCKETS; i ++ )
+		{
+			t_StringMap_Entry	*e;
+
+			for( e = info->Buckets[i]; e; e = e->Next ) {
+				SpiderScript_ReferenceString(e->Key);
+				ret->Strings[j++] = (void*)e->Key;
+			}
+		}
+
+		do{*(const tSpiderArray**)RetData = ( ret);return 0;}while(0);
+	}
+tSpiderClass gExports_class_Lang_StringMap = {
+	.Next=NULL,
+	.Name="Lang@StringMap",
+	.TypeDef={.Class=SS_TYPECLASS_NCLASS,{.NClass=&gExports_class_Lang_StringMap}},
+	.Constructor=&gExports_fcn_Lang_StringMap___construct,
+	.Destructor=&Exports_fcn_Lang_StringMap___destruct,
+	.Methods=&gExports_fcn_Lang_StringMap__keys,
+	.NAttributes=0,
+	.AttributeDefs={{NULL,{NULL,0},0,0}}};
+
+
+
+
@@ -35,6 +35,7 @@ tScript_Class *AST_AppendClass(tParser *Parser, const char *Name)
 	ret->nProperties = 0;
 	ret->nFunctions = 0;
 	ret->Functions = NULL;
+	ret->Constructor = NULL;
 	ret->Properties = NULL;
 	strcpy(ret->Name, Name);
 
@@ -126,6 +127,7 @@ tScript_Function *AST_int_MakeFunction(const char *Name, tSpiderTypeRef ReturnTy
 	fcn->ArgumentCount = arg_count;
 	fcn->ASTFcn = Code;
 	fcn->BCFcn = NULL;
+	fcn->Native = NULL;
 	fcn->IsVariable = bIsVariable;
 	
 	// Set arguments
@@ -263,6 +265,11 @@ void AST_FreeNode(tAST_Node *Node)
 		AST_FreeNode(Node->Iterator.Value);
 		AST_FreeNode(Node->Iterator.Code);
 		break;
+	case NODETYPE_TRYCATCH:
+		AST_FreeNode(Node->TryCatch.Code);
+		AST_FreeNode(Node->TryCatch.CatchVar);
+		AST_FreeNode(Node->TryCatch.Catch);
+		break;
 	
 	// Asignment
 	case NODETYPE_ASSIGN:
@@ -359,6 +366,8 @@ tAST_Node *AST_int_AllocateNode(tParser *Parser, int Type, int ExtraSize)
 	ret->File = Parser->Filename;	*(int*)(Parser->Filename - sizeof(int)) += 1;
 	ret->Line = Parser->Cur.Line;
 	ret->Type = Type;
+	ret->DataType.Def = NULL;	// Set by AST_Optimise
+	ret->DataType.ArrayDepth = 0;
 	
 	// Runtime Caching
 	ret->BlockState = NULL;
@@ -465,6 +474,25 @@ tAST_Node *AST_NewIterator(tParser *Parser, const char *Tag, tAST_Node *Value, c
 	return ret;
 }
 
+/**
+ * \brief Create an exception handler
+ * \param CatchVar	Variable definition (NODETYPE_DEFVAR) set to the caught exception
+ */
+tAST_Node *AST_NewTryCatch(tParser *Parser, tAST_Node *Code, tAST_Node *CatchVar, tAST_Node *Catch)
+{
+	if( !Code || !CatchVar || !Catch ) {
+		AST_FreeNode(Code);
+		AST_FreeNode(CatchVar);
+		AST_FreeNode(Catch);
+		return NULL;
+	}
+	tAST_Node	*ret = AST_int_AllocateNode(Parser, NODETYPE_TRYCATCH, 0);
+	ret->TryCatch.Code = Code;
+	ret->TryCatch.CatchVar = CatchVar;
+	ret->TryCatch.Catch = Catch;
+	return ret;
+}
+
 tAST_Node *AST_NewAssign(tParser *Parser, int Operation, tAST_Node *Dest, tAST_Node *Value)
 {
 	if( !Dest || !Value ) {
@@ -61,17 +61,18 @@ enum eAST_NodeTypes
 	NODETYPE_TERNARY,	//!< Ternary / Null-Coalescing
 	NODETYPE_LOOP,	//!< Looping Construct
 	NODETYPE_ITERATE,	//!< Iteration construct (foreach)
+	NODETYPE_TRYCATCH,	//!< Exception handler
 	
-	// 30
+	// 31
 	NODETYPE_INDEX,	//!< Index into an array
 	
-	// 31
+	// 32
 	NODETYPE_LOGICALNOT,	//!< Logical NOT operator
 	NODETYPE_LOGICALAND,	//!< Logical AND operator
 	NODETYPE_LOGICALOR, 	//!< Logical OR operator
 	NODETYPE_LOGICALXOR,	//!< Logical XOR operator
 	
-	// 35
+	// 36
 	NODETYPE_REFEQUALS,	//!< References are equal
 	NODETYPE_REFNOTEQUALS,	//!< References differ
 	NODETYPE_EQUALS,	//!< Comparison Equals
@@ -81,18 +82,18 @@ enum eAST_NodeTypes
 	NODETYPE_GREATERTHAN,	//!< Comparison Greater Than
 	NODETYPE_GREATERTHANEQUAL,	//!< Comparison Greater Than or Equal
 	
-	// 43
+	// 44
 	NODETYPE_BWNOT,	//!< Bitwise NOT
 	NODETYPE_BWAND,	//!< Bitwise AND
 	NODETYPE_BWOR,	//!< Bitwise OR
 	NODETYPE_BWXOR,	//!< Bitwise XOR
 	
-	// 47
+	// 48
 	NODETYPE_BITSHIFTLEFT,	//!< Bitwise Shift Left (Grow)
 	NODETYPE_BITSHIFTRIGHT,	//!< Bitwise Shift Right (Shrink)
 	NODETYPE_BITROTATELEFT,	//!< Bitwise Rotate Left (Grow)
 	
-	// 50
+	// 51
 	NODETYPE_NEGATE,	//!< Negagte
 	NODETYPE_ADD,	//!< Add
 	NODETYPE_SUBTRACT,	//!< Subtract
@@ -167,6 +168,11 @@ struct sAST_Node
 			tAST_Node	*Code;
 			char	Tag[];
 		}	Iterator;
+		struct {
+			tAST_Node	*Code;
+			tAST_Node	*CatchVar;	//!< NODETYPE_DEFVAR, given the exception
+			tAST_Node	*Catch;
+		}	TryCatch;
 		
 		/**
 		 * \note Used for \a NODETYPE_VARIABLE and \a NODETYPE_CONSTANT
@@ -246,6 +252,7 @@ extern tAST_Node	*AST_NewIf(tParser *Parser, tAST_Node *Condition, tAST_Node *Tr
 extern tAST_Node	*AST_NewTernary(tParser *Parser, tAST_Node *Condition, tAST_Node *True, tAST_Node *False);
 extern tAST_Node	*AST_NewLoop(tParser *Parser, const char *Tag, tAST_Node *Init, int bPostCheck, tAST_Node *Condition, tAST_Node *Increment, tAST_Node *Code);
 extern tAST_Node	*AST_NewIterator(tParser *Parser, const char *Tag, tAST_Node *Value, const char *ItName, const char *ValName, tAST_Node *Code);
+extern tAST_Node	*AST_NewTryCatch(tParser *Parser, tAST_Node *Code, tAST_Node *CatchVar, tAST_Node *Catch);
 
 extern tAST_Node	*AST_NewAssign(tParser *Parser, int Operation, tAST_Node *Dest, tAST_Node *Value);
 extern tAST_Node	*AST_NewCast(tParser *Parser, tSpiderTypeRef Target, tAST_Node *Value);
@@ -257,7 +264,7 @@ extern tAST_Node	*AST_NewBreakout(tParser *Parser, int Type, const char *DestTag
 extern void	AST_FreeNode(tAST_Node *Node);
 
 // ast_optimise.c
-extern tAST_Node	*AST_Optimise(tAST_Node *Node);
+extern tAST_Node	*AST_Optimise(tSpiderScript *Script, tScript_Function *Fcn, tAST_Node *Node);
 
 // exec_ast.h
 extern tSpiderScript_CoreType	AST_ExecuteNode_UniOp_GetType(tSpiderScript *Script, int Op, tSpiderScript_CoreType Type);
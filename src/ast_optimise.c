@@ -2,8 +2,8 @@
  * SpiderScript Library
  * by John Hodge (thePowersGang)
  * 
- * bytecode_gen.c
- * - Generate bytecode
+ * ast_optimise.c
+ * - AST optimisation and type inference
  */
 #include <stdlib.h>
 #include "ast.h"
@@ -19,7 +19,44 @@
 #define LOG(...)	do{}while(0);
 #endif
 
-#define _OPT(var)	(var = AST_Optimise(var))
+#define TYPE_VOID	((tSpiderTypeRef){0,0})
+#define TYPE_INTEGER	((tSpiderTypeRef){.ArrayDepth=0,.Def=&gSpiderScript_IntegerType})
+#define TYPE_REAL	((tSpiderTypeRef){.ArrayDepth=0,.Def=&gSpiderScript_RealType})
+#define TYPE_BOOLEAN	((tSpiderTypeRef){.ArrayDepth=0,.Def=&gSpiderScript_BoolType})
+#define TYPE_STRING	((tSpiderTypeRef){.ArrayDepth=0,.Def=&gSpiderScript_StringType})
+
+#define _ISCORE(_t)	((_t).ArrayDepth == 0 && (_t).Def && (_t).Def->Class == SS_TYPECLASS_CORE)
+
+#define _OPT(var)	(var = AST_Optimise_int(State, var))
+
+typedef struct sAST_OptVar	tAST_OptVar;
+typedef struct sAST_OptState	tAST_OptState;
+
+/**
+ * \brief Variable in scope, with its declared (or inferred for `auto`) type
+ */
+struct sAST_OptVar
+{
+	tAST_OptVar	*Next;
+	tSpiderTypeRef	Type;
+	const char	*Name;
+};
+
+/**
+ * \brief State for optimising a function
+ * \note Node types are only set when they are certain, TYPE_VOID is "unknown" and is
+ *       never acted on (the bytecode generator still does its own checks)
+ */
+struct sAST_OptState
+{
+	tSpiderScript	*Script;
+	tScript_Function	*Function;
+	tAST_OptVar	*Vars;	// Innermost first
+};
+
+// === PROTOTYPES ===
+tAST_Node	*AST_Optimise_int(tAST_OptState *State, tAST_Node *const Node);
+tAST_Node	*AST_Optimise_CastConst(tAST_Node *Node, tSpiderTypeRef Type);
 
 // === CODE ===
 tAST_Node *AST_Optimise_MakeString(tAST_Node **ents, int len, int First, int Cur)
@@ -37,6 +74,7 @@ tAST_Node *AST_Optimise_MakeString(tAST_Node **ents, int len, int First, int Cur
 		len += ents[j]->ConstString->Length;
 		AST_FreeNode(ents[j]);
 	}
+	ns->DataType = TYPE_STRING;
 	return ns;
 }
 
@@ -46,7 +84,7 @@ tAST_Node *AST_Optimise_MakeString2(tAST_Node *Left, tAST_Node *Right)
 	assert(Left->Type  == NODETYPE_STRING);
 	assert(Right->Type == NODETYPE_STRING);
 	size_t	len = Left->ConstString->Length + Right->ConstString->Length;
-	
+
 	tAST_Node *ns = AST_NewString(&state, NULL, len);
 	memcpy(ns->ConstString->Data + 0,
 		Left->ConstString->Data, Left->ConstString->Length);
@@ -54,17 +92,18 @@ tAST_Node *AST_Optimise_MakeString2(tAST_Node *Left, tAST_Node *Right)
 		Right->ConstString->Data, Right->ConstString->Length);
 	AST_FreeNode(Left);
 	AST_FreeNode(Right);
+	ns->DataType = TYPE_STRING;
 	return ns;
 }
 
-tAST_Node *AST_Optimise_OptList(tAST_Node *First)
+tAST_Node *AST_Optimise_OptList(tAST_OptState *State, tAST_Node *First)
 {
 	tAST_Node	*ret = First;
 	tAST_Node	**np = &ret;
 	for( tAST_Node *node = First; node; np = &node->NextSibling, node = node->NextSibling)
 	{
 		tAST_Node	*next = node->NextSibling;
-		tAST_Node	*newnode = AST_Optimise(node);
+		tAST_Node	*newnode = AST_Optimise_int(State, node);
 		if( newnode != node ) {
 			LOG("Replacing %p with %p", node, newnode);
 			*np = node = newnode;
@@ -74,6 +113,284 @@ tAST_Node *AST_Optimise_OptList(tAST_Node *First)
 	return ret;
 }
 
+// --- Types ---
+void AST_Optimise_DefineVar(tAST_OptState *State, tSpiderTypeRef Type, const char *Name)
+{
+	tAST_OptVar	*var = malloc( sizeof(tAST_OptVar) );
+	var->Type = Type;
+	var->Name = Name;
+	var->Next = State->Vars;
+	State->Vars = var;
+}
+
+/**
+ * \brief Drop variables defined since \a Saved was the innermost
+ */
+void AST_Optimise_EndScope(tAST_OptState *State, tAST_OptVar *Saved)
+{
+	while( State->Vars != Saved )
+	{
+		tAST_OptVar	*var = State->Vars;
+		State->Vars = var->Next;
+		free(var);
+	}
+}
+
+tSpiderTypeRef AST_Optimise_GetVarType(tAST_OptState *State, const char *Name)
+{
+	for( tAST_OptVar *var = State->Vars; var; var = var->Next )
+	{
+		if( strcmp(var->Name, Name) == 0 )
+			return var->Type;
+	}
+	return TYPE_VOID;
+}
+
+tSpiderTypeRef AST_Optimise_CoreType(tSpiderScript_CoreType Core)
+{
+	switch(Core)
+	{
+	case SS_DATATYPE_BOOLEAN:	return TYPE_BOOLEAN;
+	case SS_DATATYPE_INTEGER:	return TYPE_INTEGER;
+	case SS_DATATYPE_REAL:  	return TYPE_REAL;
+	case SS_DATATYPE_STRING:	return TYPE_STRING;
+	default:	return TYPE_VOID;
+	}
+}
+
+/**
+ * \brief Look up a method of a class (the same way as BC_CallFunction)
+ * \return Boolean success, with the method in either \a SF or \a NF
+ */
+int AST_Optimise_FindMethod(tSpiderTypeRef ObjType, const char *Name, tScript_Function **SF, tSpiderFunction **NF)
+{
+	if( ObjType.ArrayDepth || !ObjType.Def )
+		return 0;
+	if( ObjType.Def->Class == SS_TYPECLASS_NCLASS )
+	{
+		for( tSpiderFunction *nf = ObjType.Def->NClass->Methods; nf; nf = nf->Next )
+		{
+			if( strcmp(nf->Name, Name) == 0 ) {
+				*NF = nf;
+				return 1;
+			}
+		}
+	}
+	else if( ObjType.Def->Class == SS_TYPECLASS_SCLASS )
+	{
+		for( tScript_Function *sf = ObjType.Def->SClass->FirstFunction; sf; sf = sf->Next )
+		{
+			if( strcmp(sf->Name, Name) == 0 ) {
+				*SF = sf;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * \brief Get the type of a parameter (TYPE_VOID if past the fixed arguments)
+ */
+tSpiderTypeRef AST_Optimise_ArgType(tScript_Function *SF, tSpiderFunction *NF, int Index)
+{
+	if( SF )
+		return (Index < SF->ArgumentCount ? SF->Arguments[Index].Type : TYPE_VOID);
+	for( int i = 0; i < Index; i ++ )
+	{
+		if( NF->Prototype->Args[i].Def == NULL )
+			return TYPE_VOID;
+	}
+	return NF->Prototype->Args[Index];
+}
+
+tSpiderTypeRef AST_Optimise_GetElementType(tSpiderTypeRef ObjType, const char *Name)
+{
+	if( ObjType.ArrayDepth || !ObjType.Def )
+		return TYPE_VOID;
+	if( ObjType.Def->Class == SS_TYPECLASS_NCLASS )
+	{
+		tSpiderClass	*nc = ObjType.Def->NClass;
+		for( int i = 0; i < nc->NAttributes; i ++ )
+		{
+			if( strcmp(Name, nc->AttributeDefs[i].Name) == 0 )
+				return nc->AttributeDefs[i].Type;
+		}
+	}
+	else if( ObjType.Def->Class == SS_TYPECLASS_SCLASS )
+	{
+		tScript_Class	*sc = ObjType.Def->SClass;
+		for( int i = 0; i < sc->nProperties; i ++ )
+		{
+			if( strcmp(Name, sc->Properties[i]->Name) == 0 )
+				return sc->Properties[i]->Type;
+		}
+	}
+	return TYPE_VOID;
+}
+
+/**
+ * \brief Give `null` the type of the reference it's used as
+ */
+void AST_Optimise_TypeNull(tAST_Node *Node, tSpiderTypeRef Type)
+{
+	if( Node && Node->Type == NODETYPE_NULL && SS_ISTYPEREFERENCE(Type) )
+		Node->DataType = Type;
+}
+
+/**
+ * \brief Adapt a value to the type it's stored/passed as
+ * - `null` takes the type, and with implicit casts numeric constants are converted
+ */
+void AST_Optimise_TypeValue(tAST_OptState *State, tAST_Node *Node, tSpiderTypeRef Type)
+{
+	if( !Node )
+		return ;
+	AST_Optimise_TypeNull(Node, Type);
+	if( State->Script->Variant->bImplicitCasts && _ISCORE(Type) )
+		AST_Optimise_CastConst(Node, Type);
+}
+
+/**
+ * \brief Set the type of a call from the prototype of the function/method/constructor
+ */
+void AST_Optimise_TypeCall(tAST_OptState *State, tAST_Node *Node)
+{
+	const char	*namespaces[] = {NULL};	// TODO: Default/imported namespaces
+	tScript_Function	*sf = NULL;
+	tSpiderFunction 	*nf = NULL;
+	 int	first_arg = 0;	// Parameter taking the first argument
+
+	switch(Node->Type)
+	{
+	case NODETYPE_FUNCTIONCALL: {
+		void	*ident;
+		 int	id = SpiderScript_ResolveFunction(State->Script, namespaces, Node->FunctionCall.Name, &ident);
+		if( id == -1 )
+			return ;
+		// TODO: Assuming the internals is hacky (same as BC_CallFunction)
+		if( id >> 16 )
+			nf = ident;
+		else
+			sf = ident;
+		Node->DataType = (sf ? sf->ReturnType : nf->Prototype->ReturnType);
+		break; }
+	case NODETYPE_METHODCALL:
+		if( !AST_Optimise_FindMethod(Node->FunctionCall.Object->DataType, Node->FunctionCall.Name, &sf, &nf) )
+			return ;
+		// - Parameter 0 is `this`
+		first_arg = 1;
+		Node->DataType = (sf ? sf->ReturnType : nf->Prototype->ReturnType);
+		break;
+	case NODETYPE_CREATEOBJECT: {
+		tSpiderScript_TypeDef	*def = SpiderScript_ResolveObject(State->Script, namespaces, Node->FunctionCall.Name);
+		if( !def )
+			return ;
+		Node->DataType.Def = def;
+		Node->DataType.ArrayDepth = 0;
+		if( def->Class == SS_TYPECLASS_SCLASS ) {
+			AST_Optimise_FindMethod(Node->DataType, CONSTRUCTOR_NAME, &sf, &nf);
+			// - Script class constructors take an implicit `this`
+			first_arg = 1;
+		}
+		else if( def->Class == SS_TYPECLASS_NCLASS ) {
+			nf = def->NClass->Constructor;
+		}
+		break; }
+	default:
+		return ;
+	}
+
+	if( !sf && !nf )
+		return ;
+	 int	i = first_arg;
+	for( tAST_Node *arg = Node->FunctionCall.FirstArg; arg; arg = arg->NextSibling, i ++ )
+	{
+		AST_Optimise_TypeValue(State, arg, AST_Optimise_ArgType(sf, nf, i));
+	}
+}
+
+/**
+ * \brief Get the result type of a binary operation on core types
+ */
+tSpiderTypeRef AST_Optimise_BinOpType(tAST_OptState *State, int Op, tSpiderTypeRef Left, tSpiderTypeRef Right)
+{
+	if( !_ISCORE(Left) || !_ISCORE(Right) )
+		return TYPE_VOID;
+	 int	type = AST_ExecuteNode_BinOp_GetType(State->Script, Op, Left.Def->Core, Right.Def->Core);
+	if( type < 0 && State->Script->Variant->bImplicitCasts )
+		type = AST_ExecuteNode_BinOp_GetType(State->Script, Op, Left.Def->Core, -type);
+	if( type <= 0 )
+		return TYPE_VOID;
+	return AST_Optimise_CoreType(type);
+}
+
+/**
+ * \brief Cast a constant to \a Type
+ * \return Node with the cast value, or NULL if it can't be done now
+ */
+tAST_Node *AST_Optimise_CastConst(tAST_Node *Node, tSpiderTypeRef Type)
+{
+	switch(Node->Type)
+	{
+	case NODETYPE_BOOLEAN:
+	case NODETYPE_STRING:
+		break;
+	case NODETYPE_INTEGER:
+		if( SS_ISCORETYPE(Type, SS_DATATYPE_REAL) ) {
+			tSpiderInteger	val = Node->ConstInt;
+			LOG("Optimised (Real)%li", val);
+			Node->Type = NODETYPE_REAL;
+			Node->ConstReal = val;
+			Node->DataType = Type;
+		}
+		break;
+	case NODETYPE_REAL:
+		// - Out of range values are left to the runtime conversion
+		if( SS_ISCORETYPE(Type, SS_DATATYPE_INTEGER)
+		 && Node->ConstReal > -9.2e18 && Node->ConstReal < 9.2e18 ) {
+			tSpiderReal	val = Node->ConstReal;
+			LOG("Optimised (Integer)%lf", val);
+			Node->Type = NODETYPE_INTEGER;
+			Node->ConstInt = val;
+			Node->DataType = Type;
+		}
+		break;
+	default:
+		return NULL;
+	}
+	return SS_TYPESEQUAL(Node->DataType, Type) ? Node : NULL;
+}
+
+/**
+ * \brief Apply the implicit cast of the right operand of a binary operation
+ * \param bWrap	Insert a cast node if the value isn't constant
+ */
+tAST_Node *AST_Optimise_ImplicitCast(tAST_OptState *State, int Op, tSpiderTypeRef Left, tAST_Node *Right, bool bWrap)
+{
+	if( !State->Script->Variant->bImplicitCasts )
+		return Right;
+	if( !_ISCORE(Left) || !_ISCORE(Right->DataType) )
+		return Right;
+
+	 int	type = AST_ExecuteNode_BinOp_GetType(State->Script, Op, Left.Def->Core, Right->DataType.Def->Core);
+	if( type >= 0 )
+		return Right;
+	tSpiderTypeRef	tgt_type = AST_Optimise_CoreType(-type);
+
+	tAST_Node	*ret = AST_Optimise_CastConst(Right, tgt_type);
+	if( ret )
+		return ret;
+	if( !bWrap )
+		return Right;
+
+	tParser	state = {.Cur={.Line = Right->Line}, .Filename = (char*)Right->File};
+	ret = AST_NewCast(&state, tgt_type, Right);
+	ret->DataType = tgt_type;
+	return ret;
+}
+
+// --- Folding ---
 tAST_Node *AST_Optimise_DoMaths(tAST_Node *Node, tAST_Node *L, tAST_Node *R)
 {
 	switch(L->Type)
@@ -96,7 +413,8 @@ tAST_Node *AST_Optimise_DoMaths(tAST_Node *Node, tAST_Node *L, tAST_Node *R)
 			}
 			break;
 		case NODETYPE_DIVIDE:
-			if(R->Type == NODETYPE_INTEGER) {
+			// - Division by zero (and the overflowing MIN/-1) is left to the runtime
+			if(R->Type == NODETYPE_INTEGER && R->ConstInt != 0 && R->ConstInt != -1) {
 				LOG("Optimised %li/%li", L->ConstInt, R->ConstInt);
 				L->ConstInt /= R->ConstInt;
 				return L;
@@ -106,7 +424,7 @@ tAST_Node *AST_Optimise_DoMaths(tAST_Node *Node, tAST_Node *L, tAST_Node *R)
 			break;
 		}
 		break;
-	
+
 	case NODETYPE_REAL:
 		switch(Node->Type)
 		{
@@ -140,22 +458,90 @@ tAST_Node *AST_Optimise_DoMaths(tAST_Node *Node, tAST_Node *L, tAST_Node *R)
 	return NULL;
 }
 
-tAST_Node *AST_Optimise(tAST_Node *const Node)
+/**
+ * \brief Fold a unary operation on a constant
+ * \return Constant node with the result, or NULL
+ */
+tAST_Node *AST_Optimise_DoUniOp(tAST_Node *Node, tAST_Node *Value)
+{
+	switch(Node->Type)
+	{
+	case NODETYPE_BWNOT:
+		if( Value->Type == NODETYPE_INTEGER ) {
+			Value->ConstInt = ~Value->ConstInt;
+			return Value;
+		}
+		break;
+	case NODETYPE_LOGICALNOT:
+		switch( Value->Type )
+		{
+		case NODETYPE_BOOLEAN:
+			Value->ConstBoolean = !Value->ConstBoolean;
+			return Value;
+		case NODETYPE_INTEGER:
+			Value->ConstBoolean = (Value->ConstInt == 0);
+			break;
+		case NODETYPE_REAL:
+			Value->ConstBoolean = (Value->ConstReal == 0);
+			break;
+		default:
+			return NULL;
+		}
+		Value->Type = NODETYPE_BOOLEAN;
+		Value->DataType = TYPE_BOOLEAN;
+		return Value;
+	case NODETYPE_NEGATE:
+		switch( Value->Type )
+		{
+		case NODETYPE_INTEGER:	Value->ConstInt  = -(uint64_t)Value->ConstInt;	return Value;
+		case NODETYPE_REAL:	Value->ConstReal = -Value->ConstReal;	return Value;
+		default:	break;
+		}
+		break;
+	default:
+		break;
+	}
+	return NULL;
+}
+
+/**
+ * \brief Optimise a function's code, and infer the types of its nodes
+ */
+tAST_Node *AST_Optimise(tSpiderScript *Script, tScript_Function *Fcn, tAST_Node *Node)
+{
+	tAST_OptState	state = {.Script = Script, .Function = Fcn};
+
+	for( int i = 0; i < Fcn->ArgumentCount; i ++ )
+		AST_Optimise_DefineVar(&state, Fcn->Arguments[i].Type, Fcn->Arguments[i].Name);
+
+	Node = AST_Optimise_int(&state, Node);
+
+	AST_Optimise_EndScope(&state, NULL);
+	return Node;
+}
+
+tAST_Node *AST_Optimise_int(tAST_OptState *State, tAST_Node *const Node)
 {
 	tAST_Node	*l;
 	tAST_Node	*r;
 	tAST_Node	*tmp;
+	tAST_OptVar	*saved_vars = State->Vars;
+	tSpiderTypeRef	type;
 
 	if( !Node )
-		return NULL;	
+		return NULL;
 
 	//LOG("Node=%p(%i)", Node, Node->Type);
+	Node->DataType = TYPE_VOID;
 	switch(Node->Type)
 	{
 	case NODETYPE_BLOCK:
-		l = Node->Block.FirstChild = AST_Optimise_OptList(Node->Block.FirstChild);
+		l = Node->Block.FirstChild = AST_Optimise_OptList(State, Node->Block.FirstChild);
+		AST_Optimise_EndScope(State, saved_vars);
 		// Reduce single-operation blocks
-		if( l && l->NextSibling == NULL )
+		// - Definitions keep their block, so they don't leak into the parent scope
+		if( l && l->NextSibling == NULL
+		 && l->Type != NODETYPE_DEFVAR && l->Type != NODETYPE_DEFGLOBAL )
 		{
 			LOG("Optimised single item block");
 			Node->Block.FirstChild = NULL;
@@ -168,28 +554,42 @@ tAST_Node *AST_Optimise(tAST_Node *const Node)
 		_OPT(Node->Assign.Dest);
 		_OPT(Node->Assign.Value);
 		Node->DataType = Node->Assign.Dest->DataType;
+		if( Node->Assign.Operation == NODETYPE_NOP ) {
+			AST_Optimise_TypeValue(State, Node->Assign.Value, Node->DataType);
+		}
+		else {
+			// - The operation is done in place, so the value has to be cast beforehand
+			Node->Assign.Value = AST_Optimise_ImplicitCast(State, Node->Assign.Operation,
+				Node->DataType, Node->Assign.Value, true);
+		}
 		break;
-	
+
 	case NODETYPE_FUNCTIONCALL:
 	case NODETYPE_METHODCALL:
-		Node->FunctionCall.FirstArg = AST_Optimise_OptList( Node->FunctionCall.FirstArg );
+	case NODETYPE_CREATEOBJECT:
 		if( Node->Type == NODETYPE_METHODCALL )
 			_OPT(Node->FunctionCall.Object);
-		// TODO: Resolve function and get datatype
-		break;
-	case NODETYPE_CREATEOBJECT:
-		Node->FunctionCall.FirstArg = AST_Optimise_OptList( Node->FunctionCall.FirstArg );
+		Node->FunctionCall.FirstArg = AST_Optimise_OptList( State, Node->FunctionCall.FirstArg );
+		AST_Optimise_TypeCall(State, Node);
 		break;
 
 	case NODETYPE_CREATEARRAY:
-	case NODETYPE_CAST:
 		_OPT(Node->Cast.Value);
 		Node->DataType = Node->Cast.DataType;
 		break;
-	
+	case NODETYPE_CAST:
+		l = _OPT(Node->Cast.Value);
+		Node->DataType = Node->Cast.DataType;
+		// Constants are cast now
+		if( (tmp = AST_Optimise_CastConst(l, Node->DataType)) ) {
+			Node->Cast.Value = NULL;
+			AST_FreeNode(Node);
+			return tmp;
+		}
+		break;
+
 	// If/Ternary node
 	case NODETYPE_IF:
-		//Node->DataType = SS_DATATYPE_NOVALUE;
 		_OPT(Node->If.Condition);
 		_OPT(Node->If.True);
 		_OPT(Node->If.False);
@@ -200,96 +600,130 @@ tAST_Node *AST_Optimise(tAST_Node *const Node)
 		_OPT(Node->If.False);
 		l = (Node->If.True ? Node->If.True : Node->If.Condition);
 		r = Node->If.False;
+		// - `null` takes the type of the other value
+		AST_Optimise_TypeNull(r, l->DataType);
+		AST_Optimise_TypeNull(Node->If.True, r->DataType);
 		if( !SS_TYPESEQUAL(l->DataType, r->DataType) ) {
-			// Type mismatch?
+			// Type mismatch? (reported by codegen)
 		}
-		Node->DataType = Node->If.False->DataType;
+		Node->DataType = (l->DataType.Def ? l->DataType : r->DataType);
 		break;
-	
+
 	// Looping Construct (For loop node)
 	case NODETYPE_LOOP:
 		_OPT(Node->For.Init);
 		_OPT(Node->For.Condition);
 		_OPT(Node->For.Increment);
 		_OPT(Node->For.Code);
-		//Node->DataType = SS_DATATYPE_NOVALUE;
+		AST_Optimise_EndScope(State, saved_vars);
 		break;
 	case NODETYPE_ITERATE:
-		_OPT(Node->Iterator.Code);
 		_OPT(Node->Iterator.Value);
+		type = Node->Iterator.Value->DataType;
+		if( SS_GETARRAYDEPTH(type) )
+			type.ArrayDepth --;
+		else
+			type = TYPE_VOID;
+		if( Node->Iterator.IndexVar )
+			AST_Optimise_DefineVar(State, TYPE_INTEGER, Node->Iterator.IndexVar);
+		AST_Optimise_DefineVar(State, type, Node->Iterator.ValueVar);
+		_OPT(Node->Iterator.Code);
+		AST_Optimise_EndScope(State, saved_vars);
 		break;
-	
+	case NODETYPE_TRYCATCH:
+		_OPT(Node->TryCatch.Code);
+		AST_Optimise_DefineVar(State, Node->TryCatch.CatchVar->DefVar.DataType,
+			Node->TryCatch.CatchVar->DefVar.Name);
+		_OPT(Node->TryCatch.Catch);
+		AST_Optimise_EndScope(State, saved_vars);
+		break;
+
 	case NODETYPE_SWITCH:
 		_OPT(Node->BinOp.Left);
-		Node->BinOp.Right = AST_Optimise_OptList( Node->BinOp.Right );
-		//Node->DataType = SS_DATATYPE_NOVALUE;
+		Node->BinOp.Right = AST_Optimise_OptList( State, Node->BinOp.Right );
+		AST_Optimise_EndScope(State, saved_vars);
 		break;
 	case NODETYPE_CASE:
 		_OPT(Node->BinOp.Left);
 		_OPT(Node->BinOp.Right);
-		//Node->DataType = SS_DATATYPE_NOVALUE;
 		break;
-	
+
 	case NODETYPE_ELEMENT:
 		_OPT(Node->Scope.Element);
-		// TODO: Resolve object to get type of element
+		Node->DataType = AST_Optimise_GetElementType(Node->Scope.Element->DataType, Node->Scope.Name);
 		break;
-	
+
 	// Define a variable
 	case NODETYPE_DEFVAR:
 	case NODETYPE_DEFGLOBAL:
 		_OPT(Node->DefVar.InitialValue);
+		type = Node->DefVar.DataType;
+		if( Node->DefVar.InitialValue )
+		{
+			// `auto` takes the type of the initial value
+			if( SS_TYPESEQUAL(type, TYPE_VOID) )
+				type = Node->DefVar.InitialValue->DataType;
+			else
+				AST_Optimise_TypeValue(State, Node->DefVar.InitialValue, type);
+		}
+		AST_Optimise_DefineVar(State, type, Node->DefVar.Name);
 		break;
-	
+
 	// Unary Operations
 	case NODETYPE_RETURN:
+		_OPT(Node->UniOp.Value);
+		AST_Optimise_TypeValue(State, Node->UniOp.Value, State->Function->ReturnType);
+		break;
 	case NODETYPE_POSTINC:
 	case NODETYPE_POSTDEC:
+		_OPT(Node->UniOp.Value);
+		Node->DataType = Node->UniOp.Value->DataType;
+		break;
 	case NODETYPE_DELETE:
 		_OPT(Node->UniOp.Value);
 		break;
 	case NODETYPE_BWNOT:
-		l = _OPT(Node->UniOp.Value);
-		switch( l->Type )
-		{
-		case NODETYPE_INTEGER:	l->ConstInt = ~l->ConstInt;	break;
-		default:	break;
-		}
-		break;
 	case NODETYPE_LOGICALNOT:
-		l = _OPT(Node->UniOp.Value);
-		switch( l->Type )
-		{
-		case NODETYPE_BOOLEAN:
-			l->ConstBoolean = !l->ConstBoolean;
-			break;
-		case NODETYPE_INTEGER:
-			l->Type = NODETYPE_BOOLEAN;
-			l->ConstBoolean = (l->ConstInt != 0);
-			break;
-		default:	break;
-		}
-		break;
 	case NODETYPE_NEGATE:
 		l = _OPT(Node->UniOp.Value);
-		switch( l->Type )
-		{
-		case NODETYPE_INTEGER:	l->ConstInt  = -l->ConstInt;	break;
-		case NODETYPE_REAL:	l->ConstReal = -l->ConstReal;	break;
-		default:	break;
+		if( (tmp = AST_Optimise_DoUniOp(Node, l)) ) {
+			Node->UniOp.Value = NULL;
+			AST_FreeNode(Node);
+			return tmp;
 		}
+		if( _ISCORE(l->DataType) )
+			Node->DataType = AST_Optimise_CoreType(
+				AST_ExecuteNode_UniOp_GetType(State->Script, Node->Type, l->DataType.Def->Core));
 		break;
-	
+
 	case NODETYPE_INDEX:
+		l = _OPT( Node->BinOp.Left );
+		_OPT( Node->BinOp.Right );
+		type = l->DataType;
+		if( SS_GETARRAYDEPTH(type) ) {
+			type.ArrayDepth --;
+			Node->DataType = type;
+		}
+		else {
+			tScript_Function	*sf = NULL;
+			tSpiderFunction 	*nf = NULL;
+			if( AST_Optimise_FindMethod(type, "operator []", &sf, &nf) )
+				Node->DataType = (sf ? sf->ReturnType : nf->Prototype->ReturnType);
+		}
+		break;
 	case NODETYPE_REFEQUALS:
 	case NODETYPE_REFNOTEQUALS:
-		_OPT( Node->BinOp.Left );
-		_OPT( Node->BinOp.Right );
+		l = _OPT( Node->BinOp.Left );
+		r = _OPT( Node->BinOp.Right );
+		AST_Optimise_TypeNull(r, l->DataType);
+		AST_Optimise_TypeNull(l, r->DataType);
+		Node->DataType = TYPE_BOOLEAN;
 		break;
-	
+
 	case NODETYPE_ADD:
 		l = _OPT(Node->BinOp.Left);
 		r = _OPT(Node->BinOp.Right);
+		r = Node->BinOp.Right = AST_Optimise_ImplicitCast(State, Node->Type, l->DataType, r, false);
 
 		// TODO: If implicit casting is enabled, convert string + ???
 		// into Lang.Strings.Concat(string, ???)
@@ -316,7 +750,7 @@ tAST_Node *AST_Optimise(tAST_Node *const Node)
 			}
 		}
 		#endif
-		
+
 		// String merging
 		if(l->Type == r->Type && l->Type == NODETYPE_STRING)
 		{
@@ -330,13 +764,14 @@ tAST_Node *AST_Optimise(tAST_Node *const Node)
 			AST_FreeNode(Node);
 			return l;
 		}
-		
+
 		// Maths
 		if( (tmp = AST_Optimise_DoMaths(Node, l, r)) ) {
 			Node->BinOp.Left = NULL;
 			AST_FreeNode(Node);
 			return tmp;
 		}
+		Node->DataType = AST_Optimise_BinOpType(State, Node->Type, l->DataType, r->DataType);
 		break;
 	case NODETYPE_SUBTRACT:
 	case NODETYPE_MULTIPLY:
@@ -346,52 +781,60 @@ tAST_Node *AST_Optimise(tAST_Node *const Node)
 	case NODETYPE_BITSHIFTRIGHT:
 		l = _OPT(Node->BinOp.Left);
 		r = _OPT(Node->BinOp.Right);
-		
+		r = Node->BinOp.Right = AST_Optimise_ImplicitCast(State, Node->Type, l->DataType, r, false);
+
 		if( (tmp = AST_Optimise_DoMaths(Node, l, r)) ) {
 			Node->BinOp.Left = NULL;
 			AST_FreeNode(Node);
 			return tmp;
 		}
+		Node->DataType = AST_Optimise_BinOpType(State, Node->Type, l->DataType, r->DataType);
+		break;
+
+	case NODETYPE_LOGICALAND:
+	case NODETYPE_LOGICALOR:
+		_OPT(Node->BinOp.Left);
+		_OPT(Node->BinOp.Right);
+		Node->DataType = TYPE_BOOLEAN;
 		break;
-	
 	case NODETYPE_BITROTATELEFT:
-	case NODETYPE_BWAND:	case NODETYPE_LOGICALAND:
-	case NODETYPE_BWOR: 	case NODETYPE_LOGICALOR:
+	case NODETYPE_BWAND:
+	case NODETYPE_BWOR:
 	case NODETYPE_BWXOR:	case NODETYPE_LOGICALXOR:
-		l = _OPT(Node->BinOp.Left);
-		r = _OPT(Node->BinOp.Right);
-		break;
 	case NODETYPE_EQUALS:	case NODETYPE_NOTEQUALS:
 	case NODETYPE_GREATERTHAN:	case NODETYPE_GREATERTHANEQUAL:
 	case NODETYPE_LESSTHAN:	case NODETYPE_LESSTHANEQUAL:
 		l = _OPT(Node->BinOp.Left);
 		r = _OPT(Node->BinOp.Right);
+		r = Node->BinOp.Right = AST_Optimise_ImplicitCast(State, Node->Type, l->DataType, r, false);
+		Node->DataType = AST_Optimise_BinOpType(State, Node->Type, l->DataType, r->DataType);
 		break;
-	
+
 	case NODETYPE_VARIABLE:
 		// TODO: Determine if variable's value is constantly known at this point, and replace
+		Node->DataType = AST_Optimise_GetVarType(State, Node->Variable.Name);
 		break;
-	
+
 	// Node types that don't optimise (leaf nodes)
 	case NODETYPE_NOP:
 	case NODETYPE_BREAK:
 	case NODETYPE_CONTINUE:
-		//Node->DataType = SS_DATATYPE_NOVALUE;
 		break;
 	case NODETYPE_CONSTANT:
-		//Node->DataType = SS_DATATYPE_VOID;
 		break;
 	case NODETYPE_STRING:
-		//Node->DataType = SS_DATATYPE_STRING;
+		Node->DataType = TYPE_STRING;
 		break;
 	case NODETYPE_INTEGER:
-		//Node->DataType = SS_DATATYPE_INTEGER;
+		Node->DataType = TYPE_INTEGER;
 		break;
 	case NODETYPE_REAL:
-		//Node->DataType = SS_DATATYPE_REAL;
+		Node->DataType = TYPE_REAL;
+		break;
 	case NODETYPE_BOOLEAN:
-		//Node->DataType = SS_DATATYPE_BOOLEAN;
+		Node->DataType = TYPE_BOOLEAN;
 		break;
+	// - Typed by the node using it (see AST_Optimise_TypeNull)
 	case NODETYPE_NULL:
 		break;
 	}
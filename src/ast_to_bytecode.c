@@ -16,8 +16,8 @@
 #define TRACE_VAR_LOOKUPS	0
 #define TRACE_TYPE_STACK	0
 #define MAX_NAMESPACE_DEPTH	10
-#define MAX_REGISTERS	64	// This is for one function
-#define MAX_GLOBALS	32
+#define INITIAL_REGISTERS	64	// Registers tracked per function, grown up to the frame budget
+#define INITIAL_GLOBALS	8
 
 #define TYPE_VOID	((tSpiderTypeRef){0,0})
 #define TYPE_STRING	((tSpiderTypeRef){.ArrayDepth=0,.Def=&gSpiderScript_StringType})
@@ -46,16 +46,22 @@ typedef struct sAST_FuncInfo
 	
 	 int	MaxRegisters;
 	 int	NumAllocatedRegs;
+	 int	RegSpace;	// Size of Registers (see _GrowRegisters)
 	struct sRegInfo {
 		tAST_Node	*Node;
 		tSpiderTypeRef	Type;
 		void	*Info;
 		 int	RefCount;
-	}	Registers[MAX_REGISTERS];	// Stores types of stack values
+		bool	Cleared;	// Value moved out by a window call, no CLEARREG needed
+	}	*Registers;	// Stores types of stack values
 
 	 int	MaxGlobals;
 	 int	NumGlobals;	
-	tScript_Var	*ImportedGlobals[MAX_GLOBALS];	
+	 int	GlobalSpace;	// Size of ImportedGlobals
+	tScript_Var	**ImportedGlobals;	
+
+	tAST_Node	*TailCall;	// Call node whose value is returned directly
+	 int	TryDepth;	// Number of try blocks being converted
 } tAST_FuncInfo;
 typedef struct sAST_BlockInfo
 {
@@ -82,6 +88,8 @@ typedef struct sAST_BlockInfo
  int	BC_FinaliseBlock(tAST_BlockInfo *ParentBlock, tAST_Node *Node, tAST_BlockInfo *ChildBlock);
  int	BC_ConstructObject(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *Result, const char *Namespaces[], const char *Name, int NArgs, tRegister ArgRegs[], bool VArgsPassThrough);
  int	BC_CallFunction(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *Result, const char *Namespaces[], const char *Name, int NArgs, tRegister ArgRegs[], bool VArgsPassThrough);
+ int	BC_int_CallWindow(tAST_BlockInfo *Block, tAST_Node *Node, bool IsMethod, int ID, tRegister RetReg, int NArgs, tRegister ArgRegs[]);
+ int	BC_int_CondJump(tAST_BlockInfo *Block, tAST_Node *Node, bool JumpIf, int Label);
  int	BC_int_GetElement(tAST_BlockInfo *Block, tAST_Node *Node, tSpiderTypeRef ObjType, const char *Name, tSpiderTypeRef *EleType);
  int	BC_SaveValue(tAST_BlockInfo *Block, tAST_Node *DestNode, tRegister Register);
  int	BC_CastValue(tAST_BlockInfo *Block, tAST_Node *Node, tSpiderTypeRef DestType, tRegister SrcReg, tRegister *Result);
@@ -90,14 +98,18 @@ typedef struct sAST_BlockInfo
 const tScript_Var	*BC_Variable_LookupGlobal(tAST_BlockInfo *Block, tAST_Node *Node, const char *Name, int *Index);
 const tVariable	*BC_Variable_Lookup(tAST_BlockInfo *Block, tAST_Node *Node, const char *Name, tSpiderTypeRef CreateType);
  int 	BC_Variable_Define(tAST_BlockInfo *Block, tAST_Node *DefNode, tSpiderTypeRef Type, const char *Name, const tVariable **VarPtr);
+ int 	BC_Variable_DefineReg(tAST_BlockInfo *Block, tAST_Node *DefNode, tSpiderTypeRef Type, const char *Name, tRegister Reg, const tVariable **VarPtr);
  int	BC_Variable_DefImportGlobal(tAST_BlockInfo *Block, tAST_Node *DefNode, tSpiderTypeRef Type, const char *Name);
  int	BC_Variable_SetValue(tAST_BlockInfo *Block, tAST_Node *VarNode, tRegister Register);
  int	BC_Variable_GetValue(tAST_BlockInfo *Block, tAST_Node *VarNode, tRegister *Result);
 void	BC_Variable_Delete(tAST_BlockInfo *Block, tVariable *Var);
 void	BC_Variable_Clear(tAST_BlockInfo *Block);
+ int	BC_Variable_GrowGlobals(tAST_FuncInfo *Func, int Count);
  int	BC_BinOp(tAST_BlockInfo *Block, int Operation, tRegister RegOut, tRegister RegL, tRegister RegR);
 // - Type stack
+ int	_GrowRegisters(tAST_FuncInfo *Func, int Count);
  int	_AllocateRegister(tAST_BlockInfo *Block, tAST_Node *Node, tSpiderTypeRef Type, void *Info, tRegister *RegPtr);
+ int	_AllocateRegisterPair(tAST_BlockInfo *Block, tAST_Node *Node, tSpiderTypeRef Type0, tSpiderTypeRef Type1, tRegister *RegPtr);
 void	_DumpRegisters(const tAST_BlockInfo *Block);
  int	_ReferenceRegister(tAST_BlockInfo *Block, tRegister Reg);
  int	_GetRegisterInfo(tAST_BlockInfo *Block, tRegister Register, tSpiderTypeRef *Type, void **Info);
@@ -148,7 +160,7 @@ tBC_Function *Bytecode_ConvertFunction(tSpiderScript *Script, tScript_Function *
 	fi.Script = Script;
 	bi.Func = &fi;
 
-	Fcn->ASTFcn = AST_Optimise(Fcn->ASTFcn);
+	Fcn->ASTFcn = AST_Optimise(Script, Fcn, Fcn->ASTFcn);
 
 	DEBUGS1("%p %s %i args", Fcn, Fcn->Name, Fcn->ArgumentCount);
 	
@@ -159,15 +171,20 @@ tBC_Function *Bytecode_ConvertFunction(tSpiderScript *Script, tScript_Function *
 		if(rv) {
 			AST_RuntimeError(Script, Fcn->ASTFcn, "Error in creating arguments");
 			BC_Variable_Clear(&bi);
+			free(fi.Registers);
 			Bytecode_DeleteFunction(ret);
 			return NULL;
 		}
 	}
 
+	// - Bodies optimised down to a single statement have no block to note their position
+	Bytecode_AppendPos(ret, Fcn->ASTFcn->File, Fcn->ASTFcn->Line);
 	if( AST_ConvertNode(&bi, Fcn->ASTFcn, 0) )
 	{
 		AST_RuntimeError(Script, Fcn->ASTFcn, "Error in converting function");
 		BC_Variable_Clear(&bi);
+		free(fi.Registers);
+		free(fi.ImportedGlobals);
 		Bytecode_DeleteFunction(ret);
 		return NULL;
 	}
@@ -177,6 +194,8 @@ tBC_Function *Bytecode_ConvertFunction(tSpiderScript *Script, tScript_Function *
 		AST_RuntimeError(Script, Fcn->ASTFcn, "Leaked regs when converting %s", Fcn->Name);
 		_DumpRegisters(&bi);
 	}
+	free(fi.Registers);
+	free(fi.ImportedGlobals);
 
 	Bytecode_CommitFunction(ret, fi.MaxRegisters+1, fi.MaxGlobals+1);
 
@@ -184,6 +203,7 @@ tBC_Function *Bytecode_ConvertFunction(tSpiderScript *Script, tScript_Function *
 //	Bytecode_AppendConstInt(ret, 0);
 //	Bytecode_AppendReturn(ret);
 	Fcn->BCFcn = ret;
+	Bytecode_VerifyFunction(Script, Fcn);
 
 	return ret;
 }
@@ -422,8 +442,6 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 	// Conditional
 	case NODETYPE_IF: {
 		 int	if_end;
-		ret = AST_ConvertNode(Block, Node->If.Condition, &vreg);
-		if(ret)	return ret;
 		// Note: Technically should be boolean, but there's logic in execution to handle it
 	
 		if_end = Bytecode_AllocateLabel(Block->Func->Handle);
@@ -432,7 +450,8 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 		{
 			 int	if_true = Bytecode_AllocateLabel(Block->Func->Handle);
 			
-			Bytecode_AppendCondJump(Block->Func->Handle, if_true, vreg);
+			ret = BC_int_CondJump(Block, Node->If.Condition, true, if_true);
+			if(ret)	return ret;
 	
 			// False
 			ret = AST_ConvertNode(Block, Node->If.False, NULL);
@@ -442,11 +461,10 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 		}
 		else
 		{
-			Bytecode_AppendCondJumpNot(Block->Func->Handle, if_end, vreg);
+			ret = BC_int_CondJump(Block, Node->If.Condition, false, if_end);
+			if(ret)	return ret;
 		}
 		
-		_ReleaseRegister(Block, vreg);
-		
 		// True
 		ret = AST_ConvertNode(Block, Node->If.True, NULL);
 		if(ret)	return ret;
@@ -460,12 +478,6 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 	// Ternary
 	case NODETYPE_TERNARY: {
 		tRegister result_reg;
-		ret = AST_ConvertNode(Block, Node->If.Condition, &vreg);
-		if(ret)	return ret;
-
-		ret = _GetRegisterInfo(Block, vreg, &type, NULL);
-		if(ret)	return ret;
-		
 		int if_end = Bytecode_AllocateLabel(Block->Func->Handle);
 		
 		if( Node->If.True )
@@ -473,8 +485,8 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 			int if_false = Bytecode_AllocateLabel(Block->Func->Handle);
 			tRegister	trueval_reg, falseval_reg;
 			// Actual Ternary
-			Bytecode_AppendCondJumpNot(Block->Func->Handle, if_false, vreg);
-			_ReleaseRegister(Block, vreg);
+			ret = BC_int_CondJump(Block, Node->If.Condition, false, if_false);
+			if(ret)	return ret;
 			
 			// - True
 			ret = AST_ConvertNode(Block, Node->If.True, &trueval_reg);
@@ -499,6 +511,11 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 		}
 		else
 		{
+			ret = AST_ConvertNode(Block, Node->If.Condition, &vreg);
+			if(ret)	return ret;
+			ret = _GetRegisterInfo(Block, vreg, &type, NULL);
+			if(ret)	return ret;
+			
 			Block->NullType = type;
 			// Null-Coalescing
 			ret = _AllocateRegister(Block, Node, type, NULL, &result_reg);
@@ -546,11 +563,9 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 		// Check initial condition
 		if( !Node->For.bCheckAfter )
 		{
-			ret = AST_ConvertNode(Block, Node->For.Condition, &vreg);
-			if(ret)	return ret;
 			// Boolean magic in exec_bytecode.c
-			Bytecode_AppendCondJumpNot(Block->Func->Handle, loop_end, vreg);
-			_ReleaseRegister(Block, vreg);
+			ret = BC_int_CondJump(Block, Node->For.Condition, false, loop_end);
+			if(ret)	return ret;
 		}
 	
 		// Code
@@ -566,11 +581,9 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 		// Tail check
 		if( Node->For.bCheckAfter )
 		{
-			ret = AST_ConvertNode(Block, Node->For.Condition, &vreg);
-			if(ret)	return ret;
 			// Boolean magic in exec_bytecode.c
-			Bytecode_AppendCondJump(Block->Func->Handle, loop_start, vreg);
-			_ReleaseRegister(Block, vreg);
+			ret = BC_int_CondJump(Block, Node->For.Condition, true, loop_start);
+			if(ret)	return ret;
 		}
 		else
 		{
@@ -593,6 +606,29 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 		ret = _GetRegisterInfo(Block, vreg, &type, NULL);
 		if(ret)	return ret;
 		
+		// Arrays yield their elements, Strings their bytes (as integers)
+		tSpiderTypeRef	valtype;
+		if( SS_GETARRAYDEPTH(type) ) {
+			valtype = type;
+			valtype.ArrayDepth -= 1;
+		}
+		else if( SS_ISCORETYPE(type, SS_DATATYPE_STRING) ) {
+			valtype = TYPE_INTEGER;
+		}
+		else {
+			AST_NODEERROR("foreach on unsupported type %s",
+				SpiderScript_GetTypeName(Block->Func->Script, type));
+			return -1;
+		}
+
+		// Iterator state, (collection, index) in a register pair
+		// - The pair holds its own reference to the collection
+		tRegister	state;
+		ret = _AllocateRegisterPair(Block, Node, type, TYPE_INTEGER, &state);
+		if(ret)	return ret;
+		Bytecode_AppendForeachInit(Block->Func->Handle, state, vreg);
+		_ReleaseRegister(Block, vreg);
+		
 		tAST_BlockInfo	blockInfo = {0};
 		tAST_BlockInfo	*parentBlock = Block;
 		BC_PrepareBlock(parentBlock, &blockInfo);
@@ -604,115 +640,83 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 		Block->BreakTarget = loop_end;
 		Block->ContinueTarget = loop_start;
 		
-		if( SS_GETARRAYDEPTH(type) )
-		{
-			tRegister	iterator;
-			tRegister	maximum;
-			tRegister	comparison;
-			// Get length, iterate 0 ... n-1
-			
-			if( Node->Iterator.IndexVar != NULL ) {
-				const tVariable *var;
-				ret = BC_Variable_Define(Block, Node, TYPE_INTEGER, Node->Iterator.IndexVar, &var);
-				if(ret)	return ret;
-				iterator = var->Register;
-			}
-			else {
-				ret = _AllocateRegister(Block, Node, TYPE_INTEGER, NULL, &iterator);	// Iterator
-				if(ret)	return ret;
-			}
-		
-			// Initialise loop state (iterator=-1,max=sizeof(array))	
-			Bytecode_AppendConstInt(Block->Func->Handle, iterator, -1);
-			const char *namespaces[] = {NULL};
-			tRegister	args[] = {vreg};
-			ret = BC_CallFunction(Block, Node, &maximum, namespaces, "sizeof", 1, args, false);
-			if(ret)	return ret;
-			ret = _AssertRegType(Block, Node, maximum, TYPE_INTEGER);
-			if(ret)	return ret;
-
-			// Create value variable
-			type.ArrayDepth -= 1;
-			const tVariable *var;
-			ret = BC_Variable_Define(Block, Node, type, Node->Iterator.ValueVar, &var);
-			if(ret)	return ret;
-		
-			// Loop header (increment, comparison)
-			Bytecode_SetLabel(Block->Func->Handle, loop_start);
-			ret = _AllocateRegister(Block, Node, TYPE_INTEGER, NULL, &comparison);
+		// The index variable is the iterator's index register
+		if( Node->Iterator.IndexVar != NULL ) {
+			ret = BC_Variable_DefineReg(Block, Node, TYPE_INTEGER, Node->Iterator.IndexVar, state+1, NULL);
 			if(ret)	return ret;
-			Bytecode_AppendConstInt(Block->Func->Handle, comparison, 1);
-			Bytecode_AppendBinOpInt(Block->Func->Handle, BINOP_ADD, iterator, iterator, comparison);
-			Bytecode_AppendBinOpInt(Block->Func->Handle, BINOP_GE, comparison, iterator, maximum);
-			Bytecode_AppendCondJump(Block->Func->Handle, loop_end, comparison);
-			_ReleaseRegister(Block, comparison);
-			
-			// Set iteration variable
-			Bytecode_AppendIndex(Block->Func->Handle, var->Register, vreg, iterator);
-			
-			// Content
-			ret = AST_ConvertNode(Block, Node->Iterator.Code, NULL);
-			if(ret)	return ret;
-			
-			// Loop tail
-			Bytecode_AppendJump(Block->Func->Handle, loop_start);
-			Bytecode_SetLabel(Block->Func->Handle, loop_end);
-			
-			if( Node->Iterator.IndexVar == NULL )
-				_ReleaseRegister(Block, iterator);
-			_ReleaseRegister(Block, maximum);
-		}
-		else
-		{
-			// oops :)
-			AST_NODEERROR("foreach on unsupported type");
 		}
+		const tVariable *var;
+		ret = BC_Variable_Define(Block, Node, valtype, Node->Iterator.ValueVar, &var);
+		if(ret)	return ret;
+		
+		// Loop header (advance, exit once exhausted, load the value)
+		Bytecode_SetLabel(Block->Func->Handle, loop_start);
+		Bytecode_AppendForeachNext(Block->Func->Handle, loop_end, state, var->Register);
+		
+		// Content
+		ret = AST_ConvertNode(Block, Node->Iterator.Code, NULL);
+		if(ret)	return ret;
+		
+		// Loop tail
+		Bytecode_AppendJump(Block->Func->Handle, loop_start);
+		Bytecode_SetLabel(Block->Func->Handle, loop_end);
 		
 		Block = parentBlock;
-		_ReleaseRegister(Block, vreg);
 		BC_FinaliseBlock(Block, Node, &blockInfo);
+		_ReleaseRegister(Block, state);
+		_ReleaseRegister(Block, state+1);
 		NO_RESULT();
 		break; }
 
-	// Try/catch block
-#if 0
-	case NODETYPE_TRY: {
+	// Exception handler
+	// - The try block's range is recorded in the function's handler table, so entering and
+	//   leaving it costs nothing (see Bytecode_int_FindHandler)
+	case NODETYPE_TRYCATCH: {
+		tAST_Node	*var_node = Node->TryCatch.CatchVar;
+		 int	catch_type;
+		if( SS_TYPESEQUAL(var_node->DefVar.DataType, TYPE_INTEGER) )
+			catch_type = SS_DATATYPE_INTEGER;
+		else if( SS_TYPESEQUAL(var_node->DefVar.DataType, TYPE_STRING) )
+			catch_type = SS_DATATYPE_STRING;
+		else {
+			AST_NODEERROR("Can't catch an exception as %s (Integer number or String message)",
+				SpiderScript_GetTypeName(Block->Func->Script, var_node->DefVar.DataType));
+			return -1;
+		}
+		
+		 int	try_start = Bytecode_AllocateLabel(Block->Func->Handle);
+		 int	try_end = Bytecode_AllocateLabel(Block->Func->Handle);
 		 int	handler = Bytecode_AllocateLabel(Block->Func->Handle);
 		 int	post_handler = Bytecode_AllocateLabel(Block->Func->Handle);
-		// TODO: Support finally?
-		// 'finally': is called before stack unwinding, and upon leaving try/catch
-		
 
-		Bytecode_AppendPushExceptHandler(Block->Func->Handle, handler);
+		Bytecode_SetLabel(Block->Func->Handle, try_start);
+		// - Tail calls would leave the frame that catches the exception
+		Block->Func->TryDepth ++;
 		ret = AST_ConvertNode(Block, Node->TryCatch.Code, NULL);
+		Block->Func->TryDepth --;
 		if(ret)	return ret;
-
+		Bytecode_SetLabel(Block->Func->Handle, try_end);
 		Bytecode_AppendJump(Block->Func->Handle, post_handler);
-		Bytecode_SetLabel(Block->Func->Handle, handler);
 
-		for( tAST_Node *cnode = Node->TryCatch.FirstCatch; cnode; cnode = cnode->NextSibling )
-		{
-			int next = Bytecode_AllocateLabel(Block->Func->Handle);
-			// TODO: Create block
-			const tVariable *var;
-			ret = BC_Variable_Define(Block, cnode, cnode->Catch.Type, cnode->Catch.Name, &var);
-			if(ret)	return ret;
-			Bytecode_AppendCheckException(Block->Func->Handle, cnode->Catch.Type, var->Register, next);
-
-			ret = AST_ConvertNode(Block, cnode->Catch.Code, NULL);
-			if(ret)	return ret;
+		tAST_BlockInfo	blockInfo = {0};
+		tAST_BlockInfo	*parentBlock = Block;
+		BC_PrepareBlock(parentBlock, &blockInfo);
+		Block = &blockInfo;
 
-			BC_Variable_Delete(Block, BC_Variable_Lookup(Block, cnode, cnode->Catch.Name, TYPE_VOID));
+		Bytecode_SetLabel(Block->Func->Handle, handler);
+		const tVariable *var;
+		ret = BC_Variable_Define(Block, var_node, var_node->DefVar.DataType, var_node->DefVar.Name, &var);
+		if(ret)	return ret;
+		// - Added after the try block, so handlers nested in it are found first
+		Bytecode_AppendHandler(Block->Func->Handle, try_start, try_end, handler, catch_type, var->Register);
+		ret = AST_ConvertNode(Block, Node->TryCatch.Catch, NULL);
+		if(ret)	return ret;
 
-			Bytecode_AppendJump(Block->Func->Handle, post_handler);
-			Bytecode_SetLabel(Block->Func->Handle, next);
-		}
-	
+		Block = parentBlock;
+		BC_FinaliseBlock(Block, Node, &blockInfo);
 		Bytecode_SetLabel(Block->Func->Handle, post_handler);
-		Bytecode_AppendPopExecptHandler(Block->Func->Handle);
-
-		} break;
-#endif
+		NO_RESULT();
+		break; }
 
 
 	case NODETYPE_SWITCH: {
@@ -788,7 +792,12 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 		// Special case for `return null;`
 		Block->NullType = Block->Func->Function->ReturnType;
 		
+		// `return f(...);` can reuse this function's frame (see BC_CallFunction)
+		if( Block->Func->TryDepth == 0 && (Node->UniOp.Value->Type == NODETYPE_FUNCTIONCALL
+		 || Node->UniOp.Value->Type == NODETYPE_METHODCALL) )
+			Block->Func->TailCall = Node->UniOp.Value;
 		ret = AST_ConvertNode(Block, Node->UniOp.Value, &vreg);
+		Block->Func->TailCall = NULL;
 		if(ret)	return ret;
 		ret = _AssertRegType(Block, Node->UniOp.Value, vreg, Block->Func->Function->ReturnType);
 		if(ret)	return ret;
@@ -982,19 +991,25 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 	
 	// Constant Values
 	case NODETYPE_NULL:
-		if( SS_TYPESEQUAL(Block->NullType, TYPE_VOID) ) {
+		// - Otherwise typed by where it's used (see AST_Optimise_TypeNull)
+		type = Block->NullType;
+		if( SS_TYPESEQUAL(type, TYPE_VOID) )
+			type = Node->DataType;
+		if( SS_TYPESEQUAL(type, TYPE_VOID) ) {
 			AST_NODEERROR("null on non-reference");
 			return -2;
 		}
-		ret = _AllocateRegister(Block, Node, Block->NullType, NULL, &rreg);
+		ret = _AllocateRegister(Block, Node, type, NULL, &rreg);
 		if(ret)	return ret;
-		Bytecode_AppendConstNull(Block->Func->Handle, rreg, Block->NullType);
+		Bytecode_AppendConstNull(Block->Func->Handle, rreg, type);
 		SET_RESULT(rreg, 1);
 		break;
 	case NODETYPE_BOOLEAN:
 		ret = _AllocateRegister(Block, Node, TYPE_BOOLEAN, NULL, &rreg);
 		if(ret)	return ret;
 		Bytecode_AppendConstInt(Block->Func->Handle, rreg, Node->ConstBoolean);
+		// - There's no boolean load, and verified functions check the type of their arguments
+		Bytecode_AppendCast(Block->Func->Handle, rreg, SS_DATATYPE_BOOLEAN, rreg);
 		SET_RESULT(rreg, 1);
 		break;
 	case NODETYPE_INTEGER:
@@ -1149,9 +1164,35 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 		SET_RESULT(rreg, 1);
 		break;
 
+	// Short-circuit logic
+	// - The right side is only evaluated when the left doesn't decide the result, either
+	//   side can be of any type (like conditions, see Bytecode_int_IsStackEntTrue)
+	// - In conditions these become jumps instead (see BC_int_CondJump)
+	case NODETYPE_LOGICALAND:
+	case NODETYPE_LOGICALOR: {
+		 int	is_and = (Node->Type == NODETYPE_LOGICALAND);
+		 int	logic_end = Bytecode_AllocateLabel(Block->Func->Handle);
+		ret = AST_ConvertNode(Block, Node->BinOp.Left, &reg1);
+		if(ret)	return ret;
+		ret = _AllocateRegister(Block, Node, TYPE_BOOLEAN, NULL, &rreg);
+		if(ret)	return ret;
+		// - Truth of the left is the result if the right side is skipped ((a op a) == a)
+		Bytecode_AppendBinOpBool(Block->Func->Handle, (is_and ? BINOP_LOGICAND : BINOP_LOGICOR), rreg, reg1, reg1);
+		_ReleaseRegister(Block, reg1);
+		if( is_and )
+			Bytecode_AppendCondJumpNot(Block->Func->Handle, logic_end, rreg);
+		else
+			Bytecode_AppendCondJump(Block->Func->Handle, logic_end, rreg);
+		
+		ret = AST_ConvertNode(Block, Node->BinOp.Right, &reg2);
+		if(ret)	return ret;
+		Bytecode_AppendBinOpBool(Block->Func->Handle, (is_and ? BINOP_LOGICAND : BINOP_LOGICOR), rreg, rreg, reg2);
+		_ReleaseRegister(Block, reg2);
+		Bytecode_SetLabel(Block->Func->Handle, logic_end);
+		SET_RESULT(rreg, 1);
+		} break;
+
 	// Logic
-	case NODETYPE_LOGICALAND:	if(!op)	op = BINOP_LOGICAND;
-	case NODETYPE_LOGICALOR:	if(!op)	op = BINOP_LOGICOR;
 	case NODETYPE_LOGICALXOR:	if(!op)	op = BINOP_LOGICXOR;
 	// Comparisons
 	case NODETYPE_EQUALS:   	if(!op)	op = BINOP_EQ;
@@ -1196,8 +1237,6 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 			#define suf	""
 			switch(Node->Type)
 			{
-			case NODETYPE_LOGICALAND:	name_tpl = "operator &&"suf;	break;
-			case NODETYPE_LOGICALOR:	name_tpl = "operator ||"suf;	break;
 			case NODETYPE_LOGICALXOR:	name_tpl = "operator ^^"suf;	break;
 			case NODETYPE_EQUALS:   	name_tpl = "operator =="suf;	break;
 			case NODETYPE_NOTEQUALS:	name_tpl = "operator !="suf;	break;
@@ -1309,7 +1348,6 @@ int AST_ConvertNode(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *ResultReg
 
 int BC_PrepareBlock(tAST_BlockInfo *Block, tAST_BlockInfo *ChildBlock)
 {
-	Bytecode_AppendEnterContext(Block->Func->Handle);	// Create a new block
 	ChildBlock->ContinueTarget = -1;
 	ChildBlock->BreakTarget = -1;
 	ChildBlock->Tag = NULL;
@@ -1330,7 +1368,6 @@ int BC_FinaliseBlock(tAST_BlockInfo *ParentBlock, tAST_Node *Node, tAST_BlockInf
 	assert(ParentBlock->Func->NumGlobals >= ChildBlock->OrigNumGlobals);
 	for( int i = ChildBlock->OrigNumGlobals; i < ParentBlock->Func->NumGlobals; i ++ )
 		ParentBlock->Func->ImportedGlobals[i] = NULL;
-	Bytecode_AppendLeaveContext(ParentBlock->Func->Handle);	// Leave this context
 	return 0;
 }
 
@@ -1625,9 +1662,25 @@ int BC_CallFunction(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *RetReg, c
 	if(ret)	return ret;
 
 	DEBUGS1("Add call bytecode op");
+	// Tail calls are only worth it for script callees, the RETURN after is kept
+	// for when the call can't replace the frame (e.g. callee takes varargs)
+	bool	is_tail = (sf && Block->Func->TailCall == Node
+		&& SS_TYPESEQUAL(ret_type, Block->Func->Function->ReturnType));
+	// Calls to script functions pass their arguments in a window (see BC_int_CallWindow)
+	// - Only for call nodes, other users of BC_CallFunction keep using their argument registers
+	bool	use_window = (sf && !is_tail && !VArgsPassThrough && !sf->IsVariable && NArgs > 0
+		&& (Node->Type == NODETYPE_FUNCTIONCALL || Node->Type == NODETYPE_METHODCALL));
 	// TODO: For passthough, add flag
-	if( Namespaces == NULL )
+	if( use_window ) {
+		ret = BC_int_CallWindow(Block, Node, (Namespaces == NULL), id, retreg, NArgs, ArgRegs);
+		if(ret)	return ret;
+	}
+	else if( Namespaces == NULL && is_tail )
+		Bytecode_AppendTailMethodCall(Block->Func->Handle, id, retreg, NArgs, ArgRegs, VArgsPassThrough);
+	else if( Namespaces == NULL )
 		Bytecode_AppendMethodCall(Block->Func->Handle, id, retreg, NArgs, ArgRegs, VArgsPassThrough);
+	else if( is_tail )
+		Bytecode_AppendTailFunctionCall(Block->Func->Handle, id, retreg, NArgs, ArgRegs, VArgsPassThrough);
 	else
 		Bytecode_AppendFunctionCall(Block->Func->Handle, id, retreg, NArgs, ArgRegs, VArgsPassThrough);
 	
@@ -1642,6 +1695,117 @@ int BC_CallFunction(tAST_BlockInfo *Block, tAST_Node *Node, tRegister *RetReg, c
 	return 0;
 }
 
+/**
+ * \brief Emit a jump taken when the truth of a condition is JumpIf
+ *
+ * Chains of && and || become a jump per operand, so operands after the one that decides
+ * the result are skipped, and comparisons feed their jump directly (see
+ * Bytecode_int_FuseInstructions).
+ */
+int BC_int_CondJump(tAST_BlockInfo *Block, tAST_Node *Node, bool JumpIf, int Label)
+{
+	 int	ret;
+	tRegister	reg;
+	
+	if( Node->Type == NODETYPE_LOGICALAND || Node->Type == NODETYPE_LOGICALOR )
+	{
+		const bool	is_and = (Node->Type == NODETYPE_LOGICALAND);
+		// (a && b) is false if either is false, (a || b) is true if either is true
+		if( JumpIf != is_and ) {
+			ret = BC_int_CondJump(Block, Node->BinOp.Left, JumpIf, Label);
+			if(ret)	return ret;
+			return BC_int_CondJump(Block, Node->BinOp.Right, JumpIf, Label);
+		}
+		// Otherwise the left side can only rule the jump out
+		 int	skip = Bytecode_AllocateLabel(Block->Func->Handle);
+		ret = BC_int_CondJump(Block, Node->BinOp.Left, !JumpIf, skip);
+		if(ret)	return ret;
+		ret = BC_int_CondJump(Block, Node->BinOp.Right, JumpIf, Label);
+		if(ret)	return ret;
+		Bytecode_SetLabel(Block->Func->Handle, skip);
+		return 0;
+	}
+	
+	ret = AST_ConvertNode(Block, Node, &reg);
+	if(ret)	return ret;
+	if( JumpIf )
+		Bytecode_AppendCondJump(Block->Func->Handle, Label, reg);
+	else
+		Bytecode_AppendCondJumpNot(Block->Func->Handle, Label, reg);
+	_ReleaseRegister(Block, reg);
+	return 0;
+}
+
+/**
+ * \brief Emit a call with the arguments in a window at the top of the frame
+ *
+ * The callee's frame starts at the window, so every register above it must be dead at the
+ * call (other than the return register, which is written once the callee has returned).
+ * Argument temporaries that are already there are used as-is, otherwise the arguments are
+ * moved to new registers above all allocated ones.
+ */
+int BC_int_CallWindow(tAST_BlockInfo *Block, tAST_Node *Node, bool IsMethod, int ID, tRegister RetReg, int NArgs, tRegister ArgRegs[])
+{
+	struct sRegInfo	*regs = Block->Func->Registers;
+	
+	bool	in_place = true;
+	for( int i = 0; i < NArgs && in_place; i ++ )
+	{
+		if( ArgRegs[i] != ArgRegs[0] + i || regs[ArgRegs[i]].RefCount != 1 )
+			in_place = false;
+	}
+	for( int r = ArgRegs[0] + NArgs; r < Block->Func->RegSpace && in_place; r ++ )
+	{
+		if( regs[r].RefCount && r != RetReg )
+			in_place = false;
+	}
+	if( in_place )
+	{
+		Bytecode_AppendWindowCall(Block->Func->Handle, IsMethod, ID, RetReg, NArgs, ArgRegs);
+		// - Released by the caller
+		for( int i = 0; i < NArgs; i ++ )
+			regs[ArgRegs[i]].Cleared = true;
+		return 0;
+	}
+
+	 int	base = 0;
+	for( int r = 0; r < Block->Func->RegSpace; r ++ )
+	{
+		if( regs[r].RefCount )
+			base = r + 1;
+	}
+	if( _GrowRegisters(Block->Func, base + NArgs) ) {
+		AST_NODEERROR("Out of avaliable registers");
+		_DumpRegisters(Block);
+		return 1;
+	}
+	regs = Block->Func->Registers;
+	tRegister	window[NArgs];
+	for( int i = 0; i < NArgs; i ++ )
+	{
+		struct sRegInfo	*ri = &regs[base + i];
+		*ri = regs[ArgRegs[i]];
+		ri->Node = Node;
+		ri->RefCount = 1;
+		ri->Cleared = true;
+		window[i] = base + i;
+		Block->Func->NumAllocatedRegs ++;
+		if( base + i > Block->Func->MaxRegisters )
+			Block->Func->MaxRegisters = base + i;
+		// - Temporaries are released by the caller after this, so are moved
+		if( regs[ArgRegs[i]].RefCount == 1 && SS_ISTYPEREFERENCE(ri->Type) ) {
+			Bytecode_AppendMove(Block->Func->Handle, window[i], ArgRegs[i]);
+			regs[ArgRegs[i]].Cleared = true;
+		}
+		else
+			Bytecode_AppendMov(Block->Func->Handle, window[i], ArgRegs[i]);
+	}
+	Bytecode_AppendWindowCall(Block->Func->Handle, IsMethod, ID, RetReg, NArgs, window);
+	for( int i = 0; i < NArgs; i ++ )
+		_ReleaseRegister(Block, window[i]);
+	return 0;
+}
+
 int BC_BinOp(tAST_BlockInfo *Block, int Op, tRegister rreg, tRegister reg1, tRegister reg2)
 {
 	 int	ret;
@@ -1795,6 +1959,13 @@ int BC_CastValue(tAST_BlockInfo *Block, tAST_Node *Node, tSpiderTypeRef DestType
 	ret = _GetRegisterInfo(Block, SrcReg, &SourceType, NULL);
 	if(ret)	return ret;
 
+	// Already the right type, the value is used as-is
+	if( SS_TYPESEQUAL(SourceType, DestType) ) {
+		_ReferenceRegister(Block, SrcReg);
+		*DstReg = SrcReg;
+		return 0;
+	}
+
 	if( SS_GETARRAYDEPTH(SourceType) && !SS_ISCORETYPE(DestType, SS_DATATYPE_BOOLEAN) ) {
 		AST_NODEERROR("Invalid cast from array (0x%x)", SourceType);
 		return 1;
@@ -1857,7 +2028,7 @@ int BC_CastValue(tAST_BlockInfo *Block, tAST_Node *Node, tSpiderTypeRef DestType
 
 const tScript_Var *BC_Variable_LookupGlobal(tAST_BlockInfo *Block, tAST_Node *Node, const char *Name, int *Index)
 {
-	for( int i = 0; i < MAX_GLOBALS; i ++ )
+	for( int i = 0; i < Block->Func->NumGlobals; i ++ )
 	{
 		if( !Block->Func->ImportedGlobals[i] )
 			continue ;
@@ -1915,6 +2086,24 @@ const tVariable *BC_Variable_Lookup(tAST_BlockInfo *Block, tAST_Node *Node, cons
  * \return Boolean Failure
  */
 int BC_Variable_Define(tAST_BlockInfo *Block, tAST_Node *Node, tSpiderTypeRef Type, const char *Name, const tVariable **VarPtr)
+{
+	 int	ret;
+	
+	tRegister reg;
+	ret = _AllocateRegister(Block, Node, Type, NULL, &reg);
+	if(ret)	return ret;
+
+	ret = BC_Variable_DefineReg(Block, Node, Type, Name, reg, VarPtr);
+	_ReleaseRegister(Block, reg);
+	return ret;
+}
+
+/**
+ * \brief Define a variable held in an already allocated register
+ * \param Reg	Register of the variable, the variable takes its own reference
+ * \return Boolean Failure
+ */
+int BC_Variable_DefineReg(tAST_BlockInfo *Block, tAST_Node *Node, tSpiderTypeRef Type, const char *Name, tRegister Reg, const tVariable **VarPtr)
 {
 	if( BC_Variable_LookupGlobal(Block, Node, Name, NULL) ) {
 		AST_NODEERROR("Definition of '%s' collides with imported global", Name);
@@ -1926,26 +2115,22 @@ int BC_Variable_Define(tAST_BlockInfo *Block, tAST_Node *Node, tSpiderTypeRef Ty
 		return -1;
 	}
 
-	 int	ret;
-	
-	tRegister reg;
-	ret = _AllocateRegister(Block, Node, Type, NULL, &reg);
-	if(ret)	return ret;
+	_ReferenceRegister(Block, Reg);
 
 	tVariable *var = malloc( sizeof(tScript_Var) + strlen(Name) + 1 );
 	var->Next = NULL;
 	var->Type = Type;
-	var->Register = reg;
+	var->Register = Reg;
 	//var->Name = (char*)(var + 1);
 	strcpy(var->Name, Name);
 
 	var->Next = Block->FirstVar;
 	Block->FirstVar = var;
 	
-	Bytecode_AppendDefineVar(Block->Func->Handle, reg, Name, Type);	
+	Bytecode_AppendDefineVar(Block->Func->Handle, Reg, Name, Type);	
 
 	DEBUGS1("%p %s '%s' (Reg %i)", Block,
-		SpiderScript_GetTypeName(Block->Func->Script, Type), Name, reg);
+		SpiderScript_GetTypeName(Block->Func->Script, Type), Name, Reg);
 
 	if( VarPtr )
 		*VarPtr = var;
@@ -1953,6 +2138,31 @@ int BC_Variable_Define(tAST_BlockInfo *Block, tAST_Node *Node, tSpiderTypeRef Ty
 	return 0;
 }
 
+/**
+ * \brief Make room for at least \a Count imported globals
+ * \return Non-zero if that is over the frame global budget (see SpiderScript_SetExecLimit)
+ */
+int BC_Variable_GrowGlobals(tAST_FuncInfo *Func, int Count)
+{
+	if( Count <= Func->GlobalSpace )
+		return 0;
+	const int	max = (Func->Script->MaxFrameGlobals ? Func->Script->MaxFrameGlobals : DEF_MAX_FRAME_GLOBALS);
+	if( Count > max )
+		return 1;
+	 int	space = (Func->GlobalSpace ? Func->GlobalSpace * 2 : INITIAL_GLOBALS);
+	while( space < Count )
+		space *= 2;
+	if( space > max )
+		space = max;
+	tScript_Var	**globals = realloc(Func->ImportedGlobals, space * sizeof(*globals));
+	if( !globals )
+		return 1;
+	memset(globals + Func->GlobalSpace, 0, (space - Func->GlobalSpace) * sizeof(*globals));
+	Func->ImportedGlobals = globals;
+	Func->GlobalSpace = space;
+	return 0;
+}
+
 int BC_Variable_DefImportGlobal(tAST_BlockInfo *Block, tAST_Node *DefNode, tSpiderTypeRef Type, const char *Name)
 {
 	if( BC_Variable_Lookup(Block, DefNode, Name, TYPE_VOID) ) {
@@ -1969,9 +2179,11 @@ int BC_Variable_DefImportGlobal(tAST_BlockInfo *Block, tAST_Node *DefNode, tSpid
 
 	// Globals cannot be de-scoped except by a block closing
 	// - This allows a simple allocation scheme (and simplifies cleanup)
-	if( Block->Func->NumGlobals == MAX_GLOBALS ) {
+	if( BC_Variable_GrowGlobals(Block->Func, Block->Func->NumGlobals + 1) ) {
+		const tSpiderScript	*script = Block->Func->Script;
 		AST_RuntimeError(Block->Func->Script, DefNode,
-			"Too many globals in function, %i max", MAX_GLOBALS);
+			"Too many globals in function, %i max",
+			(script->MaxFrameGlobals ? script->MaxFrameGlobals : DEF_MAX_FRAME_GLOBALS));
 		return -1;
 	}
 	int slot = Block->Func->NumGlobals;
@@ -2146,11 +2358,38 @@ void AST_RuntimeError(tAST_Node *Node, const char *Format, ...)
 }
 #endif
 
+/**
+ * \brief Make room to track at least \a Count registers
+ * \return Non-zero if that is over the frame register budget (see SpiderScript_SetExecLimit)
+ */
+int _GrowRegisters(tAST_FuncInfo *Func, int Count)
+{
+	if( Count <= Func->RegSpace )
+		return 0;
+	const int	max = (Func->Script->MaxFrameRegisters ? Func->Script->MaxFrameRegisters : DEF_MAX_FRAME_REGISTERS);
+	if( Count > max )
+		return 1;
+	 int	space = (Func->RegSpace ? Func->RegSpace * 2 : INITIAL_REGISTERS);
+	while( space < Count )
+		space *= 2;
+	if( space > max )
+		space = max;
+	struct sRegInfo	*regs = realloc(Func->Registers, space * sizeof(*regs));
+	if( !regs )
+		return 1;
+	memset(regs + Func->RegSpace, 0, (space - Func->RegSpace) * sizeof(*regs));
+	Func->Registers = regs;
+	Func->RegSpace = space;
+	return 0;
+}
+
 int _AllocateRegister(tAST_BlockInfo *Block, tAST_Node *Node, tSpiderTypeRef Type, void *Info, int *RegPtr)
 {
 	assert(RegPtr);
-	for( int i = 0; i < MAX_REGISTERS; i ++ )
+	for( int i = 0; ; i ++ )
 	{
+		if( i == Block->Func->RegSpace && _GrowRegisters(Block->Func, i + 1) )
+			break;
 		struct sRegInfo	*ri = &Block->Func->Registers[i];
 		if( ri->Type.Def == NULL )
 		{
@@ -2158,6 +2397,7 @@ int _AllocateRegister(tAST_BlockInfo *Block, tAST_Node *Node, tSpiderTypeRef Typ
 			ri->Type = Type;
 			ri->Info = Info;
 			ri->RefCount = 1;
+			ri->Cleared = false;
 			*RegPtr = i;
 			Block->Func->NumAllocatedRegs ++;
 			if( i > Block->Func->MaxRegisters )
@@ -2170,9 +2410,43 @@ int _AllocateRegister(tAST_BlockInfo *Block, tAST_Node *Node, tSpiderTypeRef Typ
 	_DumpRegisters(Block);
 	return 1;
 }
+/**
+ * \brief Allocate two adjacent registers (for operations on a register pair, e.g. FOREACH_INIT)
+ * \param RegPtr	Set to the first register, the second is RegPtr+1 and is released separately
+ */
+int _AllocateRegisterPair(tAST_BlockInfo *Block, tAST_Node *Node, tSpiderTypeRef Type0, tSpiderTypeRef Type1, tRegister *RegPtr)
+{
+	assert(RegPtr);
+	for( int i = 0; ; i ++ )
+	{
+		if( i + 2 > Block->Func->RegSpace && _GrowRegisters(Block->Func, i + 2) )
+			break;
+		struct sRegInfo	*ri = &Block->Func->Registers[i];
+		if( ri[0].Type.Def == NULL && ri[1].Type.Def == NULL )
+		{
+			for( int j = 0; j < 2; j ++ )
+			{
+				ri[j].Node = Node;
+				ri[j].Type = (j == 0 ? Type0 : Type1);
+				ri[j].Info = NULL;
+				ri[j].RefCount = 1;
+				ri[j].Cleared = false;
+			}
+			*RegPtr = i;
+			Block->Func->NumAllocatedRegs += 2;
+			if( i+1 > Block->Func->MaxRegisters )
+				Block->Func->MaxRegisters = i+1;
+			DEBUGS2("Alloc R%i,R%i", i, i+1);
+			return 0;
+		}
+	}
+	AST_NODEERROR("Out of avaliable registers");
+	_DumpRegisters(Block);
+	return 1;
+}
 void _DumpRegisters(const tAST_BlockInfo *Block)
 {
-	for( int i = 0; i < MAX_REGISTERS; i ++ )
+	for( int i = 0; i < Block->Func->RegSpace; i ++ )
 	{
 		const struct sRegInfo	*ri = &Block->Func->Registers[i];
 		if(ri->Type.Def == NULL)	continue ;
@@ -2188,7 +2462,7 @@ int _ReferenceRegister(tAST_BlockInfo *Block, tRegister Register)
 {
 	DEBUGS2("Reference R%i", Register);
 	assert(Register >= 0);
-	assert(Register < MAX_REGISTERS);
+	assert(Register < Block->Func->RegSpace);
 	struct sRegInfo	*ri = &Block->Func->Registers[Register];
 	assert(ri->RefCount);
 	ri->RefCount ++;
@@ -2197,7 +2471,7 @@ int _ReferenceRegister(tAST_BlockInfo *Block, tRegister Register)
 int _GetRegisterInfo(tAST_BlockInfo *Block, int Register, tSpiderTypeRef *Type, void **Info)
 {
 	assert(Register >= 0);
-	assert(Register < MAX_REGISTERS);
+	assert(Register < Block->Func->RegSpace);
 	struct sRegInfo	*ri = &Block->Func->Registers[Register];
 	assert(ri->RefCount);
 	if( Type )
@@ -2222,15 +2496,17 @@ int _AssertRegType(tAST_BlockInfo *Block, tAST_Node *Node, int Register, tSpider
 int _ReleaseRegister(tAST_BlockInfo *Block, int Register)
 {
 	assert(Register >= 0);
-	assert(Register < MAX_REGISTERS);
+	assert(Register < Block->Func->RegSpace);
 	struct sRegInfo	*ri = &Block->Func->Registers[Register];
 	assert(ri->RefCount);
 	ri->RefCount --;
 	if( ri->RefCount == 0 )
 	{
 		DEBUGS2("Release R%i Free", Register);
-		if( SS_ISTYPEREFERENCE(ri->Type) ) {
-			// Emit dereference
+		// Emit dereference
+		// - Unless the last use was a MOV just emitted, which can take the value instead
+		if( SS_ISTYPEREFERENCE(ri->Type) && !ri->Cleared
+		 && !Bytecode_MoveLastUse(Block->Func->Handle, Register) ) {
 			Bytecode_AppendClearReg(Block->Func->Handle, Register);
 		}
 		ri->Type.Def = NULL;
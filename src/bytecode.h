@@ -7,7 +7,22 @@
 
 #include "bytecode_ops.h"
 
+#define BC_INLINECACHE_WAYS	4	// Object types remembered per call/element site
+
+// Content.Function.ArgCount of call operations, the argument count and flags
+#define BC_CALL_ARGCOUNT_MASK	0xFF
+#define BC_CALL_VARGS_PASSTHROUGH	0x100	// The caller's variable arguments are passed on
+#define BC_CALL_WINDOW	0x200	// Arguments are in consecutive registers that become the callee's (see Bytecode_AppendWindowCall)
+
 typedef struct sBC_Op	tBC_Op;
+typedef struct sBC_Insn	tBC_Insn;
+typedef struct sBC_InlineCache	tBC_InlineCache;
+typedef struct sBC_InlineCacheEnt	tBC_InlineCacheEnt;
+typedef struct sBC_StackEnt	tBC_StackEnt;
+typedef struct sBC_JitCode	tBC_JitCode;
+typedef struct sBC_LineEnt	tBC_LineEnt;
+typedef struct sBC_VarEnt	tBC_VarEnt;
+typedef struct sBC_HandlerEnt	tBC_HandlerEnt;
 
 struct sBC_Op
 {
@@ -34,13 +49,117 @@ struct sBC_Op
 			size_t	Length;
 			char	Data[];
 		} String;
+	} Content;
+};
+
+/**
+ * \brief Flattened instruction (execution form of a tBC_Op)
+ * \note Jump instructions have DstReg replaced by the target instruction index
+ */
+struct sBC_Insn
+{
+	uint16_t	Operation;
+	 int16_t	Aux;	// Extra operand for fused instructions, inline cache index for method/element ops
+	 int32_t	DstReg;
+	union {
 		struct {
-			 int	RefCount;
-			char	Data[];
-		} *RefStr;
+			 int32_t	RegInt2;
+			 int32_t	RegInt3;
+		} RegInt;
+		uint64_t	Integer;
+		double	Real;
+		tBC_Op	*Op;	// Source op, for out-of-line data (strings, calls)
+		tScript_Var	*Var;	// Linked global
 	} Content;
 };
 
+/**
+ * \brief Inline cache entry, keyed on the object's type
+ */
+struct sBC_InlineCacheEnt
+{
+	const tSpiderScript_TypeDef	*TypeDef;
+	union {
+		void	*MethodIdent;	// CALLMETHOD: resolved and validated FunctionIdent
+		struct {
+			 int	TypeId;	// Register type of the element
+			 int	Size;	// Storage size (primitives)
+		} Element;	// GETELEMENT/SETELEMENT
+	};
+};
+
+/**
+ * \brief Per-site inline cache (monomorphic until a second type is seen)
+ */
+struct sBC_InlineCache
+{
+	 int	NEntries;
+	 int	NextReplace;	// Round-robin victim once all ways are used
+	tBC_InlineCacheEnt	Entries[BC_INLINECACHE_WAYS];
+};
+
+/**
+ * \brief Register value
+ * \note Type is an index into Script->BCTypes, core types use their SS_DATATYPE_* value
+ * \note The layout is relied on by generated native code (see bytecode_jit.c)
+ */
+struct sBC_StackEnt
+{
+	 int	TypeId;
+	union {
+		tSpiderBool	Boolean;
+		tSpiderInteger	Integer;
+		tSpiderReal 	Real;
+		tSpiderString	*String;
+		tSpiderArray	*Array;
+		tSpiderObject	*Object;
+	};
+};
+
+/**
+ * \brief Native code for a function (see bytecode_jit.c)
+ */
+struct sBC_JitCode
+{
+	// Runs native code from Entry, returns the index of the instruction to interpret next
+	 int	(*Enter)(tBC_StackEnt *Registers, const void *Entry);
+	const void	*Entries[];	// Per instruction, NULL if left to the interpreter
+};
+
+/**
+ * \brief Source position of the code from an operation/instruction onwards
+ */
+struct sBC_LineEnt
+{
+	 int	PC;
+	 int	Line;
+	const char	*File;	// Reference counted (see Bytecode_AppendPos)
+};
+
+/**
+ * \brief Name of a variable held in a register, from an operation onwards
+ */
+struct sBC_VarEnt
+{
+	 int	PC;
+	 int	Reg;
+	char	*Name;
+};
+
+/**
+ * \brief Exception handler covering a range of code
+ * \note Positions are label indexes in the operation list (Handlers), and instruction indexes
+ *       once flattened (InsnHandlers)
+ */
+struct sBC_HandlerEnt
+{
+	 int	Start;	// First covered operation
+	 int	End;	// First operation after the covered range
+	 int	Handler;	// Entered with the exception in CatchReg
+	 int	CatchType;	// SS_DATATYPE_INTEGER (exception number) or SS_DATATYPE_STRING (message)
+	 int	CatchReg;
+};
+
 struct sBC_Function
 {
 	tSpiderScript	*Script;
@@ -51,14 +170,101 @@ struct sBC_Function
 
 	 int	MaxGlobalCount;
 	 int	MaxRegisters;
+	 int	ArgumentCount;	// Registers holding the arguments on entry (from R0)
 	
 	 int	OperationCount;
 	tBC_Op	*Operations;
 	tBC_Op	*OperationsEnd;
+
+	// Debug information, kept out of the instruction stream
+	// - PC is the index of the operation, sorted in ascending order
+	 int	LineCount;
+	 int	LineSpace;
+	tBC_LineEnt	*Lines;
+	 int	VarCount;
+	 int	VarSpace;
+	tBC_VarEnt	*Vars;
+	// Exception handlers, inner ranges before the ranges that contain them
+	 int	HandlerCount;
+	 int	HandlerSpace;
+	tBC_HandlerEnt	*Handlers;
+
+	// Built by Bytecode_CommitFunction
+	 int	InstructionCount;
+	tBC_Insn	*Instructions;
+	 int	InsnLineCount;
+	tBC_LineEnt	*InsnLines;	// Lines, with PC as an instruction index (file names are borrowed)
+	tBC_HandlerEnt	*InsnHandlers;	// Handlers (HandlerCount), with instruction indexes
+	 int	InlineCacheCount;
+	tBC_InlineCache	*InlineCaches;
+
+	// Set by Bytecode_VerifyFunction
+	bool	IsVerified;	// Operand types proven, type checks can be skipped
+	 int	ReturnTypeId;
+
+	// Native code (see bytecode_jit.c)
+	 int	HotCount;	// Calls and loop iterations, counted until the JIT threshold is passed
+	tBC_JitCode	*JitCode;
+
+	// Tiered re-optimisation (see bytecode_tier.c)
+	 int	Tier;	// 0 = as committed, 1 = re-optimised (or attempted)
+	 int	CallCount;	// Counted until the tier threshold is reached
+	 int	LoopCount;	// Loop back-edges taken, as above
+	 int	ActiveFrames;	// Frames executing the installed instructions
+	tBC_Function	*Optimised;	// Code waiting to be installed at the next call
+};
+
+enum eBC_RegUse
+{
+	BC_REGUSE_NONE,
+	BC_REGUSE_READ,	// Read (and possibly written)
+	BC_REGUSE_WRITE,	// Overwritten without being read
 };
 
 extern int	Bytecode_int_OpUsesString(int Op);
 extern int	Bytecode_int_OpUsesInteger(int Op);
+extern void	Bytecode_int_InitTypes(tSpiderScript *Script);
 extern int	Bytecode_int_GetTypeIdx(tSpiderScript *Script, tSpiderTypeRef Type);
+extern void	Bytecode_int_OpToInsn(const tBC_Op *Op, tBC_Insn *Insn);
+extern int	Bytecode_int_FlattenFunction(tBC_Function *Fcn);
+extern int	Bytecode_int_AllocInlineCaches(tBC_Function *Fcn);
+extern void	Bytecode_int_DerefFile(const char *File);
+extern int	Bytecode_int_AddLine(tBC_Function *Fcn, int PC, const char *File, int Line);
+extern int	Bytecode_int_AddVar(tBC_Function *Fcn, int PC, int Reg, const char *Name);
+extern void	Bytecode_int_RemapLines(tBC_Function *Fcn, const int *NewIdx);
+extern int	Bytecode_int_AddHandler(tBC_Function *Fcn, const tBC_HandlerEnt *Ent);
+extern void	Bytecode_int_MarkHandlerTargets(const tBC_Function *Fcn, bool *IsTarget);
+extern int	Bytecode_int_GetPosition(const tBC_Function *Fcn, int PC, const char **File, int *Line);
+
+// bytecode_ssa.c
+extern int	Bytecode_int_OptimiseSSA(tBC_Function *Fcn);
+
+// bytecode_fuse.c
+extern int	Bytecode_int_InsnIsJump(const tBC_Insn *Insn);
+extern enum eBC_RegUse	Bytecode_int_InsnRegUse(const tBC_Insn *Insn, int Reg);
+extern int	Bytecode_int_IsRegDeadAfter(const tBC_Insn *Insns, int Count, int Index, int Reg);
+extern int	Bytecode_int_FuseInstructions(tBC_Function *Fcn);
+
+// bytecode_verify.c
+extern int	*Bytecode_int_InferTypes(tSpiderScript *Script, tScript_Function *Fcn, tBC_Function *BCFcn);
+
+// bytecode_link.c
+extern int	Bytecode_int_LinkFunction(tSpiderScript *Script, tScript_Function *Fcn, tBC_Function *BCFcn);
+
+// bytecode_tier.c
+#define BC_TIER_INLINE_SIZE	24	// Maximum instructions in an inlined function
+extern int	Bytecode_int_TierUp(tSpiderScript *Script, tScript_Function *Fcn, int MaxRegisters);
+extern void	Bytecode_int_InstallTier(tBC_Function *Fcn);
+extern void	Bytecode_int_FreeTier(tBC_Function *Code);
+extern tBC_Function	*Bytecode_int_CloneCode(const tBC_Function *Fcn);
+
+// bytecode_jit.c
+#if defined(__x86_64__) && defined(__linux__)
+# define BC_JIT_AVAILABLE	1
+#else
+# define BC_JIT_AVAILABLE	0
+#endif
+extern int	Bytecode_JIT_Compile(tSpiderScript *Script, tBC_Function *Fcn);
+extern void	Bytecode_JIT_Free(tSpiderScript *Script);
 
 #endif
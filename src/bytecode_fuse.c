@@ -0,0 +1,431 @@
+/*
+ * SpiderScript Library
+ * by John Hodge (thePowersGang)
+ *
+ * bytecode_fuse.c
+ * - Superinstruction formation on flattened bytecode
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common.h"
+#include "bytecode.h"
+
+// === PROTOTYPES ===
+ int	Bytecode_int_InsnIsJump(const tBC_Insn *Insn);
+enum eBC_RegUse	Bytecode_int_InsnRegUse(const tBC_Insn *Insn, int Reg);
+ int	Bytecode_int_IsRegDeadAfter(const tBC_Insn *Insns, int Count, int Index, int Reg);
+ int	Bytecode_int_FuseInstructions(tBC_Function *Fcn);
+static int	Bytecode_int_FuseAt(const tBC_Insn *Insns, int Count, const bool *IsTarget, int Index, tBC_Insn *Out);
+
+// === CODE ===
+/**
+ * \brief Check if an instruction's DstReg is a jump target
+ * \return 1 for an unconditional jump, 2 for a conditional jump, 0 otherwise
+ */
+int Bytecode_int_InsnIsJump(const tBC_Insn *Insn)
+{
+	switch(Insn->Operation)
+	{
+	case BC_OP_JUMP:
+		return 1;
+	case BC_OP_JUMPIF:
+	case BC_OP_JUMPIFNOT:
+	case BC_OP_JUMPIF_INT_EQ ... BC_OP_JUMPIFNOT_REAL_GE:
+	case BC_OP_INT_INC_JUMPIF_EQ ... BC_OP_INT_INC_JUMPIF_GE:
+	case BC_OP_JUMPIF_BOOL:
+	case BC_OP_JUMPIFNOT_BOOL:
+	case BC_OP_JUMPIF_INT:
+	case BC_OP_JUMPIFNOT_INT:
+	case BC_OP_FOREACH_NEXT:
+	case BC_OP_FOREACH_NEXT_INTARRAY:
+	case BC_OP_FOREACH_NEXT_REALARRAY:
+	case BC_OP_FOREACH_NEXT_STRING:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * \brief Determine how an instruction accesses a register
+ * \note Unknown operations are assumed to read every register
+ */
+enum eBC_RegUse Bytecode_int_InsnRegUse(const tBC_Insn *Insn, int Reg)
+{
+	const int	r2 = Insn->Content.RegInt.RegInt2;
+	const int	r3 = Insn->Content.RegInt.RegInt3;
+	const bool	is_dst = (Insn->DstReg == Reg);
+	switch(Insn->Operation)
+	{
+	case BC_OP_NOP:
+	case BC_OP_IMPORTGLOBAL:	// DstReg is a global slot
+	case BC_OP_IMPORTGLOBAL_LINKED:
+	case BC_OP_JUMP:
+		return BC_REGUSE_NONE;
+
+	case BC_OP_GETGLOBAL:
+	case BC_OP_LOADNULLREF:
+	case BC_OP_LOADINT:
+	case BC_OP_LOADREAL:
+	case BC_OP_LOADSTRING:
+	case BC_OP_CLEARREG:
+		return is_dst ? BC_REGUSE_WRITE : BC_REGUSE_NONE;
+
+	case BC_OP_SETGLOBAL:
+	case BC_OP_RETURN:
+		return is_dst ? BC_REGUSE_READ : BC_REGUSE_NONE;
+
+	case BC_OP_JUMPIF:
+	case BC_OP_JUMPIFNOT:
+	case BC_OP_JUMPIF_BOOL:
+	case BC_OP_JUMPIFNOT_BOOL:
+	case BC_OP_JUMPIF_INT:
+	case BC_OP_JUMPIFNOT_INT:
+		return (r2 == Reg) ? BC_REGUSE_READ : BC_REGUSE_NONE;
+
+	// Source in RegInt2
+	case BC_OP_MOV:
+	case BC_OP_MOV_MOVE:	// The cleared source is never read again
+	case BC_OP_GETELEMENT:	// RegInt3 is an element index
+	case BC_OP_BOOL_LOGICNOT:
+	case BC_OP_INT_BITNOT:
+	case BC_OP_INT_NEG:
+	case BC_OP_REAL_NEG:
+	case BC_OP_INT_ADDI:	// RegInt3 is an immediate
+		if( r2 == Reg )	return BC_REGUSE_READ;
+		return is_dst ? BC_REGUSE_WRITE : BC_REGUSE_NONE;
+
+	// Source in RegInt3, RegInt2 is a type
+	case BC_OP_CREATEARRAY:
+	case BC_OP_CAST:
+	case BC_OP_CAST_INT_TO_REAL:
+	case BC_OP_CAST_REAL_TO_INT:
+		if( r3 == Reg )	return BC_REGUSE_READ;
+		return is_dst ? BC_REGUSE_WRITE : BC_REGUSE_NONE;
+
+	// Sources in RegInt2 and RegInt3 (quickened, so no encoding)
+	case BC_OP_GETINDEX_INTARRAY:
+	case BC_OP_GETINDEX_REALARRAY:
+	case BC_OP_GETINDEX_INTARRAY_INRANGE:
+	case BC_OP_GETINDEX_REALARRAY_INRANGE:
+		if( r2 == Reg || r3 == Reg )	return BC_REGUSE_READ;
+		return is_dst ? BC_REGUSE_WRITE : BC_REGUSE_NONE;
+
+	// No register written
+	case BC_OP_SETELEMENT:	// RegInt3 is an element index
+		return (is_dst || r2 == Reg) ? BC_REGUSE_READ : BC_REGUSE_NONE;
+	case BC_OP_SETINDEX:
+	case BC_OP_SETINDEX_INRANGE:
+	case BC_OP_SETINDEX_INTARRAY:
+	case BC_OP_SETINDEX_REALARRAY:
+	case BC_OP_SETINDEX_INTARRAY_INRANGE:
+	case BC_OP_SETINDEX_REALARRAY_INRANGE:
+		return (is_dst || r2 == Reg || r3 == Reg) ? BC_REGUSE_READ : BC_REGUSE_NONE;
+	case BC_OP_JUMPIF_INT_EQ ... BC_OP_JUMPIFNOT_REAL_GE:
+	case BC_OP_INT_INC_JUMPIF_EQ ... BC_OP_INT_INC_JUMPIF_GE:
+		return (r2 == Reg || r3 == Reg) ? BC_REGUSE_READ : BC_REGUSE_NONE;
+
+	// foreach, the iterator is the register pair at DstReg (INIT) or RegInt2 (NEXT)
+	case BC_OP_FOREACH_INIT:
+		if( r2 == Reg )	return BC_REGUSE_READ;
+		return (is_dst || Insn->DstReg + 1 == Reg) ? BC_REGUSE_WRITE : BC_REGUSE_NONE;
+	case BC_OP_FOREACH_NEXT:
+	case BC_OP_FOREACH_NEXT_INTARRAY:
+	case BC_OP_FOREACH_NEXT_REALARRAY:
+	case BC_OP_FOREACH_NEXT_STRING:
+		// - The value is left as it was once the collection is exhausted
+		return (r2 == Reg || r2 + 1 == Reg || r3 == Reg) ? BC_REGUSE_READ : BC_REGUSE_NONE;
+
+	case BC_OP_CREATEOBJ:
+	case BC_OP_CALLFUNCTION:
+	case BC_OP_CALLMETHOD:
+	case BC_OP_TAILCALLFUNCTION:
+	case BC_OP_TAILCALLMETHOD:
+	case BC_OP_CALLLOCAL:
+	case BC_OP_TAILCALLLOCAL: {
+		const tBC_Op	*op = Insn->Content.Op;
+		const int	argc = op->Content.Function.ArgCount & BC_CALL_ARGCOUNT_MASK;
+		for( int i = 0; i < argc; i ++ )
+		{
+			if( op->Content.Function.ArgRegs[i] == Reg )
+				return BC_REGUSE_READ;
+		}
+		// - The callee's frame overwrites everything from a window up (see Bytecode_AppendWindowCall)
+		if( (op->Content.Function.ArgCount & BC_CALL_WINDOW) && argc > 0 && Reg >= op->Content.Function.ArgRegs[0] )
+			return BC_REGUSE_WRITE;
+		return is_dst ? BC_REGUSE_WRITE : BC_REGUSE_NONE; }
+
+	default:
+		// Binary operations
+		if( caOpEncodingTypes[Insn->Operation] == BC_OPENC_REG3 )
+		{
+			if( r2 == Reg || r3 == Reg )	return BC_REGUSE_READ;
+			return is_dst ? BC_REGUSE_WRITE : BC_REGUSE_NONE;
+		}
+		return BC_REGUSE_READ;
+	}
+}
+
+/**
+ * \brief Check that the value in a register is never read after an instruction
+ * \param Index	Instruction after which the register is checked
+ */
+int Bytecode_int_IsRegDeadAfter(const tBC_Insn *Insns, int Count, int Index, int Reg)
+{
+	 int	stack[Count];
+	 int	sp = 0;
+	bool	visited[Count];
+	for( int i = 0; i < Count; i ++ )
+		visited[i] = false;
+
+	void _push_successors(int idx)
+	{
+		const tBC_Insn	*insn = &Insns[idx];
+		if( insn->Operation == BC_OP_RETURN )
+			return ;
+		 int	jmp = Bytecode_int_InsnIsJump(insn);
+		if( jmp && !visited[insn->DstReg] ) {
+			visited[insn->DstReg] = true;
+			stack[sp++] = insn->DstReg;
+		}
+		if( jmp != 1 && idx + 1 < Count && !visited[idx+1] ) {
+			visited[idx+1] = true;
+			stack[sp++] = idx + 1;
+		}
+	}
+
+	_push_successors(Index);
+	while( sp > 0 )
+	{
+		 int	idx = stack[--sp];
+		switch( Bytecode_int_InsnRegUse(&Insns[idx], Reg) )
+		{
+		case BC_REGUSE_READ:
+			return 0;
+		case BC_REGUSE_WRITE:
+			break;
+		case BC_REGUSE_NONE:
+			_push_successors(idx);
+			break;
+		}
+	}
+	return 1;
+}
+
+static int _IntCmpCond(int Operation, bool Invert)
+{
+	static const int	inverse[] = {
+		BC_OP_JUMPIF_INT_NE, BC_OP_JUMPIF_INT_EQ,
+		BC_OP_JUMPIF_INT_GE, BC_OP_JUMPIF_INT_GT,
+		BC_OP_JUMPIF_INT_LE, BC_OP_JUMPIF_INT_LT
+		};
+	 int	ret;
+	switch(Operation)
+	{
+	case BC_OP_INT_EQUALS:      	ret = BC_OP_JUMPIF_INT_EQ;	break;
+	case BC_OP_INT_NOTEQUALS:   	ret = BC_OP_JUMPIF_INT_NE;	break;
+	case BC_OP_INT_LESSTHAN:    	ret = BC_OP_JUMPIF_INT_LT;	break;
+	case BC_OP_INT_LESSTHANEQ:  	ret = BC_OP_JUMPIF_INT_LE;	break;
+	case BC_OP_INT_GREATERTHAN: 	ret = BC_OP_JUMPIF_INT_GT;	break;
+	case BC_OP_INT_GREATERTHANEQ:	ret = BC_OP_JUMPIF_INT_GE;	break;
+	default:
+		return -1;
+	}
+	if( Invert )
+		ret = inverse[ret - BC_OP_JUMPIF_INT_EQ];
+	return ret;
+}
+
+static int _RealCmpCond(int Operation, bool Invert)
+{
+	 int	ret;
+	switch(Operation)
+	{
+	case BC_OP_REAL_EQUALS:      	ret = BC_OP_JUMPIF_REAL_EQ;	break;
+	case BC_OP_REAL_NOTEQUALS:   	ret = BC_OP_JUMPIF_REAL_NE;	break;
+	case BC_OP_REAL_LESSTHAN:    	ret = BC_OP_JUMPIF_REAL_LT;	break;
+	case BC_OP_REAL_LESSTHANEQ:  	ret = BC_OP_JUMPIF_REAL_LE;	break;
+	case BC_OP_REAL_GREATERTHAN: 	ret = BC_OP_JUMPIF_REAL_GT;	break;
+	case BC_OP_REAL_GREATERTHANEQ:	ret = BC_OP_JUMPIF_REAL_GE;	break;
+	default:
+		return -1;
+	}
+	// NaN means the condition can't be inverted, so a separate set of ops is used
+	if( Invert )
+		ret += BC_OP_JUMPIFNOT_REAL_EQ - BC_OP_JUMPIF_REAL_EQ;
+	return ret;
+}
+
+/**
+ * \brief Get the constant added by a LOADINT/ADD (or SUBTRACT) pair
+ * \return Register that is incremented, or -1 if the pair doesn't match
+ */
+static int _GetAddImmediate(const tBC_Insn *Insns, int Count, int Index, int64_t *Imm)
+{
+	const tBC_Insn	*ld = &Insns[Index], *add = &Insns[Index+1];
+	if( ld->Operation != BC_OP_LOADINT )
+		return -1;
+	const int	rk = ld->DstReg;
+	 int	src;
+	int64_t	val = ld->Content.Integer;
+	switch(add->Operation)
+	{
+	case BC_OP_INT_ADD:
+		if( add->Content.RegInt.RegInt3 == rk )
+			src = add->Content.RegInt.RegInt2;
+		else if( add->Content.RegInt.RegInt2 == rk )
+			src = add->Content.RegInt.RegInt3;
+		else
+			return -1;
+		break;
+	case BC_OP_INT_SUBTRACT:
+		if( add->Content.RegInt.RegInt3 != rk )
+			return -1;
+		src = add->Content.RegInt.RegInt2;
+		val = -val;
+		break;
+	default:
+		return -1;
+	}
+	if( src == rk || val < INT32_MIN || val > INT32_MAX )
+		return -1;
+	// The constant must not be needed after the add
+	if( add->DstReg != rk && !Bytecode_int_IsRegDeadAfter(Insns, Count, Index+1, rk) )
+		return -1;
+	*Imm = val;
+	return src;
+}
+
+/**
+ * \brief Attempt to form a superinstruction at \a Index
+ * \return Number of source instructions consumed (0 to drop the instruction)
+ */
+static int Bytecode_int_FuseAt(const tBC_Insn *Insns, int Count, const bool *IsTarget, int Index, tBC_Insn *Out)
+{
+	const tBC_Insn	*insn = &Insns[Index];
+	const int	avail = Count - Index;
+	int64_t	imm;
+	 int	src;
+
+	*Out = *insn;
+
+	// Runtime no-ops
+	if( insn->Operation == BC_OP_NOP )
+		return 0;
+	if( insn->Operation == BC_OP_MOV && insn->DstReg == insn->Content.RegInt.RegInt2 )
+		return 0;
+	if( insn->Operation == BC_OP_JUMP && insn->DstReg == Index + 1 )
+		return 0;
+
+	// LOADINT, ADD, <cmp>, JUMPIF[NOT] (counted loop header)
+	if( avail >= 4 && !IsTarget[Index+1] && !IsTarget[Index+2] && !IsTarget[Index+3]
+	 && (src = _GetAddImmediate(Insns, Count, Index, &imm)) != -1
+	 && Insns[Index+1].DstReg == src && imm >= INT16_MIN && imm <= INT16_MAX )
+	{
+		const tBC_Insn	*cmp = &Insns[Index+2], *jmp = &Insns[Index+3];
+		const int	rb = cmp->DstReg;
+		 int	cond = -1;
+		if( (jmp->Operation == BC_OP_JUMPIF || jmp->Operation == BC_OP_JUMPIFNOT)
+		 && jmp->Content.RegInt.RegInt2 == rb
+		 && cmp->Content.RegInt.RegInt2 == src
+		 && cmp->Content.RegInt.RegInt3 != Insns[Index].DstReg
+		 && rb != src )
+			cond = _IntCmpCond(cmp->Operation, jmp->Operation == BC_OP_JUMPIFNOT);
+		if( cond != -1 && Bytecode_int_IsRegDeadAfter(Insns, Count, Index+3, rb) )
+		{
+			Out->Operation = cond - BC_OP_JUMPIF_INT_EQ + BC_OP_INT_INC_JUMPIF_EQ;
+			Out->Aux = imm;
+			Out->DstReg = jmp->DstReg;
+			Out->Content.RegInt.RegInt2 = src;
+			Out->Content.RegInt.RegInt3 = cmp->Content.RegInt.RegInt3;
+			return 4;
+		}
+	}
+
+	// LOADINT, ADD
+	if( avail >= 2 && !IsTarget[Index+1]
+	 && (src = _GetAddImmediate(Insns, Count, Index, &imm)) != -1 )
+	{
+		Out->Operation = BC_OP_INT_ADDI;
+		Out->DstReg = Insns[Index+1].DstReg;
+		Out->Content.RegInt.RegInt2 = src;
+		Out->Content.RegInt.RegInt3 = imm;
+		return 2;
+	}
+
+	// <cmp>, JUMPIF[NOT]
+	if( avail >= 2 && !IsTarget[Index+1] && caOpEncodingTypes[insn->Operation] == BC_OPENC_REG3 )
+	{
+		const tBC_Insn	*jmp = &Insns[Index+1];
+		if( (jmp->Operation == BC_OP_JUMPIF || jmp->Operation == BC_OP_JUMPIFNOT)
+		 && jmp->Content.RegInt.RegInt2 == insn->DstReg )
+		{
+			bool	invert = (jmp->Operation == BC_OP_JUMPIFNOT);
+			 int	cond = _IntCmpCond(insn->Operation, invert);
+			if( cond == -1 )
+				cond = _RealCmpCond(insn->Operation, invert);
+			if( cond != -1 && Bytecode_int_IsRegDeadAfter(Insns, Count, Index+1, insn->DstReg) )
+			{
+				Out->Operation = cond;
+				Out->DstReg = jmp->DstReg;
+				return 2;
+			}
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * \brief Replace common instruction sequences with fused instructions
+ * \note Called on the flattened form, jump targets are instruction indexes
+ */
+int Bytecode_int_FuseInstructions(tBC_Function *Fcn)
+{
+	const int	count = Fcn->InstructionCount;
+	const tBC_Insn	*insns = Fcn->Instructions;
+
+	// Sequences can't be fused across a jump target
+	bool	is_target[count];
+	for( int i = 0; i < count; i ++ )
+		is_target[i] = false;
+	for( int i = 0; i < count; i ++ )
+	{
+		if( Bytecode_int_InsnIsJump(&insns[i]) )
+			is_target[ insns[i].DstReg ] = true;
+	}
+	Bytecode_int_MarkHandlerTargets(Fcn, is_target);
+
+	tBC_Insn	*out = malloc( count * sizeof(tBC_Insn) );
+	if( !out )	return -1;
+
+	 int	new_idx[count];
+	 int	n_out = 0;
+	for( int i = 0; i < count; )
+	{
+		 int	used = Bytecode_int_FuseAt(insns, count, is_target, i, &out[n_out]);
+		new_idx[i] = n_out;
+		if( used == 0 ) {
+			i ++;
+			continue ;
+		}
+		for( int j = 1; j < used; j ++ )
+			new_idx[i+j] = n_out;
+		n_out ++;
+		i += used;
+	}
+
+	// Update jump targets
+	for( int i = 0; i < n_out; i ++ )
+	{
+		if( Bytecode_int_InsnIsJump(&out[i]) )
+			out[i].DstReg = new_idx[ out[i].DstReg ];
+	}
+	Bytecode_int_RemapLines(Fcn, new_idx);
+
+	free(Fcn->Instructions);
+	Fcn->Instructions = out;
+	Fcn->InstructionCount = n_out;
+	return 0;
+}
@@ -26,13 +26,9 @@ tBC_Op	*Bytecode_int_AllocateOp(enum eBC_Ops Operation, int ExtraBytes);
  int	Bytecode_int_AddVariable(tBC_Function *Handle, const char *Name);
 
 // === GLOBALS ===
-const enum eOpEncodingType caOpEncodingTypes[] = {
+const enum eOpEncodingType caOpEncodingTypes[BC_OP_COUNT] = {
 	[BC_OP_NOP] = BC_OPENC_NOOPRS,
-	[BC_OP_ENTERCONTEXT] = BC_OPENC_NOOPRS,
-	[BC_OP_LEAVECONTEXT] = BC_OPENC_NOOPRS,
-	[BC_OP_NOTEPOSITION] = BC_OPENC_UNK,
 
-	[BC_OP_TAGREGISTER] = BC_OPENC_STRING,
 	[BC_OP_IMPORTGLOBAL] = BC_OPENC_STRING,
 	[BC_OP_GETGLOBAL] = BC_OPENC_REG2,
 	[BC_OP_SETGLOBAL] = BC_OPENC_REG2,
@@ -56,9 +52,16 @@ const enum eOpEncodingType caOpEncodingTypes[] = {
 	[BC_OP_CREATEOBJ]    = BC_OPENC_UNK,
 	[BC_OP_CALLFUNCTION] = BC_OPENC_UNK,
 	[BC_OP_CALLMETHOD]   = BC_OPENC_UNK,
+	[BC_OP_TAILCALLFUNCTION] = BC_OPENC_UNK,
+	[BC_OP_TAILCALLMETHOD]   = BC_OPENC_UNK,
+	[BC_OP_MOV_MOVE] = BC_OPENC_REG2,
+	[BC_OP_FOREACH_INIT] = BC_OPENC_REG2,
+	[BC_OP_FOREACH_NEXT] = BC_OPENC_REG3,
 
 	[BC_OP_GETINDEX] = BC_OPENC_REG3,
 	[BC_OP_SETINDEX] = BC_OPENC_REG3,
+	[BC_OP_GETINDEX_INRANGE] = BC_OPENC_REG3,
+	[BC_OP_SETINDEX_INRANGE] = BC_OPENC_REG3,
 	[BC_OP_GETELEMENT] = BC_OPENC_REG3,
 	[BC_OP_SETELEMENT] = BC_OPENC_REG3,
 
@@ -68,6 +71,7 @@ const enum eOpEncodingType caOpEncodingTypes[] = {
 	[BC_OP_INT_BITNOT] = BC_OPENC_REG2,
 
 	[BC_OP_BOOL_EQUALS] = BC_OPENC_REG3,
+	[BC_OP_BOOL_LOGICNOT] = BC_OPENC_REG2,
 	[BC_OP_BOOL_LOGICAND] = BC_OPENC_REG3,
 	[BC_OP_BOOL_LOGICOR]  = BC_OPENC_REG3,
 	[BC_OP_BOOL_LOGICXOR] = BC_OPENC_REG3,
@@ -113,8 +117,6 @@ const enum eOpEncodingType caOpEncodingTypes[] = {
 	[BC_OP_STR_GREATERTHANEQ] = BC_OPENC_REG3,
 	
 	[BC_OP_STR_ADD] = BC_OPENC_REG3,
-
-	[BC_OP_EXCEPTION_POP] = BC_OPENC_NOOPRS,
 };
 
 // === CODE ===
@@ -125,6 +127,7 @@ tBC_Function *Bytecode_CreateFunction(tSpiderScript *Script, tScript_Function *F
 	ret = calloc(sizeof(tBC_Function), 1);
 	if(!ret)	return NULL;
 	ret->Script = Script;
+	ret->ArgumentCount = Fcn->ArgumentCount;
 	ret->OperationsEnd = (void*)&ret->Operations;
 
 	return ret;
@@ -134,6 +137,250 @@ int Bytecode_CommitFunction(tBC_Function *Fcn, int MaxReg, int MaxGlobal)
 {
 	Fcn->MaxRegisters = MaxReg;
 	Fcn->MaxGlobalCount = MaxGlobal;
+	// - Optimisation can add registers, so it needs the frame size
+	if( Bytecode_OptimiseFunction(Fcn->Script, Fcn) )
+		return -1;
+	if( Bytecode_int_FlattenFunction(Fcn) )
+		return -1;
+	if( Bytecode_int_FuseInstructions(Fcn) )
+		return -1;
+	return Bytecode_int_AllocInlineCaches(Fcn);
+}
+
+/**
+ * \brief Fill an instruction from an operation
+ * \note Jumps are left with the label number in DstReg
+ */
+void Bytecode_int_OpToInsn(const tBC_Op *Op, tBC_Insn *Insn)
+{
+	Insn->Operation = Op->Operation;
+	Insn->Aux = 0;
+	Insn->DstReg = Op->DstReg;
+	switch(Op->Operation)
+	{
+	case BC_OP_LOADINT:
+		Insn->Content.Integer = Op->Content.Integer;
+		break;
+	case BC_OP_LOADREAL:
+		Insn->Content.Real = Op->Content.Real;
+		break;
+	default:
+		switch( caOpEncodingTypes[Op->Operation] )
+		{
+		case BC_OPENC_REG1:
+		case BC_OPENC_REG2:
+		case BC_OPENC_REG3:
+			Insn->Content.RegInt.RegInt2 = Op->Content.RegInt.RegInt2;
+			Insn->Content.RegInt.RegInt3 = Op->Content.RegInt.RegInt3;
+			break;
+		default:
+			// Strings, calls and positions keep their data in the op
+			Insn->Content.Op = (tBC_Op*)Op;
+			break;
+		}
+		break;
+	}
+}
+
+/**
+ * \brief Lower the operation list into a contiguous instruction array
+ * \note Label numbers in jumps are resolved to instruction indexes
+ */
+int Bytecode_int_FlattenFunction(tBC_Function *Fcn)
+{
+	 int	count = 0;
+	for( tBC_Op *op = Fcn->Operations; op; op = op->Next )
+		count ++;
+
+	// - One extra for the implicit return at the end
+	tBC_Insn	*insns = malloc( (count + 1) * sizeof(tBC_Insn) );
+	if( !insns )	return -1;
+
+	// Get the instruction index of each label
+	 int	label_idx[Fcn->LabelCount+1];
+	for( int i = 0; i < Fcn->LabelCount; i ++ )
+		label_idx[i] = -1;
+	tBC_Op	*prev = (void*)&Fcn->Operations;
+	for( int idx = 0; idx <= count; idx ++ )
+	{
+		// Labels point to the operation before the target
+		for( int i = 0; i < Fcn->LabelCount; i ++ )
+		{
+			if( Fcn->Labels[i] == prev )
+				label_idx[i] = idx;
+		}
+		prev = prev->Next;
+	}
+
+	 int	idx = 0;
+	for( tBC_Op *op = Fcn->Operations; op; op = op->Next, idx ++ )
+	{
+		tBC_Insn	*insn = &insns[idx];
+		Bytecode_int_OpToInsn(op, insn);
+		switch(op->Operation)
+		{
+		case BC_OP_JUMP:
+		case BC_OP_JUMPIF:
+		case BC_OP_JUMPIFNOT:
+		case BC_OP_FOREACH_NEXT:
+			if( op->DstReg < 0 || op->DstReg >= Fcn->LabelCount || label_idx[op->DstReg] == -1 ) {
+				BUG("Jump to unset label %i", op->DstReg);
+				free(insns);
+				return -1;
+			}
+			insn->DstReg = label_idx[op->DstReg];
+			// - FOREACH_NEXT's value register is in RegInt3
+			if( op->Operation != BC_OP_FOREACH_NEXT )
+				insn->Content.RegInt.RegInt3 = 0;
+			break;
+		default:
+			break;
+		}
+	}
+	// Falling off the end is a void return
+	insns[count].Operation = BC_OP_RETURN;
+	insns[count].Aux = 0;
+	insns[count].DstReg = -1;
+	insns[count].Content.Op = NULL;
+
+	// Operations and instructions correspond one to one, so positions are copied as-is
+	tBC_LineEnt	*lines = malloc( Fcn->LineCount * sizeof(tBC_LineEnt) );
+	if( !lines && Fcn->LineCount ) {
+		free(insns);
+		return -1;
+	}
+	memcpy(lines, Fcn->Lines, Fcn->LineCount * sizeof(tBC_LineEnt));
+
+	// Handler ranges are labels
+	tBC_HandlerEnt	*handlers = malloc( Fcn->HandlerCount * sizeof(tBC_HandlerEnt) );
+	if( !handlers && Fcn->HandlerCount ) {
+		free(lines);
+		free(insns);
+		return -1;
+	}
+	for( int i = 0; i < Fcn->HandlerCount; i ++ )
+	{
+		const tBC_HandlerEnt	*ent = &Fcn->Handlers[i];
+		if( label_idx[ent->Start] == -1 || label_idx[ent->End] == -1 || label_idx[ent->Handler] == -1 ) {
+			BUG("Handler %i uses an unset label", i);
+			free(handlers);
+			free(lines);
+			free(insns);
+			return -1;
+		}
+		handlers[i] = *ent;
+		handlers[i].Start = label_idx[ent->Start];
+		handlers[i].End = label_idx[ent->End];
+		handlers[i].Handler = label_idx[ent->Handler];
+	}
+
+	free(Fcn->Instructions);
+	Fcn->Instructions = insns;
+	Fcn->InstructionCount = count + 1;
+	free(Fcn->InsnLines);
+	Fcn->InsnLines = lines;
+	Fcn->InsnLineCount = Fcn->LineCount;
+	free(Fcn->InsnHandlers);
+	Fcn->InsnHandlers = handlers;
+	return 0;
+}
+
+/**
+ * \brief Update the instruction line and handler tables after instructions have been moved
+ * \param NewIdx	New index of each old instruction (ascending)
+ * \note Positions that end up at the same instruction are merged, the last one is kept
+ */
+void Bytecode_int_RemapLines(tBC_Function *Fcn, const int *NewIdx)
+{
+	 int	n = 0;
+	for( int i = 0; i < Fcn->InsnLineCount; i ++ )
+	{
+		tBC_LineEnt	ent = Fcn->InsnLines[i];
+		ent.PC = NewIdx[ent.PC];
+		if( n > 0 && Fcn->InsnLines[n-1].PC == ent.PC )
+			n --;
+		Fcn->InsnLines[n++] = ent;
+	}
+	Fcn->InsnLineCount = n;
+
+	// - A range that loses all its instructions is left empty (Start == End)
+	for( int i = 0; i < Fcn->HandlerCount; i ++ )
+	{
+		tBC_HandlerEnt	*ent = &Fcn->InsnHandlers[i];
+		ent->Start = NewIdx[ent->Start];
+		ent->End = NewIdx[ent->End];
+		ent->Handler = NewIdx[ent->Handler];
+	}
+}
+
+/**
+ * \brief Mark the instructions at the edges of handler ranges as jump targets
+ * \note Instructions can't be merged across these, they are where control arrives or where
+ *       the handler in effect changes
+ */
+void Bytecode_int_MarkHandlerTargets(const tBC_Function *Fcn, bool *IsTarget)
+{
+	for( int i = 0; i < Fcn->HandlerCount; i ++ )
+	{
+		const tBC_HandlerEnt	*ent = &Fcn->InsnHandlers[i];
+		IsTarget[ent->Start] = true;
+		IsTarget[ent->End] = true;
+		IsTarget[ent->Handler] = true;
+	}
+}
+
+/**
+ * \brief Get the source position of an instruction
+ * \return Non-zero if no position is known (\a File is set to NULL)
+ */
+int Bytecode_int_GetPosition(const tBC_Function *Fcn, int PC, const char **File, int *Line)
+{
+	// Last entry at or before PC
+	 int	lo = 0, hi = Fcn->InsnLineCount;
+	while( lo < hi )
+	{
+		 int	mid = (lo + hi) / 2;
+		if( Fcn->InsnLines[mid].PC <= PC )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if( lo == 0 ) {
+		*File = NULL;
+		*Line = 0;
+		return 1;
+	}
+	*File = Fcn->InsnLines[lo-1].File;
+	*Line = Fcn->InsnLines[lo-1].Line;
+	return 0;
+}
+
+/**
+ * \brief Give each method call and element access its own inline cache
+ * \note The cache index is stored in the instruction's Aux field (-1 = uncached)
+ */
+int Bytecode_int_AllocInlineCaches(tBC_Function *Fcn)
+{
+	 int	n = 0;
+	for( int i = 0; i < Fcn->InstructionCount; i ++ )
+	{
+		tBC_Insn	*insn = &Fcn->Instructions[i];
+		switch(insn->Operation)
+		{
+		case BC_OP_CALLMETHOD:
+		case BC_OP_TAILCALLMETHOD:
+		case BC_OP_GETELEMENT:
+		case BC_OP_SETELEMENT:
+			insn->Aux = (n <= INT16_MAX ? n ++ : -1);
+			break;
+		}
+	}
+
+	free(Fcn->InlineCaches);
+	Fcn->InlineCaches = calloc(n, sizeof(tBC_InlineCache));
+	if( !Fcn->InlineCaches && n )
+		return -1;
+	Fcn->InlineCacheCount = n;
 	return 0;
 }
 
@@ -143,14 +390,22 @@ void Bytecode_DeleteFunction(tBC_Function *Fcn)
 	for( op = Fcn->Operations; op; )
 	{
 		tBC_Op	*nextop = op->Next;
-		if(op->Operation == BC_OP_NOTEPOSITION) {
-			op->Content.RefStr->RefCount --;
-			if( op->Content.RefStr->RefCount == 0 )
-				free(op->Content.RefStr);
-		}
 		free(op);
 		op = nextop;
 	}
+	for( int i = 0; i < Fcn->LineCount; i ++ )
+		Bytecode_int_DerefFile(Fcn->Lines[i].File);
+	free(Fcn->Lines);
+	for( int i = 0; i < Fcn->VarCount; i ++ )
+		free(Fcn->Vars[i].Name);
+	free(Fcn->Vars);
+	free(Fcn->Handlers);
+	free(Fcn->Instructions);
+	free(Fcn->InsnLines);
+	free(Fcn->InsnHandlers);
+	free(Fcn->InlineCaches);
+	free(Fcn->JitCode);
+	Bytecode_int_FreeTier(Fcn->Optimised);
 	free(Fcn->Labels);
 	free(Fcn);
 }
@@ -196,10 +451,121 @@ void Bytecode_int_AppendOp(tBC_Function *Fcn, tBC_Op *Op)
 	else
 		Fcn->Operations = Op;
 	Fcn->OperationsEnd = Op;
+	Fcn->OperationCount ++;
+}
+
+/**
+ * \brief Release a reference to a file name used in a line table
+ * \note File names are preceded by a reference count (see Parse_BufferInt)
+ */
+void Bytecode_int_DerefFile(const char *File)
+{
+	 int	*refcount = (int*)File - 1;
+	if( -- *refcount == 0 )
+		free(refcount);
+}
+
+/**
+ * \brief Append a source position to a function's line table
+ * \param PC	Index of the first operation at the position
+ */
+int Bytecode_int_AddLine(tBC_Function *Fcn, int PC, const char *File, int Line)
+{
+	tBC_LineEnt	*last = (Fcn->LineCount > 0 ? &Fcn->Lines[Fcn->LineCount-1] : NULL);
+
+	if( last && last->File == File && last->Line == Line )
+		return 0;
+	// Nothing was emitted for the previous position
+	if( last && last->PC == PC ) {
+		Bytecode_int_DerefFile(last->File);
+		Fcn->LineCount --;
+	}
+	if( Fcn->LineCount == Fcn->LineSpace )
+	{
+		 int	space = Fcn->LineSpace * 2 + 16;
+		void *tmp = realloc(Fcn->Lines, space * sizeof(tBC_LineEnt));
+		if( !tmp )	return -1;
+		Fcn->Lines = tmp;
+		Fcn->LineSpace = space;
+	}
+	((int*)File)[-1] ++;
+	Fcn->Lines[Fcn->LineCount].PC = PC;
+	Fcn->Lines[Fcn->LineCount].Line = Line;
+	Fcn->Lines[Fcn->LineCount].File = File;
+	Fcn->LineCount ++;
+	return 0;
+}
+
+/**
+ * \brief Append a variable name to a function's variable table
+ * \param PC	Index of the first operation where \a Reg holds the variable
+ */
+int Bytecode_int_AddVar(tBC_Function *Fcn, int PC, int Reg, const char *Name)
+{
+	if( Fcn->VarCount == Fcn->VarSpace )
+	{
+		 int	space = Fcn->VarSpace * 2 + 8;
+		void *tmp = realloc(Fcn->Vars, space * sizeof(tBC_VarEnt));
+		if( !tmp )	return -1;
+		Fcn->Vars = tmp;
+		Fcn->VarSpace = space;
+	}
+	char	*name = strdup(Name);
+	if( !name )	return -1;
+	Fcn->Vars[Fcn->VarCount].PC = PC;
+	Fcn->Vars[Fcn->VarCount].Reg = Reg;
+	Fcn->Vars[Fcn->VarCount].Name = name;
+	Fcn->VarCount ++;
+	return 0;
+}
+
+/**
+ * \brief Append an exception handler to a function's handler table
+ * \note Handlers are searched in order, so a range must be added before any range containing it
+ */
+int Bytecode_int_AddHandler(tBC_Function *Fcn, const tBC_HandlerEnt *Ent)
+{
+	if( Fcn->HandlerCount == Fcn->HandlerSpace )
+	{
+		 int	space = Fcn->HandlerSpace * 2 + 4;
+		void *tmp = realloc(Fcn->Handlers, space * sizeof(tBC_HandlerEnt));
+		if( !tmp )	return -1;
+		Fcn->Handlers = tmp;
+		Fcn->HandlerSpace = space;
+	}
+	Fcn->Handlers[Fcn->HandlerCount++] = *Ent;
+	return 0;
+}
+
+/**
+ * \brief Pre-seed the script's type table with the core types
+ *
+ * Core types are always at the index matching their SS_DATATYPE_* value, so
+ * the interpreter can type-check registers with a plain integer compare.
+ */
+void Bytecode_int_InitTypes(tSpiderScript *Script)
+{
+	if( Script->BCTypeCount > 0 )
+		return ;
+	
+	Script->BCTypeSpace = NUM_SS_DATATYPES + 10;
+	Script->BCTypes = malloc(Script->BCTypeSpace * sizeof(*Script->BCTypes));
+	if( !Script->BCTypes ) {
+		perror("Bytecode_int_InitTypes");
+		Script->BCTypeSpace = 0;
+		return ;
+	}
+	for( int i = 0; i < NUM_SS_DATATYPES; i ++ )
+	{
+		Script->BCTypes[i].ArrayDepth = 0;
+		Script->BCTypes[i].Def = SpiderScript_GetCoreType(i);
+	}
+	Script->BCTypeCount = NUM_SS_DATATYPES;
 }
 
 int Bytecode_int_GetTypeIdx(tSpiderScript *Script, tSpiderTypeRef Type)
 {
+	Bytecode_int_InitTypes(Script);
 	for( int i = 0; i < Script->BCTypeCount; i ++ )
 	{
 		if( SS_TYPESEQUAL(Script->BCTypes[i], Type) ) {
@@ -276,6 +642,17 @@ void Bytecode_AppendCondJumpNot(tBC_Function *Handle, int Label, int CReg)
 	DEF_BC_RI2(BC_OP_JUMPIFNOT, Label, CReg)
 void Bytecode_AppendReturn(tBC_Function *Handle, int Reg)
 	DEF_BC_RI1(BC_OP_RETURN, Reg);
+/**
+ * \brief Start iterating over an array or String
+ * \param StateReg	First of two consecutive registers, holding the collection and the index
+ */
+void Bytecode_AppendForeachInit(tBC_Function *Handle, int StateReg, int SrcReg)
+	DEF_BC_RI2(BC_OP_FOREACH_INIT, StateReg, SrcReg)
+/**
+ * \brief Load the next element into \a ValReg, or jump to \a Label once exhausted
+ */
+void Bytecode_AppendForeachNext(tBC_Function *Handle, int Label, int StateReg, int ValReg)
+	DEF_BC_RI3(BC_OP_FOREACH_NEXT, Label, StateReg, ValReg)
 
 // --- Constants
 void Bytecode_AppendConstNull(tBC_Function *Handle, int Dst, tSpiderTypeRef Type)
@@ -319,7 +696,7 @@ void Bytecode_int_AppendCall(tBC_Function *Handle, enum eBC_Ops Op, int RetReg,
 	tBC_Op *op = Bytecode_int_AllocateOp(Op, sizeof(int)*ArgC);
 	op->DstReg = RetReg;
 	op->Content.Function.ID = FcnIdx;
-	op->Content.Function.ArgCount = ArgC | (VArgsPassThrough ? 0x100 : 0);
+	op->Content.Function.ArgCount = ArgC | (VArgsPassThrough ? BC_CALL_VARGS_PASSTHROUGH : 0);
 	for( int i = 0; i < ArgC; i ++ )
 		op->Content.Function.ArgRegs[i] = ArgRegs[i];
 	Bytecode_int_AppendOp(Handle, op);
@@ -339,6 +716,26 @@ void Bytecode_AppendFunctionCall(tBC_Function *Handle, uint32_t ID, int RetReg,
 {
 	Bytecode_int_AppendCall(Handle, BC_OP_CALLFUNCTION, RetReg, ID, NArgs, ArgRegs, VArgsPassThrough);
 }
+void Bytecode_AppendTailMethodCall(tBC_Function *Handle, uint32_t ID, int RetReg, size_t NArgs, int ArgRegs[], bool VArgsPassThrough)
+{
+	Bytecode_int_AppendCall(Handle, BC_OP_TAILCALLMETHOD, RetReg, ID, NArgs, ArgRegs, VArgsPassThrough);
+}
+void Bytecode_AppendTailFunctionCall(tBC_Function *Handle, uint32_t ID, int RetReg, size_t NArgs, int ArgRegs[], bool VArgsPassThrough)
+{
+	Bytecode_int_AppendCall(Handle, BC_OP_TAILCALLFUNCTION, RetReg, ID, NArgs, ArgRegs, VArgsPassThrough);
+}
+/**
+ * \brief Call a script function with its arguments in a register window
+ * \param ArgRegs	Consecutive registers, with no live register above them except RetReg
+ *
+ * The callee's registers start at the window, so the arguments are moved to the callee
+ * and are cleared by the call. Registers above the window are overwritten.
+ */
+void Bytecode_AppendWindowCall(tBC_Function *Handle, bool IsMethod, uint32_t ID, int RetReg, size_t NArgs, int ArgRegs[])
+{
+	Bytecode_int_AppendCall(Handle, (IsMethod ? BC_OP_CALLMETHOD : BC_OP_CALLFUNCTION), RetReg, ID, NArgs, ArgRegs, false);
+	Handle->OperationsEnd->Content.Function.ArgCount |= BC_CALL_WINDOW;
+}
 void Bytecode_AppendCreateArray(tBC_Function *Handle, int RetReg, tSpiderTypeRef Type, int SizeReg) 
 	DEF_BC_RI3(BC_OP_CREATEARRAY, RetReg, Bytecode_int_GetTypeIdx(Handle->Script, Type), SizeReg)
 
@@ -348,6 +745,26 @@ void Bytecode_AppendClearReg(tBC_Function *Handle, int Reg)
 	DEF_BC_RI1(BC_OP_CLEARREG, Reg)
 void Bytecode_AppendMov(tBC_Function *Handle, int DstReg, int SrcReg)
 	DEF_BC_RI2(BC_OP_MOV, DstReg, SrcReg)
+void Bytecode_AppendMove(tBC_Function *Handle, int DstReg, int SrcReg)
+	DEF_BC_RI2(BC_OP_MOV_MOVE, DstReg, SrcReg)
+/**
+ * \brief Turn a MOV from a register that is no longer used into a move
+ * \return Boolean, true if the last operation was changed (the register is now cleared)
+ */
+int Bytecode_MoveLastUse(tBC_Function *Handle, int Reg)
+{
+	tBC_Op	*op = Handle->OperationsEnd;
+	if( !op || op->Operation != BC_OP_MOV || op->Content.RegInt.RegInt2 != Reg || op->DstReg == Reg )
+		return 0;
+	// - A jump to after the MOV could arrive with a different value in the register
+	for( int i = 0; i < Handle->LabelCount; i ++ )
+	{
+		if( Handle->Labels[i] == op )
+			return 0;
+	}
+	op->Operation = BC_OP_MOV_MOVE;
+	return 1;
+}
 //void Bytecode_AppendDeref(tBC_Function *Handle, int Reg)
 //	DEF_BC_RI1(BC_OP_DEREF, Reg)
 enum eBC_Ops Bytecode_int_GetBinOpBool(enum eBC_BinOp Op)
@@ -382,8 +799,12 @@ enum eBC_Ops Bytecode_int_GetBinOpInt(enum eBC_BinOp Op)
 	case BINOP_DIV: 	return BC_OP_INT_DIVIDE;
 	case BINOP_MOD: 	return BC_OP_INT_MODULO;
 	
+	case BINOP_BITAND:	return BC_OP_INT_BITAND;
 	case BINOP_BITOR:	return BC_OP_INT_BITOR;
 	case BINOP_BITXOR:	return BC_OP_INT_BITXOR;
+	case BINOP_BITSHIFTLEFT:	return BC_OP_INT_BITSHIFTLEFT;
+	case BINOP_BITSHIFTRIGHT:	return BC_OP_INT_BITSHIFTRIGHT;
+	case BINOP_BITROTATELEFT:	return BC_OP_INT_BITROTATELEFT;
 	default:
 		BUG("BinOpInt %i unhandled", Op);
 		return BC_OP_NOP;
@@ -399,6 +820,13 @@ enum eBC_Ops Bytecode_int_GetBinOpReal(enum eBC_BinOp Op)
 	case BINOP_SUB:	return BC_OP_REAL_SUBTRACT;
 	case BINOP_MUL:	return BC_OP_REAL_MULTIPLY;
 	case BINOP_DIV:	return BC_OP_REAL_DIVIDE;
+	
+	case BINOP_EQ:	return BC_OP_REAL_EQUALS;
+	case BINOP_NE:	return BC_OP_REAL_NOTEQUALS;
+	case BINOP_LT:	return BC_OP_REAL_LESSTHAN;
+	case BINOP_LE:	return BC_OP_REAL_LESSTHANEQ;
+	case BINOP_GT:	return BC_OP_REAL_GREATERTHAN;
+	case BINOP_GE:	return BC_OP_REAL_GREATERTHANEQ;
 	default:
 		BUG("BinOpReal %i unhandled", Op);
 		return BC_OP_NOP;
@@ -450,26 +878,36 @@ enum eBC_Ops Bytecode_int_GetUniOpInt(enum eBC_UniOp Op)
 }
 void Bytecode_AppendUniInt(tBC_Function *Handle, int Op, int DstReg, int SrcReg)
 	DEF_BC_RI2(Bytecode_int_GetUniOpInt(Op), DstReg, SrcReg)
-void Bytecode_AppendEnterContext(tBC_Function *Handle)
-	DEF_BC_NONE(BC_OP_ENTERCONTEXT)
-void Bytecode_AppendLeaveContext(tBC_Function *Handle)
-	DEF_BC_NONE(BC_OP_LEAVECONTEXT)
+/**
+ * \brief Note the source position of the following operations
+ * \note Recorded in the line table, it is only looked up when an exception is raised
+ */
 void Bytecode_AppendPos(tBC_Function *Handle, const char *Filename, int Line)
 {
-	tBC_Op *op = Bytecode_int_AllocateOp(BC_OP_NOTEPOSITION, 0);
-	op->DstReg = Line;
-	op->Content.RefStr = (void*)((int*)Filename-1);
-	op->Content.RefStr->RefCount ++;
-	Bytecode_int_AppendOp(Handle, op);
+	if( Bytecode_int_AddLine(Handle, Handle->OperationCount, Filename, Line) )
+		BUG("Out of memory recording %s:%i", Filename, Line);
 }
 
 void Bytecode_AppendDefineVar(tBC_Function *Handle, int Reg, const char *Name, tSpiderTypeRef Type)
 {
-	tBC_Op *op = Bytecode_int_AllocateOp(BC_OP_TAGREGISTER, strlen(Name)+1);
-	op->DstReg = Reg;
-	op->Content.String.Length = strlen(Name);
-	strcpy(op->Content.String.Data, Name);
-	Bytecode_int_AppendOp(Handle, op);
+	if( Bytecode_int_AddVar(Handle, Handle->OperationCount, Reg, Name) )
+		BUG("Out of memory recording variable %s", Name);
+}
+/**
+ * \brief Catch exceptions raised between two labels
+ * \param CatchType	SS_DATATYPE_INTEGER to catch the exception number, SS_DATATYPE_STRING
+ *                 	for the message
+ * \param CatchReg	Register set to the caught value when \a HandlerLabel is entered
+ * \note Recorded in the handler table, nothing is executed unless an exception is raised
+ */
+void Bytecode_AppendHandler(tBC_Function *Handle, int StartLabel, int EndLabel, int HandlerLabel, int CatchType, int CatchReg)
+{
+	tBC_HandlerEnt	ent = {
+		.Start = StartLabel, .End = EndLabel, .Handler = HandlerLabel,
+		.CatchType = CatchType, .CatchReg = CatchReg
+		};
+	if( Bytecode_int_AddHandler(Handle, &ent) )
+		BUG("Out of memory recording handler");
 }
 void Bytecode_AppendImportGlobal(tBC_Function *Handle, int Slot, const char *Name, tSpiderTypeRef Type)
 {
@@ -11,7 +11,8 @@
 #include <stdbool.h>
 
 enum eBC_UniOp {
-	UNIOP_LOGICNOT,
+	// - Non-zero, AST_ConvertNode picks the operation with `if(!op)` fall-through
+	UNIOP_LOGICNOT = 1,
 	UNIOP_BITNOT,
 	UNIOP_NEG
 };
@@ -45,9 +46,12 @@ extern int	Bytecode_int_GetTypeIdx(tSpiderScript *Script, tSpiderTypeRef Type);
 extern tBC_Function	*Bytecode_CreateFunction(tSpiderScript *Script, tScript_Function *ScriptFcn);
 extern  int	Bytecode_CommitFunction(tBC_Function *Handle, int MaxReg, int MaxGlobal);
 extern void	Bytecode_DeleteFunction(tBC_Function *Handle);
+// bytecode_optimise.c
+extern  int	Bytecode_OptimiseFunction(tSpiderScript *Script, tBC_Function *Handle);
+// bytecode_verify.c
+extern  int	Bytecode_VerifyFunction(tSpiderScript *Script, tScript_Function *Fcn);
+extern  int	Bytecode_VerifyScript(tSpiderScript *Script);
 
-extern void	Bytecode_AppendEnterContext(tBC_Function *Handle);
-extern void	Bytecode_AppendLeaveContext(tBC_Function *Handle);
 extern void	Bytecode_AppendPos(tBC_Function *Handle, const char *Filename, int Line);
 
 extern  int	Bytecode_AllocateLabel(tBC_Function *Handle);
@@ -55,6 +59,9 @@ extern void	Bytecode_SetLabel(tBC_Function *Handle, int Label);
 extern void	Bytecode_AppendJump(tBC_Function *Handle, int Label);
 extern void	Bytecode_AppendCondJump(tBC_Function *Handle, int Label, int CReg);
 extern void	Bytecode_AppendCondJumpNot(tBC_Function *Handle, int Label, int CReg);
+extern void	Bytecode_AppendForeachInit(tBC_Function *Handle, int StateReg, int SrcReg);
+extern void	Bytecode_AppendForeachNext(tBC_Function *Handle, int Label, int StateReg, int ValReg);
+extern void	Bytecode_AppendHandler(tBC_Function *Handle, int StartLabel, int EndLabel, int HandlerLabel, int CatchType, int CatchReg);
 
 extern void	Bytecode_AppendConstNull(tBC_Function *Handle, int DstReg, tSpiderTypeRef Type);
 extern void	Bytecode_AppendConstInt(tBC_Function *Handle, int DstReg, tSpiderInteger Value);
@@ -65,11 +72,16 @@ extern void	Bytecode_AppendCreateArray(tBC_Function *Handle, int RetReg, tSpider
 extern void	Bytecode_AppendCreateObj(tBC_Function *Handle, tSpiderScript_TypeDef *Def, int RetReg, size_t NArgs, int ArgRegs[], bool VArgsPassThrough);
 extern void	Bytecode_AppendFunctionCall(tBC_Function *Handle, uint32_t ID, int RetReg, size_t NArgs, int ArgRegs[], bool VArgsPassThrough);
 extern void	Bytecode_AppendMethodCall(tBC_Function *Handle, uint32_t ID, int RetReg, size_t NArgs, int ArgRegs[], bool VArgsPassThrough);
+extern void	Bytecode_AppendTailFunctionCall(tBC_Function *Handle, uint32_t ID, int RetReg, size_t NArgs, int ArgRegs[], bool VArgsPassThrough);
+extern void	Bytecode_AppendTailMethodCall(tBC_Function *Handle, uint32_t ID, int RetReg, size_t NArgs, int ArgRegs[], bool VArgsPassThrough);
+extern void	Bytecode_AppendWindowCall(tBC_Function *Handle, bool IsMethod, uint32_t ID, int RetReg, size_t NArgs, int ArgRegs[]);
 
 extern void	Bytecode_AppendReturn(tBC_Function *Handle, int ReturnReg);
 
 extern void	Bytecode_AppendClearReg(tBC_Function *Handle, int Reg);
 extern void	Bytecode_AppendMov(tBC_Function *Handle, int DstReg, int SrcReg);
+extern void	Bytecode_AppendMove(tBC_Function *Handle, int DstReg, int SrcReg);
+extern int	Bytecode_MoveLastUse(tBC_Function *Handle, int Reg);
 extern void	Bytecode_AppendBinOpBool(tBC_Function *Handle, int DstReg, int Op, int LReg, int RReg);
 extern void	Bytecode_AppendBinOpInt(tBC_Function *Handle, int DstReg, int Op, int LReg, int RReg);
 extern void	Bytecode_AppendBinOpReal(tBC_Function *Handle, int DstReg, int Op, int LReg, int RReg);
@@ -0,0 +1,753 @@
+/*
+ * SpiderScript Library
+ * by John Hodge (thePowersGang)
+ *
+ * bytecode_jit.c
+ * - Template compiler from flattened bytecode to x86-64 machine code
+ *
+ * Registers stay in the frame, each supported instruction becomes a fixed sequence of
+ * machine code. Everything else (calls, allocation, exceptions, failed type guards) leaves
+ * the native code, returning the index of the instruction for the interpreter to run.
+ */
+#define DEBUG	0
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "common.h"
+#include "bytecode.h"
+#if BC_JIT_AVAILABLE
+# include <sys/mman.h>
+#endif
+
+#define JIT_ARENA_CHUNK	(256*1024)	// Minimum size of an executable mapping
+
+// === TYPES ===
+/**
+ * \brief Executable memory mapping, code is appended until it is full
+ */
+struct sBC_JitArena
+{
+	struct sBC_JitArena	*Next;
+	uint8_t	*Base;
+	size_t	Size;
+	size_t	Used;
+};
+
+// === PROTOTYPES ===
+ int	Bytecode_JIT_Compile(tSpiderScript *Script, tBC_Function *Fcn);
+void	Bytecode_JIT_Free(tSpiderScript *Script);
+
+#if BC_JIT_AVAILABLE
+typedef struct sJitBuf	tJitBuf;
+
+/**
+ * \brief Code being generated for a function
+ */
+struct sJitBuf
+{
+	uint8_t	*Data;
+	size_t	Len;
+	size_t	Space;
+	bool	Failed;	// Allocation failure
+
+	 int	nFixups;
+	 int	FixupSpace;
+	struct {
+		size_t	Pos;	// Location of the rel32
+		 int	Target;	// Instruction index
+		bool	IsExit;	// Leave to the interpreter at Target, instead of jumping to its code
+	} *Fixups;
+};
+
+// x86-64 register numbers
+enum {
+	RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8, R9, R10, R11,
+};
+#define XMM0	0
+
+// Condition codes (low nibble of Jcc/SETcc)
+enum {
+	CC_B = 0x2, CC_AE, CC_E, CC_NE, CC_BE, CC_A,
+	CC_P = 0xA, CC_NP, CC_L, CC_GE, CC_LE, CC_G,
+};
+
+// Frame register operands (based on RDI)
+#define REG_TYPE(r)	((int32_t)((r)*sizeof(tBC_StackEnt) + offsetof(tBC_StackEnt, TypeId)))
+#define REG_VAL(r)	((int32_t)((r)*sizeof(tBC_StackEnt) + offsetof(tBC_StackEnt, Integer)))
+
+static struct sBC_JitArena	*Bytecode_int_JitArenaAlloc(tSpiderScript *Script, size_t Len);
+static void	*Bytecode_int_JitInstall(tSpiderScript *Script, const void *Code, size_t Len);
+static int	Bytecode_int_JitInsn(tJitBuf *B, const tBC_Function *Fcn, int Index);
+#endif
+
+// === CODE ===
+#if BC_JIT_AVAILABLE
+static void _jit_byte(tJitBuf *B, uint8_t Val)
+{
+	if( B->Len == B->Space ) {
+		size_t	space = (B->Space ? B->Space * 2 : 1024);
+		void *tmp = realloc(B->Data, space);
+		if( !tmp ) {
+			B->Failed = true;
+			B->Len = 0;
+			return ;
+		}
+		B->Data = tmp;
+		B->Space = space;
+	}
+	B->Data[B->Len++] = Val;
+}
+static void _jit_dword(tJitBuf *B, uint32_t Val)
+{
+	for( int i = 0; i < 4; i ++ )
+		_jit_byte(B, Val >> (i*8));
+}
+static void _jit_qword(tJitBuf *B, uint64_t Val)
+{
+	_jit_dword(B, Val);
+	_jit_dword(B, Val >> 32);
+}
+static void _jit_bytes(tJitBuf *B, int Count, const uint8_t *Bytes)
+{
+	for( int i = 0; i < Count; i ++ )
+		_jit_byte(B, Bytes[i]);
+}
+#define _jit_raw(B, v...)	_jit_bytes(B, sizeof((const uint8_t[]){v}), (const uint8_t[]){v})
+
+/**
+ * \brief Emit an instruction with a [Base+Disp] operand
+ * \param Prefix	Mandatory prefix (0 for none)
+ * \param W	REX.W (64-bit operand)
+ * \param Opcode	Opcode bytes (OpLen of them, most significant first)
+ * \note Base may not be RSP/R12 (no SIB byte is emitted)
+ */
+static void _jit_mem(tJitBuf *B, uint8_t Prefix, int W, uint32_t Opcode, int OpLen, int Reg, int Base, int32_t Disp)
+{
+	uint8_t	rex = 0x40 | (W ? 8 : 0) | (Reg & 8 ? 4 : 0) | (Base & 8 ? 1 : 0);
+	if( Prefix )
+		_jit_byte(B, Prefix);
+	if( rex != 0x40 )
+		_jit_byte(B, rex);
+	for( int i = OpLen; i --; )
+		_jit_byte(B, Opcode >> (i*8));
+	if( -128 <= Disp && Disp <= 127 ) {
+		_jit_byte(B, 0x40 | (Reg & 7) << 3 | (Base & 7));
+		_jit_byte(B, Disp);
+	}
+	else {
+		_jit_byte(B, 0x80 | (Reg & 7) << 3 | (Base & 7));
+		_jit_dword(B, Disp);
+	}
+}
+
+/**
+ * \brief Emit an instruction with a [Base+Index*8+Disp] operand (64-bit, single byte opcode)
+ */
+static void _jit_memidx(tJitBuf *B, uint8_t Opcode, int Reg, int Base, int Index, int32_t Disp)
+{
+	_jit_byte(B, 0x48 | (Reg & 8 ? 4 : 0) | (Index & 8 ? 2 : 0) | (Base & 8 ? 1 : 0));
+	_jit_byte(B, Opcode);
+	_jit_byte(B, 0x84 | (Reg & 7) << 3);
+	_jit_byte(B, 0xC0 | (Index & 7) << 3 | (Base & 7));
+	_jit_dword(B, Disp);
+}
+
+// Jump (rel32) to an instruction, or to the interpreter at an instruction
+static void _jit_fixup(tJitBuf *B, int Target, bool IsExit)
+{
+	if( B->nFixups == B->FixupSpace ) {
+		 int	space = (B->FixupSpace ? B->FixupSpace * 2 : 64);
+		void *tmp = realloc(B->Fixups, space * sizeof(B->Fixups[0]));
+		if( !tmp ) {
+			B->Failed = true;
+			return ;
+		}
+		B->Fixups = tmp;
+		B->FixupSpace = space;
+	}
+	B->Fixups[B->nFixups].Pos = B->Len;
+	B->Fixups[B->nFixups].Target = Target;
+	B->Fixups[B->nFixups].IsExit = IsExit;
+	B->nFixups ++;
+	_jit_dword(B, 0);
+}
+static void _jit_jcc(tJitBuf *B, int CC, int Target, bool IsExit)
+{
+	_jit_raw(B, 0x0F, 0x80|CC);
+	_jit_fixup(B, Target, IsExit);
+}
+static void _jit_jmp(tJitBuf *B, int Target)
+{
+	_jit_byte(B, 0xE9);
+	_jit_fixup(B, Target, false);
+}
+// Short forward jump within a template, see _jit_here
+static size_t _jit_jcc8(tJitBuf *B, int CC)
+{
+	_jit_raw(B, 0x70|CC, 0);
+	return B->Len - 1;
+}
+static size_t _jit_jmp8(tJitBuf *B)
+{
+	_jit_raw(B, 0xEB, 0);
+	return B->Len - 1;
+}
+static void _jit_here(tJitBuf *B, size_t Pos)
+{
+	if( !B->Failed )
+		B->Data[Pos] = B->Len - (Pos + 1);
+}
+
+// Register access
+static void _jit_load(tJitBuf *B, int Reg, int Src)	{ _jit_mem(B, 0, 1, 0x8B, 1, Reg, RDI, REG_VAL(Src)); }
+static void _jit_store(tJitBuf *B, int Dst, int Reg)	{ _jit_mem(B, 0, 1, 0x89, 1, Reg, RDI, REG_VAL(Dst)); }
+static void _jit_loadsd(tJitBuf *B, int Src)	{ _jit_mem(B, 0xF2, 0, 0x0F10, 2, XMM0, RDI, REG_VAL(Src)); }
+static void _jit_storesd(tJitBuf *B, int Dst)	{ _jit_mem(B, 0xF2, 0, 0x0F11, 2, XMM0, RDI, REG_VAL(Dst)); }
+static void _jit_storebool(tJitBuf *B, int Dst)	{ _jit_mem(B, 0, 0, 0x88, 1, RAX, RDI, REG_VAL(Dst)); }
+static void _jit_ucomisd(tJitBuf *B, int Src)	{ _jit_mem(B, 0x66, 0, 0x0F2E, 2, XMM0, RDI, REG_VAL(Src)); }
+static void _jit_settype(tJitBuf *B, int Dst, int TypeId)
+{
+	_jit_mem(B, 0, 0, 0xC7, 1, 0, RDI, REG_TYPE(Dst));
+	_jit_dword(B, TypeId);
+}
+// cmp dword [type], TypeId
+static void _jit_cmptype(tJitBuf *B, int Reg, int TypeId)
+{
+	if( TypeId <= 127 ) {
+		_jit_mem(B, 0, 0, 0x83, 1, 7, RDI, REG_TYPE(Reg));
+		_jit_byte(B, TypeId);
+	}
+	else {
+		_jit_mem(B, 0, 0, 0x81, 1, 7, RDI, REG_TYPE(Reg));
+		_jit_dword(B, TypeId);
+	}
+}
+// Leave to the interpreter unless the register has the type
+static void _jit_guardtype(tJitBuf *B, int Reg, int TypeId, int Index)
+{
+	_jit_cmptype(B, Reg, TypeId);
+	_jit_jcc(B, CC_NE, Index, true);
+}
+// Leave to the interpreter if the register holds a reference (which would need releasing)
+static void _jit_guardref(tJitBuf *B, int Reg, int Index)
+{
+	_jit_cmptype(B, Reg, SS_DATATYPE_STRING);
+	_jit_jcc(B, CC_GE, Index, true);
+}
+
+/**
+ * \brief Emit the code for an instruction
+ * \return Non-zero if the instruction is left to the interpreter (nothing emitted)
+ */
+static int Bytecode_int_JitInsn(tJitBuf *B, const tBC_Function *Fcn, int Index)
+{
+	const tBC_Insn	*op = &Fcn->Instructions[Index];
+	const int	dst = op->DstReg;
+	const int	r2 = op->Content.RegInt.RegInt2;
+	const int	r3 = op->Content.RegInt.RegInt3;
+	const bool	chk = !Fcn->IsVerified;	// Operand types not proven (see bytecode_verify.c)
+	size_t	l1, l2;
+
+	#define GUARD_SRC2(type)	do { if(chk) { \
+		_jit_guardtype(B, r2, type, Index); \
+		_jit_guardtype(B, r3, type, Index); \
+	} } while(0)
+	switch(op->Operation)
+	{
+	case BC_OP_NOP:
+		return 0;
+
+	case BC_OP_JUMP:
+		_jit_jmp(B, dst);
+		return 0;
+	case BC_OP_JUMPIF:
+	case BC_OP_JUMPIFNOT:
+	case BC_OP_JUMPIF_BOOL:
+	case BC_OP_JUMPIFNOT_BOOL:
+	case BC_OP_JUMPIF_INT:
+	case BC_OP_JUMPIFNOT_INT: {
+		const int	cc = (op->Operation == BC_OP_JUMPIF || op->Operation == BC_OP_JUMPIF_BOOL
+			|| op->Operation == BC_OP_JUMPIF_INT ? CC_NE : CC_E);
+		// Booleans and integers, anything else is left to the interpreter
+		_jit_cmptype(B, r2, SS_DATATYPE_BOOLEAN);
+		l1 = _jit_jcc8(B, CC_NE);
+		_jit_mem(B, 0, 0, 0x80, 1, 7, RDI, REG_VAL(r2));	// cmp byte [r2], 0
+		_jit_byte(B, 0);
+		_jit_jcc(B, cc, dst, false);
+		l2 = _jit_jmp8(B);
+		_jit_here(B, l1);
+		_jit_guardtype(B, r2, SS_DATATYPE_INTEGER, Index);
+		_jit_mem(B, 0, 1, 0x83, 1, 7, RDI, REG_VAL(r2));	// cmp qword [r2], 0
+		_jit_byte(B, 0);
+		_jit_jcc(B, cc, dst, false);
+		_jit_here(B, l2);
+		return 0; }
+
+	case BC_OP_LOADINT:
+	case BC_OP_LOADREAL:
+		_jit_guardref(B, dst, Index);
+		_jit_settype(B, dst, op->Operation == BC_OP_LOADINT ? SS_DATATYPE_INTEGER : SS_DATATYPE_REAL);
+		_jit_raw(B, 0x48, 0xB8);	// mov rax, imm64
+		_jit_qword(B, op->Content.Integer);
+		_jit_store(B, dst, RAX);
+		return 0;
+	case BC_OP_MOV:
+		if( dst == r2 )
+			return 0;
+		_jit_guardref(B, r2, Index);
+		_jit_guardref(B, dst, Index);
+		_jit_mem(B, 0, 0, 0x8B, 1, RAX, RDI, REG_TYPE(r2));
+		_jit_mem(B, 0, 0, 0x89, 1, RAX, RDI, REG_TYPE(dst));
+		_jit_load(B, RAX, r2);
+		_jit_store(B, dst, RAX);
+		return 0;
+	case BC_OP_CLEARREG:
+		_jit_guardref(B, dst, Index);
+		_jit_settype(B, dst, SS_DATATYPE_NOVALUE);
+		_jit_raw(B, 0x31, 0xC0);	// xor eax, eax
+		_jit_store(B, dst, RAX);
+		return 0;
+
+	case BC_OP_CAST:
+	case BC_OP_CAST_INT_TO_REAL:
+	case BC_OP_CAST_REAL_TO_INT:
+		// RegInt2 is the target type
+		if( r2 == SS_DATATYPE_REAL ) {
+			_jit_guardtype(B, r3, SS_DATATYPE_INTEGER, Index);
+			_jit_guardref(B, dst, Index);
+			_jit_mem(B, 0xF2, 1, 0x0F2A, 2, XMM0, RDI, REG_VAL(r3));	// cvtsi2sd
+			_jit_settype(B, dst, SS_DATATYPE_REAL);
+			_jit_storesd(B, dst);
+			return 0;
+		}
+		if( r2 == SS_DATATYPE_INTEGER ) {
+			_jit_guardtype(B, r3, SS_DATATYPE_REAL, Index);
+			_jit_guardref(B, dst, Index);
+			_jit_mem(B, 0xF2, 1, 0x0F2C, 2, RAX, RDI, REG_VAL(r3));	// cvttsd2si
+			_jit_settype(B, dst, SS_DATATYPE_INTEGER);
+			_jit_store(B, dst, RAX);
+			return 0;
+		}
+		return 1;
+
+	// Integer arithmetic
+	case BC_OP_INT_ADD:
+	case BC_OP_INT_SUBTRACT:
+	case BC_OP_INT_MULTIPLY:
+	case BC_OP_INT_BITAND:
+	case BC_OP_INT_BITOR:
+	case BC_OP_INT_BITXOR:
+		GUARD_SRC2(SS_DATATYPE_INTEGER);
+		_jit_guardref(B, dst, Index);
+		_jit_load(B, RAX, r2);
+		switch(op->Operation)
+		{
+		case BC_OP_INT_ADD:	_jit_mem(B, 0, 1, 0x03, 1, RAX, RDI, REG_VAL(r3));	break;
+		case BC_OP_INT_SUBTRACT:	_jit_mem(B, 0, 1, 0x2B, 1, RAX, RDI, REG_VAL(r3));	break;
+		case BC_OP_INT_MULTIPLY:	_jit_mem(B, 0, 1, 0x0FAF, 2, RAX, RDI, REG_VAL(r3));	break;
+		case BC_OP_INT_BITAND:	_jit_mem(B, 0, 1, 0x23, 1, RAX, RDI, REG_VAL(r3));	break;
+		case BC_OP_INT_BITOR:	_jit_mem(B, 0, 1, 0x0B, 1, RAX, RDI, REG_VAL(r3));	break;
+		default:	_jit_mem(B, 0, 1, 0x33, 1, RAX, RDI, REG_VAL(r3));	break;
+		}
+		_jit_settype(B, dst, SS_DATATYPE_INTEGER);
+		_jit_store(B, dst, RAX);
+		return 0;
+	case BC_OP_INT_DIVIDE:
+	case BC_OP_INT_MODULO:
+		GUARD_SRC2(SS_DATATYPE_INTEGER);
+		_jit_guardref(B, dst, Index);
+		// Zero (exception) and -1 (overflow) divisors are left to the interpreter
+		_jit_load(B, RCX, r3);
+		_jit_raw(B, 0x48, 0x85, 0xC9);	// test rcx, rcx
+		_jit_jcc(B, CC_E, Index, true);
+		_jit_raw(B, 0x48, 0x83, 0xF9, 0xFF);	// cmp rcx, -1
+		_jit_jcc(B, CC_E, Index, true);
+		_jit_load(B, RAX, r2);
+		_jit_raw(B, 0x48, 0x99);	// cqo
+		_jit_raw(B, 0x48, 0xF7, 0xF9);	// idiv rcx
+		_jit_settype(B, dst, SS_DATATYPE_INTEGER);
+		_jit_store(B, dst, op->Operation == BC_OP_INT_DIVIDE ? RAX : RDX);
+		return 0;
+	case BC_OP_INT_BITSHIFTLEFT:
+	case BC_OP_INT_BITSHIFTRIGHT:
+		GUARD_SRC2(SS_DATATYPE_INTEGER);
+		_jit_guardref(B, dst, Index);
+		_jit_load(B, RAX, r2);
+		_jit_load(B, RCX, r3);
+		if( op->Operation == BC_OP_INT_BITSHIFTLEFT )
+			_jit_raw(B, 0x48, 0xD3, 0xE0);	// shl rax, cl
+		else
+			_jit_raw(B, 0x48, 0xD3, 0xF8);	// sar rax, cl
+		_jit_settype(B, dst, SS_DATATYPE_INTEGER);
+		_jit_store(B, dst, RAX);
+		return 0;
+	case BC_OP_INT_NEG:
+	case BC_OP_INT_BITNOT:
+	case BC_OP_INT_ADDI:
+		if( chk )
+			_jit_guardtype(B, r2, SS_DATATYPE_INTEGER, Index);
+		_jit_guardref(B, dst, Index);
+		_jit_load(B, RAX, r2);
+		if( op->Operation == BC_OP_INT_NEG )
+			_jit_raw(B, 0x48, 0xF7, 0xD8);	// neg rax
+		else if( op->Operation == BC_OP_INT_BITNOT )
+			_jit_raw(B, 0x48, 0xF7, 0xD0);	// not rax
+		else {
+			_jit_raw(B, 0x48, 0x05);	// add rax, imm32
+			_jit_dword(B, r3);
+		}
+		_jit_settype(B, dst, SS_DATATYPE_INTEGER);
+		_jit_store(B, dst, RAX);
+		return 0;
+	case BC_OP_INT_EQUALS:
+	case BC_OP_INT_NOTEQUALS:
+	case BC_OP_INT_LESSTHAN:
+	case BC_OP_INT_LESSTHANEQ:
+	case BC_OP_INT_GREATERTHAN:
+	case BC_OP_INT_GREATERTHANEQ: {
+		static const uint8_t	ccs[] = {CC_E, CC_NE, CC_L, CC_LE, CC_G, CC_GE};
+		GUARD_SRC2(SS_DATATYPE_INTEGER);
+		_jit_guardref(B, dst, Index);
+		_jit_load(B, RAX, r2);
+		_jit_mem(B, 0, 1, 0x3B, 1, RAX, RDI, REG_VAL(r3));	// cmp rax, [r3]
+		_jit_raw(B, 0x0F, 0x90|ccs[op->Operation - BC_OP_INT_EQUALS], 0xC0);	// setcc al
+		_jit_settype(B, dst, SS_DATATYPE_BOOLEAN);
+		_jit_storebool(B, dst);
+		return 0; }
+
+	// Real arithmetic
+	case BC_OP_REAL_ADD:
+	case BC_OP_REAL_SUBTRACT:
+	case BC_OP_REAL_MULTIPLY:
+	case BC_OP_REAL_DIVIDE: {
+		static const uint8_t	ops[] = {0x58, 0x5C, 0x59, 0x5E};	// addsd, subsd, mulsd, divsd
+		GUARD_SRC2(SS_DATATYPE_REAL);
+		_jit_guardref(B, dst, Index);
+		_jit_loadsd(B, r2);
+		_jit_mem(B, 0xF2, 0, 0x0F00|ops[op->Operation - BC_OP_REAL_ADD], 2, XMM0, RDI, REG_VAL(r3));
+		_jit_settype(B, dst, SS_DATATYPE_REAL);
+		_jit_storesd(B, dst);
+		return 0; }
+	case BC_OP_REAL_NEG:
+		if( chk )
+			_jit_guardtype(B, r2, SS_DATATYPE_REAL, Index);
+		_jit_guardref(B, dst, Index);
+		_jit_load(B, RAX, r2);
+		_jit_raw(B, 0x48, 0x0F, 0xBA, 0xF8, 63);	// btc rax, 63
+		_jit_settype(B, dst, SS_DATATYPE_REAL);
+		_jit_store(B, dst, RAX);
+		return 0;
+	// - Comparisons are done as ucomisd (the unordered result gives false, except for !=)
+	case BC_OP_REAL_EQUALS:
+	case BC_OP_REAL_NOTEQUALS:
+	case BC_OP_REAL_LESSTHAN:
+	case BC_OP_REAL_LESSTHANEQ:
+	case BC_OP_REAL_GREATERTHAN:
+	case BC_OP_REAL_GREATERTHANEQ:
+		GUARD_SRC2(SS_DATATYPE_REAL);
+		_jit_guardref(B, dst, Index);
+		switch(op->Operation)
+		{
+		case BC_OP_REAL_EQUALS:
+			_jit_loadsd(B, r2);	_jit_ucomisd(B, r3);
+			_jit_raw(B, 0x0F, 0x94, 0xC0, 0x0F, 0x9B, 0xC1, 0x20, 0xC8);	// sete al; setnp cl; and al, cl
+			break;
+		case BC_OP_REAL_NOTEQUALS:
+			_jit_loadsd(B, r2);	_jit_ucomisd(B, r3);
+			_jit_raw(B, 0x0F, 0x95, 0xC0, 0x0F, 0x9A, 0xC1, 0x08, 0xC8);	// setne al; setp cl; or al, cl
+			break;
+		case BC_OP_REAL_LESSTHAN:
+			_jit_loadsd(B, r3);	_jit_ucomisd(B, r2);
+			_jit_raw(B, 0x0F, 0x97, 0xC0);	// seta al
+			break;
+		case BC_OP_REAL_LESSTHANEQ:
+			_jit_loadsd(B, r3);	_jit_ucomisd(B, r2);
+			_jit_raw(B, 0x0F, 0x93, 0xC0);	// setae al
+			break;
+		case BC_OP_REAL_GREATERTHAN:
+			_jit_loadsd(B, r2);	_jit_ucomisd(B, r3);
+			_jit_raw(B, 0x0F, 0x97, 0xC0);
+			break;
+		default:
+			_jit_loadsd(B, r2);	_jit_ucomisd(B, r3);
+			_jit_raw(B, 0x0F, 0x93, 0xC0);
+			break;
+		}
+		_jit_settype(B, dst, SS_DATATYPE_BOOLEAN);
+		_jit_storebool(B, dst);
+		return 0;
+
+	// Fused instructions (see bytecode_fuse.c)
+	case BC_OP_JUMPIF_INT_EQ ... BC_OP_JUMPIF_INT_GE:
+	case BC_OP_INT_INC_JUMPIF_EQ ... BC_OP_INT_INC_JUMPIF_GE: {
+		static const uint8_t	ccs[] = {CC_E, CC_NE, CC_L, CC_LE, CC_G, CC_GE};
+		const bool	is_inc = (op->Operation >= BC_OP_INT_INC_JUMPIF_EQ);
+		GUARD_SRC2(SS_DATATYPE_INTEGER);
+		_jit_load(B, RAX, r2);
+		if( is_inc ) {
+			_jit_raw(B, 0x48, 0x05);	// add rax, imm32
+			_jit_dword(B, op->Aux);
+			_jit_store(B, r2, RAX);
+		}
+		_jit_mem(B, 0, 1, 0x3B, 1, RAX, RDI, REG_VAL(r3));
+		_jit_jcc(B, ccs[op->Operation - (is_inc ? BC_OP_INT_INC_JUMPIF_EQ : BC_OP_JUMPIF_INT_EQ)], dst, false);
+		return 0; }
+	case BC_OP_JUMPIF_REAL_EQ ... BC_OP_JUMPIFNOT_REAL_GE: {
+		const bool	is_not = (op->Operation >= BC_OP_JUMPIFNOT_REAL_EQ);
+		const int	cmp = op->Operation - (is_not ? BC_OP_JUMPIFNOT_REAL_EQ : BC_OP_JUMPIF_REAL_EQ);
+		GUARD_SRC2(SS_DATATYPE_REAL);
+		// LT/LE are done as GT/GE with the operands swapped
+		if( cmp == 2 || cmp == 3 ) {
+			_jit_loadsd(B, r3);	_jit_ucomisd(B, r2);
+		}
+		else {
+			_jit_loadsd(B, r2);	_jit_ucomisd(B, r3);
+		}
+		switch(cmp)
+		{
+		case 0:	// ==
+		case 1:	// !=
+			if( (cmp == 0) != is_not ) {
+				// Ordered and equal
+				l1 = _jit_jcc8(B, CC_P);
+				_jit_jcc(B, CC_E, dst, false);
+				_jit_here(B, l1);
+			}
+			else {
+				// Unordered or not equal
+				_jit_jcc(B, CC_P, dst, false);
+				_jit_jcc(B, CC_NE, dst, false);
+			}
+			break;
+		case 2:	// <
+		case 4:	// >
+			_jit_jcc(B, is_not ? CC_BE : CC_A, dst, false);
+			break;
+		default:	// <=, >=
+			_jit_jcc(B, is_not ? CC_B : CC_AE, dst, false);
+			break;
+		}
+		return 0; }
+
+	// Quickened array indexing (see exec_bytecode.c), Aux is the array's register type
+	case BC_OP_GETINDEX_INTARRAY:
+	case BC_OP_GETINDEX_REALARRAY:
+	case BC_OP_SETINDEX_INTARRAY:
+	case BC_OP_SETINDEX_REALARRAY:
+	case BC_OP_GETINDEX_INTARRAY_INRANGE:
+	case BC_OP_GETINDEX_REALARRAY_INRANGE:
+	case BC_OP_SETINDEX_INTARRAY_INRANGE:
+	case BC_OP_SETINDEX_REALARRAY_INRANGE: {
+		const bool	is_set = (op->Operation == BC_OP_SETINDEX_INTARRAY || op->Operation == BC_OP_SETINDEX_REALARRAY
+			|| op->Operation == BC_OP_SETINDEX_INTARRAY_INRANGE || op->Operation == BC_OP_SETINDEX_REALARRAY_INRANGE);
+		const bool	in_range = (op->Operation >= BC_OP_GETINDEX_INTARRAY_INRANGE);	// (The last quickened ops)
+		const int	type = (op->Operation == BC_OP_GETINDEX_INTARRAY || op->Operation == BC_OP_SETINDEX_INTARRAY
+			|| op->Operation == BC_OP_GETINDEX_INTARRAY_INRANGE || op->Operation == BC_OP_SETINDEX_INTARRAY_INRANGE
+			? SS_DATATYPE_INTEGER : SS_DATATYPE_REAL);
+		_jit_guardtype(B, r2, op->Aux, Index);
+		_jit_guardtype(B, r3, SS_DATATYPE_INTEGER, Index);
+		if( is_set )
+			_jit_guardtype(B, dst, type, Index);
+		else
+			_jit_guardref(B, dst, Index);
+		// NULL and out of bounds are left to the interpreter (to raise the exception)
+		_jit_mem(B, 0, 1, 0x8B, 1, R8, RDI, REG_VAL(r2));	// mov r8, [r2]
+		_jit_raw(B, 0x4D, 0x85, 0xC0);	// test r8, r8
+		_jit_jcc(B, CC_E, Index, true);
+		_jit_load(B, RAX, r3);
+		if( !in_range ) {
+			_jit_mem(B, 0, 1, 0x3B, 1, RAX, R8, offsetof(tSpiderArray, Length));
+			_jit_jcc(B, CC_AE, Index, true);
+		}
+		if( is_set ) {
+			_jit_load(B, R9, dst);
+			_jit_memidx(B, 0x89, R9, R8, RAX, offsetof(tSpiderArray, Integers));
+		}
+		else {
+			_jit_memidx(B, 0x8B, RAX, R8, RAX, offsetof(tSpiderArray, Integers));
+			_jit_settype(B, dst, type);
+			_jit_store(B, dst, RAX);
+		}
+		return 0; }
+	// Quickened foreach (the collection and index are the pair at r2), a NULL array is left to
+	// the interpreter
+	case BC_OP_FOREACH_NEXT_INTARRAY:
+	case BC_OP_FOREACH_NEXT_REALARRAY:
+		_jit_guardtype(B, r2, op->Aux, Index);
+		_jit_guardtype(B, r2+1, SS_DATATYPE_INTEGER, Index);
+		_jit_guardref(B, r3, Index);
+		_jit_mem(B, 0, 1, 0x8B, 1, R8, RDI, REG_VAL(r2));	// mov r8, [r2]
+		_jit_raw(B, 0x4D, 0x85, 0xC0);	// test r8, r8
+		_jit_jcc(B, CC_E, Index, true);
+		_jit_load(B, RAX, r2+1);
+		_jit_raw(B, 0x48, 0x83, 0xC0, 0x01);	// add rax, 1
+		_jit_store(B, r2+1, RAX);
+		// - Unsigned, a negative index ends the loop
+		_jit_mem(B, 0, 1, 0x3B, 1, RAX, R8, offsetof(tSpiderArray, Length));
+		_jit_jcc(B, CC_AE, dst, false);
+		_jit_memidx(B, 0x8B, RAX, R8, RAX, offsetof(tSpiderArray, Integers));
+		_jit_settype(B, r3, op->Operation == BC_OP_FOREACH_NEXT_INTARRAY ? SS_DATATYPE_INTEGER : SS_DATATYPE_REAL);
+		_jit_store(B, r3, RAX);
+		return 0;
+
+	default:
+		return 1;
+	}
+	#undef GUARD_SRC2
+}
+
+/**
+ * \brief Get an arena with space for code
+ */
+static struct sBC_JitArena *Bytecode_int_JitArenaAlloc(tSpiderScript *Script, size_t Len)
+{
+	struct sBC_JitArena	*arena = Script->JitArena;
+	if( arena && arena->Used + Len <= arena->Size )
+		return arena;
+
+	size_t	size = (Len > JIT_ARENA_CHUNK ? (Len + 0xFFF) & ~(size_t)0xFFF : JIT_ARENA_CHUNK);
+	void	*base = mmap(NULL, size, PROT_READ|PROT_EXEC, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if( base == MAP_FAILED )
+		return NULL;
+	arena = malloc(sizeof(*arena));
+	if( !arena ) {
+		munmap(base, size);
+		return NULL;
+	}
+	arena->Next = Script->JitArena;
+	arena->Base = base;
+	arena->Size = size;
+	arena->Used = 0;
+	Script->JitArena = arena;
+	return arena;
+}
+
+/**
+ * \brief Copy code into executable memory
+ * \note The arena is only writable while the code is copied
+ */
+static void *Bytecode_int_JitInstall(tSpiderScript *Script, const void *Code, size_t Len)
+{
+	Len = (Len + 15) & ~(size_t)15;
+	struct sBC_JitArena	*arena = Bytecode_int_JitArenaAlloc(Script, Len);
+	if( !arena )
+		return NULL;
+
+	uint8_t	*ret = arena->Base + arena->Used;
+	if( mprotect(arena->Base, arena->Size, PROT_READ|PROT_WRITE) )
+		return NULL;
+	memcpy(ret, Code, Len);
+	if( mprotect(arena->Base, arena->Size, PROT_READ|PROT_EXEC) )
+		return NULL;
+	__builtin___clear_cache((void*)ret, (void*)(ret + Len));
+	arena->Used += Len;
+	return ret;
+}
+#endif
+
+/**
+ * \brief Compile a function's flattened instructions to native code
+ * \return Non-zero if the function could not be compiled (it stays interpreted)
+ * \note Operands are as seen now, quickened instructions keep the guards of their template
+ */
+int Bytecode_JIT_Compile(tSpiderScript *Script, tBC_Function *Fcn)
+{
+	#if BC_JIT_AVAILABLE
+	const int	count = Fcn->InstructionCount;
+	tJitBuf	buf = {0};
+	size_t	offsets[count+1];
+	bool	native[count];
+	size_t	exits[count+1];
+	 int	ret = -1;
+
+	if( Fcn->JitCode )
+		return 0;
+	if( count == 0 )
+		return -1;
+
+	// Entry: rdi = registers, rsi = instruction to start at
+	_jit_raw(&buf, 0xFF, 0xE6);	// jmp rsi
+
+	for( int i = 0; i < count; i ++ )
+	{
+		offsets[i] = buf.Len;
+		native[i] = (Bytecode_int_JitInsn(&buf, Fcn, i) == 0);
+		if( !native[i] ) {
+			_jit_byte(&buf, 0xB8);	// mov eax, i
+			_jit_dword(&buf, i);
+			_jit_byte(&buf, 0xC3);	// ret
+		}
+	}
+	// Falling off the end (should be unreachable, functions end with RETURN)
+	offsets[count] = buf.Len;
+	_jit_byte(&buf, 0xB8);
+	_jit_dword(&buf, count - 1);
+	_jit_byte(&buf, 0xC3);
+
+	// Side exits (emitted once per instruction) and jump targets
+	for( int i = 0; i <= count; i ++ )
+		exits[i] = 0;
+	for( int i = 0; i < buf.nFixups && !buf.Failed; i ++ )
+	{
+		 int	target = buf.Fixups[i].Target;
+		size_t	dest;
+		if( target < 0 || target > count )
+			goto _err;
+		if( buf.Fixups[i].IsExit ) {
+			if( !exits[target] ) {
+				exits[target] = buf.Len;
+				_jit_byte(&buf, 0xB8);
+				_jit_dword(&buf, target);
+				_jit_byte(&buf, 0xC3);
+			}
+			dest = exits[target];
+		}
+		else
+			dest = offsets[target];
+		if( buf.Failed )
+			break;
+		int32_t	rel = dest - (buf.Fixups[i].Pos + 4);
+		memcpy(buf.Data + buf.Fixups[i].Pos, &rel, 4);
+	}
+	if( buf.Failed )
+		goto _err;
+
+	uint8_t	*base = Bytecode_int_JitInstall(Script, buf.Data, buf.Len);
+	if( !base )
+		goto _err;
+	tBC_JitCode	*code = malloc(sizeof(*code) + count * sizeof(code->Entries[0]));
+	if( !code )
+		goto _err;
+	code->Enter = (void*)base;
+	for( int i = 0; i < count; i ++ )
+		code->Entries[i] = (native[i] ? base + offsets[i] : NULL);
+	Fcn->JitCode = code;
+	ret = 0;
+_err:
+	free(buf.Data);
+	free(buf.Fixups);
+	return ret;
+	#else
+	return -1;
+	#endif
+}
+
+/**
+ * \brief Release a script's executable memory
+ * \note Function's JitCode tables are freed with the function (Bytecode_DeleteFunction)
+ */
+void Bytecode_JIT_Free(tSpiderScript *Script)
+{
+	#if BC_JIT_AVAILABLE
+	while( Script->JitArena )
+	{
+		struct sBC_JitArena	*arena = Script->JitArena;
+		Script->JitArena = arena->Next;
+		munmap(arena->Base, arena->Size);
+		free(arena);
+	}
+	#endif
+}
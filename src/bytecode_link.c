@@ -0,0 +1,110 @@
+/*
+ * SpiderScript Library
+ * by John Hodge (thePowersGang)
+ *
+ * bytecode_link.c
+ * - Resolution of symbol references in flattened bytecode
+ */
+#define DEBUG	0
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "common.h"
+#include "bytecode.h"
+#include "bytecode_gen.h"
+
+// === PROTOTYPES ===
+ int	SpiderScript_Link(tSpiderScript *Script);
+ int	Bytecode_int_LinkFunction(tSpiderScript *Script, tScript_Function *Fcn, tBC_Function *BCFcn);
+
+// === CODE ===
+/**
+ * \brief Resolve global imports and local calls in a function to direct pointers
+ * \param BCFcn	Code to link (normally Fcn->BCFcn)
+ * \return Number of unresolved references
+ */
+int Bytecode_int_LinkFunction(tSpiderScript *Script, tScript_Function *Fcn, tBC_Function *BCFcn)
+{
+	tBC_Function	*bcfcn = BCFcn;
+	 int	errors = 0;
+
+	if( !bcfcn || !bcfcn->Instructions )
+		return 0;
+
+	for( int i = 0; i < bcfcn->InstructionCount; i ++ )
+	{
+		tBC_Insn	*insn = &bcfcn->Instructions[i];
+		switch(insn->Operation)
+		{
+		case BC_OP_IMPORTGLOBAL: {
+			const char	*name = insn->Content.Op->Content.String.Data;
+			tScript_Var	*var;
+			if( insn->DstReg < 0 || insn->DstReg >= bcfcn->MaxGlobalCount ) {
+				SpiderScript_RuntimeError(Script, "%s: Global slot %i out of 0..%i",
+					Fcn->Name, insn->DstReg, bcfcn->MaxGlobalCount);
+				errors ++;
+				break;
+			}
+			for( var = Script->FirstGlobal; var; var = var->Next )
+			{
+				if( strcmp(var->Name, name) == 0 )
+					break;
+			}
+			if( !var ) {
+				SpiderScript_RuntimeError(Script, "%s: Reference to undefined global variable '%s'",
+					Fcn->Name, name);
+				errors ++;
+				break;
+			}
+			insn->Operation = BC_OP_IMPORTGLOBAL_LINKED;
+			insn->Content.Var = var;
+			break; }
+
+		case BC_OP_CALLFUNCTION:
+		case BC_OP_TAILCALLFUNCTION: {
+			tBC_Op	*op = insn->Content.Op;
+			 int	id = op->Content.Function.ID;
+			 int	idx = id & 0xFFFF;
+			 int	count;
+			switch( id >> 16 )
+			{
+			case 0:	count = Script->nFunctions;	break;	// Script
+			case 1:	count = giNumExportedFunctions;	break;	// Exports
+			case 2:	count = Script->Variant->nFunctions;	break;	// Variant
+			default:	count = 0;	break;
+			}
+			if( idx >= count ) {
+				SpiderScript_RuntimeError(Script, "%s: Call to undefined function 0x%x",
+					Fcn->Name, id);
+				errors ++;
+				break;
+			}
+			if( (id >> 16) != 0 )
+				break;
+			// Local calls go straight to the callee
+			op->CacheEnt = Script->FunctionTable[idx];
+			insn->Operation = (insn->Operation == BC_OP_CALLFUNCTION ? BC_OP_CALLLOCAL : BC_OP_TAILCALLLOCAL);
+			break; }
+		}
+	}
+
+	return errors;
+}
+
+/**
+ * \brief Link a script's bytecode (after parse/load)
+ * \return Non-zero if any reference could not be resolved
+ * \note Requires the function tables (SpiderScript_int_BuildTables)
+ */
+int SpiderScript_Link(tSpiderScript *Script)
+{
+	 int	errors = 0;
+	for( tScript_Function *fcn = Script->Functions; fcn; fcn = fcn->Next )
+		errors += Bytecode_int_LinkFunction(Script, fcn, fcn->BCFcn);
+	for( tScript_Class *sc = Script->FirstClass; sc; sc = sc->Next )
+	{
+		for( tScript_Function *fcn = sc->FirstFunction; fcn; fcn = fcn->Next )
+			errors += Bytecode_int_LinkFunction(Script, fcn, fcn->BCFcn);
+	}
+	return (errors ? -1 : 0);
+}
@@ -14,7 +14,7 @@
 #include <string.h>
 #include <assert.h>
 
-#define MAGIC_STR	"SSBC\r\n\xBC\x58"
+#define MAGIC_STR	"SSBC\r\n\xBC\x5A"	// Last byte changes with incompatible format revisions
 #define MAGIC_STR_LEN	(sizeof(MAGIC_STR)-1)
 
 #define DEBUG	0
@@ -78,7 +78,7 @@ typedef struct
  int	SpiderScript_int_SaveBytecodeStream(tSpiderScript *Script, FILE *fp);
  int	StringList_GetString(tStringList *List, const char *String, int Length);
 char	*Bytecode_SerialiseFunction(const tBC_Function *Function, int *Length, tStringList *Strings);
-tBC_Function	*Bytecode_DeserialiseFunction(const void *Data, size_t Length, t_loadstate *State);
+tBC_Function	*Bytecode_DeserialiseFunction(const void *Data, size_t Length, int ArgumentCount, t_loadstate *State);
 
 // === GLOBALS ===
 
@@ -172,6 +172,7 @@ tScript_Function *_get_fcn(t_loadstate *State)
 	ret->ReturnType = _get_type(State, ret_type);
 	ret->IsVariable = (flags & 1);
 	ret->ASTFcn = NULL;
+	ret->Native = NULL;
 	char *nameptr = ret->Name + _get_str(State, NULL, namestr) + 1;
 	for( int i = 0; i < n_args; i ++ )
 	{
@@ -193,7 +194,7 @@ tScript_Function *_get_fcn(t_loadstate *State)
 	fseek(State->FP, old_pos, SEEK_SET);
 
 	// Parse back into bytecode
-	ret->BCFcn = Bytecode_DeserialiseFunction(code, code_len, State);
+	ret->BCFcn = Bytecode_DeserialiseFunction(code, code_len, n_args, State);
 
 	free(code);
 
@@ -312,6 +313,7 @@ int SpiderScript_int_LoadBytecodeStream(tSpiderScript *Script, FILE *fp)
 		sc->TypeInfo.SClass = sc;
 		sc->Properties = malloc( n_attrib * sizeof(void*) );
 		sc->Functions = malloc( n_method * sizeof(void*) );
+		sc->Constructor = NULL;
 
 		State->Classes[i].Class = sc;
 		State->Classes[i].NMethods = n_method;
@@ -459,6 +461,15 @@ int SpiderScript_int_LoadBytecodeStream(tSpiderScript *Script, FILE *fp)
 	free(State->Types);
 	free(State->Classes);
 
+	if( SpiderScript_int_BuildTables(Script) )
+		return 1;
+
+	// Verify once every function is loaded (calls are resolved to their return types)
+	Bytecode_VerifyScript(Script);
+
+	if( SpiderScript_Link(Script) )
+		return 1;
+
 	return 0;
 _err:
 	free(State->Types);
@@ -528,7 +539,7 @@ int SpiderScript_int_SaveBytecodeStream(tSpiderScript *Script, FILE *fp)
 	int _putfcn_hdr(tScript_Function *fcn)
 	{
 		TRACE("Function %s at 0x%lx", fcn->Name, ftell(fp));
-		#define BYTES_PER_FCNHDR(argc)	(2+4+4+2+2+(argc)*4)
+		#define BYTES_PER_FCNHDR(argc)	(2+4+4+2+1+2+(argc)*4)
 		_put16( StringList_GetString(&strings, fcn->Name, strlen(fcn->Name)) );
 		_put32( 0 );	// Code offset (filled later)
 		_put32( 0 );	// Code length
@@ -828,7 +839,8 @@ int Bytecode_int_Serialize(const tBC_Function *Function, void *Output, int *Labe
 
 	void _put_string(const char *str, int len)
 	{
-		 int	strIdx = 0;
+		// - Indexes are only known on the second pass, so the first reserves the largest encoding
+		uint32_t	strIdx = UINT32_MAX;
 		if( Output ) {
 			strIdx = StringList_GetString(Strings, str, len);
 		}
@@ -849,9 +861,40 @@ int Bytecode_int_Serialize(const tBC_Function *Function, void *Output, int *Labe
 			len += 4;
 	}
 
+	// Debug information (operation indexes, positions are delta encoded)
+	_put_index(Function->LineCount);
+	for( int i = 0; i < Function->LineCount; i ++ )
+	{
+		const tBC_LineEnt	*ent = &Function->Lines[i];
+		_put_index(ent->PC - (i > 0 ? ent[-1].PC : 0));
+		_put_index(ent->Line);
+		_put_string(ent->File, strlen(ent->File));
+	}
+	_put_index(Function->VarCount);
+	for( int i = 0; i < Function->VarCount; i ++ )
+	{
+		const tBC_VarEnt	*ent = &Function->Vars[i];
+		_put_index(ent->PC);
+		_put_index(ent->Reg);
+		_put_string(ent->Name, strlen(ent->Name));
+	}
+
+	// Exception handlers (label indexes)
+	_put_index(Function->HandlerCount);
+	for( int i = 0; i < Function->HandlerCount; i ++ )
+	{
+		const tBC_HandlerEnt	*ent = &Function->Handlers[i];
+		_put_index(ent->Start);
+		_put_index(ent->End);
+		_put_index(ent->Handler);
+		_put_index(ent->CatchType);
+		_put_index(ent->CatchReg);
+	}
+
 	for( tBC_Op *op = Function->Operations; op; op = op->Next, idx ++ )
 	{
 		// If first run, convert labels into instruction offsets
+		// - Stored as (index of preceding op)+1, 0 is the start of the function
 		if( !Output )
 		{
 			for( int i = 0; i < Function->LabelCount; i ++ )
@@ -859,12 +902,18 @@ int Bytecode_int_Serialize(const tBC_Function *Function, void *Output, int *Labe
 				if(LabelOffsets[i])	continue;
 				if(op != Function->Labels[i])	continue;
 				
-				LabelOffsets[i] = idx;
+				LabelOffsets[i] = idx + 1;
 			}
 		}
 
 		assert(op->Operation < 256);
-		_put_byte(op->Operation);
+		// Proofs aren't trusted from a file (see bytecode_ops.h)
+		if( op->Operation == BC_OP_GETINDEX_INRANGE )
+			_put_byte(BC_OP_GETINDEX);
+		else if( op->Operation == BC_OP_SETINDEX_INRANGE )
+			_put_byte(BC_OP_SETINDEX);
+		else
+			_put_byte(op->Operation);
 		switch(op->Operation)
 		{
 		// Special case for inline values
@@ -880,16 +929,14 @@ int Bytecode_int_Serialize(const tBC_Function *Function, void *Output, int *Labe
 		case BC_OP_CALLFUNCTION:
 		case BC_OP_CREATEOBJ:
 		case BC_OP_CALLMETHOD:
+		case BC_OP_TAILCALLFUNCTION:
+		case BC_OP_TAILCALLMETHOD:
 			_put_index(op->DstReg);
 			_put_index(op->Content.Function.ID);
 			_put_index(op->Content.Function.ArgCount);
-			for( int i = 0; i < (op->Content.Function.ArgCount&0xFF); i ++ )
+			for( int i = 0; i < (op->Content.Function.ArgCount&BC_CALL_ARGCOUNT_MASK); i ++ )
 				_put_index(op->Content.Function.ArgRegs[i]);
 			break;
-		case BC_OP_NOTEPOSITION:
-			_put_index(op->DstReg);
-			_put_string(op->Content.RefStr->Data, strlen(op->Content.RefStr->Data));
-			break;
 		// Everthing else just gets handled nicely
 		default:
 			switch( caOpEncodingTypes[op->Operation] )
@@ -999,16 +1046,19 @@ double buf_get_double(t_bi *Bi)
 }
 
 
-tBC_Function *Bytecode_DeserialiseFunction(const void *Data, size_t Length, t_loadstate *State)
+tBC_Function *Bytecode_DeserialiseFunction(const void *Data, size_t Length, int ArgumentCount, t_loadstate *State)
 {
-	tBC_Op	*op;
+	tBC_Op	*op = NULL;
 	t_bi	bi, *Bi = &bi;
 	bi.Data = Data;
 	bi.Ofs = 0;
 	bi.Length = Length;
 
-	tBC_Function	*ret = malloc( sizeof(tBC_Function) );
+	tBC_Function	*ret = calloc( 1, sizeof(tBC_Function) );
+	ret->Script = State->Script;
+	ret->ArgumentCount = ArgumentCount;
 	ret->LabelCount = buf_get_index(Bi);
+	ret->LabelSpace = ret->LabelCount;
 	ret->MaxRegisters = buf_get_index(Bi);
 	ret->MaxGlobalCount = buf_get_index(Bi);
 	ret->Labels = malloc( sizeof(ret->Labels[0]) * ret->LabelCount );
@@ -1021,14 +1071,77 @@ tBC_Function *Bytecode_DeserialiseFunction(const void *Data, size_t Length, t_lo
 		ret->Labels[i] = (void*) (intptr_t) buf_get_index(Bi);
 	}
 
+	// Debug information
+	 int	n_lines = buf_get_index(Bi);
+	 int	pc = 0, file_str = -1;
+	char	*file = NULL;
+	for( int i = 0; i < n_lines; i ++ )
+	{
+		pc += buf_get_index(Bi);
+		 int	line = buf_get_index(Bi);
+		 int	sidx = buf_get_index(Bi);
+		// Consecutive positions in the same file share the name
+		if( sidx != file_str )
+		{
+			size_t	slen = _get_str(State, NULL, sidx);
+			_ASSERT_G(slen, !=, -1, _err);
+			if( file )
+				Bytecode_int_DerefFile(file);
+			 int	*refcount = malloc( sizeof(int) + slen + 1 );
+			*refcount = 1;
+			file = (char*)(refcount + 1);
+			_get_str(State, file, sidx);
+			file_str = sidx;
+		}
+		Bytecode_int_AddLine(ret, pc, file, line);
+	}
+	if( file )
+		Bytecode_int_DerefFile(file);
+	 int	n_vars = buf_get_index(Bi);
+	for( int i = 0; i < n_vars; i ++ )
+	{
+		 int	var_pc = buf_get_index(Bi);
+		 int	reg = buf_get_index(Bi);
+		 int	sidx = buf_get_index(Bi);
+		_ASSERT_G(reg, <, ret->MaxRegisters, _err);
+		size_t	slen = _get_str(State, NULL, sidx);
+		_ASSERT_G(slen, !=, -1, _err);
+		char	name[slen+1];
+		_get_str(State, name, sidx);
+		Bytecode_int_AddVar(ret, var_pc, reg, name);
+	}
+	 int	n_handlers = buf_get_index(Bi);
+	for( int i = 0; i < n_handlers; i ++ )
+	{
+		tBC_HandlerEnt	ent;
+		ent.Start = buf_get_index(Bi);
+		ent.End = buf_get_index(Bi);
+		ent.Handler = buf_get_index(Bi);
+		ent.CatchType = buf_get_index(Bi);
+		ent.CatchReg = buf_get_index(Bi);
+		_ASSERT_G((unsigned)ent.Start, <, (unsigned)ret->LabelCount, _err);
+		_ASSERT_G((unsigned)ent.End, <, (unsigned)ret->LabelCount, _err);
+		_ASSERT_G((unsigned)ent.Handler, <, (unsigned)ret->LabelCount, _err);
+		_ASSERT_G((unsigned)ent.CatchReg, <, (unsigned)ret->MaxRegisters, _err);
+		if( ent.CatchType != SS_DATATYPE_INTEGER && ent.CatchType != SS_DATATYPE_STRING ) {
+			fprintf(stderr, "Handler %i catches invalid type %i\n", i, ent.CatchType);
+			goto _err;
+		}
+		Bytecode_int_AddHandler(ret, &ent);
+	}
+
 	while( bi.Ofs < Length )
 	{
 		unsigned int	ot = buf_get8(Bi);
-		if( ot > BC_OP_EXCEPTION_POP ) {
+		if( ot > BC_OP_FOREACH_NEXT ) {
 			// Oops?
 			continue ;
 		}
 		op = NULL;
+		// Jumps store a label index in DstReg, and IMPORTGLOBAL a global slot
+		const int	dst_limit = (ot == BC_OP_JUMP || ot == BC_OP_JUMPIF || ot == BC_OP_JUMPIFNOT
+			|| ot == BC_OP_FOREACH_NEXT) ? ret->LabelCount
+			: (ot == BC_OP_IMPORTGLOBAL ? ret->MaxGlobalCount : ret->MaxRegisters);
 		switch( ot )
 		{
 		// Special case for inline values
@@ -1044,15 +1157,12 @@ tBC_Function *Bytecode_DeserialiseFunction(const void *Data, size_t Length, t_lo
 			_ASSERT_G(op->DstReg,<,ret->MaxRegisters,_err);
 			op->Content.Real = buf_get_double(Bi);
 			break;
-		case BC_OP_NOTEPOSITION:
-			op = malloc(sizeof(tBC_Op));
-			op->DstReg = buf_get_index(Bi);
-			op->Content.RefStr = NULL;
-			break;
 		// Function calls are specail
 		case BC_OP_CALLFUNCTION:
 		case BC_OP_CREATEOBJ:
-		case BC_OP_CALLMETHOD: {
+		case BC_OP_CALLMETHOD:
+		case BC_OP_TAILCALLFUNCTION:
+		case BC_OP_TAILCALLMETHOD: {
 			 int	dstreg = buf_get_index(Bi);
 			 int	fcnid = buf_get_index(Bi);
 			 int	argc = buf_get_index(Bi);
@@ -1061,8 +1171,13 @@ tBC_Function *Bytecode_DeserialiseFunction(const void *Data, size_t Length, t_lo
 			_ASSERT_G(op->DstReg,<,ret->MaxRegisters,_err);
 			op->Content.Function.ID = fcnid;
 			op->Content.Function.ArgCount = argc;
-			for( int i = 0; i < (argc&0xFF); i ++ )
+			for( int i = 0; i < (argc&BC_CALL_ARGCOUNT_MASK); i ++ ) {
 				op->Content.Function.ArgRegs[i] = buf_get_index(Bi);
+				_ASSERT_G(op->Content.Function.ArgRegs[i],<,ret->MaxRegisters,_err);
+				// - Argument windows are consecutive registers (see Bytecode_AppendWindowCall)
+				if( argc & BC_CALL_WINDOW )
+					_ASSERT_G(op->Content.Function.ArgRegs[i],==,op->Content.Function.ArgRegs[0]+i,_err);
+			}
 			} break;
 		// Everthing else just gets handled nicely
 		default:
@@ -1077,18 +1192,18 @@ tBC_Function *Bytecode_DeserialiseFunction(const void *Data, size_t Length, t_lo
 			case BC_OPENC_REG1:
 				op = malloc( sizeof(tBC_Op) );
 				op->DstReg = buf_get_index(Bi);
-				_ASSERT_G(op->DstReg,<,ret->MaxRegisters,_err);
+				_ASSERT_G(op->DstReg,<,dst_limit,_err);
 				break;
 			case BC_OPENC_REG2:
 				op = malloc( sizeof(tBC_Op) );
 				op->DstReg = buf_get_index(Bi);
-				_ASSERT_G(op->DstReg,<,ret->MaxRegisters,_err);
+				_ASSERT_G(op->DstReg,<,dst_limit,_err);
 				op->Content.RegInt.RegInt2 = buf_get_index(Bi);
 				break;
 			case BC_OPENC_REG3:
 				op = malloc( sizeof(tBC_Op) );
 				op->DstReg = buf_get_index(Bi);
-				_ASSERT_G(op->DstReg,<,ret->MaxRegisters,_err);
+				_ASSERT_G(op->DstReg,<,dst_limit,_err);
 				op->Content.RegInt.RegInt2 = buf_get_index(Bi);
 				op->Content.RegInt.RegInt3 = buf_get_index(Bi);
 				break;
@@ -1099,7 +1214,7 @@ tBC_Function *Bytecode_DeserialiseFunction(const void *Data, size_t Length, t_lo
 				_ASSERT_R(slen, !=, -1, NULL);
 				op = malloc(sizeof(tBC_Op) + slen + 1);
 				op->DstReg = dreg;
-				_ASSERT_G(op->DstReg,<,ret->MaxRegisters,_err);
+				_ASSERT_G(op->DstReg,<,dst_limit,_err);
 				op->Content.String.Length = slen;
 				_get_str(State, op->Content.String.Data, sidx);
 				} break;
@@ -1107,6 +1222,19 @@ tBC_Function *Bytecode_DeserialiseFunction(const void *Data, size_t Length, t_lo
 			break;
 		}
 		assert(op);
+
+		// foreach state is a register pair, which the value must not overlap
+		if( ot == BC_OP_FOREACH_INIT || ot == BC_OP_FOREACH_NEXT )
+		{
+			 int	state = (ot == BC_OP_FOREACH_INIT ? op->DstReg : op->Content.RegInt.RegInt2);
+			 int	src = (ot == BC_OP_FOREACH_INIT ? op->Content.RegInt.RegInt2 : op->Content.RegInt.RegInt3);
+			_ASSERT_G(state+1, <, ret->MaxRegisters, _err);
+			_ASSERT_G(src, <, ret->MaxRegisters, _err);
+			if( ot == BC_OP_FOREACH_NEXT && (src == state || src == state+1) ) {
+				fprintf(stderr, "FOREACH_NEXT value R%i overlaps state R%i\n", src, state);
+				goto _err;
+			}
+		}
 		
 		// Convert types
 		// - Allows a bytecode file to be merged with another script
@@ -1137,14 +1265,28 @@ tBC_Function *Bytecode_DeserialiseFunction(const void *Data, size_t Length, t_lo
 		else
 			ret->Operations = op;
 		ret->OperationsEnd = op;
+		ret->OperationCount ++;
+	}
+	op = NULL;
+
+	if( ret->LineCount > 0 && ret->Lines[ret->LineCount-1].PC > ret->OperationCount ) {
+		fprintf(stderr, "Function line table is out of range (%i > %i)\n",
+			ret->Lines[ret->LineCount-1].PC, ret->OperationCount);
+		Bytecode_DeleteFunction(ret);
+		return NULL;
 	}
 	
 	// Fix labels
+	// - Offset 0 refers to the start of the function (see Bytecode_int_Serialize)
 	for( int i = 0; i < ret->LabelCount; i ++ )
 	{
 		 int	idx = 0;
 		const int	labelidx = (intptr_t)ret->Labels[i];
-		for( op = ret->Operations; op && idx != labelidx; op = op->Next )
+		if( labelidx == 0 ) {
+			ret->Labels[i] = (void*)&ret->Operations;
+			continue ;
+		}
+		for( op = ret->Operations; op && idx != labelidx-1; op = op->Next )
 			idx ++;
 		if( !op ) {
 			fprintf(stderr, "Function label #%i is out of range (%i out of 0..%i)\n", i,
@@ -1154,6 +1296,11 @@ tBC_Function *Bytecode_DeserialiseFunction(const void *Data, size_t Length, t_lo
 		ret->Labels[i] = op;
 	}
 
+	if( Bytecode_CommitFunction(ret, ret->MaxRegisters, ret->MaxGlobalCount) ) {
+		Bytecode_DeleteFunction(ret);
+		return NULL;
+	}
+
 	return ret;
 _err:
 	free(op);
@@ -7,11 +7,7 @@ enum eBC_Ops
 {
 	BC_OP_NOP,
 
-	BC_OP_ENTERCONTEXT,
-	BC_OP_LEAVECONTEXT,
-	BC_OP_NOTEPOSITION,
-
-	BC_OP_TAGREGISTER,	// aka name a variable
+	// Source positions and variable names are in side tables (see tBC_Function)
 	BC_OP_IMPORTGLOBAL,
 	BC_OP_GETGLOBAL,
 	BC_OP_SETGLOBAL,
@@ -92,9 +88,77 @@ enum eBC_Ops
 	BC_OP_STR_GREATERTHANEQ,
 	BC_OP_STR_ADD,	
 
-	BC_OP_EXCEPTION_PUSH,
-	BC_OP_EXCEPTION_CHECK,
-	BC_OP_EXCEPTION_POP,
+	BC_OP_TAILCALLFUNCTION,	// CALLFUNCTION, script callee replaces the current frame
+	BC_OP_TAILCALLMETHOD,
+
+	BC_OP_MOV_MOVE,	// MOV, R2 is left cleared (last use of a reference, see _ReleaseRegister)
+
+	// foreach, the iterator is a register pair (collection, index)
+	BC_OP_FOREACH_INIT,	// Dst = R2 (array or String), Dst+1 = -1
+	BC_OP_FOREACH_NEXT,	// if( ++R2[1] >= length(R2) ) goto Dst; R3 = R2[ R2[1] ] (a String yields bytes)
+
+	// Proven instructions
+	// - Formed by the optimiser (see Bytecode_int_SSARanges), serialised as the generic op so
+	//   the proof is redone when the code is loaded
+	BC_OP_GETINDEX_INRANGE,	// GETINDEX, R3 is a valid index into R2 (unless R2 is NULL)
+	BC_OP_SETINDEX_INRANGE,	// SETINDEX, as above
+
+	// Fused instructions
+	// - Only formed in the flattened form (see Bytecode_int_FuseInstructions), never serialised
+	BC_OP_JUMPIF_INT_EQ,	// if( R2 == R3 ) goto Dst
+	BC_OP_JUMPIF_INT_NE,
+	BC_OP_JUMPIF_INT_LT,
+	BC_OP_JUMPIF_INT_LE,
+	BC_OP_JUMPIF_INT_GT,
+	BC_OP_JUMPIF_INT_GE,
+	BC_OP_JUMPIF_REAL_EQ,
+	BC_OP_JUMPIF_REAL_NE,
+	BC_OP_JUMPIF_REAL_LT,
+	BC_OP_JUMPIF_REAL_LE,
+	BC_OP_JUMPIF_REAL_GT,
+	BC_OP_JUMPIF_REAL_GE,
+	BC_OP_JUMPIFNOT_REAL_EQ,	// if( !(R2 == R3) ) goto Dst (not inverted, NaN compares false)
+	BC_OP_JUMPIFNOT_REAL_NE,
+	BC_OP_JUMPIFNOT_REAL_LT,
+	BC_OP_JUMPIFNOT_REAL_LE,
+	BC_OP_JUMPIFNOT_REAL_GT,
+	BC_OP_JUMPIFNOT_REAL_GE,
+	BC_OP_INT_ADDI, 	// Dst = R2 + (int32)RegInt3
+	BC_OP_INT_INC_JUMPIF_EQ,	// R2 += Aux; if( R2 == R3 ) goto Dst
+	BC_OP_INT_INC_JUMPIF_NE,
+	BC_OP_INT_INC_JUMPIF_LT,
+	BC_OP_INT_INC_JUMPIF_LE,
+	BC_OP_INT_INC_JUMPIF_GT,
+	BC_OP_INT_INC_JUMPIF_GE,
+
+	// Linked instructions
+	// - Formed by SpiderScript_Link, never serialised
+	BC_OP_IMPORTGLOBAL_LINKED,	// globals[Dst] = Content.Var
+	BC_OP_CALLLOCAL,	// CALLFUNCTION of a script function, Content.Op->CacheEnt is the callee
+	BC_OP_TAILCALLLOCAL,	// TAILCALLFUNCTION, as above
+
+	// Quickened instructions
+	// - Rewritten from the generic op by the interpreter once operand types are seen, and back
+	//   again if the guard fails (see exec_bytecode.c), never serialised
+	BC_OP_JUMPIF_BOOL,	// JUMPIF, R2 is a Boolean
+	BC_OP_JUMPIFNOT_BOOL,
+	BC_OP_JUMPIF_INT,	// JUMPIF, R2 is an Integer (boolean constants are loaded as integers)
+	BC_OP_JUMPIFNOT_INT,
+	BC_OP_CAST_INT_TO_REAL,	// CAST, R3 is an Integer
+	BC_OP_CAST_REAL_TO_INT,
+	BC_OP_FOREACH_NEXT_INTARRAY,	// FOREACH_NEXT, R2 is an Integer[] with register type Aux
+	BC_OP_FOREACH_NEXT_REALARRAY,
+	BC_OP_FOREACH_NEXT_STRING,	// FOREACH_NEXT, R2 is a String
+	BC_OP_GETINDEX_INTARRAY,	// GETINDEX, R2 is an Integer[] with register type Aux
+	BC_OP_GETINDEX_REALARRAY,
+	BC_OP_SETINDEX_INTARRAY,	// SETINDEX, as above
+	BC_OP_SETINDEX_REALARRAY,
+	BC_OP_GETINDEX_INTARRAY_INRANGE,	// GETINDEX_INRANGE, as above without the bounds check
+	BC_OP_GETINDEX_REALARRAY_INRANGE,
+	BC_OP_SETINDEX_INTARRAY_INRANGE,
+	BC_OP_SETINDEX_REALARRAY_INRANGE,
+
+	BC_OP_COUNT	// Not an operation, number of opcodes
 };
 
 extern const enum eOpEncodingType {
@@ -104,6 +168,6 @@ extern const enum eOpEncodingType {
 	BC_OPENC_REG2,
 	BC_OPENC_REG3,
 	BC_OPENC_STRING,
-} caOpEncodingTypes[];
+} caOpEncodingTypes[BC_OP_COUNT];
 
 #endif
@@ -1,19 +1,878 @@
 /*
  * SpiderScript Library
  * by John Hodge (thePowersGang)
- * 
- * bytecode_gen.c
- * - Generate bytecode
+ *
+ * bytecode_optimise.c
+ * - Bytecode optimisation passes
+ *
+ * Run on the operation list once a function is complete (generated or loaded), before it is
+ * committed. Passes are repeated until none of them finds anything more to do. At the full
+ * level, this alternates with the SSA optimisations (bytecode_ssa.c), which leave moves and
+ * loads for these passes to clean up.
  */
 #include <stdlib.h>
-#include "bytecode_ops.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "common.h"
+#include "bytecode.h"
+#include "bytecode_gen.h"
 
-// Patterns:
-// TODO: Figure out what optimisations can be done
+#define BC_OPT_MAXPASSES	16	// Give up on reaching a fixed point after this many rounds
+#define BC_OPT_MAXROUNDS	8	// Rounds of SSA optimisation
+#define BC_OPT_MAXCONSTS	16	// Registers with a known constant tracked at once
 
-int Bytecode_OptimizeFunction(tBC_Function *Function)
+// === STRUCTURES ===
+typedef struct sBC_OptConst
 {
-	for( op = Function->Operations; op; op = op->Next, idx ++ )
+	 int	Reg;
+	 int	TypeId;	// SS_DATATYPE_INTEGER, _REAL or _BOOLEAN
+	union {
+		tSpiderInteger	Integer;
+		tSpiderReal	Real;
+		tSpiderBool	Boolean;
+	};
+} tBC_OptConst;
+
+typedef struct sBC_OptState
+{
+	tBC_Function	*Fcn;
+	 int	Count;
+	tBC_Op	**Ops;	// Operations by position, NULL once removed
+	 int	*LabelPos;	// Position of the operation at each label, -1 if unset
+	bool	*IsTarget;	// Control arrives at the position other than by falling through
+	bool	*IsPure;	// Operation has no effect besides writing DstReg
+
+	 int	NConsts;
+	tBC_OptConst	Consts[BC_OPT_MAXCONSTS];
+} tBC_OptState;
+
+// === PROTOTYPES ===
+ int	Bytecode_OptimiseFunction(tSpiderScript *Script, tBC_Function *Fcn);
+static int	Bytecode_int_OptimiseOps(tBC_Function *Fcn, int Level);
+static bool	Bytecode_int_ThreadJumps(tBC_OptState *State);
+static bool	Bytecode_int_RemoveUnreachable(tBC_OptState *State);
+static bool	Bytecode_int_RemoveRedundantMoves(tBC_OptState *State);
+static bool	Bytecode_int_PropagateConstants(tBC_OptState *State);
+static bool	Bytecode_int_RemoveDeadStores(tBC_OptState *State);
+static void	Bytecode_int_RebuildFunction(tBC_OptState *State);
+
+// === CODE ===
+static bool _IsJump(const tBC_Op *Op)
+{
+	return Op->Operation == BC_OP_JUMP || Op->Operation == BC_OP_JUMPIF
+		|| Op->Operation == BC_OP_JUMPIFNOT || Op->Operation == BC_OP_FOREACH_NEXT;
+}
+
+static enum eBC_RegUse _OpRegUse(const tBC_Op *Op, int Reg)
+{
+	tBC_Insn	insn;
+	Bytecode_int_OpToInsn(Op, &insn);
+	return Bytecode_int_InsnRegUse(&insn, Reg);
+}
+
+/**
+ * \brief Check if an operation can change the value in a register
+ */
+static bool _OpModifiesReg(const tBC_Op *Op, int Reg)
+{
+	switch( _OpRegUse(Op, Reg) )
+	{
+	case BC_REGUSE_NONE:
+		return false;
+	case BC_REGUSE_WRITE:
+		return true;
+	case BC_REGUSE_READ:
+		break;
+	}
+	switch(Op->Operation)
+	{
+	// DstReg is a source
+	case BC_OP_RETURN:
+	case BC_OP_SETGLOBAL:
+	case BC_OP_SETINDEX:
+	case BC_OP_SETINDEX_INRANGE:
+	case BC_OP_SETELEMENT:
+	case BC_OP_JUMPIF:
+	case BC_OP_JUMPIFNOT:
+		return false;
+	// Advances the index and loads the value
+	case BC_OP_FOREACH_NEXT:
+		return Reg == Op->Content.RegInt.RegInt2 + 1 || Reg == Op->Content.RegInt.RegInt3;
+	// Sources are cleared/passed on
+	case BC_OP_MOV_MOVE:
+	case BC_OP_CREATEOBJ:
+	case BC_OP_CALLFUNCTION:
+	case BC_OP_CALLMETHOD:
+	case BC_OP_TAILCALLFUNCTION:
+	case BC_OP_TAILCALLMETHOD:
+		return true;
+	default:
+		if( caOpEncodingTypes[Op->Operation] == BC_OPENC_REG2
+		 || caOpEncodingTypes[Op->Operation] == BC_OPENC_REG3 )
+			return Op->DstReg == Reg;
+		return true;
+	}
+}
+
+/**
+ * \brief Get the first remaining operation at or after a position
+ * \return Position of the operation, State->Count for the end of the function
+ */
+static int _NextLive(const tBC_OptState *State, int Pos)
+{
+	while( Pos < State->Count && !State->Ops[Pos] )
+		Pos ++;
+	return Pos;
+}
+
+static void _RemoveOp(tBC_OptState *State, int Pos)
+{
+	free(State->Ops[Pos]);
+	State->Ops[Pos] = NULL;
+}
+
+/**
+ * \brief Mark the positions that control can arrive at from elsewhere
+ */
+static void _MarkTargets(tBC_OptState *State)
+{
+	tBC_Function	*fcn = State->Fcn;
+	for( int i = 0; i <= State->Count; i ++ )
+		State->IsTarget[i] = false;
+	for( int i = 0; i < State->Count; i ++ )
+	{
+		if( State->Ops[i] && _IsJump(State->Ops[i]) )
+			State->IsTarget[ State->LabelPos[State->Ops[i]->DstReg] ] = true;
+	}
+	// - Handler ranges also change which handler is in effect
+	for( int i = 0; i < fcn->HandlerCount; i ++ )
+	{
+		State->IsTarget[ State->LabelPos[fcn->Handlers[i].Start] ] = true;
+		State->IsTarget[ State->LabelPos[fcn->Handlers[i].End] ] = true;
+		State->IsTarget[ State->LabelPos[fcn->Handlers[i].Handler] ] = true;
+	}
+}
+
+/**
+ * \brief Compute the registers live on entry to each position
+ * \return Bitsets of \a NWords words per position (Count+1 of them, the end has none live),
+ *         NULL on allocation failure. free() when done.
+ * \note An exception can be raised by any operation in a handler range, before its result is
+ *       written, so the handler's live registers are live before the operation too
+ */
+static uint32_t *_ComputeLiveness(const tBC_OptState *State, int NWords)
+{
+	const tBC_Function	*fcn = State->Fcn;
+	const int	count = State->Count;
+	const int	nregs = fcn->MaxRegisters;
+	uint32_t	*live = calloc( (size_t)(count + 1) * NWords, sizeof(uint32_t) );
+	uint32_t	*reads = calloc( (size_t)count * NWords, sizeof(uint32_t) );
+	uint32_t	*writes = calloc( (size_t)count * NWords, sizeof(uint32_t) );
+	if( !live || !reads || !writes ) {
+		free(live);
+		live = NULL;
+		goto _out;
+	}
+
+	// Per-operation register use, classified once
+	for( int i = 0; i < count; i ++ )
+	{
+		if( !State->Ops[i] )
+			continue ;
+		tBC_Insn	insn;
+		Bytecode_int_OpToInsn(State->Ops[i], &insn);
+		for( int r = 0; r < nregs; r ++ )
+		{
+			switch( Bytecode_int_InsnRegUse(&insn, r) )
+			{
+			case BC_REGUSE_READ:	reads[i*NWords + r/32] |= 1u << (r%32);	break;
+			case BC_REGUSE_WRITE:	writes[i*NWords + r/32] |= 1u << (r%32);	break;
+			case BC_REGUSE_NONE:	break;
+			}
+		}
+	}
+
+	// Backwards until nothing changes, one pass per loop nesting level
+	bool	changed = true;
+	while( changed )
+	{
+		changed = false;
+		for( int i = count; i --; )
+		{
+			const tBC_Op	*op = State->Ops[i];
+			uint32_t	*dst = &live[i*NWords];
+			for( int w = 0; w < NWords; w ++ )
+			{
+				uint32_t	out = 0;
+				if( !op )
+					out = live[(i+1)*NWords + w];
+				else if( op->Operation != BC_OP_RETURN ) {
+					if( _IsJump(op) )
+						out |= live[State->LabelPos[op->DstReg]*NWords + w];
+					if( op->Operation != BC_OP_JUMP )
+						out |= live[(i+1)*NWords + w];
+				}
+				uint32_t	val = (op ? reads[i*NWords + w] | (out & ~writes[i*NWords + w]) : out);
+				for( int h = 0; op && h < fcn->HandlerCount; h ++ )
+				{
+					const tBC_HandlerEnt	*ent = &fcn->Handlers[h];
+					if( State->LabelPos[ent->Start] <= i && i < State->LabelPos[ent->End] )
+						val |= live[State->LabelPos[ent->Handler]*NWords + w];
+				}
+				if( val != dst[w] ) {
+					dst[w] = val;
+					changed = true;
+				}
+			}
+		}
+	}
+_out:
+	free(reads);
+	free(writes);
+	return live;
+}
+
+/**
+ * \brief Check that the value in a register is never read after an operation
+ * \param Live	Registers live on entry to each position (see _ComputeLiveness)
+ */
+static bool _IsRegDeadAfter(const tBC_OptState *State, const uint32_t *Live, int NWords, int Index, int Reg)
+{
+	const tBC_Op	*op = State->Ops[Index];
+	const uint32_t	bit = 1u << (Reg % 32);
+	if( Reg < 0 || Reg >= State->Fcn->MaxRegisters )
+		return false;
+	if( op->Operation == BC_OP_RETURN )
+		return true;
+	if( _IsJump(op) && (Live[State->LabelPos[op->DstReg]*NWords + Reg/32] & bit) )
+		return false;
+	if( op->Operation != BC_OP_JUMP && (Live[(Index+1)*NWords + Reg/32] & bit) )
+		return false;
+	return true;
+}
+
+/**
+ * \brief Optimise a function's operation list
+ * \note The level is the one passed to SpiderScript_ParseFileEx/SpiderScript_LoadBytecodeEx
+ */
+int Bytecode_OptimiseFunction(tSpiderScript *Script, tBC_Function *Fcn)
+{
+	 int	level = Script->OptimiseLevel;
+	if( level == SS_OPTIMISE_DEFAULT )
+		level = SS_OPTIMISE_FULL;
+	if( level == SS_OPTIMISE_NONE )
+		return 0;
+
+	for( int round = 0; ; round ++ )
+	{
+		 int	rv = Bytecode_int_OptimiseOps(Fcn, level);
+		if( rv < 0 )
+			return -1;
+		if( rv > 0 || level < SS_OPTIMISE_FULL || round == BC_OPT_MAXROUNDS )
+			break;
+		rv = Bytecode_int_OptimiseSSA(Fcn);
+		if( rv < 0 )
+			return -1;
+		if( rv == 0 )
+			break;
+	}
+	return 0;
+}
+
+/**
+ * \brief Run the passes on the operation list until nothing changes
+ * \return 0 on success, 1 if the function was left alone, -1 on error
+ */
+static int Bytecode_int_OptimiseOps(tBC_Function *Fcn, int Level)
+{
+	if( !Fcn->Operations )
+		return 1;
+
+	tBC_OptState	state = {.Fcn = Fcn};
+	 int	ret = 1;
+	for( tBC_Op *op = Fcn->Operations; op; op = op->Next )
+		state.Count ++;
+	state.Ops = malloc( state.Count * sizeof(tBC_Op*) );
+	state.LabelPos = malloc( (Fcn->LabelCount + 1) * sizeof(int) );
+	state.IsTarget = malloc( (state.Count + 1) * sizeof(bool) );
+	state.IsPure = malloc( (state.Count + 1) * sizeof(bool) );
+	if( !state.Ops || !state.LabelPos || !state.IsTarget || !state.IsPure ) {
+		free(state.Ops);
+		free(state.LabelPos);
+		free(state.IsTarget);
+		free(state.IsPure);
+		return -1;
+	}
+
+	 int	idx = 0;
+	for( tBC_Op *op = Fcn->Operations; op; op = op->Next )
+		state.Ops[idx++] = op;
+
+	// Labels point to the operation before the target
+	for( int i = 0; i < Fcn->LabelCount; i ++ )
+	{
+		state.LabelPos[i] = -1;
+		if( Fcn->Labels[i] == (void*)&Fcn->Operations )
+			state.LabelPos[i] = 0;
+		for( int j = 0; j < state.Count && state.LabelPos[i] == -1; j ++ )
+		{
+			if( Fcn->Labels[i] == state.Ops[j] )
+				state.LabelPos[i] = j + 1;
+		}
+	}
+	// - Leave functions with broken control flow to Bytecode_CommitFunction to report
+	for( int i = 0; i < state.Count; i ++ )
+	{
+		const tBC_Op	*op = state.Ops[i];
+		if( _IsJump(op) && (op->DstReg < 0 || op->DstReg >= Fcn->LabelCount || state.LabelPos[op->DstReg] == -1) )
+			goto _out;
+	}
+	for( int i = 0; i < Fcn->HandlerCount; i ++ )
+	{
+		const tBC_HandlerEnt	*ent = &Fcn->Handlers[i];
+		if( state.LabelPos[ent->Start] == -1 || state.LabelPos[ent->End] == -1 || state.LabelPos[ent->Handler] == -1 )
+			goto _out;
+	}
+
+	for( int pass = 0; pass < BC_OPT_MAXPASSES; pass ++ )
+	{
+		bool	changed = false;
+		for( int i = 0; i <= state.Count; i ++ )
+			state.IsPure[i] = false;
+		changed |= Bytecode_int_ThreadJumps(&state);
+		changed |= Bytecode_int_RemoveUnreachable(&state);
+		_MarkTargets(&state);
+		changed |= Bytecode_int_RemoveRedundantMoves(&state);
+		if( Level >= SS_OPTIMISE_FULL )
+		{
+			changed |= Bytecode_int_PropagateConstants(&state);
+			_MarkTargets(&state);
+			changed |= Bytecode_int_RemoveDeadStores(&state);
+		}
+		if( !changed )
+			break;
+	}
+
+	Bytecode_int_RebuildFunction(&state);
+	ret = 0;
+_out:
+	free(state.Ops);
+	free(state.LabelPos);
+	free(state.IsTarget);
+	free(state.IsPure);
+	return ret;
+}
+
+/**
+ * \brief Retarget jumps to jumps, and turn jumps to a return into the return
+ */
+static bool Bytecode_int_ThreadJumps(tBC_OptState *State)
+{
+	bool	changed = false;
+	for( int i = 0; i < State->Count; i ++ )
+	{
+		tBC_Op	*op = State->Ops[i];
+		if( !op || !_IsJump(op) )
+			continue ;
+
+		// Follow the chain of unconditional jumps (giving up on loops)
+		 int	label = op->DstReg;
+		 int	dest = _NextLive(State, State->LabelPos[label]);
+		for( int hops = 0; dest < State->Count && State->Ops[dest]->Operation == BC_OP_JUMP; hops ++ )
+		{
+			if( hops == State->Count ) {
+				label = op->DstReg;
+				dest = _NextLive(State, State->LabelPos[label]);
+				break;
+			}
+			label = State->Ops[dest]->DstReg;
+			dest = _NextLive(State, State->LabelPos[label]);
+		}
+		if( label != op->DstReg ) {
+			op->DstReg = label;
+			changed = true;
+		}
+
+		if( op->Operation != BC_OP_JUMP )
+			continue ;
+		if( dest == _NextLive(State, i + 1) ) {
+			_RemoveOp(State, i);
+			changed = true;
+		}
+		else if( dest < State->Count && State->Ops[dest]->Operation == BC_OP_RETURN ) {
+			op->Operation = BC_OP_RETURN;
+			op->DstReg = State->Ops[dest]->DstReg;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+/**
+ * \brief Remove operations that control can never reach
+ */
+static bool Bytecode_int_RemoveUnreachable(tBC_OptState *State)
+{
+	const tBC_Function	*fcn = State->Fcn;
+	const int	count = State->Count;
+	bool	reached[count + 1];
+	 int	stack[count + 1];
+	 int	sp = 0;
+	for( int i = 0; i <= count; i ++ )
+		reached[i] = false;
+
+	void _push(int pos) {
+		if( !reached[pos] ) {
+			reached[pos] = true;
+			stack[sp++] = pos;
+		}
+	}
+
+	_push(0);
+	for( int i = 0; i < fcn->HandlerCount; i ++ )
+		_push( State->LabelPos[fcn->Handlers[i].Handler] );
+	while( sp > 0 )
+	{
+		 int	pos = stack[--sp];
+		if( pos == count )
+			continue ;
+		const tBC_Op	*op = State->Ops[pos];
+		if( !op ) {
+			_push(pos + 1);
+			continue ;
+		}
+		if( op->Operation == BC_OP_RETURN )
+			continue ;
+		if( _IsJump(op) )
+			_push( State->LabelPos[op->DstReg] );
+		if( op->Operation != BC_OP_JUMP )
+			_push(pos + 1);
+	}
+
+	bool	changed = false;
+	for( int i = 0; i < count; i ++ )
+	{
+		if( State->Ops[i] && !reached[i] ) {
+			_RemoveOp(State, i);
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+/**
+ * \brief Remove moves to the same register, and clears of registers that are overwritten or
+ *        released by a return before they are read
+ */
+static bool Bytecode_int_RemoveRedundantMoves(tBC_OptState *State)
+{
+	bool	changed = false;
+	for( int i = 0; i < State->Count; i ++ )
+	{
+		const tBC_Op	*op = State->Ops[i];
+		if( !op )
+			continue ;
+		if( op->Operation == BC_OP_MOV && op->DstReg == op->Content.RegInt.RegInt2 ) {
+			_RemoveOp(State, i);
+			changed = true;
+			continue ;
+		}
+		if( op->Operation != BC_OP_CLEARREG )
+			continue ;
+
+		// Only looks within the block
+		bool	redundant = false;
+		for( int j = i + 1; j <= State->Count && !State->IsTarget[j]; j ++ )
+		{
+			if( j == State->Count ) {
+				redundant = true;
+				break;
+			}
+			const tBC_Op	*next = State->Ops[j];
+			if( !next )
+				continue ;
+			enum eBC_RegUse	use = _OpRegUse(next, op->DstReg);
+			if( use == BC_REGUSE_WRITE || (use == BC_REGUSE_NONE && next->Operation == BC_OP_RETURN) )
+				redundant = true;
+			if( use != BC_REGUSE_NONE || next->Operation == BC_OP_RETURN || _IsJump(next) )
+				break;
+		}
+		if( redundant ) {
+			_RemoveOp(State, i);
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+static const tBC_OptConst *_GetConst(const tBC_OptState *State, int Reg)
+{
+	for( int i = 0; i < State->NConsts; i ++ )
+	{
+		if( State->Consts[i].Reg == Reg )
+			return &State->Consts[i];
+	}
+	return NULL;
+}
+
+static void _SetConst(tBC_OptState *State, const tBC_OptConst *Value)
+{
+	// Forget the oldest when full
+	if( State->NConsts == BC_OPT_MAXCONSTS ) {
+		memmove(&State->Consts[0], &State->Consts[1], (BC_OPT_MAXCONSTS-1)*sizeof(tBC_OptConst));
+		State->NConsts --;
+	}
+	State->Consts[State->NConsts++] = *Value;
+}
+
+/**
+ * \brief Evaluate an operation on constant operands
+ * \return Non-zero if the result is known (and can't be an error)
+ */
+static int _EvalConst(const tBC_Op *Op, const tBC_OptConst *A, const tBC_OptConst *B, tBC_OptConst *Out)
+{
+	#define INT_OP(_op, _expr)	case _op: Out->TypeId = SS_DATATYPE_INTEGER; Out->Integer = (_expr); return 1;
+	#define INT_CMP(_op, _cmp)	case _op: Out->TypeId = SS_DATATYPE_BOOLEAN; Out->Boolean = (a _cmp b); return 1;
+	#define REAL_OP(_op, _expr)	case _op: Out->TypeId = SS_DATATYPE_REAL; Out->Real = (_expr); return 1;
+	#define REAL_CMP(_op, _cmp)	case _op: Out->TypeId = SS_DATATYPE_BOOLEAN; Out->Boolean = (x _cmp y); return 1;
+	if( A && !B && A->TypeId == SS_DATATYPE_INTEGER )
+	{
+		const tSpiderInteger	a = A->Integer;
+		switch(Op->Operation)
+		{
+		INT_OP(BC_OP_INT_NEG, -(uint64_t)a)
+		INT_OP(BC_OP_INT_BITNOT, ~a)
+		default:
+			return 0;
+		}
+	}
+	if( A && !B && A->TypeId == SS_DATATYPE_REAL )
+	{
+		const tSpiderReal	x = A->Real;
+		switch(Op->Operation)
+		{
+		REAL_OP(BC_OP_REAL_NEG, -x)
+		default:
+			return 0;
+		}
+	}
+	if( A && !B && A->TypeId == SS_DATATYPE_BOOLEAN )
+	{
+		switch(Op->Operation)
+		{
+		case BC_OP_BOOL_LOGICNOT:
+			Out->TypeId = SS_DATATYPE_BOOLEAN;
+			Out->Boolean = !A->Boolean;
+			return 1;
+		default:
+			return 0;
+		}
+	}
+	if( !A || !B || A->TypeId != B->TypeId )
+		return 0;
+	if( A->TypeId == SS_DATATYPE_INTEGER )
+	{
+		const tSpiderInteger	a = A->Integer, b = B->Integer;
+		switch(Op->Operation)
+		{
+		INT_OP(BC_OP_INT_ADD, (uint64_t)a + (uint64_t)b)
+		INT_OP(BC_OP_INT_SUBTRACT, (uint64_t)a - (uint64_t)b)
+		INT_OP(BC_OP_INT_MULTIPLY, (uint64_t)a * (uint64_t)b)
+		INT_OP(BC_OP_INT_BITAND, a & b)
+		INT_OP(BC_OP_INT_BITOR, a | b)
+		INT_OP(BC_OP_INT_BITXOR, a ^ b)
+		case BC_OP_INT_DIVIDE:
+		case BC_OP_INT_MODULO:
+			// Left for the runtime error (or trap)
+			if( b == 0 || (a == INT64_MIN && b == -1) )
+				return 0;
+			Out->TypeId = SS_DATATYPE_INTEGER;
+			Out->Integer = (Op->Operation == BC_OP_INT_DIVIDE ? a / b : a % b);
+			return 1;
+		case BC_OP_INT_BITSHIFTLEFT:
+		case BC_OP_INT_BITSHIFTRIGHT:
+			if( b < 0 || b >= 64 )
+				return 0;
+			Out->TypeId = SS_DATATYPE_INTEGER;
+			Out->Integer = (Op->Operation == BC_OP_INT_BITSHIFTLEFT ? (tSpiderInteger)((uint64_t)a << b) : a >> b);
+			return 1;
+		INT_CMP(BC_OP_INT_EQUALS, ==)
+		INT_CMP(BC_OP_INT_NOTEQUALS, !=)
+		INT_CMP(BC_OP_INT_LESSTHAN, <)
+		INT_CMP(BC_OP_INT_LESSTHANEQ, <=)
+		INT_CMP(BC_OP_INT_GREATERTHAN, >)
+		INT_CMP(BC_OP_INT_GREATERTHANEQ, >=)
+		default:
+			return 0;
+		}
+	}
+	if( A->TypeId == SS_DATATYPE_REAL )
+	{
+		const tSpiderReal	x = A->Real, y = B->Real;
+		switch(Op->Operation)
+		{
+		REAL_OP(BC_OP_REAL_ADD, x + y)
+		REAL_OP(BC_OP_REAL_SUBTRACT, x - y)
+		REAL_OP(BC_OP_REAL_MULTIPLY, x * y)
+		REAL_OP(BC_OP_REAL_DIVIDE, x / y)
+		REAL_CMP(BC_OP_REAL_EQUALS, ==)
+		REAL_CMP(BC_OP_REAL_NOTEQUALS, !=)
+		REAL_CMP(BC_OP_REAL_LESSTHAN, <)
+		REAL_CMP(BC_OP_REAL_LESSTHANEQ, <=)
+		REAL_CMP(BC_OP_REAL_GREATERTHAN, >)
+		REAL_CMP(BC_OP_REAL_GREATERTHANEQ, >=)
+		default:
+			return 0;
+		}
+	}
+	return 0;
+	#undef INT_OP
+	#undef INT_CMP
+	#undef REAL_OP
+	#undef REAL_CMP
+}
+
+/**
+ * \brief Propagate constants loaded by LOADINT/LOADREAL within blocks
+ *
+ * Moves of a constant become loads, operations on constants are folded into loads, and
+ * conditional jumps on a constant are resolved. Boolean results have no load, so those
+ * operations are only marked as pure (removable once the result is unused).
+ */
+static bool Bytecode_int_PropagateConstants(tBC_OptState *State)
+{
+	bool	changed = false;
+	State->NConsts = 0;
+	for( int i = 0; i < State->Count; i ++ )
+	{
+		tBC_Op	*op = State->Ops[i];
+		if( State->IsTarget[i] )
+			State->NConsts = 0;
+		if( !op )
+			continue ;
+
+		// Operands are read before the destination is written
+		const tBC_OptConst	*a = NULL, *b = NULL;
+		tBC_OptConst	result = {.Reg = op->DstReg};
+		bool	known = false;
+		switch(op->Operation)
+		{
+		case BC_OP_LOADINT:
+			result.TypeId = SS_DATATYPE_INTEGER;
+			result.Integer = op->Content.Integer;
+			known = true;
+			break;
+		case BC_OP_LOADREAL:
+			result.TypeId = SS_DATATYPE_REAL;
+			result.Real = op->Content.Real;
+			known = true;
+			break;
+		case BC_OP_MOV:
+		case BC_OP_MOV_MOVE:
+			a = _GetConst(State, op->Content.RegInt.RegInt2);
+			if( !a )
+				break;
+			result = *a;
+			result.Reg = op->DstReg;
+			known = true;
+			// - Integer and Real sources hold no reference, so the clear of a move isn't needed
+			if( a->TypeId == SS_DATATYPE_INTEGER ) {
+				op->Operation = BC_OP_LOADINT;
+				op->Content.Integer = a->Integer;
+				changed = true;
+			}
+			else if( a->TypeId == SS_DATATYPE_REAL ) {
+				op->Operation = BC_OP_LOADREAL;
+				op->Content.Real = a->Real;
+				changed = true;
+			}
+			break;
+		case BC_OP_JUMPIF:
+		case BC_OP_JUMPIFNOT: {
+			a = _GetConst(State, op->Content.RegInt.RegInt2);
+			if( !a )
+				break;
+			// Same truth values as Bytecode_int_IsStackEntTrue
+			bool	cond;
+			switch(a->TypeId)
+			{
+			case SS_DATATYPE_BOOLEAN:	cond = !!a->Boolean;	break;
+			case SS_DATATYPE_INTEGER:	cond = !!a->Integer;	break;
+			default:	cond = !(-.5f < a->Real && a->Real < 0.5f);	break;
+			}
+			if( cond == (op->Operation == BC_OP_JUMPIF) )
+				op->Operation = BC_OP_JUMP;
+			else
+				_RemoveOp(State, i);
+			changed = true;
+			op = State->Ops[i];
+			break; }
+		default:
+			switch( caOpEncodingTypes[op->Operation] )
+			{
+			case BC_OPENC_REG2:
+				a = _GetConst(State, op->Content.RegInt.RegInt2);
+				break;
+			case BC_OPENC_REG3:
+				a = _GetConst(State, op->Content.RegInt.RegInt2);
+				b = _GetConst(State, op->Content.RegInt.RegInt3);
+				break;
+			default:
+				break;
+			}
+			if( !a || !_EvalConst(op, a, b, &result) )
+				break;
+			known = true;
+			if( result.TypeId == SS_DATATYPE_INTEGER ) {
+				op->Operation = BC_OP_LOADINT;
+				op->Content.Integer = result.Integer;
+			}
+			else if( result.TypeId == SS_DATATYPE_REAL ) {
+				op->Operation = BC_OP_LOADREAL;
+				op->Content.Real = result.Real;
+			}
+			else
+				State->IsPure[i] = true;
+			changed |= (result.TypeId != SS_DATATYPE_BOOLEAN);
+			break;
+		}
+		if( !op )
+			continue ;
+		// - A move's copy of a reference is released with the register
+		if( op->Operation == BC_OP_LOADINT || op->Operation == BC_OP_LOADREAL || op->Operation == BC_OP_MOV )
+			State->IsPure[i] = true;
+
+		// Forget registers changed by the operation
+		 int	n = 0;
+		for( int j = 0; j < State->NConsts; j ++ )
+		{
+			if( !_OpModifiesReg(op, State->Consts[j].Reg) )
+				State->Consts[n++] = State->Consts[j];
+		}
+		State->NConsts = n;
+		if( known )
+			_SetConst(State, &result);
+
+		// Only a conditional jump falls through into the same block
+		if( op->Operation == BC_OP_JUMP || op->Operation == BC_OP_RETURN )
+			State->NConsts = 0;
+	}
+	return changed;
+}
+
+/**
+ * \brief Remove pure operations whose result is never read
+ */
+static bool Bytecode_int_RemoveDeadStores(tBC_OptState *State)
+{
+	const int	nwords = (State->Fcn->MaxRegisters + 31) / 32;
+	if( nwords == 0 )
+		return false;
+	// - Removing an operation only removes reads, so the liveness stays conservative
+	uint32_t	*live = _ComputeLiveness(State, nwords);
+	if( !live )
+		return false;
+	bool	changed = false;
+	for( int i = 0; i < State->Count; i ++ )
+	{
+		if( !State->Ops[i] || !State->IsPure[i] )
+			continue ;
+		if( _IsRegDeadAfter(State, live, nwords, i, State->Ops[i]->DstReg) ) {
+			_RemoveOp(State, i);
+			changed = true;
+		}
+	}
+	free(live);
+	return changed;
+}
+
+/**
+ * \brief Relink the remaining operations and update the labels and side tables
+ * \note Labels that are no longer used are removed, the rest are renumbered
+ */
+static void Bytecode_int_RebuildFunction(tBC_OptState *State)
+{
+	tBC_Function	*fcn = State->Fcn;
+	const int	count = State->Count;
+	 int	new_pos[count + 1];
+	tBC_Op	*prev_op[count + 1];	// Label value for each position
+
+	// Relink, noting where each position ends up
+	tBC_Op	*prev = (void*)&fcn->Operations;
+	 int	n = 0;
+	for( int i = 0; i < count; i ++ )
+	{
+		new_pos[i] = n;
+		prev_op[i] = prev;
+		if( !State->Ops[i] )
+			continue ;
+		prev->Next = State->Ops[i];
+		prev = State->Ops[i];
+		n ++;
+	}
+	new_pos[count] = n;
+	prev_op[count] = prev;
+	prev->Next = NULL;
+	fcn->OperationsEnd = prev;
+	fcn->OperationCount = n;
+
+	// Renumber the labels still in use
+	bool	used[fcn->LabelCount + 1];
+	for( int i = 0; i < fcn->LabelCount; i ++ )
+		used[i] = false;
+	for( int i = 0; i < count; i ++ )
+	{
+		if( State->Ops[i] && _IsJump(State->Ops[i]) )
+			used[State->Ops[i]->DstReg] = true;
+	}
+	for( int i = 0; i < fcn->HandlerCount; i ++ )
+	{
+		used[fcn->Handlers[i].Start] = true;
+		used[fcn->Handlers[i].End] = true;
+		used[fcn->Handlers[i].Handler] = true;
+	}
+	 int	new_label[fcn->LabelCount + 1];
+	 int	nlabels = 0;
+	for( int i = 0; i < fcn->LabelCount; i ++ )
+	{
+		new_label[i] = -1;
+		if( !used[i] )
+			continue ;
+		new_label[i] = nlabels;
+		fcn->Labels[nlabels++] = prev_op[ State->LabelPos[i] ];
+	}
+	for( int i = 0; i < count; i ++ )
+	{
+		if( State->Ops[i] && _IsJump(State->Ops[i]) )
+			State->Ops[i]->DstReg = new_label[State->Ops[i]->DstReg];
+	}
+	for( int i = 0; i < fcn->HandlerCount; i ++ )
+	{
+		tBC_HandlerEnt	*ent = &fcn->Handlers[i];
+		ent->Start = new_label[ent->Start];
+		ent->End = new_label[ent->End];
+		ent->Handler = new_label[ent->Handler];
+	}
+	fcn->LabelCount = nlabels;
+
+	// Positions of removed operations move to the next remaining one
+	 int	nlines = 0;
+	for( int i = 0; i < fcn->LineCount; i ++ )
 	{
+		tBC_LineEnt	ent = fcn->Lines[i];
+		ent.PC = new_pos[ent.PC];
+		if( nlines > 0 && fcn->Lines[nlines-1].PC == ent.PC ) {
+			nlines --;
+			Bytecode_int_DerefFile(fcn->Lines[nlines].File);
+		}
+		if( nlines > 0 && fcn->Lines[nlines-1].File == ent.File && fcn->Lines[nlines-1].Line == ent.Line ) {
+			Bytecode_int_DerefFile(ent.File);
+			continue ;
+		}
+		fcn->Lines[nlines++] = ent;
 	}
+	fcn->LineCount = nlines;
+	for( int i = 0; i < fcn->VarCount; i ++ )
+		fcn->Vars[i].PC = new_pos[fcn->Vars[i].PC];
 }
@@ -0,0 +1,2147 @@
+/*
+ * SpiderScript Library
+ * by John Hodge (thePowersGang)
+ *
+ * bytecode_ssa.c
+ * - SSA form of the operation list, and the optimisations that use it
+ *
+ * Registers keep their numbers, the SSA form is built alongside the operations: every write
+ * creates a new value, blocks where definitions merge get a phi per register (placed using
+ * dominance frontiers), and every register read is resolved to the value it sees. Values
+ * that are known to be equal share a value number.
+ *
+ * The optimisations rewrite the operations in place (or insert new ones before a loop), so
+ * there is no separate lowering step. Each round makes one kind of change, the caller
+ * (Bytecode_OptimiseFunction) cleans up and rebuilds the form for the next round.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "common.h"
+#include "bytecode.h"
+#include "bytecode_gen.h"
+
+#define BC_SSA_MAXBLOCKS	1024	// Larger functions are left alone
+#define BC_SSA_MAXHOIST	16	// Registers added per round by loop-invariant code motion
+#define BC_SSA_BOUND	((tSpiderInteger)1 << 62)	// See Bytecode_int_SSABounds
+#define BC_SSA_MAXSTEP	((tSpiderInteger)1 << 16)
+#define BC_SSA_MAXFACTS	16	// Conditions collected for an operation by Bytecode_int_SSARanges
+#define BC_SSA_MAXVERSION	64	// Operations in a loop copied by Bytecode_int_SSAVersion
+
+// === STRUCTURES ===
+typedef struct sBC_SSABlock
+{
+	 int	Start;	// First operation
+	 int	End;	// Operation after the last
+	 int	NSuccs;
+	 int	Succs[2];
+	 int	NPreds;
+	 int	*Preds;	// Blocks that fall through or jump here (exceptions are not edges)
+	 int	IDom;	// Immediate dominator, the root for blocks entered with unknown registers
+	 int	Order;	// Reverse post-order number (the root is 0), -1 if unreachable
+	 int	NFrontier;
+	 int	*Frontier;	// Dominance frontier
+	bool	IsHandler;	// Entered by an exception
+	bool	IsCovered;	// In a handler range
+} tBC_SSABlock;
+
+typedef struct sBC_SSAValue
+{
+	 int	Def;	// Defining operation, -1 for phis and unknown values
+	 int	Block;	// Defining block (phis are in the block they merge into)
+	 int	VN;	// Value number, shared by values known to be equal
+	 int	NUses;	// Reads by operations and phis
+	bool	Escapes;	// May be read where reads aren't counted (handlers, unknown merges)
+	bool	IsPhi;
+	bool	IsBounded;	// In 0 .. BC_SSA_BOUND
+	 int	PhiArgs;	// First input in tBC_SSA.PhiArgs (one per predecessor)
+	 int	CopyOf;	// Value copied by a MOV, -1 if not a copy
+	 int	CopyReg;	// Register the copy was made from
+} tBC_SSAValue;
+
+typedef struct sBC_SSAFact
+{
+	 int	Lo;	// Lo < Hi (or Lo <= Hi), both values
+	 int	Hi;	// - Or a foreach's collection, Lo is below its length
+	bool	Strict;
+	 int	Cmp;	// Comparison (or FOREACH_NEXT) it comes from
+} tBC_SSAFact;
+
+typedef struct sBC_SSAExpr
+{
+	 int	Operation;
+	 int	Args[3];	// Value numbers of the operands, and of the memory for loads
+	uint64_t	Imm;
+	 int	VN;	// -1 for an empty slot
+} tBC_SSAExpr;
+
+typedef struct sBC_SSA
+{
+	tBC_Function	*Fcn;
+	 int	NRegs;	// Registers, NRegs is a pseudo-register for object/array contents
+	 int	Count;
+	tBC_Op	**Ops;
+	 int	*LabelPos;
+	 int	*BlockOf;
+
+	 int	NBlocks;	// Blocks[NBlocks] is the root, the parent of entry and handler blocks
+	tBC_SSABlock	*Blocks;
+	 int	*PredBuf;
+	 int	*RPO;	// Reachable blocks in reverse post-order
+	 int	NReached;
+
+	bool	*HasPhi;	// [block * (NRegs+1) + reg]
+	 int	*PhiValue;	// As above, the phi's value once the block is walked
+	 int	*EndState;	// Value of each register at the end of each block, as above
+
+	 int	NValues;
+	 int	ValueSpace;
+	tBC_SSAValue	*Values;
+	 int	NPhiArgs;
+	 int	PhiArgSpace;
+	 int	*PhiArgs;
+
+	 int	(*Src)[2];	// Values read from RegInt2/RegInt3, -1 where they aren't registers
+	 int	*Mem;	// Contents read by GETELEMENT/GETINDEX, -1 otherwise
+	 int	*Dst;	// Value written to DstReg, -1 if none
+	 int	*Arg;	// Value passed as a call's first argument, -1 otherwise
+
+	 int	ExprMask;
+	tBC_SSAExpr	*Exprs;
+} tBC_SSA;
+
+// === PROTOTYPES ===
+ int	Bytecode_int_OptimiseSSA(tBC_Function *Fcn);
+static int	Bytecode_int_SSABuild(tBC_SSA *SSA);
+static int	Bytecode_int_SSAWalk(tBC_SSA *SSA);
+static void	Bytecode_int_SSABounds(tBC_SSA *SSA);
+static int	Bytecode_int_SSAStrengthReduce(tBC_SSA *SSA);
+static int	Bytecode_int_SSARanges(tBC_SSA *SSA);
+static int	Bytecode_int_SSALoops(const tBC_SSA *SSA, bool *InLoop, int *Size);
+static int	Bytecode_int_SSAHoist(tBC_SSA *SSA);
+static int	Bytecode_int_SSAVersion(tBC_SSA *SSA);
+static void	Bytecode_int_SSAFree(tBC_SSA *SSA);
+
+// === CODE ===
+static bool _IsJump(const tBC_Op *Op)
+{
+	return Op->Operation == BC_OP_JUMP || Op->Operation == BC_OP_JUMPIF
+		|| Op->Operation == BC_OP_JUMPIFNOT || Op->Operation == BC_OP_FOREACH_NEXT;
+}
+
+static bool _IsCall(const tBC_Op *Op)
+{
+	switch(Op->Operation)
+	{
+	case BC_OP_CREATEOBJ:
+	case BC_OP_CALLFUNCTION:
+	case BC_OP_CALLMETHOD:
+	case BC_OP_TAILCALLFUNCTION:
+	case BC_OP_TAILCALLMETHOD:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool _IsWindowCall(const tBC_Op *Op)
+{
+	return _IsCall(Op) && (Op->Content.Function.ArgCount & BC_CALL_WINDOW);
+}
+
+/**
+ * \brief Get the registers read through RegInt2 and RegInt3
+ * \note -1 for fields that hold something else (types, slots, element indexes)
+ */
+static void _SrcFields(const tBC_Op *Op, int *R2, int *R3)
+{
+	*R2 = -1;
+	*R3 = -1;
+	switch(Op->Operation)
+	{
+	case BC_OP_LOADINT:
+	case BC_OP_LOADREAL:
+	case BC_OP_LOADNULLREF:
+	case BC_OP_GETGLOBAL:
+	case BC_OP_SETGLOBAL:
+		return ;
+	case BC_OP_CAST:
+	case BC_OP_CREATEARRAY:
+		*R3 = Op->Content.RegInt.RegInt3;
+		return ;
+	case BC_OP_GETELEMENT:
+	case BC_OP_SETELEMENT:
+	case BC_OP_FOREACH_NEXT:	// RegInt3 is written (see _OpClobbers)
+		*R2 = Op->Content.RegInt.RegInt2;
+		return ;
+	default:
+		switch( caOpEncodingTypes[Op->Operation] )
+		{
+		case BC_OPENC_REG2:
+			*R2 = Op->Content.RegInt.RegInt2;
+			break;
+		case BC_OPENC_REG3:
+			*R2 = Op->Content.RegInt.RegInt2;
+			*R3 = Op->Content.RegInt.RegInt3;
+			break;
+		default:
+			break;
+		}
+		return ;
+	}
+}
+
+/**
+ * \brief Check if DstReg is a register read by the operation (and not written)
+ */
+static bool _DstIsSource(const tBC_Op *Op)
+{
+	switch(Op->Operation)
+	{
+	case BC_OP_RETURN:
+	case BC_OP_SETGLOBAL:
+	case BC_OP_SETINDEX:
+	case BC_OP_SETINDEX_INRANGE:
+	case BC_OP_SETELEMENT:
+		return Op->DstReg >= 0;
+	default:
+		return false;
+	}
+}
+
+/**
+ * \brief Check if the operation writes DstReg
+ */
+static bool _WritesDst(const tBC_Op *Op)
+{
+	switch(Op->Operation)
+	{
+	case BC_OP_NOP:
+	case BC_OP_IMPORTGLOBAL:	// DstReg is a global slot
+	case BC_OP_RETURN:
+	case BC_OP_SETGLOBAL:
+	case BC_OP_SETINDEX:
+	case BC_OP_SETINDEX_INRANGE:
+	case BC_OP_SETELEMENT:
+	case BC_OP_JUMP:
+	case BC_OP_JUMPIF:
+	case BC_OP_JUMPIFNOT:
+	case BC_OP_FOREACH_NEXT:
+		return false;
+	default:
+		return Op->DstReg >= 0;
+	}
+}
+
+/**
+ * \brief Check if the operation reads object/array contents
+ */
+static bool _ReadsMemory(const tBC_Op *Op)
+{
+	return Op->Operation == BC_OP_GETELEMENT || Op->Operation == BC_OP_GETINDEX
+		|| Op->Operation == BC_OP_GETINDEX_INRANGE;
+}
+
+/**
+ * \brief Check if the operation can change object/array contents
+ */
+static bool _WritesMemory(const tBC_Op *Op)
+{
+	return Op->Operation == BC_OP_SETELEMENT || Op->Operation == BC_OP_SETINDEX
+		|| Op->Operation == BC_OP_SETINDEX_INRANGE || _IsCall(Op);
+}
+
+/**
+ * \brief List the registers written by an operation, other than DstReg
+ * \return Number of registers in \a Regs (which has space for NRegs+1)
+ * \note A window call overwrites every register from the window up, other calls only read
+ *       their arguments (they are copied into the callee's frame)
+ * \note FOREACH_NEXT's index is listed first (see _ForeachIndex)
+ */
+static int _OpClobbers(const tBC_SSA *SSA, const tBC_Op *Op, int *Regs)
+{
+	 int	n = 0;
+	if( _WritesMemory(Op) )
+		Regs[n++] = SSA->NRegs;
+	if( Op->Operation == BC_OP_MOV_MOVE )
+		Regs[n++] = Op->Content.RegInt.RegInt2;
+	if( Op->Operation == BC_OP_FOREACH_INIT )
+		Regs[n++] = Op->DstReg + 1;
+	if( Op->Operation == BC_OP_FOREACH_NEXT ) {
+		Regs[n++] = Op->Content.RegInt.RegInt2 + 1;
+		Regs[n++] = Op->Content.RegInt.RegInt3;
+	}
+	if( _IsWindowCall(Op) ) {
+		for( int r = Op->Content.Function.ArgRegs[0]; r < SSA->NRegs; r ++ )
+			Regs[n++] = r;
+	}
+	return n;
+}
+
+/**
+ * \brief Check that an operation only uses registers in the frame
+ */
+static bool _OpRegsValid(const tBC_SSA *SSA, const tBC_Op *Op)
+{
+	 int	r2, r3;
+	_SrcFields(Op, &r2, &r3);
+	if( r2 >= SSA->NRegs || r3 >= SSA->NRegs )
+		return false;
+	if( (_WritesDst(Op) || _DstIsSource(Op)) && Op->DstReg >= SSA->NRegs )
+		return false;
+	// - foreach state is a register pair
+	if( Op->Operation == BC_OP_FOREACH_INIT && Op->DstReg + 1 >= SSA->NRegs )
+		return false;
+	if( Op->Operation == BC_OP_FOREACH_NEXT && (r2 + 1 >= SSA->NRegs
+	 || Op->Content.RegInt.RegInt3 < 0 || Op->Content.RegInt.RegInt3 >= SSA->NRegs) )
+		return false;
+	if( _IsCall(Op) ) {
+		for( int i = 0; i < (Op->Content.Function.ArgCount & BC_CALL_ARGCOUNT_MASK); i ++ )
+		{
+			if( Op->Content.Function.ArgRegs[i] < 0 || Op->Content.Function.ArgRegs[i] >= SSA->NRegs )
+				return false;
+		}
+	}
+	return r2 >= -1 && r3 >= -1;
+}
+
+static int _NewValue(tBC_SSA *SSA, int Def, int Block)
+{
+	if( SSA->NValues == SSA->ValueSpace )
+	{
+		 int	space = SSA->ValueSpace * 2 + 64;
+		void *tmp = realloc(SSA->Values, space * sizeof(tBC_SSAValue));
+		if( !tmp )	return -1;
+		SSA->Values = tmp;
+		SSA->ValueSpace = space;
+	}
+	 int	ret = SSA->NValues ++;
+	tBC_SSAValue	*val = &SSA->Values[ret];
+	memset(val, 0, sizeof(*val));
+	val->Def = Def;
+	val->Block = Block;
+	val->VN = ret;
+	val->PhiArgs = -1;
+	val->CopyOf = -1;
+	return ret;
+}
+
+/**
+ * \brief Get the constant loaded into a value
+ * \return Non-zero if the value comes from a LOADINT
+ */
+static int _GetConstInt(const tBC_SSA *SSA, int Value, tSpiderInteger *Out)
+{
+	if( Value < 0 || SSA->Values[Value].Def < 0 )
+		return 0;
+	const tBC_Op	*op = SSA->Ops[ SSA->Values[Value].Def ];
+	if( op->Operation != BC_OP_LOADINT )
+		return 0;
+	*Out = op->Content.Integer;
+	return 1;
+}
+
+static bool _IsConst(const tBC_SSA *SSA, int Value)
+{
+	if( Value < 0 || SSA->Values[Value].Def < 0 )
+		return false;
+	const tBC_Op	*op = SSA->Ops[ SSA->Values[Value].Def ];
+	return op->Operation == BC_OP_LOADINT || op->Operation == BC_OP_LOADREAL;
+}
+
+/**
+ * \brief Check if an operation's result depends only on its operands (and memory for loads)
+ * \param Commutative	Set if the operands can be swapped
+ */
+static bool _IsPureOp(const tBC_Op *Op, bool *Commutative)
+{
+	*Commutative = false;
+	switch(Op->Operation)
+	{
+	case BC_OP_INT_ADD:
+	case BC_OP_INT_MULTIPLY:
+	case BC_OP_INT_BITAND:
+	case BC_OP_INT_BITOR:
+	case BC_OP_INT_BITXOR:
+	case BC_OP_INT_EQUALS:
+	case BC_OP_INT_NOTEQUALS:
+	case BC_OP_REAL_ADD:
+	case BC_OP_REAL_MULTIPLY:
+	case BC_OP_REAL_EQUALS:
+	case BC_OP_REAL_NOTEQUALS:
+	case BC_OP_BOOL_EQUALS:
+	case BC_OP_BOOL_LOGICAND:
+	case BC_OP_BOOL_LOGICOR:
+	case BC_OP_BOOL_LOGICXOR:
+	case BC_OP_REFEQ:
+	case BC_OP_REFNEQ:
+	case BC_OP_STR_EQUALS:
+	case BC_OP_STR_NOTEQUALS:
+		*Commutative = true;
+		return true;
+	case BC_OP_INT_SUBTRACT:
+	case BC_OP_INT_DIVIDE:
+	case BC_OP_INT_MODULO:
+	case BC_OP_INT_BITSHIFTLEFT:
+	case BC_OP_INT_BITSHIFTRIGHT:
+	case BC_OP_INT_BITROTATELEFT:
+	case BC_OP_INT_LESSTHAN:
+	case BC_OP_INT_LESSTHANEQ:
+	case BC_OP_INT_GREATERTHAN:
+	case BC_OP_INT_GREATERTHANEQ:
+	case BC_OP_INT_NEG:
+	case BC_OP_INT_BITNOT:
+	case BC_OP_REAL_SUBTRACT:
+	case BC_OP_REAL_DIVIDE:
+	case BC_OP_REAL_LESSTHAN:
+	case BC_OP_REAL_LESSTHANEQ:
+	case BC_OP_REAL_GREATERTHAN:
+	case BC_OP_REAL_GREATERTHANEQ:
+	case BC_OP_REAL_NEG:
+	case BC_OP_BOOL_LOGICNOT:
+	case BC_OP_STR_LESSTHAN:
+	case BC_OP_STR_LESSTHANEQ:
+	case BC_OP_STR_GREATERTHAN:
+	case BC_OP_STR_GREATERTHANEQ:
+	case BC_OP_GETELEMENT:
+	case BC_OP_GETINDEX:
+	case BC_OP_GETINDEX_INRANGE:
+		return true;
+	case BC_OP_CAST:
+		// - Casts to strings create a new object
+		return Op->Content.RegInt.RegInt2 == SS_DATATYPE_INTEGER
+			|| Op->Content.RegInt.RegInt2 == SS_DATATYPE_REAL
+			|| Op->Content.RegInt.RegInt2 == SS_DATATYPE_BOOLEAN;
+	default:
+		return false;
+	}
+}
+
+/**
+ * \brief Check if a pure operation can raise an exception
+ * \note Operand types of generated code are checked when it is converted, so only
+ *       operations that can fail on well-typed operands count
+ */
+static bool _CanThrow(const tBC_SSA *SSA, const tBC_Op *Op, int Divisor)
+{
+	tSpiderInteger	val;
+	switch(Op->Operation)
+	{
+	case BC_OP_INT_DIVIDE:
+	case BC_OP_INT_MODULO:
+		return !_GetConstInt(SSA, Divisor, &val) || val == 0 || val == -1;
+	case BC_OP_GETELEMENT:	// Null object
+	case BC_OP_GETINDEX:	// Null array, index out of range
+	case BC_OP_GETINDEX_INRANGE:	// Null array
+	case BC_OP_CAST:
+	case BC_OP_STR_EQUALS:	// Null strings
+	case BC_OP_STR_NOTEQUALS:
+	case BC_OP_STR_LESSTHAN:
+	case BC_OP_STR_LESSTHANEQ:
+	case BC_OP_STR_GREATERTHAN:
+	case BC_OP_STR_GREATERTHANEQ:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * \brief Get the value number of an expression, adding it if new
+ * \param VN	Value number to use for a new expression
+ */
+static int _LookupExpr(tBC_SSA *SSA, const tBC_SSAExpr *Key, int VN)
+{
+	uint64_t	hash = Key->Operation * 0x9E3779B97F4A7C15ULL;
+	hash = (hash ^ Key->Args[0]) * 0x100000001B3ULL;
+	hash = (hash ^ Key->Args[1]) * 0x100000001B3ULL;
+	hash = (hash ^ Key->Args[2]) * 0x100000001B3ULL;
+	hash = (hash ^ Key->Imm) * 0x100000001B3ULL;
+	for( int i = (hash >> 32) & SSA->ExprMask; ; i = (i + 1) & SSA->ExprMask )
+	{
+		tBC_SSAExpr	*ent = &SSA->Exprs[i];
+		if( ent->VN == -1 ) {
+			*ent = *Key;
+			ent->VN = VN;
+			return VN;
+		}
+		if( ent->Operation == Key->Operation && ent->Imm == Key->Imm
+		 && ent->Args[0] == Key->Args[0] && ent->Args[1] == Key->Args[1] && ent->Args[2] == Key->Args[2] )
+			return ent->VN;
+	}
+}
+
+/**
+ * \brief Check if block \a A dominates block \a B (which must be reachable)
+ */
+static bool _Dominates(const tBC_SSA *SSA, int A, int B)
+{
+	for( ; B != SSA->NBlocks; B = SSA->Blocks[B].IDom )
+	{
+		if( B == A )
+			return true;
+	}
+	return false;
+}
+
+/**
+ * \brief Get the value a chain of moves copied
+ */
+static int _Original(const tBC_SSA *SSA, int Value)
+{
+	while( SSA->Values[Value].CopyOf >= 0 )
+		Value = SSA->Values[Value].CopyOf;
+	return Value;
+}
+
+static bool _SameValue(const tBC_SSA *SSA, int A, int B)
+{
+	return SSA->Values[A].VN == SSA->Values[B].VN;
+}
+
+/**
+ * \brief Get the index left by a FOREACH_NEXT (which ends its block)
+ */
+static int _ForeachIndex(const tBC_SSA *SSA, int Pos)
+{
+	const int	reg = SSA->Ops[Pos]->Content.RegInt.RegInt2 + 1;
+	return SSA->EndState[ SSA->BlockOf[Pos] * (SSA->NRegs + 1) + reg ];
+}
+
+/**
+ * \brief Check if a value is the collection a foreach started on an array (see FOREACH_INIT)
+ */
+static bool _IsIteratorOf(const tBC_SSA *SSA, int Value, int Array)
+{
+	const int	def = SSA->Values[Value].Def;
+	if( def < 0 || SSA->Dst[def] != Value || SSA->Ops[def]->Operation != BC_OP_FOREACH_INIT )
+		return false;
+	return SSA->Src[def][0] >= 0 && _SameValue(SSA, SSA->Src[def][0], Array);
+}
+
+/**
+ * \brief Check if a value is the length of an array, from the exported len() or sizeof()
+ * \note Arrays can't be resized, so it stays the length
+ */
+static bool _IsLength(const tBC_SSA *SSA, int Value, int Array)
+{
+	Value = _Original(SSA, Value);
+	const int	def = SSA->Values[Value].Def;
+	if( def < 0 || SSA->Dst[def] != Value )
+		return false;
+	const tBC_Op	*op = SSA->Ops[def];
+	if( op->Operation != BC_OP_CALLFUNCTION || op->Content.Function.ArgCount != 1 )
+		return false;
+	if( (op->Content.Function.ID >> 16) != 1 )
+		return false;
+	const char	*name = SpiderScript_int_GetFunctionName(SSA->Fcn->Script, op->Content.Function.ID);
+	if( strcmp(name, "len") != 0 && strcmp(name, "sizeof") != 0 )
+		return false;
+	return SSA->Arg[def] >= 0 && _SameValue(SSA, SSA->Arg[def], Array);
+}
+
+/**
+ * \brief Check if an integer value is never negative
+ * \note As well as values found by Bytecode_int_SSABounds, this covers a counter that is
+ *       incremented before it is used (starting from a small negative value), and a foreach
+ *       index (FOREACH_NEXT raises an exception for a negative one)
+ */
+static bool _NonNegative(const tBC_SSA *SSA, int Value)
+{
+	const tBC_SSAValue	*val = &SSA->Values[Value];
+	if( val->IsBounded )
+		return true;
+	if( val->Def >= 0 && SSA->Ops[val->Def]->Operation == BC_OP_FOREACH_NEXT && _ForeachIndex(SSA, val->Def) == Value )
+		return true;
+	if( val->Def < 0 || SSA->Dst[val->Def] != Value || SSA->Ops[val->Def]->Operation != BC_OP_INT_ADD )
+		return false;
+	 int	phi = SSA->Src[val->Def][0];
+	tSpiderInteger	step;
+	if( !_GetConstInt(SSA, SSA->Src[val->Def][1], &step) ) {
+		phi = SSA->Src[val->Def][1];
+		if( !_GetConstInt(SSA, SSA->Src[val->Def][0], &step) )
+			return false;
+	}
+	if( step <= 0 || step > BC_SSA_MAXSTEP || phi < 0 || !SSA->Values[phi].IsPhi || SSA->Values[phi].PhiArgs < 0 )
+		return false;
+	// - Every input is the previous result, non-negative, or a constant the step makes so
+	const tBC_SSABlock	*blk = &SSA->Blocks[ SSA->Values[phi].Block ];
+	for( int j = 0; j < blk->NPreds; j ++ )
+	{
+		const int	arg = SSA->PhiArgs[SSA->Values[phi].PhiArgs + j];
+		tSpiderInteger	c;
+		if( arg < 0 || _SameValue(SSA, arg, Value) || SSA->Values[arg].IsBounded )
+			continue ;
+		if( _GetConstInt(SSA, arg, &c) && c >= -step )
+			continue ;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * \brief Collect the integer comparisons known to hold on entry to a block
+ * \return Number of facts in \a Facts (up to BC_SSA_MAXFACTS)
+ *
+ * Walks up the dominator tree, taking the condition from each conditional jump whose edge
+ * every path to the block goes through (other ways into the edge's target must come back
+ * from the target itself, as loop back-edges do).
+ */
+static int _EdgeFacts(const tBC_SSA *SSA, int Block, tBC_SSAFact *Facts)
+{
+	const int	root = SSA->NBlocks;
+	 int	n = 0;
+	for( int b = Block; b != root && n < BC_SSA_MAXFACTS; b = SSA->Blocks[b].IDom )
+	{
+		const int	d = SSA->Blocks[b].IDom;
+		if( d < 0 || d == root )
+			break;
+		const tBC_SSABlock	*dom = &SSA->Blocks[d];
+		if( dom->NSuccs != 2 || dom->Succs[0] == dom->Succs[1] || (dom->Succs[0] != b && dom->Succs[1] != b) )
+			continue ;
+		bool	only_edge = true;
+		for( int j = 0; j < SSA->Blocks[b].NPreds; j ++ )
+		{
+			const int	p = SSA->Blocks[b].Preds[j];
+			if( p != d && SSA->Blocks[p].Order >= 0 && !_Dominates(SSA, b, p) )
+				only_edge = false;
+		}
+		if( !only_edge )
+			continue ;
+
+		// Condition and its value on the edge (the jump target is the first successor)
+		const int	end = dom->End - 1;
+		const tBC_Op	*jump = SSA->Ops[end];
+		// - FOREACH_NEXT continues with its index below the collection's length
+		if( jump->Operation == BC_OP_FOREACH_NEXT ) {
+			if( dom->Succs[1] == b && SSA->Src[end][0] >= 0 )
+				Facts[n++] = (tBC_SSAFact){ _ForeachIndex(SSA, end), SSA->Src[end][0], true, end };
+			continue ;
+		}
+		if( SSA->Src[end][0] < 0 )
+			continue ;
+		const int	cond = _Original(SSA, SSA->Src[end][0]);
+		const int	pos = SSA->Values[cond].Def;
+		if( pos < 0 || SSA->Dst[pos] != cond )
+			continue ;
+		const int	a = SSA->Src[pos][0], c = SSA->Src[pos][1];
+		if( a < 0 || c < 0 )
+			continue ;
+		const bool	truth = ((dom->Succs[0] == b) == (jump->Operation == BC_OP_JUMPIF));
+		tBC_SSAFact	*fact = &Facts[n];
+		switch(SSA->Ops[pos]->Operation)
+		{
+		case BC_OP_INT_LESSTHAN:	// a < c, or c <= a
+			*fact = (tBC_SSAFact){ truth ? a : c, truth ? c : a, truth, pos };
+			break;
+		case BC_OP_INT_LESSTHANEQ:	// a <= c, or c < a
+			*fact = (tBC_SSAFact){ truth ? a : c, truth ? c : a, !truth, pos };
+			break;
+		case BC_OP_INT_GREATERTHAN:	// c < a, or a <= c
+			*fact = (tBC_SSAFact){ truth ? c : a, truth ? a : c, truth, pos };
+			break;
+		case BC_OP_INT_GREATERTHANEQ:	// c <= a, or a < c
+			*fact = (tBC_SSAFact){ truth ? c : a, truth ? a : c, !truth, pos };
+			break;
+		default:
+			continue ;
+		}
+		n ++;
+	}
+	return n;
+}
+
+/**
+ * \brief Check if the facts show that a value is below an array's length
+ * \return Fact giving the bound, -1 if not shown
+ */
+static int _BelowLength(const tBC_SSA *SSA, const tBC_SSAFact *Facts, int NFacts, int Value, int Array)
+{
+	for( int i = 0; i < NFacts; i ++ )
+	{
+		if( !Facts[i].Strict || !_SameValue(SSA, Facts[i].Lo, Value) )
+			continue ;
+		if( _IsLength(SSA, Facts[i].Hi, Array) || _IsIteratorOf(SSA, Facts[i].Hi, Array) )
+			return i;
+		// - Bounded by something no larger than the length
+		for( int j = 0; j < NFacts; j ++ )
+		{
+			if( _SameValue(SSA, Facts[j].Lo, Facts[i].Hi) && _IsLength(SSA, Facts[j].Hi, Array) )
+				return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * \brief Optimise a function using its SSA form
+ * \return Number of changes made, -1 on error
+ * \note Only one kind of change is made per call (see file comment)
+ */
+int Bytecode_int_OptimiseSSA(tBC_Function *Fcn)
+{
+	tBC_SSA	ssa = {.Fcn = Fcn, .NRegs = Fcn->MaxRegisters};
+	 int	ret = Bytecode_int_SSABuild(&ssa);
+	if( ret == 0 )
+		ret = Bytecode_int_SSAWalk(&ssa);
+	if( ret == 0 ) {
+		Bytecode_int_SSABounds(&ssa);
+		ret = Bytecode_int_SSAStrengthReduce(&ssa);
+	}
+	if( ret == 0 )
+		ret = Bytecode_int_SSARanges(&ssa);
+	if( ret == 0 )
+		ret = Bytecode_int_SSAHoist(&ssa);
+	if( ret == 0 )
+		ret = Bytecode_int_SSAVersion(&ssa);
+	Bytecode_int_SSAFree(&ssa);
+	return ret;
+}
+
+/**
+ * \brief Split the function into blocks, find dominators and place phis
+ * \return 0 on success, 1 if the function is left alone, -1 on error
+ */
+static int Bytecode_int_SSABuild(tBC_SSA *SSA)
+{
+	tBC_Function	*fcn = SSA->Fcn;
+	const int	nregs = SSA->NRegs;
+
+	for( tBC_Op *op = fcn->Operations; op; op = op->Next )
+		SSA->Count ++;
+	const int	count = SSA->Count;
+	if( count == 0 )
+		return 1;
+	SSA->Ops = malloc( count * sizeof(tBC_Op*) );
+	SSA->LabelPos = malloc( (fcn->LabelCount + 1) * sizeof(int) );
+	SSA->BlockOf = malloc( (count + 1) * sizeof(int) );
+	if( !SSA->Ops || !SSA->LabelPos || !SSA->BlockOf )
+		return -1;
+	 int	idx = 0;
+	for( tBC_Op *op = fcn->Operations; op; op = op->Next )
+	{
+		SSA->Ops[idx++] = op;
+		if( !_OpRegsValid(SSA, op) )
+			return 1;
+	}
+
+	// Labels point to the operation before the target
+	for( int i = 0; i < fcn->LabelCount; i ++ )
+	{
+		SSA->LabelPos[i] = -1;
+		if( fcn->Labels[i] == (void*)&fcn->Operations )
+			SSA->LabelPos[i] = 0;
+		for( int j = 0; j < count && SSA->LabelPos[i] == -1; j ++ )
+		{
+			if( fcn->Labels[i] == SSA->Ops[j] )
+				SSA->LabelPos[i] = j + 1;
+		}
+	}
+	for( int i = 0; i < count; i ++ )
+	{
+		const tBC_Op	*op = SSA->Ops[i];
+		if( _IsJump(op) && (op->DstReg < 0 || op->DstReg >= fcn->LabelCount || SSA->LabelPos[op->DstReg] == -1) )
+			return 1;
+	}
+	for( int i = 0; i < fcn->HandlerCount; i ++ )
+	{
+		const tBC_HandlerEnt	*ent = &fcn->Handlers[i];
+		if( SSA->LabelPos[ent->Start] == -1 || SSA->LabelPos[ent->End] == -1 || SSA->LabelPos[ent->Handler] == -1 )
+			return 1;
+	}
+
+	// Find block leaders
+	bool	*leader = calloc(count + 1, sizeof(bool));
+	if( !leader )	return -1;
+	leader[0] = true;
+	for( int i = 0; i < fcn->LabelCount; i ++ )
+	{
+		if( SSA->LabelPos[i] >= 0 )
+			leader[ SSA->LabelPos[i] ] = true;
+	}
+	for( int i = 0; i < count; i ++ )
+	{
+		if( _IsJump(SSA->Ops[i]) || SSA->Ops[i]->Operation == BC_OP_RETURN )
+			leader[i+1] = true;
+	}
+	 int	nblocks = 0;
+	for( int i = 0; i < count; i ++ )
+		nblocks += leader[i];
+	if( nblocks > BC_SSA_MAXBLOCKS ) {
+		free(leader);
+		return 1;
+	}
+	SSA->NBlocks = nblocks;
+	SSA->Blocks = calloc(nblocks + 1, sizeof(tBC_SSABlock));
+	if( !SSA->Blocks ) {
+		free(leader);
+		return -1;
+	}
+	 int	b = -1;
+	for( int i = 0; i < count; i ++ )
+	{
+		if( leader[i] ) {
+			b ++;
+			SSA->Blocks[b].Start = i;
+		}
+		SSA->Blocks[b].End = i + 1;
+		SSA->BlockOf[i] = b;
+	}
+	SSA->BlockOf[count] = -1;
+	free(leader);
+
+	// Edges
+	 int	npreds = 0;
+	for( b = 0; b < nblocks; b ++ )
+	{
+		tBC_SSABlock	*blk = &SSA->Blocks[b];
+		const tBC_Op	*last = SSA->Ops[blk->End-1];
+		if( _IsJump(last) ) {
+			 int	dest = SSA->BlockOf[ SSA->LabelPos[last->DstReg] ];
+			if( dest >= 0 )
+				blk->Succs[blk->NSuccs++] = dest;
+		}
+		if( last->Operation != BC_OP_JUMP && last->Operation != BC_OP_RETURN && blk->End < count ) {
+			if( blk->NSuccs == 0 || blk->Succs[0] != b + 1 )
+				blk->Succs[blk->NSuccs++] = b + 1;
+		}
+		for( int i = 0; i < blk->NSuccs; i ++ )
+			SSA->Blocks[blk->Succs[i]].NPreds ++;
+		npreds += blk->NSuccs;
+	}
+	SSA->PredBuf = malloc( (npreds + 1) * sizeof(int) );
+	if( !SSA->PredBuf )	return -1;
+	npreds = 0;
+	for( b = 0; b < nblocks; b ++ )
+	{
+		SSA->Blocks[b].Preds = SSA->PredBuf + npreds;
+		npreds += SSA->Blocks[b].NPreds;
+		SSA->Blocks[b].NPreds = 0;
+	}
+	for( b = 0; b < nblocks; b ++ )
+	{
+		const tBC_SSABlock	*blk = &SSA->Blocks[b];
+		for( int i = 0; i < blk->NSuccs; i ++ )
+		{
+			tBC_SSABlock	*dst = &SSA->Blocks[blk->Succs[i]];
+			dst->Preds[dst->NPreds++] = b;
+		}
+	}
+	for( int i = 0; i < fcn->HandlerCount; i ++ )
+	{
+		const tBC_HandlerEnt	*ent = &fcn->Handlers[i];
+		if( SSA->LabelPos[ent->Handler] < count )
+			SSA->Blocks[ SSA->BlockOf[SSA->LabelPos[ent->Handler]] ].IsHandler = true;
+		for( int j = SSA->LabelPos[ent->Start]; j < SSA->LabelPos[ent->End]; j ++ )
+			SSA->Blocks[ SSA->BlockOf[j] ].IsCovered = true;
+	}
+
+	// Reverse post-order from the root (entry and handler blocks)
+	const int	root = nblocks;
+	 int	*stack = malloc( (nblocks + 1) * 2 * sizeof(int) );
+	SSA->RPO = malloc( (nblocks + 1) * sizeof(int) );
+	if( !stack || !SSA->RPO ) {
+		free(stack);
+		return -1;
+	}
+	for( b = 0; b <= nblocks; b ++ )
+		SSA->Blocks[b].Order = -1;
+	 int	npost = 0;
+	void _dfs(int Start) {
+		 int	sp = 0;
+		if( SSA->Blocks[Start].Order != -1 )
+			return ;
+		SSA->Blocks[Start].Order = -2;
+		stack[sp++] = Start;
+		stack[sp++] = 0;
+		while( sp > 0 )
+		{
+			 int	blk = stack[sp-2];
+			 int	succ = stack[sp-1];
+			if( succ < SSA->Blocks[blk].NSuccs ) {
+				stack[sp-1] ++;
+				 int	next = SSA->Blocks[blk].Succs[succ];
+				if( SSA->Blocks[next].Order == -1 ) {
+					SSA->Blocks[next].Order = -2;
+					stack[sp++] = next;
+					stack[sp++] = 0;
+				}
+			}
+			else {
+				SSA->RPO[npost++] = blk;
+				sp -= 2;
+			}
+		}
+	}
+	for( b = nblocks; b -- > 0; )
+	{
+		if( SSA->Blocks[b].IsHandler )
+			_dfs(b);
+	}
+	_dfs(0);
+	free(stack);
+	// - Post-order to reverse post-order
+	for( int i = 0; i < npost / 2; i ++ )
+	{
+		 int	tmp = SSA->RPO[i];
+		SSA->RPO[i] = SSA->RPO[npost-1-i];
+		SSA->RPO[npost-1-i] = tmp;
+	}
+	SSA->NReached = npost;
+	SSA->Blocks[root].Order = 0;
+	for( int i = 0; i < npost; i ++ )
+		SSA->Blocks[ SSA->RPO[i] ].Order = i + 1;
+
+	// Dominators (Cooper, Harvey and Kennedy)
+	for( b = 0; b <= nblocks; b ++ )
+		SSA->Blocks[b].IDom = -1;
+	SSA->Blocks[root].IDom = root;
+	 int _intersect(int a, int b) {
+		while( a != b )
+		{
+			while( SSA->Blocks[a].Order > SSA->Blocks[b].Order )
+				a = SSA->Blocks[a].IDom;
+			while( SSA->Blocks[b].Order > SSA->Blocks[a].Order )
+				b = SSA->Blocks[b].IDom;
+		}
+		return a;
+	}
+	for( bool changed = true; changed; )
+	{
+		changed = false;
+		for( int i = 0; i < npost; i ++ )
+		{
+			tBC_SSABlock	*blk = &SSA->Blocks[ SSA->RPO[i] ];
+			 int	idom = (SSA->RPO[i] == 0 || blk->IsHandler ? root : -1);
+			for( int j = 0; j < blk->NPreds; j ++ )
+			{
+				 int	p = blk->Preds[j];
+				if( SSA->Blocks[p].IDom == -1 )
+					continue ;
+				idom = (idom == -1 ? p : _intersect(p, idom));
+			}
+			if( blk->IDom != idom ) {
+				blk->IDom = idom;
+				changed = true;
+			}
+		}
+	}
+
+	// Dominance frontiers (only blocks with a real dominator get phis)
+	 int	*stamp = malloc( (nblocks + 1) * sizeof(int) );
+	if( !stamp )	return -1;
+	for( b = 0; b <= nblocks; b ++ )
+		stamp[b] = -1;
+	for( b = 0; b < nblocks; b ++ )
+	{
+		const tBC_SSABlock	*blk = &SSA->Blocks[b];
+		if( blk->Order < 0 || blk->IDom == root || blk->NPreds < 2 )
+			continue ;
+		for( int j = 0; j < blk->NPreds; j ++ )
+		{
+			 int	runner = blk->Preds[j];
+			if( SSA->Blocks[runner].Order < 0 )
+				continue ;
+			while( runner != blk->IDom && runner != root && stamp[runner] != b )
+			{
+				tBC_SSABlock	*r = &SSA->Blocks[runner];
+				stamp[runner] = b;
+				void *tmp = realloc(r->Frontier, (r->NFrontier + 1) * sizeof(int));
+				if( !tmp ) {
+					free(stamp);
+					return -1;
+				}
+				r->Frontier = tmp;
+				r->Frontier[r->NFrontier++] = b;
+				runner = r->IDom;
+			}
+		}
+	}
+	free(stamp);
+
+	// Place phis where definitions of a register meet
+	const int	width = nregs + 1;
+	SSA->HasPhi = calloc( (size_t)nblocks * width, sizeof(bool) );
+	SSA->EndState = malloc( (size_t)nblocks * width * sizeof(int) );
+	SSA->PhiValue = malloc( (size_t)nblocks * width * sizeof(int) );
+	bool	*defs = calloc( (size_t)nblocks * width, sizeof(bool) );
+	 int	*clobbers = malloc( width * sizeof(int) );
+	 int	*work = malloc( (nblocks + 1) * sizeof(int) );
+	bool	*queued = malloc( (nblocks + 1) * sizeof(bool) );
+	if( !SSA->HasPhi || !SSA->EndState || !SSA->PhiValue || !defs || !clobbers || !work || !queued ) {
+		free(defs);
+		free(clobbers);
+		free(work);
+		free(queued);
+		return -1;
+	}
+	for( int i = 0; i < count; i ++ )
+	{
+		const tBC_Op	*op = SSA->Ops[i];
+		bool	*blk_defs = &defs[ SSA->BlockOf[i] * width ];
+		 int	n = _OpClobbers(SSA, op, clobbers);
+		for( int j = 0; j < n; j ++ )
+			blk_defs[ clobbers[j] ] = true;
+		if( _WritesDst(op) )
+			blk_defs[ op->DstReg ] = true;
+	}
+	for( int r = 0; r < width; r ++ )
+	{
+		 int	nwork = 0;
+		for( b = 0; b < nblocks; b ++ )
+		{
+			queued[b] = defs[b * width + r] && SSA->Blocks[b].Order >= 0;
+			if( queued[b] )
+				work[nwork++] = b;
+		}
+		while( nwork > 0 )
+		{
+			const tBC_SSABlock	*blk = &SSA->Blocks[ work[--nwork] ];
+			for( int j = 0; j < blk->NFrontier; j ++ )
+			{
+				 int	f = blk->Frontier[j];
+				if( SSA->HasPhi[f * width + r] )
+					continue ;
+				SSA->HasPhi[f * width + r] = true;
+				if( !queued[f] ) {
+					queued[f] = true;
+					work[nwork++] = f;
+				}
+			}
+		}
+	}
+	free(defs);
+	free(clobbers);
+	free(work);
+	free(queued);
+
+	SSA->Src = malloc( count * sizeof(*SSA->Src) );
+	SSA->Mem = malloc( count * sizeof(int) );
+	SSA->Dst = malloc( count * sizeof(int) );
+	SSA->Arg = malloc( count * sizeof(int) );
+	 int	nexprs = 64;
+	while( nexprs < count * 2 )
+		nexprs *= 2;
+	SSA->Exprs = malloc( nexprs * sizeof(tBC_SSAExpr) );
+	if( !SSA->Src || !SSA->Mem || !SSA->Dst || !SSA->Arg || !SSA->Exprs )
+		return -1;
+	SSA->ExprMask = nexprs - 1;
+	for( int i = 0; i < nexprs; i ++ )
+		SSA->Exprs[i].VN = -1;
+	for( int i = 0; i < count; i ++ )
+	{
+		SSA->Src[i][0] = -1;
+		SSA->Src[i][1] = -1;
+		SSA->Mem[i] = -1;
+		SSA->Dst[i] = -1;
+		SSA->Arg[i] = -1;
+	}
+	return 0;
+}
+
+/**
+ * \brief Resolve register reads to values, numbering the values and removing recomputations
+ * \return Number of operations replaced by moves, -1 on error
+ *
+ * Blocks are visited in reverse post-order, so a block's immediate dominator (whose final
+ * register values it starts with, apart from phis) is always done first. An operation is
+ * replaced with a move when a register already holds a value with the same number, and a
+ * read of a copy is changed to read the original while its register still holds it.
+ */
+static int Bytecode_int_SSAWalk(tBC_SSA *SSA)
+{
+	const int	nregs = SSA->NRegs;
+	const int	width = nregs + 1;
+	const int	root = SSA->NBlocks;
+	 int	changes = 0;
+	 int	cur[width];
+	 int	clobbers[width];
+
+	void _escape_all(void) {
+		for( int r = 0; r < width; r ++ )
+			SSA->Values[cur[r]].Escapes = true;
+	}
+
+	for( int i = 0; i < SSA->NReached; i ++ )
+	{
+		const int	b = SSA->RPO[i];
+		const tBC_SSABlock	*blk = &SSA->Blocks[b];
+
+		// Starting values
+		if( blk->IDom == root )
+		{
+			for( int r = 0; r < width; r ++ )
+			{
+				if( (cur[r] = _NewValue(SSA, -1, b)) < 0 )
+					return -1;
+			}
+		}
+		else
+		{
+			memcpy(cur, &SSA->EndState[blk->IDom * width], sizeof(cur));
+			for( int r = 0; r < width; r ++ )
+			{
+				if( !SSA->HasPhi[b * width + r] )
+					continue ;
+				if( (cur[r] = _NewValue(SSA, -1, b)) < 0 )
+					return -1;
+				SSA->Values[cur[r]].IsPhi = true;
+				SSA->PhiValue[b * width + r] = cur[r];
+			}
+		}
+		// - Handler code can see any value held while its range runs
+		if( blk->IsCovered )
+			_escape_all();
+
+		for( int pos = blk->Start; pos < blk->End; pos ++ )
+		{
+			tBC_Op	*op = SSA->Ops[pos];
+			 int	r2, r3;
+			_SrcFields(op, &r2, &r3);
+			// - A move clears its source, a foreach's state is a register pair
+			if( op->Operation != BC_OP_MOV_MOVE && op->Operation != BC_OP_FOREACH_NEXT )
+			{
+				 int _original(int Reg) {
+					const tBC_SSAValue	*val = &SSA->Values[cur[Reg]];
+					if( val->CopyOf < 0 || val->CopyReg == Reg || cur[val->CopyReg] != val->CopyOf )
+						return Reg;
+					changes ++;
+					return val->CopyReg;
+				}
+				if( r2 >= 0 )
+					op->Content.RegInt.RegInt2 = r2 = _original(r2);
+				if( r3 >= 0 )
+					op->Content.RegInt.RegInt3 = r3 = _original(r3);
+			}
+			const int	v2 = (r2 >= 0 ? cur[r2] : -1);
+			const int	v3 = (r3 >= 0 ? cur[r3] : -1);
+			SSA->Src[pos][0] = v2;
+			SSA->Src[pos][1] = v3;
+			if( _ReadsMemory(op) )
+				SSA->Mem[pos] = cur[nregs];
+
+			// Count reads (each register once)
+			if( v2 >= 0 )
+				SSA->Values[v2].NUses ++;
+			if( v3 >= 0 && r3 != r2 )
+				SSA->Values[v3].NUses ++;
+			if( _DstIsSource(op) && op->DstReg != r2 && op->DstReg != r3 )
+				SSA->Values[cur[op->DstReg]].NUses ++;
+			// - The index is advanced, the value is left as it was at the end
+			if( op->Operation == BC_OP_FOREACH_NEXT ) {
+				SSA->Values[cur[r2 + 1]].NUses ++;
+				SSA->Values[cur[op->Content.RegInt.RegInt3]].NUses ++;
+			}
+			if( _IsCall(op) ) {
+				for( int j = 0; j < (op->Content.Function.ArgCount & BC_CALL_ARGCOUNT_MASK); j ++ )
+					SSA->Values[cur[op->Content.Function.ArgRegs[j]]].NUses ++;
+				if( (op->Content.Function.ArgCount & BC_CALL_ARGCOUNT_MASK) > 0 )
+					SSA->Arg[pos] = cur[op->Content.Function.ArgRegs[0]];
+			}
+
+			// Number the result
+			 int	vn = -1;
+			bool	commutative;
+			tBC_SSAExpr	key = {.Operation = op->Operation};
+			// - A proven index reads the same element
+			if( op->Operation == BC_OP_GETINDEX_INRANGE )
+				key.Operation = BC_OP_GETINDEX;
+			if( op->Operation == BC_OP_LOADINT ) {
+				key.Imm = op->Content.Integer;
+				vn = _LookupExpr(SSA, &key, SSA->NValues);
+			}
+			else if( op->Operation == BC_OP_LOADREAL ) {
+				memcpy(&key.Imm, &op->Content.Real, sizeof(key.Imm));
+				vn = _LookupExpr(SSA, &key, SSA->NValues);
+			}
+			else if( (op->Operation == BC_OP_MOV || op->Operation == BC_OP_MOV_MOVE) && r2 != op->DstReg ) {
+				vn = SSA->Values[v2].VN;
+			}
+			else if( _WritesDst(op) && _IsPureOp(op, &commutative) )
+			{
+				key.Args[0] = (v2 >= 0 ? SSA->Values[v2].VN : -1);
+				key.Args[1] = (v3 >= 0 ? SSA->Values[v3].VN : -1);
+				key.Args[2] = (SSA->Mem[pos] >= 0 ? SSA->Values[SSA->Mem[pos]].VN : -1);
+				if( op->Operation == BC_OP_GETELEMENT )
+					key.Imm = op->Content.RegInt.RegInt3;
+				else if( op->Operation == BC_OP_CAST )
+					key.Imm = op->Content.RegInt.RegInt2;
+				if( commutative && key.Args[0] > key.Args[1] ) {
+					 int	tmp = key.Args[0];
+					key.Args[0] = key.Args[1];
+					key.Args[1] = tmp;
+				}
+				vn = _LookupExpr(SSA, &key, SSA->NValues);
+
+				// Already in a register? (Then it was computed without an exception)
+				for( int r = 0; r < nregs && vn != SSA->NValues; r ++ )
+				{
+					if( SSA->Values[cur[r]].VN != vn )
+						continue ;
+					op->Operation = BC_OP_MOV;
+					op->Content.RegInt.RegInt2 = r;
+					op->Content.RegInt.RegInt3 = 0;
+					SSA->Values[cur[r]].NUses ++;
+					changes ++;
+					break;
+				}
+			}
+
+			// Writes
+			 int	n = _OpClobbers(SSA, op, clobbers);
+			for( int j = 0; j < n; j ++ )
+			{
+				if( (cur[clobbers[j]] = _NewValue(SSA, pos, b)) < 0 )
+					return -1;
+			}
+			if( _WritesDst(op) )
+			{
+				 int	val = _NewValue(SSA, pos, b);
+				if( val < 0 )
+					return -1;
+				if( vn >= 0 && !(op->Operation == BC_OP_MOV_MOVE && r2 == op->DstReg) )
+					SSA->Values[val].VN = vn;
+				// - Including moves made above
+				const int	src = op->Content.RegInt.RegInt2;
+				if( op->Operation == BC_OP_MOV && src != op->DstReg ) {
+					SSA->Values[val].CopyOf = cur[src];
+					SSA->Values[val].CopyReg = src;
+				}
+				cur[op->DstReg] = val;
+				SSA->Dst[pos] = val;
+			}
+			if( blk->IsCovered ) {
+				for( int j = 0; j < n; j ++ )
+					SSA->Values[cur[clobbers[j]]].Escapes = true;
+				if( SSA->Dst[pos] >= 0 )
+					SSA->Values[SSA->Dst[pos]].Escapes = true;
+			}
+		}
+
+		memcpy(&SSA->EndState[b * width], cur, sizeof(cur));
+	}
+
+	// Phi inputs, and values flowing into blocks that start with unknown values
+	for( int i = 0; i < SSA->NReached; i ++ )
+	{
+		const int	b = SSA->RPO[i];
+		const tBC_SSABlock	*blk = &SSA->Blocks[b];
+		for( int j = 0; j < blk->NPreds; j ++ )
+		{
+			const int	p = blk->Preds[j];
+			if( SSA->Blocks[p].Order < 0 || blk->IDom != root )
+				continue ;
+			for( int r = 0; r < width; r ++ )
+				SSA->Values[ SSA->EndState[p * width + r] ].Escapes = true;
+		}
+		if( blk->IDom == root )
+			continue ;
+		for( int r = 0; r < width; r ++ )
+		{
+			if( !SSA->HasPhi[b * width + r] )
+				continue ;
+			if( SSA->NPhiArgs + blk->NPreds > SSA->PhiArgSpace )
+			{
+				 int	space = (SSA->NPhiArgs + blk->NPreds) * 2;
+				void *tmp = realloc(SSA->PhiArgs, space * sizeof(int));
+				if( !tmp )	return -1;
+				SSA->PhiArgs = tmp;
+				SSA->PhiArgSpace = space;
+			}
+			const int	phi = SSA->PhiValue[b * width + r];
+			SSA->Values[phi].PhiArgs = SSA->NPhiArgs;
+			for( int j = 0; j < blk->NPreds; j ++ )
+			{
+				const int	p = blk->Preds[j];
+				 int	arg = -1;
+				if( SSA->Blocks[p].Order >= 0 ) {
+					arg = SSA->EndState[p * width + r];
+					SSA->Values[arg].NUses ++;
+				}
+				SSA->PhiArgs[SSA->NPhiArgs++] = arg;
+			}
+		}
+	}
+	return changes;
+}
+
+/**
+ * \brief Find integer values that are non-negative
+ *
+ * Starts by assuming every value is, and removes values until the rest are consistent
+ * (so loop counters work). Values from LOADINT must be below BC_SSA_BOUND, and an addition
+ * only adds a constant up to BC_SSA_MAXSTEP, so more than 2^45 additions would be needed to
+ * overflow.
+ */
+static void Bytecode_int_SSABounds(tBC_SSA *SSA)
+{
+	for( int v = 0; v < SSA->NValues; v ++ )
+		SSA->Values[v].IsBounded = true;
+
+	bool _small_const(int Value) {
+		tSpiderInteger	val;
+		return _GetConstInt(SSA, Value, &val) && 0 <= val && val <= BC_SSA_MAXSTEP;
+	}
+	bool _bounded(int Value) {
+		return Value >= 0 && SSA->Values[Value].IsBounded;
+	}
+	bool _check(int Value) {
+		const tBC_SSAValue	*val = &SSA->Values[Value];
+		if( val->IsPhi )
+		{
+			if( val->PhiArgs < 0 )
+				return false;
+			const tBC_SSABlock	*blk = &SSA->Blocks[val->Block];
+			for( int j = 0; j < blk->NPreds; j ++ )
+			{
+				 int	arg = SSA->PhiArgs[val->PhiArgs + j];
+				if( arg >= 0 && !_bounded(arg) )
+					return false;
+			}
+			return true;
+		}
+		if( val->Def < 0 || SSA->Dst[val->Def] != Value )
+			return false;
+		const tBC_Op	*op = SSA->Ops[val->Def];
+		const int	a = SSA->Src[val->Def][0], b = SSA->Src[val->Def][1];
+		tSpiderInteger	c;
+		switch(op->Operation)
+		{
+		case BC_OP_LOADINT:
+			return 0 <= op->Content.Integer && op->Content.Integer < BC_SSA_BOUND;
+		case BC_OP_MOV:
+		case BC_OP_MOV_MOVE:
+			return _bounded(a);
+		case BC_OP_INT_BITAND:
+			return _bounded(a) || _bounded(b);
+		case BC_OP_INT_BITSHIFTRIGHT:
+			return _bounded(a) && _GetConstInt(SSA, b, &c) && 0 <= c && c < 64;
+		case BC_OP_INT_MODULO:
+			return _bounded(a);
+		case BC_OP_INT_DIVIDE:
+			return _bounded(a) && _GetConstInt(SSA, b, &c) && c > 0;
+		case BC_OP_INT_ADD:
+			return (_bounded(a) && _small_const(b)) || (_bounded(b) && _small_const(a));
+		default:
+			return false;
+		}
+	}
+
+	for( bool changed = true; changed; )
+	{
+		changed = false;
+		for( int v = 0; v < SSA->NValues; v ++ )
+		{
+			if( SSA->Values[v].IsBounded && !_check(v) ) {
+				SSA->Values[v].IsBounded = false;
+				changed = true;
+			}
+		}
+	}
+}
+
+/**
+ * \brief Replace integer multiplication, division and modulo by powers of two with shifts/masks
+ * \note The constant's LOADINT is changed, so it must have no other reads. Division and
+ *       modulo round towards zero, so are only changed for non-negative dividends.
+ */
+static int Bytecode_int_SSAStrengthReduce(tBC_SSA *SSA)
+{
+	 int	changes = 0;
+	for( int pos = 0; pos < SSA->Count; pos ++ )
+	{
+		tBC_Op	*op = SSA->Ops[pos];
+		if( op->Operation != BC_OP_INT_MULTIPLY && op->Operation != BC_OP_INT_DIVIDE
+		 && op->Operation != BC_OP_INT_MODULO )
+			continue ;
+		 int	other = op->Content.RegInt.RegInt2;
+		 int	creg = op->Content.RegInt.RegInt3;
+		 int	cval = SSA->Src[pos][1];
+		tSpiderInteger	val;
+		if( op->Operation == BC_OP_INT_MULTIPLY && !_GetConstInt(SSA, cval, &val) ) {
+			other = op->Content.RegInt.RegInt3;
+			creg = op->Content.RegInt.RegInt2;
+			cval = SSA->Src[pos][0];
+		}
+		if( !_GetConstInt(SSA, cval, &val) || val <= 0 || (val & (val - 1)) != 0 || other == creg )
+			continue ;
+		if( op->Operation != BC_OP_INT_MULTIPLY && !SSA->Values[SSA->Src[pos][0]].IsBounded )
+			continue ;
+		 int	shift = __builtin_ctzll(val);
+
+		// Multiplying/dividing by one leaves the other operand
+		if( shift == 0 && op->Operation != BC_OP_INT_MODULO ) {
+			op->Operation = BC_OP_MOV;
+			op->Content.RegInt.RegInt2 = other;
+			op->Content.RegInt.RegInt3 = 0;
+			changes ++;
+			continue ;
+		}
+		const tBC_SSAValue	*c = &SSA->Values[cval];
+		if( c->NUses != 1 || c->Escapes )
+			continue ;
+		tBC_Op	*load = SSA->Ops[c->Def];
+		switch(op->Operation)
+		{
+		case BC_OP_INT_MULTIPLY:
+			op->Operation = BC_OP_INT_BITSHIFTLEFT;
+			load->Content.Integer = shift;
+			break;
+		case BC_OP_INT_DIVIDE:
+			op->Operation = BC_OP_INT_BITSHIFTRIGHT;
+			load->Content.Integer = shift;
+			break;
+		default:
+			op->Operation = BC_OP_INT_BITAND;
+			load->Content.Integer = val - 1;
+			break;
+		}
+		op->Content.RegInt.RegInt2 = other;
+		op->Content.RegInt.RegInt3 = creg;
+		changes ++;
+	}
+	return changes;
+}
+
+/**
+ * \brief Mark array accesses whose index is proven to be in range
+ *
+ * The index must be non-negative, and below the array's length on every path to the access
+ * (see _EdgeFacts), either directly or through a bound that is no larger than the length.
+ * This covers foreach loops and `for( i = 0; i < len(a); i ++ )`, and loops given a range
+ * check by Bytecode_int_SSAVersion.
+ */
+static int Bytecode_int_SSARanges(tBC_SSA *SSA)
+{
+	 int	changes = 0;
+	tBC_SSAFact	facts[BC_SSA_MAXFACTS];
+	for( int pos = 0; pos < SSA->Count; pos ++ )
+	{
+		tBC_Op	*op = SSA->Ops[pos];
+		if( op->Operation != BC_OP_GETINDEX && op->Operation != BC_OP_SETINDEX )
+			continue ;
+		const int	array = SSA->Src[pos][0], index = SSA->Src[pos][1];
+		if( array < 0 || index < 0 || !_NonNegative(SSA, index) )
+			continue ;
+		 int	nfacts = _EdgeFacts(SSA, SSA->BlockOf[pos], facts);
+		if( _BelowLength(SSA, facts, nfacts, index, array) < 0 )
+			continue ;
+		op->Operation = (op->Operation == BC_OP_GETINDEX ? BC_OP_GETINDEX_INRANGE : BC_OP_SETINDEX_INRANGE);
+		changes ++;
+	}
+	return changes;
+}
+
+/**
+ * \brief Find natural loops
+ * \param InLoop	Set for the blocks of the loop headed by each block ([header * NBlocks + block])
+ * \param Size	Number of blocks in each loop, 0 if the block isn't a loop header
+ */
+static int Bytecode_int_SSALoops(const tBC_SSA *SSA, bool *InLoop, int *Size)
+{
+	const int	nblocks = SSA->NBlocks;
+	 int	*stack = malloc( nblocks * sizeof(int) );
+	if( !stack )
+		return -1;
+	for( int h = 0; h < nblocks; h ++ )
+	{
+		bool	*body = &InLoop[h * nblocks];
+		 int	sp = 0;
+		Size[h] = 0;
+		if( SSA->Blocks[h].Order < 0 )
+			continue ;
+		for( int j = 0; j < SSA->Blocks[h].NPreds; j ++ )
+		{
+			 int	latch = SSA->Blocks[h].Preds[j];
+			if( SSA->Blocks[latch].Order < 0 || !_Dominates(SSA, h, latch) )
+				continue ;
+			if( !body[h] ) {
+				body[h] = true;
+				Size[h] ++;
+			}
+			if( !body[latch] ) {
+				body[latch] = true;
+				Size[h] ++;
+				stack[sp++] = latch;
+			}
+		}
+		while( sp > 0 )
+		{
+			const tBC_SSABlock	*blk = &SSA->Blocks[ stack[--sp] ];
+			for( int j = 0; j < blk->NPreds; j ++ )
+			{
+				 int	p = blk->Preds[j];
+				if( SSA->Blocks[p].Order < 0 || body[p] )
+					continue ;
+				body[p] = true;
+				Size[h] ++;
+				stack[sp++] = p;
+			}
+		}
+	}
+	free(stack);
+	return 0;
+}
+
+/**
+ * \brief Move loop-invariant computations into a preheader before each loop
+ *
+ * The result goes in a new register, the operation in the loop becomes a move from it, and
+ * reads of the result in the loop are changed to read the new register (so the move is
+ * usually removed later). Constants used by hoisted operations are loaded again in the
+ * preheader. Operations that can raise an exception are only hoisted from the start of the
+ * loop's header, which always runs when the loop is entered.
+ *
+ * Loops are done innermost first, skipping any that overlap a loop already changed.
+ */
+static int Bytecode_int_SSAHoist(tBC_SSA *SSA)
+{
+	tBC_Function	*fcn = SSA->Fcn;
+	const int	nblocks = SSA->NBlocks;
+	const int	root = nblocks;
+	 int	changes = 0;
+	 int	nnew = 0;
+
+	// Find loop headers and their sizes
+	 int	loop_size[nblocks];
+	bool	*in_loop = calloc( (size_t)nblocks * nblocks, sizeof(bool) );
+	bool	*changed_blocks = calloc( nblocks, sizeof(bool) );
+	 int	*hoisted_reg = malloc( SSA->NValues * sizeof(int) );
+	if( !in_loop || !changed_blocks || !hoisted_reg || Bytecode_int_SSALoops(SSA, in_loop, loop_size) ) {
+		free(in_loop);
+		free(changed_blocks);
+		free(hoisted_reg);
+		return -1;
+	}
+
+	 int	done[nblocks];
+	 int	ndone = 0;
+	 int	ins_pos[nblocks], ins_count[nblocks];	// Earlier preheaders, for Lines/Vars
+	 int	nins = 0;
+	for( ;; )
+	{
+		// Smallest loop not yet looked at
+		 int	h = -1;
+		for( int i = 0; i < nblocks; i ++ )
+		{
+			bool	seen = false;
+			for( int j = 0; j < ndone; j ++ )
+				seen |= (done[j] == i);
+			if( loop_size[i] == 0 || seen )
+				continue ;
+			if( h == -1 || loop_size[i] < loop_size[h] )
+				h = i;
+		}
+		if( h == -1 )
+			break;
+		done[ndone++] = h;
+		const bool	*body = &in_loop[h * nblocks];
+		const tBC_SSABlock	*hdr = &SSA->Blocks[h];
+
+		// Preheader goes before the header's first operation, it must not be in the loop
+		bool	ok = !hdr->IsHandler && hdr->IDom != root;
+		if( hdr->Start > 0 && body[ SSA->BlockOf[hdr->Start - 1] ] )
+			ok = false;
+		for( int b = 0; b < nblocks && ok; b ++ )
+		{
+			if( !body[b] )
+				continue ;
+			if( changed_blocks[b] )
+				ok = false;
+			// - Window calls overwrite the new registers
+			for( int pos = SSA->Blocks[b].Start; pos < SSA->Blocks[b].End && ok; pos ++ )
+			{
+				if( _IsWindowCall(SSA->Ops[pos]) )
+					ok = false;
+			}
+		}
+		if( !ok )
+			continue ;
+
+		for( int v = 0; v < SSA->NValues; v ++ )
+			hoisted_reg[v] = -1;
+		tBC_Op	*first = NULL, *last = NULL;
+		 int	ninserted = 0;
+		void _insert(tBC_Op *Op) {
+			Op->Next = NULL;
+			if( last )
+				last->Next = Op;
+			else
+				first = Op;
+			last = Op;
+			ninserted ++;
+		}
+		// - Constants used by hoisted operations, loaded once per preheader
+		struct {
+			 int	Operation;
+			uint64_t	Bits;
+			 int	Reg;
+		}	consts[BC_SSA_MAXHOIST];
+		 int	nconsts = 0;
+		 int _const_reg(int Value) {
+			const tBC_Op	*load = SSA->Ops[ SSA->Values[Value].Def ];
+			uint64_t	bits;
+			if( load->Operation == BC_OP_LOADINT )
+				bits = load->Content.Integer;
+			else
+				memcpy(&bits, &load->Content.Real, sizeof(bits));
+			for( int i = 0; i < nconsts; i ++ )
+			{
+				if( consts[i].Operation == load->Operation && consts[i].Bits == bits )
+					return consts[i].Reg;
+			}
+			tBC_Op	*copy = malloc(sizeof(tBC_Op));
+			if( !copy )	return -1;
+			*copy = *load;
+			copy->CacheEnt = NULL;
+			copy->DstReg = SSA->NRegs + nnew++;
+			_insert(copy);
+			consts[nconsts].Operation = load->Operation;
+			consts[nconsts].Bits = bits;
+			consts[nconsts].Reg = copy->DstReg;
+			nconsts ++;
+			return copy->DstReg;
+		}
+
+		bool	header_clear = true;	// Only hoisted/harmless operations so far in the header
+		 int	loop_changes = 0;
+		for( int i = 0; i < SSA->NReached; i ++ )
+		{
+			const int	b = SSA->RPO[i];
+			if( !body[b] )
+				continue ;
+			for( int pos = SSA->Blocks[b].Start; pos < SSA->Blocks[b].End; pos ++ )
+			{
+				tBC_Op	*op = SSA->Ops[pos];
+				bool	commutative;
+				bool	can = _WritesDst(op) && _IsPureOp(op, &commutative) && SSA->Dst[pos] >= 0;
+				if( can && _CanThrow(SSA, op, SSA->Src[pos][1]) && !(b == h && header_clear) )
+					can = false;
+				 int	nconst = 0;
+				const int	srcs[3] = {SSA->Src[pos][0], SSA->Src[pos][1], SSA->Mem[pos]};
+				for( int j = 0; j < 3 && can; j ++ )
+				{
+					const int	v = srcs[j];
+					if( v < 0 || hoisted_reg[v] >= 0 || !body[ SSA->Values[v].Block ] )
+						continue ;
+					if( j < 2 && _IsConst(SSA, v) )
+						nconst ++;
+					else
+						can = false;
+				}
+				if( can && nnew + nconst + 1 > BC_SSA_MAXHOIST )
+					can = false;
+				if( !can ) {
+					bool	harmless = (op->Operation == BC_OP_LOADINT || op->Operation == BC_OP_LOADREAL
+						|| op->Operation == BC_OP_MOV || op->Operation == BC_OP_NOP
+						|| (_IsPureOp(op, &commutative) && !_CanThrow(SSA, op, SSA->Src[pos][1])));
+					if( b == h && !harmless )
+						header_clear = false;
+					continue ;
+				}
+
+				// Copy into the preheader
+				tBC_Op	*copy = malloc(sizeof(tBC_Op));
+				if( !copy )	goto _err;
+				*copy = *op;
+				copy->CacheEnt = NULL;
+				// - The index was proven where the loop checks it, not before the loop
+				if( copy->Operation == BC_OP_GETINDEX_INRANGE )
+					copy->Operation = BC_OP_GETINDEX;
+				 int	r2, r3;
+				_SrcFields(op, &r2, &r3);
+				for( int j = 0; j < 2; j ++ )
+				{
+					const int	v = srcs[j];
+					 int	reg;
+					if( v < 0 )
+						continue ;
+					if( hoisted_reg[v] >= 0 )
+						reg = hoisted_reg[v];
+					else if( body[ SSA->Values[v].Block ] ) {
+						if( (reg = _const_reg(v)) < 0 ) {
+							free(copy);
+							goto _err;
+						}
+					}
+					else
+						continue ;
+					if( j == 0 )
+						copy->Content.RegInt.RegInt2 = reg;
+					else
+						copy->Content.RegInt.RegInt3 = reg;
+				}
+				copy->DstReg = SSA->NRegs + nnew++;
+				_insert(copy);
+				hoisted_reg[ SSA->Dst[pos] ] = copy->DstReg;
+
+				op->Operation = BC_OP_MOV;
+				op->Content.RegInt.RegInt2 = copy->DstReg;
+				op->Content.RegInt.RegInt3 = 0;
+				SSA->Src[pos][0] = -1;
+				SSA->Src[pos][1] = -1;
+				loop_changes ++;
+			}
+		}
+		// - Constants are only loaded for hoisted operations, so nothing was added
+		if( loop_changes == 0 )
+			continue ;
+
+		// Read hoisted results from their new registers
+		for( int b = 0; b < nblocks; b ++ )
+		{
+			if( !body[b] )
+				continue ;
+			for( int pos = SSA->Blocks[b].Start; pos < SSA->Blocks[b].End; pos ++ )
+			{
+				tBC_Op	*op = SSA->Ops[pos];
+				for( int j = 0; j < 2; j ++ )
+				{
+					const int	v = SSA->Src[pos][j];
+					if( v < 0 || hoisted_reg[v] < 0 )
+						continue ;
+					// - The new register must not be cleared
+					if( op->Operation == BC_OP_MOV_MOVE )
+						op->Operation = BC_OP_MOV;
+					if( j == 0 )
+						op->Content.RegInt.RegInt2 = hoisted_reg[v];
+					else
+						op->Content.RegInt.RegInt3 = hoisted_reg[v];
+				}
+			}
+		}
+
+		// Link in the preheader, jumps from inside the loop skip it
+		tBC_Op	*prev = (hdr->Start > 0 ? SSA->Ops[hdr->Start - 1] : (void*)&fcn->Operations);
+		last->Next = prev->Next;
+		prev->Next = first;
+		fcn->OperationCount += ninserted;
+		 int	label = Bytecode_AllocateLabel(fcn);
+		if( label < 0 )
+			goto _err;
+		fcn->Labels[label] = last;
+		for( int b = 0; b < nblocks; b ++ )
+		{
+			const tBC_Op	*end = SSA->Ops[ SSA->Blocks[b].End - 1 ];
+			if( body[b] && _IsJump(end) && SSA->LabelPos[end->DstReg] == hdr->Start )
+				SSA->Ops[ SSA->Blocks[b].End - 1 ]->DstReg = label;
+		}
+
+		// Positions after the header move (the header's own position is now the preheader)
+		 int	start = hdr->Start;
+		for( int i = 0; i < nins; i ++ )
+		{
+			if( ins_pos[i] < hdr->Start )
+				start += ins_count[i];
+		}
+		for( int i = 0; i < fcn->LineCount; i ++ )
+		{
+			if( fcn->Lines[i].PC > start )
+				fcn->Lines[i].PC += ninserted;
+		}
+		for( int i = 0; i < fcn->VarCount; i ++ )
+		{
+			if( fcn->Vars[i].PC > start )
+				fcn->Vars[i].PC += ninserted;
+		}
+		ins_pos[nins] = hdr->Start;
+		ins_count[nins] = ninserted;
+		nins ++;
+
+		for( int b = 0; b < nblocks; b ++ )
+			changed_blocks[b] |= body[b];
+		changes += loop_changes;
+	}
+	fcn->MaxRegisters += nnew;
+
+	free(in_loop);
+	free(changed_blocks);
+	free(hoisted_reg);
+	return changes;
+_err:
+	fcn->MaxRegisters += nnew;
+	free(in_loop);
+	free(changed_blocks);
+	free(hoisted_reg);
+	return -1;
+}
+
+/**
+ * \brief Check that a value is never an unassigned register (which len() can't be called on)
+ */
+static bool _HasValue(const tBC_SSA *SSA, int Value)
+{
+	Value = _Original(SSA, Value);
+	const tBC_SSAValue	*val = &SSA->Values[Value];
+	if( val->Def >= 0 )
+		return SSA->Ops[val->Def]->Operation == BC_OP_CREATEARRAY;
+	// - The entry block is walked first, its starting values are made in register order
+	return !val->IsPhi && val->Block == 0 && SSA->Blocks[0].NPreds == 0
+		&& Value < SSA->Fcn->ArgumentCount;
+}
+
+/**
+ * \brief Copy an operation (including call arguments and strings)
+ */
+static tBC_Op *_CopyOp(const tBC_Op *Op)
+{
+	size_t	extra = 0;
+	if( _IsCall(Op) )
+		extra = (Op->Content.Function.ArgCount & BC_CALL_ARGCOUNT_MASK) * sizeof(int);
+	else if( caOpEncodingTypes[Op->Operation] == BC_OPENC_STRING )
+		extra = Op->Content.String.Length + 1;
+	tBC_Op	*ret = malloc(sizeof(tBC_Op) + extra);
+	if( !ret )	return NULL;
+	memcpy(ret, Op, sizeof(tBC_Op) + extra);
+	ret->Next = NULL;
+	ret->CacheEnt = NULL;
+	return ret;
+}
+
+/**
+ * \brief Copy a loop whose array accesses are bounded by a loop-invariant value, behind a
+ *        range check made before the loop
+ *
+ * For `for( i = 0; i < n; i ++ ) a[i]` the check is `n <= len(a)`: when it holds the copy
+ * runs, with the accesses it covers marked as proven, otherwise the original loop runs (so an
+ * out of range index raises its exception where it did before). Bytecode_int_SSARanges finds
+ * the same proof from the check when the code is loaded again.
+ *
+ * One loop is copied per call, innermost first. It must be made of consecutive blocks, no
+ * larger than BC_SSA_MAXVERSION operations, and outside any handler range.
+ */
+static int Bytecode_int_SSAVersion(tBC_SSA *SSA)
+{
+	tBC_Function	*fcn = SSA->Fcn;
+	const int	nblocks = SSA->NBlocks;
+	const int	root = nblocks;
+
+	// The check calls the exported len(), unless a script function hides it
+	void	*ident;
+	const int	len_id = SpiderScript_ResolveFunction(fcn->Script, NULL, "len", &ident);
+	if( len_id == -1 || (len_id >> 16) != 1 )
+		return 0;
+
+	 int	loop_size[nblocks];
+	bool	*in_loop = calloc( (size_t)nblocks * nblocks, sizeof(bool) );
+	if( !in_loop || Bytecode_int_SSALoops(SSA, in_loop, loop_size) ) {
+		free(in_loop);
+		return -1;
+	}
+
+	tBC_SSAFact	facts[BC_SSA_MAXFACTS];
+	bool	tried[nblocks];
+	memset(tried, 0, sizeof(tried));
+	for( ;; )
+	{
+		// Smallest loop not yet looked at
+		 int	h = -1;
+		for( int i = 0; i < nblocks; i ++ )
+		{
+			if( loop_size[i] > 0 && !tried[i] && (h == -1 || loop_size[i] < loop_size[h]) )
+				h = i;
+		}
+		if( h == -1 )
+			break;
+		tried[h] = true;
+		const bool	*body = &in_loop[h * nblocks];
+		const tBC_SSABlock	*hdr = &SSA->Blocks[h];
+
+		// Blocks from the header on, entered from before the header
+		bool	ok = h + loop_size[h] <= nblocks && !hdr->IsHandler && hdr->IDom != root
+			&& hdr->Start > 0 && !body[ SSA->BlockOf[hdr->Start - 1] ];
+		for( int b = h; ok && b < h + loop_size[h]; b ++ )
+			ok = body[b] && !SSA->Blocks[b].IsHandler && !SSA->Blocks[b].IsCovered;
+		if( !ok )
+			continue ;
+		const int	start = hdr->Start;
+		const int	end = SSA->Blocks[h + loop_size[h] - 1].End;
+		if( end - start > BC_SSA_MAXVERSION )
+			continue ;
+
+		// An access with a non-negative index, checked in the loop against a value set before it
+		 int	array = -1, bound = -1;
+		 int	array_reg = -1, bound_reg = -1;
+		tSpiderInteger	bound_const = 0;
+		for( int pos = start; pos < end && array == -1; pos ++ )
+		{
+			const tBC_Op	*op = SSA->Ops[pos];
+			if( op->Operation != BC_OP_GETINDEX && op->Operation != BC_OP_SETINDEX )
+				continue ;
+			const int	a = SSA->Src[pos][0], idx = SSA->Src[pos][1];
+			if( a < 0 || idx < 0 || body[ SSA->Values[a].Block ] || !_HasValue(SSA, a) || !_NonNegative(SSA, idx) )
+				continue ;
+			 int	nfacts = _EdgeFacts(SSA, SSA->BlockOf[pos], facts);
+			for( int f = 0; f < nfacts; f ++ )
+			{
+				const tBC_SSAFact	*fact = &facts[f];
+				if( !fact->Strict || !_SameValue(SSA, fact->Lo, idx) || !body[ SSA->BlockOf[fact->Cmp] ] )
+					continue ;
+				// - A foreach's bound is already checked on each iteration
+				if( SSA->Ops[fact->Cmp]->Operation == BC_OP_FOREACH_NEXT )
+					continue ;
+				// - The register read by the loop's comparison holds the bound before the loop
+				if( !body[ SSA->Values[fact->Hi].Block ] )
+					bound_reg = (SSA->Src[fact->Cmp][0] == fact->Hi
+						? SSA->Ops[fact->Cmp]->Content.RegInt.RegInt2 : SSA->Ops[fact->Cmp]->Content.RegInt.RegInt3);
+				else if( !_GetConstInt(SSA, fact->Hi, &bound_const) )
+					continue ;
+				array = a;
+				array_reg = op->Content.RegInt.RegInt2;
+				bound = fact->Hi;
+				break;
+			}
+		}
+		if( array == -1 )
+			continue ;
+
+		// Already behind a check (as either copy)?
+		 int	nfacts = _EdgeFacts(SSA, h, facts);
+		for( int f = 0; f < nfacts && ok; f ++ )
+		{
+			if( (_SameValue(SSA, facts[f].Lo, bound) && _IsLength(SSA, facts[f].Hi, array))
+			 || (_SameValue(SSA, facts[f].Hi, bound) && _IsLength(SSA, facts[f].Lo, array)) )
+				ok = false;
+		}
+		if( !ok )
+			continue ;
+
+		// Accesses in the copy that the check proves
+		bool	proven[end - start];
+		for( int pos = start; pos < end; pos ++ )
+		{
+			const tBC_Op	*op = SSA->Ops[pos];
+			proven[pos - start] = false;
+			if( op->Operation != BC_OP_GETINDEX && op->Operation != BC_OP_SETINDEX )
+				continue ;
+			const int	a = SSA->Src[pos][0], idx = SSA->Src[pos][1];
+			if( a < 0 || idx < 0 || !_SameValue(SSA, a, array) || !_NonNegative(SSA, idx) )
+				continue ;
+			nfacts = _EdgeFacts(SSA, SSA->BlockOf[pos], facts);
+			for( int f = 0; f < nfacts; f ++ )
+			{
+				if( facts[f].Strict && _SameValue(SSA, facts[f].Lo, idx) && _SameValue(SSA, facts[f].Hi, bound) )
+					proven[pos - start] = true;
+			}
+		}
+
+		// Check, in two new registers: if( bound > len(array) ) goto original
+		const int	treg = SSA->NRegs;
+		tBC_Op	*first = NULL, *last = NULL;
+		 int	ninserted = 0;
+		tBC_Op *_insert(tBC_Op *Op) {
+			if( !Op )
+				return NULL;
+			Op->Next = NULL;
+			if( last )
+				last->Next = Op;
+			else
+				first = Op;
+			last = Op;
+			ninserted ++;
+			return Op;
+		}
+		tBC_Op *_new(enum eBC_Ops Operation, int Dst, int R2, int R3) {
+			tBC_Op	*op = calloc(1, sizeof(tBC_Op));
+			if( !op )
+				return NULL;
+			op->Operation = Operation;
+			op->DstReg = Dst;
+			op->Content.RegInt.RegInt2 = R2;
+			op->Content.RegInt.RegInt3 = R3;
+			return _insert(op);
+		}
+		bool	failed = !_new(BC_OP_MOV, treg, array_reg, 0);
+		tBC_Op	*call = calloc(1, sizeof(tBC_Op) + sizeof(int));
+		if( call ) {
+			call->Operation = BC_OP_CALLFUNCTION;
+			call->DstReg = treg + 1;
+			call->Content.Function.ID = len_id;
+			call->Content.Function.ArgCount = 1;
+			call->Content.Function.ArgRegs[0] = treg;
+		}
+		failed |= !_insert(call);
+		if( bound_reg == -1 ) {
+			tBC_Op	*load = _new(BC_OP_LOADINT, treg, 0, 0);
+			if( load )
+				load->Content.Integer = bound_const;
+			failed |= !load;
+			bound_reg = treg;
+		}
+		else
+			failed |= !_new(BC_OP_CLEARREG, treg, 0, 0);
+		failed |= !_new(BC_OP_INT_GREATERTHAN, treg + 1, bound_reg, treg + 1);
+		tBC_Op	*check = _new(BC_OP_JUMPIF, -1, treg + 1, 0);
+		failed |= !check;
+		const int	ncheck = ninserted;
+
+		// The copy, jumps within the loop go to the copy's labels
+		tBC_Op	*copies[end - start];
+		 int	labels[end - start];
+		for( int pos = start; pos < end && !failed; pos ++ )
+		{
+			tBC_Op	*copy = _insert( _CopyOp(SSA->Ops[pos]) );
+			if( !copy ) {
+				failed = true;
+				break;
+			}
+			if( proven[pos - start] )
+				copy->Operation = (copy->Operation == BC_OP_GETINDEX ? BC_OP_GETINDEX_INRANGE : BC_OP_SETINDEX_INRANGE);
+			copies[pos - start] = copy;
+			labels[pos - start] = -1;
+		}
+		if( !failed && SSA->Ops[end-1]->Operation != BC_OP_JUMP && SSA->Ops[end-1]->Operation != BC_OP_RETURN )
+		{
+			// - Falls out of the end, jump over the original
+			 int	label = Bytecode_AllocateLabel(fcn);
+			failed = (label < 0 || !_new(BC_OP_JUMP, label, 0, 0));
+			if( !failed )
+				fcn->Labels[label] = SSA->Ops[end-1];
+		}
+		for( int pos = start; pos < end && !failed; pos ++ )
+		{
+			tBC_Op	*copy = copies[pos - start];
+			if( !_IsJump(copy) )
+				continue ;
+			const int	target = SSA->LabelPos[copy->DstReg];
+			if( target < start || target >= end )
+				continue ;
+			if( labels[target - start] == -1 )
+			{
+				 int	label = Bytecode_AllocateLabel(fcn);
+				if( label < 0 ) {
+					failed = true;
+					break;
+				}
+				fcn->Labels[label] = (target == start ? check : copies[target - start - 1]);
+				labels[target - start] = label;
+			}
+			copy->DstReg = labels[target - start];
+		}
+		 int	original = (failed ? -1 : Bytecode_AllocateLabel(fcn));
+		if( original < 0 ) {
+			while( first ) {
+				tBC_Op	*next = first->Next;
+				free(first);
+				first = next;
+			}
+			free(in_loop);
+			return -1;
+		}
+
+		// Link in before the original, its jumps to the header skip the check and the copy
+		fcn->Labels[original] = last;
+		check->DstReg = original;
+		for( int pos = start; pos < end; pos ++ )
+		{
+			tBC_Op	*op = SSA->Ops[pos];
+			if( _IsJump(op) && SSA->LabelPos[op->DstReg] == start )
+				op->DstReg = original;
+		}
+		tBC_Op	*prev = SSA->Ops[start - 1];
+		last->Next = prev->Next;
+		prev->Next = first;
+		fcn->OperationCount += ninserted;
+		fcn->MaxRegisters += 2;
+
+		// Positions: the copy gets the loop's lines and names, the original moves along
+		 int	nlines = 0, nvars = 0;
+		for( int i = 0; i < fcn->LineCount; i ++ )
+			nlines += (start < fcn->Lines[i].PC && fcn->Lines[i].PC < end);
+		for( int i = 0; i < fcn->VarCount; i ++ )
+			nvars += (start < fcn->Vars[i].PC && fcn->Vars[i].PC < end);
+		const int	line_space = fcn->LineCount + nlines + 1;
+		const int	var_space = fcn->VarCount + nvars;
+		tBC_LineEnt	*lines = malloc( line_space * sizeof(tBC_LineEnt) );
+		tBC_VarEnt	*vars = malloc( (var_space + 1) * sizeof(tBC_VarEnt) );
+		if( !lines || !vars ) {
+			free(lines);
+			free(vars);
+			free(in_loop);
+			return -1;
+		}
+		 int	n = 0, active = -1;
+		for( int i = 0; i < fcn->LineCount && fcn->Lines[i].PC <= start; i ++ )
+		{
+			lines[n++] = fcn->Lines[i];
+			active = i;
+		}
+		for( int i = 0; i < fcn->LineCount; i ++ )
+		{
+			if( start < fcn->Lines[i].PC && fcn->Lines[i].PC < end ) {
+				lines[n] = fcn->Lines[i];
+				lines[n++].PC += ncheck;
+				((int*)fcn->Lines[i].File)[-1] ++;
+			}
+		}
+		if( nlines > 0 && active >= 0 ) {
+			lines[n] = fcn->Lines[active];
+			lines[n++].PC = start + ninserted;
+			((int*)fcn->Lines[active].File)[-1] ++;
+		}
+		for( int i = 0; i < fcn->LineCount; i ++ )
+		{
+			if( fcn->Lines[i].PC > start ) {
+				lines[n] = fcn->Lines[i];
+				lines[n++].PC += ninserted;
+			}
+		}
+		free(fcn->Lines);
+		fcn->Lines = lines;
+		fcn->LineCount = n;
+		fcn->LineSpace = line_space;
+
+		n = 0;
+		for( int i = 0; i < fcn->VarCount && fcn->Vars[i].PC <= start; i ++ )
+			vars[n++] = fcn->Vars[i];
+		for( int i = 0; i < fcn->VarCount; i ++ )
+		{
+			if( start < fcn->Vars[i].PC && fcn->Vars[i].PC < end ) {
+				vars[n] = fcn->Vars[i];
+				vars[n].PC += ncheck;
+				vars[n++].Name = strdup(fcn->Vars[i].Name);
+			}
+		}
+		for( int i = 0; i < fcn->VarCount; i ++ )
+		{
+			if( fcn->Vars[i].PC > start ) {
+				vars[n] = fcn->Vars[i];
+				vars[n++].PC += ninserted;
+			}
+		}
+		free(fcn->Vars);
+		fcn->Vars = vars;
+		fcn->VarCount = n;
+		fcn->VarSpace = var_space + 1;
+
+		free(in_loop);
+		return 1;
+	}
+	free(in_loop);
+	return 0;
+}
+
+static void Bytecode_int_SSAFree(tBC_SSA *SSA)
+{
+	if( SSA->Blocks ) {
+		for( int b = 0; b < SSA->NBlocks; b ++ )
+			free(SSA->Blocks[b].Frontier);
+	}
+	free(SSA->Ops);
+	free(SSA->LabelPos);
+	free(SSA->BlockOf);
+	free(SSA->Blocks);
+	free(SSA->PredBuf);
+	free(SSA->RPO);
+	free(SSA->HasPhi);
+	free(SSA->EndState);
+	free(SSA->PhiValue);
+	free(SSA->Values);
+	free(SSA->PhiArgs);
+	free(SSA->Src);
+	free(SSA->Mem);
+	free(SSA->Dst);
+	free(SSA->Arg);
+	free(SSA->Exprs);
+}
@@ -0,0 +1,473 @@
+/*
+ * SpiderScript Library
+ * by John Hodge (thePowersGang)
+ *
+ * bytecode_tier.c
+ * - Re-optimisation of hot functions
+ *
+ * Functions are committed with only the cheap passes (superinstructions and inline caches).
+ * Once a function has been called or looped often enough (see exec_bytecode.c), its operation
+ * list is flattened again and put through the passes that aren't worth running on every
+ * function at load: small numeric functions are inlined into it and temporaries are coalesced
+ * into the registers they are moved to. The new code is verified and linked like the
+ * original, and is installed by the next call made while no frame is running the old code.
+ */
+#define DEBUG	0
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "common.h"
+#include "bytecode.h"
+
+// === PROTOTYPES ===
+ int	Bytecode_int_TierUp(tSpiderScript *Script, tScript_Function *Fcn, int MaxRegisters);
+void	Bytecode_int_InstallTier(tBC_Function *Fcn);
+void	Bytecode_int_FreeTier(tBC_Function *Code);
+tBC_Function	*Bytecode_int_CloneCode(const tBC_Function *Fcn);
+static tScript_Function	*Bytecode_int_InlineCallee(tSpiderScript *Script, tScript_Function *Fcn, const tBC_Insn *Insn, const int *Regs);
+static int	Bytecode_int_CanInline(tSpiderScript *Script, tScript_Function *Callee, tBC_Function *Code);
+static int	Bytecode_int_InlineCalls(tSpiderScript *Script, tScript_Function *Fcn, tBC_Function *Code, int MaxRegisters);
+static void	Bytecode_int_CoalesceRegisters(tBC_Function *Code);
+
+// === CODE ===
+/**
+ * \brief Flatten a function's operations into a separate copy of its code
+ * \note The operations, line and handler tables are shared with \a Fcn, see Bytecode_int_FreeTier
+ */
+tBC_Function *Bytecode_int_CloneCode(const tBC_Function *Fcn)
+{
+	tBC_Function	*ret = calloc(1, sizeof(tBC_Function));
+	if( !ret )	return NULL;
+	ret->Script = Fcn->Script;
+	// Labels are copied, a label at the start of the function points into the function
+	ret->LabelCount = Fcn->LabelCount;
+	ret->Labels = malloc( Fcn->LabelCount * sizeof(Fcn->Labels[0]) );
+	if( !ret->Labels && Fcn->LabelCount ) {
+		free(ret);
+		return NULL;
+	}
+	for( int i = 0; i < Fcn->LabelCount; i ++ )
+	{
+		if( Fcn->Labels[i] == (void*)&Fcn->Operations )
+			ret->Labels[i] = (void*)&ret->Operations;
+		else
+			ret->Labels[i] = Fcn->Labels[i];
+	}
+	ret->MaxGlobalCount = Fcn->MaxGlobalCount;
+	ret->MaxRegisters = Fcn->MaxRegisters;
+	ret->ArgumentCount = Fcn->ArgumentCount;
+	ret->Operations = Fcn->Operations;
+	ret->LineCount = Fcn->LineCount;
+	ret->Lines = Fcn->Lines;
+	ret->HandlerCount = Fcn->HandlerCount;
+	ret->Handlers = Fcn->Handlers;
+	ret->ReturnTypeId = Fcn->ReturnTypeId;
+	if( Bytecode_int_FlattenFunction(ret) ) {
+		free(ret->Labels);
+		free(ret);
+		return NULL;
+	}
+	return ret;
+}
+
+/**
+ * \brief Free code built by Bytecode_int_CloneCode
+ */
+void Bytecode_int_FreeTier(tBC_Function *Code)
+{
+	if( !Code )	return ;
+	free(Code->Instructions);
+	free(Code->InsnLines);
+	free(Code->InsnHandlers);
+	free(Code->InlineCaches);
+	free(Code->JitCode);
+	free(Code->Labels);
+	free(Code);
+}
+
+/**
+ * \brief Get the script function called by an instruction, if it can be inlined there
+ * \param Regs	Register types on entry to the instruction
+ */
+static tScript_Function *Bytecode_int_InlineCallee(tSpiderScript *Script, tScript_Function *Fcn, const tBC_Insn *Insn, const int *Regs)
+{
+	if( Insn->Operation != BC_OP_CALLFUNCTION )
+		return NULL;
+	const tBC_Op	*op = Insn->Content.Op;
+	 int	id = op->Content.Function.ID;
+	if( (id >> 16) != 0 || id >= Script->nFunctions )
+		return NULL;
+	tScript_Function	*callee = Script->FunctionTable[id];
+	if( !callee || callee == Fcn || !callee->BCFcn || !callee->BCFcn->IsVerified )
+		return NULL;
+	// - Fusion only shrinks code, so the committed size is a lower bound
+	if( callee->BCFcn->InstructionCount > BC_TIER_INLINE_SIZE )
+		return NULL;
+	// - Also rejects variable argument pass-through (argument windows don't matter, the call goes)
+	if( (op->Content.Function.ArgCount & (BC_CALL_ARGCOUNT_MASK|BC_CALL_VARGS_PASSTHROUGH)) != callee->ArgumentCount )
+		return NULL;
+	// Argument types must be proven, as the callee's entry checks are skipped
+	for( int i = 0; i < callee->ArgumentCount; i ++ )
+	{
+		if( Regs[ op->Content.Function.ArgRegs[i] ] != Bytecode_int_GetTypeIdx(Script, callee->Arguments[i].Type) )
+			return NULL;
+	}
+	return callee;
+}
+
+/**
+ * \brief Check that a function only computes on numbers, so its body can replace a call
+ * \param Code	Unfused copy of the callee's code
+ */
+static int Bytecode_int_CanInline(tSpiderScript *Script, tScript_Function *Callee, tBC_Function *Code)
+{
+	bool _IsNumber(tSpiderTypeRef Type) {
+		 int	id = Bytecode_int_GetTypeIdx(Script, Type);
+		return id == SS_DATATYPE_INTEGER || id == SS_DATATYPE_REAL;
+	}
+
+	if( Callee->IsVariable || Code->HandlerCount || Code->InstructionCount > BC_TIER_INLINE_SIZE )
+		return 0;
+	if( !_IsNumber(Callee->ReturnType) )
+		return 0;
+	for( int i = 0; i < Callee->ArgumentCount; i ++ )
+	{
+		if( !_IsNumber(Callee->Arguments[i].Type) )
+			return 0;
+	}
+
+	// No calls, references or side effects
+	for( int i = 0; i < Code->InstructionCount; i ++ )
+	{
+		const tBC_Insn	*insn = &Code->Instructions[i];
+		switch(insn->Operation)
+		{
+		case BC_OP_NOP:
+		case BC_OP_LOADINT:
+		case BC_OP_LOADREAL:
+		case BC_OP_MOV:
+		case BC_OP_JUMP:
+		case BC_OP_JUMPIF:
+		case BC_OP_JUMPIFNOT:
+		case BC_OP_RETURN:
+		case BC_OP_INT_BITNOT ... BC_OP_INT_GREATERTHANEQ:
+		case BC_OP_REAL_NEG ... BC_OP_REAL_GREATERTHANEQ:
+			break;
+		case BC_OP_CAST:
+			if( insn->Content.RegInt.RegInt2 >= SS_DATATYPE_STRING )
+				return 0;
+			break;
+		default:
+			return 0;
+		}
+	}
+
+	int	*states = Bytecode_int_InferTypes(Script, Callee, Code);
+	if( !states )
+		return 0;
+	// Registers other than the arguments must be written before they are read, as the
+	// window they are moved to isn't cleared between calls
+	const int	nregs = Code->MaxRegisters;
+	 int	rv = 1;
+	for( int i = 0; i < Code->InstructionCount && rv; i ++ )
+	{
+		for( int r = Callee->ArgumentCount; r < nregs; r ++ )
+		{
+			 int	type = states[i * nregs + r];
+			if( Bytecode_int_InsnRegUse(&Code->Instructions[i], r) == BC_REGUSE_READ
+			 && (type < 0 || type == SS_DATATYPE_NOVALUE) )
+			{
+				rv = 0;
+				break;
+			}
+		}
+	}
+	free(states);
+	return rv;
+}
+
+/**
+ * \brief Replace calls to small numeric functions with the body of the function
+ * \param MaxRegisters	Frame register limit
+ * \return Number of calls inlined
+ *
+ * The callee's registers are moved to a window above the caller's, arguments are moved in
+ * and each RETURN becomes a move to the call's destination and a jump past the body.
+ */
+static int Bytecode_int_InlineCalls(tSpiderScript *Script, tScript_Function *Fcn, tBC_Function *Code, int MaxRegisters)
+{
+	const int	count = Code->InstructionCount;
+	const int	base = Code->MaxRegisters;
+	const tBC_Insn	*insns = Code->Instructions;
+	tBC_Function	*sites[count];
+	 int	window = 0;
+	 int	n_sites = 0;
+	 int	out_count = count;
+
+	int	*states = Bytecode_int_InferTypes(Script, Fcn, Code);
+	if( !states )
+		return 0;
+	for( int i = 0; i < count; i ++ )
+	{
+		sites[i] = NULL;
+		tScript_Function	*callee = Bytecode_int_InlineCallee(Script, Fcn, &insns[i], &states[i * base]);
+		if( !callee )
+			continue ;
+		tBC_Function	*body = Bytecode_int_CloneCode(callee->BCFcn);
+		if( !body )
+			continue ;
+		if( base + body->MaxRegisters > MaxRegisters || !Bytecode_int_CanInline(Script, callee, body) ) {
+			Bytecode_int_FreeTier(body);
+			continue ;
+		}
+		sites[i] = body;
+		n_sites ++;
+		if( body->MaxRegisters > window )
+			window = body->MaxRegisters;
+		// Argument moves, plus a move for each RETURN (the call is replaced)
+		out_count += callee->ArgumentCount + body->InstructionCount - 1;
+		for( int j = 0; j < body->InstructionCount; j ++ )
+		{
+			if( body->Instructions[j].Operation == BC_OP_RETURN && insns[i].DstReg >= 0 )
+				out_count ++;
+		}
+	}
+	free(states);
+	if( n_sites == 0 )
+		return 0;
+
+	tBC_Insn	*out = malloc( out_count * sizeof(tBC_Insn) );
+	if( !out ) {
+		for( int i = 0; i < count; i ++ )
+			Bytecode_int_FreeTier(sites[i]);
+		return 0;
+	}
+
+	tBC_Insn *_emit(int *Pos, int Operation, int Dst, int R2, int R3) {
+		tBC_Insn	*insn = &out[(*Pos)++];
+		insn->Operation = Operation;
+		insn->Aux = 0;
+		insn->DstReg = Dst;
+		insn->Content.RegInt.RegInt2 = R2;
+		insn->Content.RegInt.RegInt3 = R3;
+		return insn;
+	}
+
+	 int	new_idx[count];
+	 int	n = 0;
+	for( int i = 0; i < count; i ++ )
+	{
+		new_idx[i] = n;
+		tBC_Function	*body = sites[i];
+		if( !body ) {
+			out[n++] = insns[i];
+			continue ;
+		}
+
+		const tBC_Op	*call = insns[i].Content.Op;
+		const int	dst = insns[i].DstReg;
+		for( int a = 0; a < (call->Content.Function.ArgCount & BC_CALL_ARGCOUNT_MASK); a ++ )
+			_emit(&n, BC_OP_MOV, base + a, call->Content.Function.ArgRegs[a], 0);
+
+		// Position of each body instruction
+		 int	local_idx[body->InstructionCount];
+		 int	end = n;
+		for( int j = 0; j < body->InstructionCount; j ++ )
+		{
+			local_idx[j] = end;
+			end += (body->Instructions[j].Operation == BC_OP_RETURN && dst >= 0 ? 2 : 1);
+		}
+
+		for( int j = 0; j < body->InstructionCount; j ++ )
+		{
+			const tBC_Insn	*src = &body->Instructions[j];
+			const int	r2 = src->Content.RegInt.RegInt2;
+			const int	r3 = src->Content.RegInt.RegInt3;
+			tBC_Insn	*insn;
+			switch(src->Operation)
+			{
+			case BC_OP_NOP:
+				_emit(&n, BC_OP_NOP, 0, 0, 0);
+				break;
+			case BC_OP_RETURN:
+				if( dst >= 0 && src->DstReg >= 0 )
+					_emit(&n, BC_OP_MOV, dst, base + src->DstReg, 0);
+				else if( dst >= 0 && body->ReturnTypeId == SS_DATATYPE_REAL )
+					_emit(&n, BC_OP_LOADREAL, dst, 0, 0)->Content.Real = 0;
+				else if( dst >= 0 )
+					_emit(&n, BC_OP_LOADINT, dst, 0, 0)->Content.Integer = 0;
+				_emit(&n, BC_OP_JUMP, end, 0, 0);
+				break;
+			case BC_OP_JUMP:
+				_emit(&n, src->Operation, local_idx[src->DstReg], 0, 0);
+				break;
+			case BC_OP_JUMPIF:
+			case BC_OP_JUMPIFNOT:
+				_emit(&n, src->Operation, local_idx[src->DstReg], base + r2, 0);
+				break;
+			case BC_OP_LOADINT:
+			case BC_OP_LOADREAL:
+				insn = &out[n++];
+				*insn = *src;
+				insn->DstReg += base;
+				break;
+			case BC_OP_CAST:
+				_emit(&n, src->Operation, base + src->DstReg, r2, base + r3);
+				break;
+			case BC_OP_MOV:
+			case BC_OP_INT_BITNOT:
+			case BC_OP_INT_NEG:
+			case BC_OP_REAL_NEG:
+				_emit(&n, src->Operation, base + src->DstReg, base + r2, 0);
+				break;
+			default:
+				_emit(&n, src->Operation, base + src->DstReg, base + r2, base + r3);
+				break;
+			}
+		}
+		Bytecode_int_FreeTier(body);
+	}
+
+	// Update the caller's jump targets
+	for( int i = 0; i < count; i ++ )
+	{
+		if( !sites[i] && Bytecode_int_InsnIsJump(&insns[i]) )
+			out[ new_idx[i] ].DstReg = new_idx[ insns[i].DstReg ];
+	}
+
+	// - Inlined bodies take the position of their call
+	Bytecode_int_RemapLines(Code, new_idx);
+
+	DEBUGS1("Inlined %i calls (%i -> %i instructions)", n_sites, count, n);
+	free(Code->Instructions);
+	Code->Instructions = out;
+	Code->InstructionCount = n;
+	Code->MaxRegisters = base + window;
+	return n_sites;
+}
+
+/**
+ * \brief Compute values directly into the register they are moved to
+ *
+ * Expressions are generated into temporaries, so an assignment is an operation followed
+ * by a MOV from a temporary that is never read again.
+ */
+static void Bytecode_int_CoalesceRegisters(tBC_Function *Code)
+{
+	const int	count = Code->InstructionCount;
+	tBC_Insn	*insns = Code->Instructions;
+
+	bool	is_target[count];
+	for( int i = 0; i < count; i ++ )
+		is_target[i] = false;
+	for( int i = 0; i < count; i ++ )
+	{
+		if( Bytecode_int_InsnIsJump(&insns[i]) )
+			is_target[ insns[i].DstReg ] = true;
+	}
+	Bytecode_int_MarkHandlerTargets(Code, is_target);
+
+	for( int i = 0; i + 1 < count; i ++ )
+	{
+		tBC_Insn	*insn = &insns[i], *mov = &insns[i+1];
+		switch(insn->Operation)
+		{
+		// Only operations on primitives, which read their sources before the destination
+		// is written (CAST is excluded for this reason)
+		case BC_OP_LOADINT:
+		case BC_OP_LOADREAL:
+		case BC_OP_INT_BITNOT ... BC_OP_INT_GREATERTHANEQ:
+		case BC_OP_REAL_NEG ... BC_OP_REAL_GREATERTHANEQ:
+			break;
+		default:
+			continue ;
+		}
+		if( mov->Operation != BC_OP_MOV || is_target[i+1] )
+			continue ;
+		if( mov->Content.RegInt.RegInt2 != insn->DstReg || mov->DstReg == insn->DstReg )
+			continue ;
+		if( !Bytecode_int_IsRegDeadAfter(insns, count, i+1, insn->DstReg) )
+			continue ;
+		insn->DstReg = mov->DstReg;
+		// - Removed by Bytecode_int_FuseInstructions
+		mov->Operation = BC_OP_NOP;
+	}
+}
+
+/**
+ * \brief Build the optimised code for a hot function
+ * \param MaxRegisters	Frame register limit
+ * \return Non-zero if the function is left as it is
+ * \note Only attempted once per function, the result is installed by Bytecode_int_InstallTier
+ */
+int Bytecode_int_TierUp(tSpiderScript *Script, tScript_Function *Fcn, int MaxRegisters)
+{
+	tBC_Function	*bcfcn = Fcn->BCFcn;
+
+	bcfcn->Tier = 1;
+	tBC_Function	*code = Bytecode_int_CloneCode(bcfcn);
+	if( !code )
+		return -1;
+
+	if( bcfcn->IsVerified )
+		Bytecode_int_InlineCalls(Script, Fcn, code, MaxRegisters);
+	Bytecode_int_CoalesceRegisters(code);
+	if( Bytecode_int_FuseInstructions(code) )
+		goto _err;
+	if( Bytecode_int_AllocInlineCaches(code) )
+		goto _err;
+
+	// The new code must keep the verified state (argument checks depend on it)
+	if( bcfcn->IsVerified ) {
+		int	*states = Bytecode_int_InferTypes(Script, Fcn, code);
+		if( !states ) {
+			DEBUGS1("%s: Optimised code failed verification", Fcn->Name);
+			goto _err;
+		}
+		free(states);
+		code->IsVerified = true;
+	}
+	code->ReturnTypeId = bcfcn->ReturnTypeId;
+	if( Bytecode_int_LinkFunction(Script, Fcn, code) )
+		goto _err;
+
+	DEBUGS1("%s: %i -> %i instructions", Fcn->Name, bcfcn->InstructionCount, code->InstructionCount);
+	Bytecode_int_FreeTier(bcfcn->Optimised);
+	bcfcn->Optimised = code;
+	return 0;
+_err:
+	Bytecode_int_FreeTier(code);
+	return -1;
+}
+
+/**
+ * \brief Replace a function's instructions with its optimised code
+ * \note No frame may be running the function (instruction pointers and register counts change)
+ */
+void Bytecode_int_InstallTier(tBC_Function *Fcn)
+{
+	tBC_Function	*code = Fcn->Optimised;
+
+	free(Fcn->Instructions);
+	free(Fcn->InsnLines);
+	free(Fcn->InsnHandlers);
+	free(Fcn->InlineCaches);
+	free(Fcn->JitCode);
+	Fcn->InstructionCount = code->InstructionCount;
+	Fcn->Instructions = code->Instructions;
+	Fcn->InsnLineCount = code->InsnLineCount;
+	Fcn->InsnLines = code->InsnLines;
+	Fcn->InsnHandlers = code->InsnHandlers;
+	Fcn->InlineCacheCount = code->InlineCacheCount;
+	Fcn->InlineCaches = code->InlineCaches;
+	Fcn->MaxRegisters = code->MaxRegisters;
+	Fcn->IsVerified = code->IsVerified;
+	// - Native code is compiled again from the new instructions
+	Fcn->JitCode = NULL;
+	Fcn->HotCount = 0;
+
+	free(code->Labels);
+	free(code);
+	Fcn->Optimised = NULL;
+}
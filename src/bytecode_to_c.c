@@ -0,0 +1,951 @@
+/*
+ * SpiderScript Library
+ * by John Hodge (thePowersGang)
+ *
+ * bytecode_to_c.c
+ * - Ahead-of-time translation of bytecode to C
+ *
+ * Functions whose register types can be proven (see bytecode_verify.c) and that only work on
+ * Boolean, Integer, Real and String values are written out as C, with a local for each
+ * register/type pair and jumps as gotos. Anything else (objects, arrays, globals, methods) is
+ * left to the interpreter. The generated file is built into the host program, which passes its
+ * function table to SpiderScript_RegisterNative once the script is loaded; from then on calls to
+ * those functions (from the interpreter or from native code) run the compiled version.
+ * Each function is fingerprinted from its bytecode, so a table built from a different version
+ * of the script is ignored.
+ */
+#define DEBUG	0
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include "common.h"
+#include "bytecode.h"
+
+#define FNV_OFFSET	0x811C9DC5
+#define FNV_PRIME	0x01000193
+
+// Register type for a value that differs between paths, and for unreachable instructions
+// (as in bytecode_verify.c)
+#define TYPE_UNKNOWN	-1
+#define TYPE_UNVISITED	-2
+
+// Register types that have a C local
+#define IS_CTYPE(t)	((t) >= SS_DATATYPE_BOOLEAN && (t) <= SS_DATATYPE_STRING)
+
+// === TYPES ===
+typedef struct sBC_CGen	tBC_CGen;
+
+struct sBC_CGen
+{
+	tSpiderScript	*Script;
+	const char	*Prefix;
+	bool	*Translated;	// Indexed by function ID
+
+	// Function being translated
+	 int	FcnID;
+	tScript_Function	*Fcn;
+	tBC_Function	*Code;
+	const int	*States;
+	 int	NRegs;
+	uint8_t	*Locals;	// Per register, bitmask of the types with a local
+	bool	*IsString;	// Per register, holds a string at some point
+	bool	*IsTarget;	// Per instruction, jumped to
+	bool	UsesReturn;
+	bool	UsesEntry;	// Tail calls to itself jump back to the start
+	FILE	*FP;
+};
+
+// === PROTOTYPES ===
+ int	SpiderScript_SaveC(tSpiderScript *Script, const char *DestFile, const char *Prefix);
+ int	SpiderScript_RegisterNative(tSpiderScript *Script, const tSpiderNativeFunction *Functions);
+static uint32_t	Bytecode_int_HashData(uint32_t Hash, const void *Data, size_t Length);
+static uint32_t	Bytecode_int_HashFunction(tSpiderScript *Script, tScript_Function *Fcn, const tBC_Function *Code);
+static void	Bytecode_int_CGenString(FILE *FP, const char *Data, size_t Length);
+static int	Bytecode_int_CGenPrototype(tBC_CGen *G, tScript_Function *Fcn, int ID, FILE *FP);
+static int	Bytecode_int_CGenInsn(tBC_CGen *G, int Index);
+static int	Bytecode_int_CGenFunction(tBC_CGen *G, int ID, FILE *FP);
+
+// === GLOBALS ===
+static const char * const caCTypes[] = {
+	[SS_DATATYPE_BOOLEAN] = "tSpiderBool",
+	[SS_DATATYPE_INTEGER] = "tSpiderInteger",
+	[SS_DATATYPE_REAL] = "tSpiderReal",
+	[SS_DATATYPE_STRING] = "tSpiderString*",
+};
+static const char * const caTypeDefs[] = {
+	[SS_DATATYPE_BOOLEAN] = "gSpiderScript_BoolType",
+	[SS_DATATYPE_INTEGER] = "gSpiderScript_IntegerType",
+	[SS_DATATYPE_REAL] = "gSpiderScript_RealType",
+	[SS_DATATYPE_STRING] = "gSpiderScript_StringType",
+};
+static const char caLocalPrefix[] = {
+	[SS_DATATYPE_BOOLEAN] = 'b',
+	[SS_DATATYPE_INTEGER] = 'i',
+	[SS_DATATYPE_REAL] = 'r',
+	[SS_DATATYPE_STRING] = 's',
+};
+
+// Support code at the top of every generated file
+static const char csCGenPrelude[] =
+	"#include <spiderscript.h>\n"
+	"\n"
+	"#define _SS_TYPE(_def)	((tSpiderTypeRef){.ArrayDepth=0,.Def=&(_def)})\n"
+	"\n"
+	"#include <stdint.h>\n"
+	"\n"
+	"// Compiled calls nest on the C stack, which is limited separately from the VM stack\n"
+	"#ifndef _SS_MAX_STACK\n"
+	"# define _SS_MAX_STACK	(4*1024*1024)\n"
+	"#endif\n"
+	"static int	_ss_depth;\n"
+	"static uintptr_t	_ss_stack_base;\n"
+	"static inline int _ss_enter(tSpiderScript *Script, const void *SP)\n"
+	"{\n"
+	"\tuintptr_t	sp = (uintptr_t)SP;\n"
+	"\tif( _ss_depth ++ == 0 )\n"
+	"\t\t_ss_stack_base = sp;\n"
+	"\telse if( (sp < _ss_stack_base ? _ss_stack_base - sp : sp - _ss_stack_base) > _SS_MAX_STACK )\n"
+	"\t\treturn SpiderScript_ThrowException(Script, SS_EXCEPTION_MEMORY, \"Native stack exhausted\");\n"
+	"\treturn 0;\n"
+	"}\n"
+	"\n"
+	"typedef union {\n"
+	"\ttSpiderBool	b;\n"
+	"\ttSpiderInteger	i;\n"
+	"\ttSpiderReal	r;\n"
+	"\tvoid	*p;\n"
+	"} _ss_value;\n"
+	"\n"
+	"// Replace the string held by a register (the new value is already referenced)\n"
+	"static inline void _ss_setstr(tSpiderString **Reg, tSpiderString *Value)\n"
+	"{\n"
+	"\tSpiderScript_DereferenceString(*Reg);\n"
+	"\t*Reg = Value;\n"
+	"}\n"
+	"static inline tSpiderString *_ss_refstr(tSpiderString *Value)\n"
+	"{\n"
+	"\tSpiderScript_ReferenceString(Value);\n"
+	"\treturn Value;\n"
+	"}\n"
+	"// Release a value returned by a call whose result isn't used\n"
+	"static inline void _ss_release(tSpiderTypeRef Type, void *Value)\n"
+	"{\n"
+	"\tif( SS_GETARRAYDEPTH(Type) )\n"
+	"\t\tSpiderScript_DereferenceArray(Value);\n"
+	"\telse if( SS_ISTYPEOBJECT(Type) )\n"
+	"\t\tSpiderScript_DereferenceObject(Value);\n"
+	"\telse if( SS_ISCORETYPE(Type, SS_DATATYPE_STRING) )\n"
+	"\t\tSpiderScript_DereferenceString(Value);\n"
+	"}\n"
+	"\n";
+
+// === CODE ===
+static uint32_t Bytecode_int_HashData(uint32_t Hash, const void *Data, size_t Length)
+{
+	const uint8_t	*bytes = Data;
+	for( size_t i = 0; i < Length; i ++ )
+	{
+		Hash ^= bytes[i];
+		Hash *= FNV_PRIME;
+	}
+	return Hash;
+}
+
+/**
+ * \brief Fingerprint a function's prototype and flattened (unfused) bytecode
+ * \note Only the operands used by each instruction are included, so the result is the same for a
+ *       function compiled from source and one loaded from a bytecode file
+ */
+static uint32_t Bytecode_int_HashFunction(tSpiderScript *Script, tScript_Function *Fcn, const tBC_Function *Code)
+{
+	uint32_t	hash = FNV_OFFSET;
+	#define _HASHVAL(v)	do { int64_t _v = (v); hash = Bytecode_int_HashData(hash, &_v, sizeof(_v)); } while(0)
+	#define _HASHSTR(s)	do { const char *_s = (s); hash = Bytecode_int_HashData(hash, _s, strlen(_s)+1); } while(0)
+
+	_HASHSTR( SpiderScript_GetTypeName(Script, Fcn->ReturnType) );
+	_HASHVAL( Fcn->ArgumentCount );
+	_HASHVAL( Fcn->IsVariable );
+	for( int i = 0; i < Fcn->ArgumentCount; i ++ )
+		_HASHSTR( SpiderScript_GetTypeName(Script, Fcn->Arguments[i].Type) );
+
+	for( int i = 0; i < Code->InstructionCount; i ++ )
+	{
+		const tBC_Insn	*insn = &Code->Instructions[i];
+		const tBC_Op	*op = insn->Content.Op;
+		_HASHVAL( insn->Operation );
+		if( caOpEncodingTypes[insn->Operation] != BC_OPENC_NOOPRS )
+			_HASHVAL( insn->DstReg );
+		switch( insn->Operation )
+		{
+		case BC_OP_LOADINT:
+			_HASHVAL( insn->Content.Integer );
+			break;
+		case BC_OP_LOADREAL:
+			hash = Bytecode_int_HashData(hash, &insn->Content.Real, sizeof(insn->Content.Real));
+			break;
+		case BC_OP_JUMP:
+			break;
+		case BC_OP_JUMPIF:
+		case BC_OP_JUMPIFNOT:
+			_HASHVAL( insn->Content.RegInt.RegInt2 );
+			break;
+		case BC_OP_CREATEOBJ:
+		case BC_OP_CALLFUNCTION:
+		case BC_OP_CALLMETHOD:
+		case BC_OP_TAILCALLFUNCTION:
+		case BC_OP_TAILCALLMETHOD:
+			_HASHVAL( op->Content.Function.ID );
+			_HASHVAL( op->Content.Function.ArgCount );
+			for( int j = 0; j < (op->Content.Function.ArgCount & BC_CALL_ARGCOUNT_MASK); j ++ )
+				_HASHVAL( op->Content.Function.ArgRegs[j] );
+			break;
+		default:
+			switch( caOpEncodingTypes[insn->Operation] )
+			{
+			case BC_OPENC_REG3:
+				_HASHVAL( insn->Content.RegInt.RegInt3 );
+			case BC_OPENC_REG2:
+				_HASHVAL( insn->Content.RegInt.RegInt2 );
+				break;
+			case BC_OPENC_STRING:
+				if( op ) {
+					_HASHVAL( op->Content.String.Length );
+					hash = Bytecode_int_HashData(hash, op->Content.String.Data, op->Content.String.Length);
+				}
+				break;
+			default:
+				break;
+			}
+			break;
+		}
+	}
+	#undef _HASHVAL
+	#undef _HASHSTR
+	return hash;
+}
+
+/**
+ * \brief Write a C string literal
+ */
+static void Bytecode_int_CGenString(FILE *FP, const char *Data, size_t Length)
+{
+	fputc('"', FP);
+	for( size_t i = 0; i < Length; i ++ )
+	{
+		unsigned char	ch = Data[i];
+		// - '?' is escaped to avoid trigraphs
+		if( ch < ' ' || ch >= 0x7F || ch == '"' || ch == '\\' || ch == '?' )
+			fprintf(FP, "\\%03o", ch);
+		else
+			fputc(ch, FP);
+	}
+	fputc('"', FP);
+}
+
+/**
+ * \brief Write the prototype of a translated function's C implementation
+ * \return Boolean success (false if the prototype has types without a C equivalent)
+ */
+static int Bytecode_int_CGenPrototype(tBC_CGen *G, tScript_Function *Fcn, int ID, FILE *FP)
+{
+	 int	ret_type = Bytecode_int_GetTypeIdx(G->Script, Fcn->ReturnType);
+	if( ret_type != SS_DATATYPE_NOVALUE && !IS_CTYPE(ret_type) )
+		return 0;
+	for( int i = 0; i < Fcn->ArgumentCount; i ++ )
+	{
+		if( !IS_CTYPE( Bytecode_int_GetTypeIdx(G->Script, Fcn->Arguments[i].Type) ) )
+			return 0;
+	}
+	if( !FP )
+		return 1;
+
+	fprintf(FP, "static int %s_f%i(tSpiderScript *Script", G->Prefix, ID);
+	if( ret_type != SS_DATATYPE_NOVALUE )
+		fprintf(FP, ", %s *Ret", caCTypes[ret_type]);
+	for( int i = 0; i < Fcn->ArgumentCount; i ++ )
+		fprintf(FP, ", %s a%i", caCTypes[Bytecode_int_GetTypeIdx(G->Script, Fcn->Arguments[i].Type)], i);
+	fprintf(FP, ")");
+	return 1;
+}
+
+/**
+ * \brief Translate an instruction
+ * \return Boolean success (false if the instruction can't be translated)
+ */
+static int Bytecode_int_CGenInsn(tBC_CGen *G, int Index)
+{
+	tSpiderScript	*Script = G->Script;
+	const tBC_Insn	*insn = &G->Code->Instructions[Index];
+	const int	*regs = &G->States[Index * G->NRegs];
+	const int	dst = insn->DstReg;
+	const int	r2 = insn->Content.RegInt.RegInt2;
+	const int	r3 = insn->Content.RegInt.RegInt3;
+	FILE	*fp = G->FP;
+	char	buf1[128], buf2[128];
+
+	#define EMIT(fmt, v...)	fprintf(fp, "\t" fmt "\n" ,## v)
+	// Type of a register on entry to the instruction
+	#define TYPE(r)	((r) >= 0 && (r) < G->NRegs ? regs[r] : TYPE_UNKNOWN)
+	// C local for a register as a type
+	#define LOCAL(t, r)	caLocalPrefix[t], _use(t, r)
+	// Register read as a C value, must be of a type with a local
+	#define READ(r)	do { if( !IS_CTYPE(TYPE(r)) ) return 0; } while(0)
+
+	int _use(int Type, int Reg)
+	{
+		G->Locals[Reg] |= 1 << Type;
+		return Reg;
+	}
+	// Release the string in a register about to be overwritten with another type
+	void _clobber(int Reg)
+	{
+		if( G->IsString[Reg] && !(TYPE(Reg) >= SS_DATATYPE_NOVALUE && TYPE(Reg) < SS_DATATYPE_STRING) )
+			EMIT("_ss_setstr(&s%i, NULL);", _use(SS_DATATYPE_STRING, Reg));
+	}
+	// Condition expression for a register (see Bytecode_int_IsStackEntTrue)
+	const char *_truth(char *Buf, int Reg)
+	{
+		switch( TYPE(Reg) )
+		{
+		case SS_DATATYPE_BOOLEAN:
+			snprintf(Buf, 128, "b%i", _use(SS_DATATYPE_BOOLEAN, Reg));
+			break;
+		case SS_DATATYPE_INTEGER:
+			snprintf(Buf, 128, "(i%i != 0)", _use(SS_DATATYPE_INTEGER, Reg));
+			break;
+		case SS_DATATYPE_REAL:
+			snprintf(Buf, 128, "!(-.5f < r%i && r%i < 0.5f)", _use(SS_DATATYPE_REAL, Reg), Reg);
+			break;
+		case SS_DATATYPE_STRING:
+			snprintf(Buf, 128, "SpiderScript_CastValueToBool(_SS_TYPE(gSpiderScript_StringType), s%i)",
+				_use(SS_DATATYPE_STRING, Reg));
+			break;
+		}
+		return Buf;
+	}
+	// Pointer to a register's value, as taken by the runtime API (see Bytecode_int_GetSpiderValue)
+	const char *_valptr(char *Buf, int Reg)
+	{
+		 int	t = TYPE(Reg);
+		snprintf(Buf, 128, "%s%c%i", (t == SS_DATATYPE_STRING ? "" : "&"), LOCAL(t, Reg));
+		return Buf;
+	}
+
+	// - Jumps hold a target, operations without operands leave it unset
+	if( dst >= G->NRegs && caOpEncodingTypes[insn->Operation] != BC_OPENC_NOOPRS
+	 && insn->Operation != BC_OP_JUMP && insn->Operation != BC_OP_JUMPIF && insn->Operation != BC_OP_JUMPIFNOT )
+		return 0;
+
+	switch( insn->Operation )
+	{
+	case BC_OP_NOP:
+		return 1;
+
+	case BC_OP_LOADINT:
+		_clobber(dst);
+		EMIT("i%i = (tSpiderInteger)%"PRIu64"ull;", _use(SS_DATATYPE_INTEGER, dst), insn->Content.Integer);
+		return 1;
+	case BC_OP_LOADREAL: {
+		double	v = insn->Content.Real;
+		_clobber(dst);
+		if( v != v )
+			EMIT("r%i = 0.0/0.0;", _use(SS_DATATYPE_REAL, dst));
+		else if( v - v != 0 )
+			EMIT("r%i = %s1.0/0.0;", _use(SS_DATATYPE_REAL, dst), (v < 0 ? "-" : ""));
+		else
+			EMIT("r%i = %a;", _use(SS_DATATYPE_REAL, dst), v);
+		return 1; }
+	case BC_OP_LOADSTRING: {
+		const tBC_Op	*op = insn->Content.Op;
+		fprintf(fp, "\t_ss_setstr(&s%i, SpiderScript_CreateString(%zi, ",
+			_use(SS_DATATYPE_STRING, dst), op->Content.String.Length);
+		Bytecode_int_CGenString(fp, op->Content.String.Data, op->Content.String.Length);
+		fprintf(fp, "));\n");
+		return 1; }
+	case BC_OP_LOADNULLREF:
+		if( r2 != SS_DATATYPE_STRING )
+			return 0;
+		EMIT("_ss_setstr(&s%i, NULL);", _use(SS_DATATYPE_STRING, dst));
+		return 1;
+
+	case BC_OP_RETURN: {
+		 int	ret_type = G->Code->ReturnTypeId;
+		if( ret_type == SS_DATATYPE_NOVALUE )
+			;
+		else if( dst >= 0 && ret_type == SS_DATATYPE_STRING )
+			EMIT("*Ret = _ss_refstr(s%i);", _use(SS_DATATYPE_STRING, dst));
+		else if( dst >= 0 )
+			EMIT("*Ret = %c%i;", LOCAL(ret_type, dst));
+		else
+			EMIT("*Ret = 0;");
+		EMIT("goto _ret;");
+		G->UsesReturn = true;
+		return 1; }
+	case BC_OP_CLEARREG:
+		_clobber(dst);
+		return 1;
+	case BC_OP_MOV:
+	case BC_OP_MOV_MOVE: {
+		 int	t = TYPE(r2);
+		if( dst == r2 )
+			return 1;
+		if( t == SS_DATATYPE_NOVALUE ) {
+			_clobber(dst);
+			return 1;
+		}
+		READ(r2);
+		if( t == SS_DATATYPE_STRING && insn->Operation == BC_OP_MOV_MOVE ) {
+			EMIT("_ss_setstr(&s%i, s%i);", _use(t, dst), _use(t, r2));
+			EMIT("s%i = NULL;", _use(t, r2));
+		}
+		else if( t == SS_DATATYPE_STRING ) {
+			EMIT("_ss_setstr(&s%i, _ss_refstr(s%i));", _use(t, dst), _use(t, r2));
+		}
+		else {
+			_clobber(dst);
+			EMIT("%c%i = %c%i;", LOCAL(t, dst), LOCAL(t, r2));
+		}
+		return 1; }
+
+	case BC_OP_JUMP:
+		EMIT("goto L%i;", dst);
+		return 1;
+	case BC_OP_JUMPIF:
+		READ(r2);
+		EMIT("if( %s )\tgoto L%i;", _truth(buf1, r2), dst);
+		return 1;
+	case BC_OP_JUMPIFNOT:
+		READ(r2);
+		EMIT("if( !%s )\tgoto L%i;", _truth(buf1, r2), dst);
+		return 1;
+
+	case BC_OP_CAST: {
+		 int	t = TYPE(r3);
+		READ(r3);
+		if( !IS_CTYPE(r2) )
+			return 0;
+		if( t == r2 && t == SS_DATATYPE_STRING ) {
+			if( dst != r3 )
+				EMIT("_ss_setstr(&s%i, _ss_refstr(s%i));", _use(t, dst), _use(t, r3));
+		}
+		else if( r2 == SS_DATATYPE_STRING ) {
+			EMIT("_ss_setstr(&s%i, SpiderScript_CastValueToString(_SS_TYPE(%s), %s));",
+				_use(r2, dst), caTypeDefs[t], _valptr(buf1, r3));
+		}
+		else if( t == r2 || (t == SS_DATATYPE_INTEGER && r2 == SS_DATATYPE_REAL)
+		      || (t == SS_DATATYPE_REAL && r2 == SS_DATATYPE_INTEGER) ) {
+			_clobber(dst);
+			EMIT("%c%i = %c%i;", LOCAL(r2, dst), LOCAL(t, r3));
+		}
+		else {
+			static const char * const fcns[] = {
+				[SS_DATATYPE_BOOLEAN] = "SpiderScript_CastValueToBool",
+				[SS_DATATYPE_INTEGER] = "SpiderScript_CastValueToInteger",
+				[SS_DATATYPE_REAL] = "SpiderScript_CastValueToReal",
+			};
+			_clobber(dst);
+			EMIT("%c%i = %s(_SS_TYPE(%s), %s);", LOCAL(r2, dst), fcns[r2], caTypeDefs[t], _valptr(buf1, r3));
+		}
+		return 1; }
+
+	case BC_OP_REFEQ:
+	case BC_OP_REFNEQ:
+		if( TYPE(r2) != SS_DATATYPE_STRING || TYPE(r3) != SS_DATATYPE_STRING )
+			return 0;
+		_clobber(dst);
+		EMIT("b%i = (s%i %s s%i);", _use(SS_DATATYPE_BOOLEAN, dst), _use(SS_DATATYPE_STRING, r2),
+			(insn->Operation == BC_OP_REFEQ ? "==" : "!="), _use(SS_DATATYPE_STRING, r3));
+		return 1;
+	case BC_OP_BOOL_EQUALS:
+	case BC_OP_BOOL_LOGICAND:
+	case BC_OP_BOOL_LOGICOR:
+	case BC_OP_BOOL_LOGICXOR: {
+		static const char * const oprs[] = {
+			[BC_OP_BOOL_EQUALS] = "==", [BC_OP_BOOL_LOGICAND] = "&&",
+			[BC_OP_BOOL_LOGICOR] = "||", [BC_OP_BOOL_LOGICXOR] = "!="
+		};
+		READ(r2);
+		READ(r3);
+		_clobber(dst);
+		EMIT("b%i = (%s %s %s);", _use(SS_DATATYPE_BOOLEAN, dst),
+			_truth(buf1, r2), oprs[insn->Operation], _truth(buf2, r3));
+		return 1; }
+	case BC_OP_BOOL_LOGICNOT:
+		READ(r2);
+		_clobber(dst);
+		EMIT("b%i = !%s;", _use(SS_DATATYPE_BOOLEAN, dst), _truth(buf1, r2));
+		return 1;
+
+	case BC_OP_INT_BITNOT:
+	case BC_OP_INT_NEG:
+		_clobber(dst);
+		EMIT("i%i = %ci%i;", _use(SS_DATATYPE_INTEGER, dst), (insn->Operation == BC_OP_INT_NEG ? '-' : '~'),
+			_use(SS_DATATYPE_INTEGER, r2));
+		return 1;
+	case BC_OP_REAL_NEG:
+		_clobber(dst);
+		EMIT("r%i = -r%i;", _use(SS_DATATYPE_REAL, dst), _use(SS_DATATYPE_REAL, r2));
+		return 1;
+
+	case BC_OP_INT_BITAND ... BC_OP_INT_GREATERTHANEQ:
+	case BC_OP_REAL_ADD ... BC_OP_REAL_GREATERTHANEQ: {
+		static const char * const oprs[] = {
+			[BC_OP_INT_BITAND] = "&", [BC_OP_INT_BITOR] = "|", [BC_OP_INT_BITXOR] = "^",
+			[BC_OP_INT_BITSHIFTLEFT] = "<<", [BC_OP_INT_BITSHIFTRIGHT] = ">>",
+			[BC_OP_INT_ADD] = "+", [BC_OP_INT_SUBTRACT] = "-", [BC_OP_INT_MULTIPLY] = "*",
+			[BC_OP_INT_DIVIDE] = "/", [BC_OP_INT_MODULO] = "%",
+			[BC_OP_INT_EQUALS] = "==", [BC_OP_INT_NOTEQUALS] = "!=",
+			[BC_OP_INT_LESSTHAN] = "<", [BC_OP_INT_LESSTHANEQ] = "<=",
+			[BC_OP_INT_GREATERTHAN] = ">", [BC_OP_INT_GREATERTHANEQ] = ">=",
+			[BC_OP_REAL_ADD] = "+", [BC_OP_REAL_SUBTRACT] = "-", [BC_OP_REAL_MULTIPLY] = "*",
+			[BC_OP_REAL_DIVIDE] = "/",
+			[BC_OP_REAL_EQUALS] = "==", [BC_OP_REAL_NOTEQUALS] = "!=",
+			[BC_OP_REAL_LESSTHAN] = "<", [BC_OP_REAL_LESSTHANEQ] = "<=",
+			[BC_OP_REAL_GREATERTHAN] = ">", [BC_OP_REAL_GREATERTHANEQ] = ">=",
+		};
+		const int	op = insn->Operation;
+		const int	src = (op >= BC_OP_REAL_ADD ? SS_DATATYPE_REAL : SS_DATATYPE_INTEGER);
+		 int	res = src;
+		if( (op >= BC_OP_INT_EQUALS && op <= BC_OP_INT_GREATERTHANEQ) || op >= BC_OP_REAL_EQUALS )
+			res = SS_DATATYPE_BOOLEAN;
+		// - The interpreter traps on a zero modulus, the compiled code throws as for division
+		if( op == BC_OP_INT_DIVIDE || op == BC_OP_INT_MODULO ) {
+			EMIT("if( i%i == 0 ) {", _use(src, r3));
+			EMIT("\tSpiderScript_ThrowException(Script, SS_EXCEPTION_ARITH, \"Divide by zero\");");
+			EMIT("\tgoto _err;");
+			EMIT("}");
+		}
+		_clobber(dst);
+		if( op == BC_OP_INT_BITROTATELEFT )
+			EMIT("i%i = (i%i << i%i) | (i%i >> (64-i%i));", _use(res, dst),
+				_use(src, r2), _use(src, r3), r2, r3);
+		else
+			EMIT("%c%i = %c%i %s %c%i;", LOCAL(res, dst), LOCAL(src, r2), oprs[op], LOCAL(src, r3));
+		return 1; }
+
+	case BC_OP_STR_EQUALS ... BC_OP_STR_ADD: {
+		static const char * const oprs[] = {
+			[BC_OP_STR_EQUALS] = "==", [BC_OP_STR_NOTEQUALS] = "!=",
+			[BC_OP_STR_LESSTHAN] = "<", [BC_OP_STR_LESSTHANEQ] = "<=",
+			[BC_OP_STR_GREATERTHAN] = ">", [BC_OP_STR_GREATERTHANEQ] = ">=",
+		};
+		// - The interpreter only has string operations with a string on both sides
+		if( TYPE(r2) != SS_DATATYPE_STRING || TYPE(r3) != SS_DATATYPE_STRING )
+			return 0;
+		if( insn->Operation == BC_OP_STR_ADD ) {
+			EMIT("_ss_setstr(&s%i, SpiderScript_StringConcat(s%i, s%i));", _use(SS_DATATYPE_STRING, dst),
+				_use(SS_DATATYPE_STRING, r2), _use(SS_DATATYPE_STRING, r3));
+		}
+		else {
+			_clobber(dst);
+			EMIT("b%i = (SpiderScript_StringCompare(s%i, s%i) %s 0);", _use(SS_DATATYPE_BOOLEAN, dst),
+				_use(SS_DATATYPE_STRING, r2), _use(SS_DATATYPE_STRING, r3), oprs[insn->Operation]);
+		}
+		return 1; }
+
+	// The result of a tail call is returned by the following RETURN
+	case BC_OP_CALLFUNCTION:
+	case BC_OP_TAILCALLFUNCTION: {
+		const tBC_Op	*op = insn->Content.Op;
+		const int	id = op->Content.Function.ID;
+		const int	argc = op->Content.Function.ArgCount & BC_CALL_ARGCOUNT_MASK;
+		const int	*argregs = op->Content.Function.ArgRegs;
+		tScript_Function	*callee = NULL;
+		 int	ret_type = TYPE_UNKNOWN;
+		bool	direct;
+
+		// - Passing on variable arguments needs the interpreter's frame
+		if( op->Content.Function.ArgCount & BC_CALL_VARGS_PASSTHROUGH )
+			return 0;
+		for( int i = 0; i < argc; i ++ )
+			READ(argregs[i]);
+		if( (id >> 16) == 0 ) {
+			if( id >= Script->nFunctions )
+				return 0;
+			callee = Script->FunctionTable[id];
+			ret_type = Bytecode_int_GetTypeIdx(Script, callee->ReturnType);
+			if( ret_type != SS_DATATYPE_NOVALUE && !IS_CTYPE(ret_type) )
+				return 0;
+		}
+		if( dst >= 0 && ret_type != SS_DATATYPE_STRING )
+			_clobber(dst);
+
+		// Compiled script functions are called directly when the argument types match
+		direct = (callee && G->Translated[id] && !callee->IsVariable && argc == callee->ArgumentCount);
+		for( int i = 0; direct && i < argc; i ++ )
+		{
+			if( TYPE(argregs[i]) != Bytecode_int_GetTypeIdx(Script, callee->Arguments[i].Type) )
+				direct = false;
+		}
+
+		// A tail call to itself becomes a loop, as the interpreter reuses the frame
+		if( direct && id == G->FcnID && insn->Operation == BC_OP_TAILCALLFUNCTION )
+		{
+			EMIT("{");
+			for( int i = 0; i < argc; i ++ )
+			{
+				 int	t = TYPE(argregs[i]);
+				if( t == SS_DATATYPE_STRING )
+					EMIT("\t%s\t_a%i = _ss_refstr(s%i);", caCTypes[t], i, _use(t, argregs[i]));
+				else
+					EMIT("\t%s\t_a%i = %c%i;", caCTypes[t], i, LOCAL(t, argregs[i]));
+			}
+			for( int r = 0; r < G->NRegs; r ++ )
+			{
+				if( G->IsString[r] )
+					EMIT("\t_ss_setstr(&s%i, NULL);", _use(SS_DATATYPE_STRING, r));
+			}
+			for( int i = 0; i < argc; i ++ )
+				EMIT("\t%c%i = _a%i;", LOCAL(TYPE(argregs[i]), i), i);
+			EMIT("}");
+			EMIT("goto _entry;");
+			G->UsesEntry = true;
+			return 1;
+		}
+
+		EMIT("{");
+		if( direct )
+		{
+			if( ret_type != SS_DATATYPE_NOVALUE )
+				EMIT("\t%s\t_rv = 0;", caCTypes[ret_type]);
+			fprintf(fp, "\t\tif( %s_f%i(Script%s", G->Prefix, id, (ret_type != SS_DATATYPE_NOVALUE ? ", &_rv" : ""));
+			for( int i = 0; i < argc; i ++ )
+				fprintf(fp, ", %c%i", LOCAL(TYPE(argregs[i]), argregs[i]));
+			fprintf(fp, ") < 0 )\n");
+			EMIT("\t\tgoto _err;");
+		}
+		else
+		{
+			if( argc ) {
+				fprintf(fp, "\t\tconst void	*_args[] = {");
+				for( int i = 0; i < argc; i ++ )
+					fprintf(fp, "%s%s", (i ? ", " : ""), _valptr(buf1, argregs[i]));
+				fprintf(fp, "};\n");
+				fprintf(fp, "\t\tconst tSpiderTypeRef	_types[] = {");
+				for( int i = 0; i < argc; i ++ )
+					fprintf(fp, "%s_SS_TYPE(%s)", (i ? ", " : ""), caTypeDefs[TYPE(argregs[i])]);
+				fprintf(fp, "};\n");
+			}
+			// - Exported functions are the same for every script, so the lookup can be cached
+			if( (id >> 16) == 1 )
+				EMIT("\tstatic void	*_ident;");
+			EMIT("\ttSpiderTypeRef	_rt = {0,0};");
+			EMIT("\t_ss_value	_v = {0};");
+			fprintf(fp, "\t\tif( SpiderScript_ExecuteFunction(Script, ");
+			const char	*name = SpiderScript_int_GetFunctionName(Script, id);
+			Bytecode_int_CGenString(fp, name, strlen(name));
+			fprintf(fp, ", &_rt, &_v, %i, %s, %s, %s) < 0 )\n", argc, (argc ? "_types" : "NULL"),
+				(argc ? "_args" : "NULL"), ((id >> 16) == 1 ? "&_ident" : "NULL"));
+			EMIT("\t\tgoto _err;");
+			switch( (dst >= 0 ? ret_type : TYPE_UNKNOWN) )
+			{
+			case SS_DATATYPE_NOVALUE:
+				break;
+			case SS_DATATYPE_BOOLEAN:
+			case SS_DATATYPE_INTEGER:
+			case SS_DATATYPE_REAL:
+				EMIT("\t%c%i = _v.%c;", LOCAL(ret_type, dst), caLocalPrefix[ret_type]);
+				break;
+			case SS_DATATYPE_STRING:
+				EMIT("\t_ss_setstr(&s%i, _v.p);", _use(SS_DATATYPE_STRING, dst));
+				break;
+			default:
+				EMIT("\t_ss_release(_rt, _v.p);");
+				break;
+			}
+		}
+		if( direct && ret_type != SS_DATATYPE_NOVALUE )
+		{
+			if( dst < 0 && ret_type == SS_DATATYPE_STRING )
+				EMIT("\tSpiderScript_DereferenceString(_rv);");
+			else if( ret_type == SS_DATATYPE_STRING )
+				EMIT("\t_ss_setstr(&s%i, _rv);", _use(ret_type, dst));
+			else if( dst >= 0 )
+				EMIT("\t%c%i = _rv;", LOCAL(ret_type, dst));
+		}
+		EMIT("}");
+		return 1; }
+
+	// Globals, arrays, objects and exceptions stay in the interpreter
+	default:
+		return 0;
+	}
+
+	#undef EMIT
+	#undef TYPE
+	#undef LOCAL
+	#undef READ
+}
+
+/**
+ * \brief Translate a function
+ * \param FP	Destination, NULL to only check if the function can be translated
+ * \return Boolean success
+ */
+static int Bytecode_int_CGenFunction(tBC_CGen *G, int ID, FILE *FP)
+{
+	tScript_Function	*fcn = G->Script->FunctionTable[ID];
+	 int	ret = 0;
+	char	*body = NULL;
+	size_t	body_len = 0;
+
+	if( !fcn->BCFcn || fcn->IsVariable )
+		return 0;
+	// - Exceptions are caught by the interpreter's unwinding
+	if( fcn->BCFcn->HandlerCount )
+		return 0;
+	if( !Bytecode_int_CGenPrototype(G, fcn, ID, NULL) )
+		return 0;
+
+	tBC_Function	*code = Bytecode_int_CloneCode(fcn->BCFcn);
+	if( !code )
+		return 0;
+	int	*states = Bytecode_int_InferTypes(G->Script, fcn, code);
+	const int	count = code->InstructionCount;
+	const int	nregs = code->MaxRegisters;
+	G->FcnID = ID;
+	G->Fcn = fcn;
+	G->Code = code;
+	G->States = states;
+	G->NRegs = nregs;
+	G->Locals = calloc(nregs, sizeof(uint8_t));
+	G->IsString = calloc(nregs, sizeof(bool));
+	G->IsTarget = calloc(count, sizeof(bool));
+	G->UsesReturn = false;
+	G->UsesEntry = false;
+	G->FP = open_memstream(&body, &body_len);
+	if( !states || !G->Locals || !G->IsString || !G->IsTarget || !G->FP )
+		goto _out;
+
+	bool _reachable(int idx)
+	{
+		return nregs == 0 || states[idx * nregs] != TYPE_UNVISITED;
+	}
+	for( int i = 0; i < count; i ++ )
+	{
+		if( !_reachable(i) )
+			continue ;
+		for( int r = 0; r < nregs; r ++ )
+			G->IsString[r] |= (states[i * nregs + r] == SS_DATATYPE_STRING);
+		if( Bytecode_int_InsnIsJump(&code->Instructions[i]) )
+			G->IsTarget[ code->Instructions[i].DstReg ] = true;
+	}
+
+	 int	line = 0;
+	for( int i = 0; i < count; i ++ )
+	{
+		// Source positions become comments
+		const tBC_LineEnt	*pos = NULL;
+		if( line < code->InsnLineCount && code->InsnLines[line].PC == i )
+			pos = &code->InsnLines[line++];
+		if( !_reachable(i) )
+			continue ;
+		if( pos ) {
+			fprintf(G->FP, "\t// ");
+			for( const char *file = pos->File; *file; file ++ )
+				fputc( (*file < ' ' ? '?' : *file), G->FP );
+			fprintf(G->FP, ":%i\n", pos->Line);
+		}
+		if( G->IsTarget[i] )
+			fprintf(G->FP, "L%i:\n", i);
+		if( !Bytecode_int_CGenInsn(G, i) ) {
+			DEBUGS1("%s: Can't translate instruction %i (op %i)", fcn->Name, i, code->Instructions[i].Operation);
+			goto _out;
+		}
+	}
+	fclose(G->FP);
+	G->FP = NULL;
+	ret = 1;
+
+	if( !FP )
+		goto _out;
+
+	// Implementation
+	fprintf(FP, "// %s\n", fcn->Name);
+	Bytecode_int_CGenPrototype(G, fcn, ID, FP);
+	fprintf(FP, "\n{\n");
+	fprintf(FP, "\t int	rv = 0;\n");
+	for( int r = 0; r < nregs; r ++ )
+	{
+		if( G->IsString[r] )
+			G->Locals[r] |= 1 << SS_DATATYPE_STRING;
+		if( r < fcn->ArgumentCount )
+			G->Locals[r] |= 1 << Bytecode_int_GetTypeIdx(G->Script, fcn->Arguments[r].Type);
+		for( int t = SS_DATATYPE_BOOLEAN; t <= SS_DATATYPE_STRING; t ++ )
+		{
+			if( G->Locals[r] & (1 << t) )
+				fprintf(FP, "\t%s	%c%i = 0;\n", caCTypes[t], caLocalPrefix[t], r);
+		}
+	}
+	fprintf(FP, "\tchar	_sp;\n");
+	fprintf(FP, "\tif( _ss_enter(Script, &_sp) < 0 )\n\t\tgoto _err;\n");
+	for( int i = 0; i < fcn->ArgumentCount; i ++ )
+	{
+		 int	t = Bytecode_int_GetTypeIdx(G->Script, fcn->Arguments[i].Type);
+		if( t == SS_DATATYPE_STRING )
+			fprintf(FP, "\ts%i = _ss_refstr(a%i);\n", i, i);
+		else
+			fprintf(FP, "\t%c%i = a%i;\n", caLocalPrefix[t], i, i);
+	}
+	if( G->UsesEntry )
+		fprintf(FP, "_entry:\n");
+	fwrite(body, 1, body_len, FP);
+	fprintf(FP, "_err:\n\trv = -1;\n");
+	if( G->UsesReturn )
+		fprintf(FP, "_ret:\n");
+	for( int r = 0; r < nregs; r ++ )
+	{
+		if( G->Locals[r] & (1 << SS_DATATYPE_STRING) )
+			fprintf(FP, "\tSpiderScript_DereferenceString(s%i);\n", r);
+	}
+	fprintf(FP, "\t_ss_depth --;\n");
+	fprintf(FP, "\treturn rv;\n}\n");
+
+	// Entry point with the native function signature
+	fprintf(FP, "static int %s_e%i(tSpiderScript *Script, void *RetData, int NArgs, "
+		"const tSpiderTypeRef *ArgTypes, const void * const Args[])\n{\n", G->Prefix, ID);
+	if( fcn->ArgumentCount == 0 )
+		fprintf(FP, "\t(void)ArgTypes;\t(void)Args;\n");
+	fprintf(FP, "\tif( NArgs != %i )\n\t\treturn SpiderScript_ThrowException_ArgCount(Script, ", fcn->ArgumentCount);
+	Bytecode_int_CGenString(FP, fcn->Name, strlen(fcn->Name));
+	fprintf(FP, ", %i, NArgs);\n", fcn->ArgumentCount);
+	for( int i = 0; i < fcn->ArgumentCount; i ++ )
+	{
+		 int	t = Bytecode_int_GetTypeIdx(G->Script, fcn->Arguments[i].Type);
+		fprintf(FP, "\tif( !SS_TYPESEQUAL(ArgTypes[%i], _SS_TYPE(%s)) )\n", i, caTypeDefs[t]);
+		fprintf(FP, "\t\treturn SpiderScript_ThrowException(Script, SS_EXCEPTION_ARGUMENT,\n");
+		fprintf(FP, "\t\t\t\"Argument %%i of '%%s' should be %%s, given %%s\", %i, ", i);
+		Bytecode_int_CGenString(FP, fcn->Name, strlen(fcn->Name));
+		fprintf(FP, ",\n\t\t\tSpiderScript_GetTypeName(Script, _SS_TYPE(%s)), SpiderScript_GetTypeName(Script, ArgTypes[%i]));\n",
+			caTypeDefs[t], i);
+	}
+	fprintf(FP, "\treturn %s_f%i(Script", G->Prefix, ID);
+	if( code->ReturnTypeId != SS_DATATYPE_NOVALUE )
+		fprintf(FP, ", RetData");
+	for( int i = 0; i < fcn->ArgumentCount; i ++ )
+	{
+		 int	t = Bytecode_int_GetTypeIdx(G->Script, fcn->Arguments[i].Type);
+		if( t == SS_DATATYPE_STRING )
+			fprintf(FP, ", (tSpiderString*)Args[%i]", i);
+		else
+			fprintf(FP, ", *(const %s*)Args[%i]", caCTypes[t], i);
+	}
+	fprintf(FP, ");\n}\n\n");
+
+_out:
+	if( G->FP )
+		fclose(G->FP);
+	G->FP = NULL;
+	free(body);
+	free(G->Locals);
+	free(G->IsString);
+	free(G->IsTarget);
+	free(states);
+	Bytecode_int_FreeTier(code);
+	return ret;
+}
+
+/**
+ * \brief Translate a script's functions to C
+ */
+int SpiderScript_SaveC(tSpiderScript *Script, const char *DestFile, const char *Prefix)
+{
+	tBC_CGen	gen = {.Script = Script, .Prefix = Prefix};
+	 int	n = 0;
+
+	Bytecode_int_InitTypes(Script);
+
+	gen.Translated = calloc(Script->nFunctions + 1, sizeof(bool));
+	if( !gen.Translated )
+		return -1;
+	FILE	*fp = fopen(DestFile, "w");
+	if( !fp ) {
+		free(gen.Translated);
+		return -1;
+	}
+
+	// Work out which functions can be translated first, calls to them are made directly
+	for( int i = 0; i < Script->nFunctions; i ++ )
+	{
+		gen.Translated[i] = Bytecode_int_CGenFunction(&gen, i, NULL);
+		n += gen.Translated[i];
+	}
+
+	fprintf(fp, "/*\n * Generated by SpiderScript_SaveC, do not edit\n */\n");
+	fputs(csCGenPrelude, fp);
+	for( int i = 0; i < Script->nFunctions; i ++ )
+	{
+		if( !gen.Translated[i] )
+			continue ;
+		Bytecode_int_CGenPrototype(&gen, Script->FunctionTable[i], i, fp);
+		fprintf(fp, ";\n");
+	}
+	fprintf(fp, "\n");
+	for( int i = 0; i < Script->nFunctions; i ++ )
+	{
+		if( gen.Translated[i] && !Bytecode_int_CGenFunction(&gen, i, fp) ) {
+			fclose(fp);
+			free(gen.Translated);
+			return -1;
+		}
+	}
+
+	fprintf(fp, "const tSpiderNativeFunction	%s_Functions[] = {\n", Prefix);
+	for( int i = 0; i < Script->nFunctions; i ++ )
+	{
+		tScript_Function	*fcn = Script->FunctionTable[i];
+		if( !gen.Translated[i] )
+			continue ;
+		tBC_Function	*code = Bytecode_int_CloneCode(fcn->BCFcn);
+		if( !code )
+			continue ;
+		fprintf(fp, "\t{");
+		Bytecode_int_CGenString(fp, fcn->Name, strlen(fcn->Name));
+		fprintf(fp, ", 0x%08"PRIx32", %s_e%i},\n", Bytecode_int_HashFunction(Script, fcn, code), Prefix, i);
+		Bytecode_int_FreeTier(code);
+	}
+	fprintf(fp, "\t{NULL, 0, NULL}\n};\n");
+
+	fclose(fp);
+	free(gen.Translated);
+	return n;
+}
+
+/**
+ * \brief Run the compiled versions of a script's functions
+ */
+int SpiderScript_RegisterNative(tSpiderScript *Script, const tSpiderNativeFunction *Functions)
+{
+	 int	n = 0;
+
+	Bytecode_int_InitTypes(Script);
+
+	for( ; Functions->Name; Functions ++ )
+	{
+		tScript_Function	*fcn;
+		for( fcn = Script->Functions; fcn; fcn = fcn->Next )
+		{
+			if( strcmp(fcn->Name, Functions->Name) == 0 )
+				break;
+		}
+		if( !fcn || !fcn->BCFcn )
+			continue ;
+
+		tBC_Function	*code = Bytecode_int_CloneCode(fcn->BCFcn);
+		if( !code )
+			continue ;
+		uint32_t	hash = Bytecode_int_HashFunction(Script, fcn, code);
+		Bytecode_int_FreeTier(code);
+		if( hash != Functions->Hash ) {
+			DEBUGS1("%s: Bytecode has changed, compiled version not used", fcn->Name);
+			continue ;
+		}
+
+		fcn->Native = Functions->Handler;
+		n ++;
+	}
+	return n;
+}
@@ -0,0 +1,492 @@
+/*
+ * SpiderScript Library
+ * by John Hodge (thePowersGang)
+ *
+ * bytecode_verify.c
+ * - Load-time type verification of flattened bytecode
+ */
+#define DEBUG	0
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "common.h"
+#include "bytecode.h"
+#include "bytecode_gen.h"
+
+// Register state for a value that differs between paths (or is unknown)
+#define TYPE_UNKNOWN	-1
+// Instruction state before the instruction is first reached
+#define TYPE_UNVISITED	-2
+
+// === PROTOTYPES ===
+ int	*Bytecode_int_InferTypes(tSpiderScript *Script, tScript_Function *Fcn, tBC_Function *BCFcn);
+ int	Bytecode_VerifyFunction(tSpiderScript *Script, tScript_Function *Fcn);
+ int	Bytecode_VerifyScript(tSpiderScript *Script);
+static int	Bytecode_int_CallReturnType(tSpiderScript *Script, const tBC_Insn *Insn, const int *Regs);
+static int	Bytecode_int_VerifyInsn(tSpiderScript *Script, tBC_Function *BCFcn, const tBC_Insn *Insn, int *Regs);
+
+// === CODE ===
+/**
+ * \brief Get the type of the value returned by a call
+ * \return Type index, or TYPE_UNKNOWN if the callee can't be resolved statically
+ * \note Only calls into script functions are resolved, their RETURN enforces the stated type
+ */
+static int Bytecode_int_CallReturnType(tSpiderScript *Script, const tBC_Insn *Insn, const int *Regs)
+{
+	const tBC_Op	*op = Insn->Content.Op;
+	 int	id = op->Content.Function.ID;
+	tScript_Function	*fcn = NULL;
+
+	switch(Insn->Operation)
+	{
+	case BC_OP_CREATEOBJ:
+		if( id < 0 || id >= Script->BCTypeCount )
+			return TYPE_UNKNOWN;
+		if( Script->BCTypes[id].ArrayDepth || !SS_ISTYPEOBJECT(Script->BCTypes[id]) )
+			return TYPE_UNKNOWN;
+		return id;
+	case BC_OP_CALLFUNCTION:
+	case BC_OP_TAILCALLFUNCTION:
+		if( (id >> 16) != 0 )
+			return TYPE_UNKNOWN;
+		if( id >= Script->nFunctions )
+			return TYPE_UNKNOWN;
+		fcn = Script->FunctionTable[id];
+		break;
+	case BC_OP_CALLMETHOD:
+	case BC_OP_TAILCALLMETHOD: {
+		if( (op->Content.Function.ArgCount & BC_CALL_ARGCOUNT_MASK) < 1 )
+			return TYPE_UNKNOWN;
+		 int	this_type = Regs[ op->Content.Function.ArgRegs[0] ];
+		if( this_type < 0 )
+			return TYPE_UNKNOWN;
+		tSpiderTypeRef	type = Script->BCTypes[this_type];
+		if( !SS_ISTYPEOBJECT(type) || type.Def->Class != SS_TYPECLASS_SCLASS )
+			return TYPE_UNKNOWN;
+		if( id >= type.Def->SClass->nFunctions )
+			return TYPE_UNKNOWN;
+		fcn = type.Def->SClass->Functions[id];
+		break; }
+	default:
+		return TYPE_UNKNOWN;
+	}
+
+	if( !fcn )
+		return TYPE_UNKNOWN;
+	return Bytecode_int_GetTypeIdx(Script, fcn->ReturnType);
+}
+
+/**
+ * \brief Check the operand types of an instruction and apply its effect to the register state
+ * \return Boolean success (false if the operand types can't be proven)
+ */
+static int Bytecode_int_VerifyInsn(tSpiderScript *Script, tBC_Function *BCFcn, const tBC_Insn *Insn, int *Regs)
+{
+	const int	nregs = BCFcn->MaxRegisters;
+	const int	dst = Insn->DstReg;
+	const int	r2 = Insn->Content.RegInt.RegInt2;
+	const int	r3 = Insn->Content.RegInt.RegInt3;
+
+	#define _REG(idx)	do { if( (idx) < 0 || (idx) >= nregs )	return 0; } while(0)
+	#define _EXPECT(idx, type)	do { _REG(idx); if( Regs[idx] != (type) ) return 0; } while(0)
+	#define _SET(idx, type)	do { _REG(idx); Regs[idx] = (type); } while(0)
+
+	switch(Insn->Operation)
+	{
+	case BC_OP_NOP:
+	case BC_OP_IMPORTGLOBAL:
+	case BC_OP_JUMP:
+		return 1;
+
+	case BC_OP_JUMPIF:
+	case BC_OP_JUMPIFNOT:
+		_REG(r2);
+		return 1;
+
+	case BC_OP_GETGLOBAL:
+		_SET(dst, TYPE_UNKNOWN);
+		return 1;
+	case BC_OP_SETGLOBAL:
+		_REG(dst);
+		return 1;
+
+	case BC_OP_LOADNULLREF:
+		if( r2 < 0 || r2 >= Script->BCTypeCount )
+			return 0;
+		if( !SS_ISTYPEREFERENCE(Script->BCTypes[r2]) )
+			return 0;
+		_SET(dst, r2);
+		return 1;
+	case BC_OP_LOADINT:
+		_SET(dst, SS_DATATYPE_INTEGER);
+		return 1;
+	case BC_OP_LOADREAL:
+		_SET(dst, SS_DATATYPE_REAL);
+		return 1;
+	case BC_OP_LOADSTRING:
+		_SET(dst, SS_DATATYPE_STRING);
+		return 1;
+
+	case BC_OP_RETURN:
+		if( dst >= 0 && BCFcn->ReturnTypeId != SS_DATATYPE_NOVALUE )
+			_EXPECT(dst, BCFcn->ReturnTypeId);
+		return 1;
+	case BC_OP_CLEARREG:
+		_SET(dst, SS_DATATYPE_NOVALUE);
+		return 1;
+	case BC_OP_MOV:
+		_REG(r2);
+		_SET(dst, Regs[r2]);
+		return 1;
+	case BC_OP_MOV_MOVE: {
+		_REG(r2);
+		 int	type = Regs[r2];
+		Regs[r2] = SS_DATATYPE_NOVALUE;
+		_SET(dst, type);
+		return 1; }
+
+	case BC_OP_CREATEARRAY:
+		if( r2 < 0 || r2 >= Script->BCTypeCount || Script->BCTypes[r2].ArrayDepth == 0 )
+			return 0;
+		_EXPECT(r3, SS_DATATYPE_INTEGER);
+		_SET(dst, r2);
+		return 1;
+	case BC_OP_CREATEOBJ:
+	case BC_OP_CALLFUNCTION:
+	case BC_OP_CALLMETHOD:
+	case BC_OP_TAILCALLFUNCTION:
+	case BC_OP_TAILCALLMETHOD: {
+		const tBC_Op	*op = Insn->Content.Op;
+		const int	argc = op->Content.Function.ArgCount & BC_CALL_ARGCOUNT_MASK;
+		for( int i = 0; i < argc; i ++ )
+			_REG(op->Content.Function.ArgRegs[i]);
+		 int	ret_type = Bytecode_int_CallReturnType(Script, Insn, Regs);
+		// A window is consumed by the call, and the callee's registers cover everything above it
+		if( (op->Content.Function.ArgCount & BC_CALL_WINDOW) && argc > 0 ) {
+			for( int i = 1; i < argc; i ++ ) {
+				if( op->Content.Function.ArgRegs[i] != op->Content.Function.ArgRegs[0] + i )
+					return 0;
+			}
+			for( int r = op->Content.Function.ArgRegs[0]; r < nregs; r ++ )
+				Regs[r] = SS_DATATYPE_NOVALUE;
+		}
+		_SET(dst, ret_type);
+		return 1; }
+
+	case BC_OP_GETINDEX:
+	case BC_OP_SETINDEX:
+	case BC_OP_GETINDEX_INRANGE:
+	case BC_OP_SETINDEX_INRANGE: {
+		_EXPECT(r3, SS_DATATYPE_INTEGER);
+		_REG(r2);
+		if( Regs[r2] < 0 )
+			return 0;
+		tSpiderTypeRef	type = Script->BCTypes[ Regs[r2] ];
+		if( type.ArrayDepth == 0 )
+			return 0;
+		if( Insn->Operation == BC_OP_SETINDEX || Insn->Operation == BC_OP_SETINDEX_INRANGE ) {
+			_REG(dst);
+		}
+		else {
+			type.ArrayDepth --;
+			_SET(dst, Bytecode_int_GetTypeIdx(Script, type));
+		}
+		return 1; }
+	// foreach, the state is a register pair (collection, index)
+	case BC_OP_FOREACH_INIT:
+		_REG(r2);
+		if( Regs[r2] < 0 )
+			return 0;
+		if( Regs[r2] != SS_DATATYPE_STRING && Script->BCTypes[ Regs[r2] ].ArrayDepth == 0 )
+			return 0;
+		_REG(dst + 1);
+		_SET(dst, Regs[r2]);
+		_SET(dst + 1, SS_DATATYPE_INTEGER);
+		return 1;
+	case BC_OP_FOREACH_NEXT: {
+		_REG(r2);
+		_EXPECT(r2 + 1, SS_DATATYPE_INTEGER);
+		if( Regs[r2] < 0 )
+			return 0;
+		// - Strings are iterated as bytes
+		if( Regs[r2] == SS_DATATYPE_STRING ) {
+			_SET(r3, SS_DATATYPE_INTEGER);
+			return 1;
+		}
+		tSpiderTypeRef	type = Script->BCTypes[ Regs[r2] ];
+		if( type.ArrayDepth == 0 )
+			return 0;
+		type.ArrayDepth --;
+		_SET(r3, Bytecode_int_GetTypeIdx(Script, type));
+		return 1; }
+	case BC_OP_GETELEMENT:
+		_REG(r2);
+		_SET(dst, TYPE_UNKNOWN);
+		return 1;
+	case BC_OP_SETELEMENT:
+		_REG(r2);
+		_REG(dst);
+		return 1;
+
+	case BC_OP_CAST:
+		_REG(r3);
+		if( r2 < SS_DATATYPE_BOOLEAN || r2 > SS_DATATYPE_STRING )
+			return 0;
+		_SET(dst, r2);
+		return 1;
+
+	case BC_OP_BOOL_LOGICNOT:
+		_REG(r2);
+		_SET(dst, SS_DATATYPE_BOOLEAN);
+		return 1;
+	case BC_OP_REFEQ:
+	case BC_OP_REFNEQ:
+	case BC_OP_BOOL_EQUALS:
+	case BC_OP_BOOL_LOGICAND:
+	case BC_OP_BOOL_LOGICOR:
+	case BC_OP_BOOL_LOGICXOR:
+	case BC_OP_STR_EQUALS ... BC_OP_STR_GREATERTHANEQ:
+		_REG(r2);
+		_REG(r3);
+		_SET(dst, SS_DATATYPE_BOOLEAN);
+		return 1;
+	case BC_OP_STR_ADD:
+		_REG(r2);
+		_REG(r3);
+		_SET(dst, SS_DATATYPE_STRING);
+		return 1;
+
+	case BC_OP_INT_BITNOT:
+	case BC_OP_INT_NEG:
+	case BC_OP_INT_ADDI:
+		_EXPECT(r2, SS_DATATYPE_INTEGER);
+		_SET(dst, SS_DATATYPE_INTEGER);
+		return 1;
+	case BC_OP_REAL_NEG:
+		_EXPECT(r2, SS_DATATYPE_REAL);
+		_SET(dst, SS_DATATYPE_REAL);
+		return 1;
+
+	case BC_OP_INT_BITAND ... BC_OP_INT_MODULO:
+		_EXPECT(r2, SS_DATATYPE_INTEGER);
+		_EXPECT(r3, SS_DATATYPE_INTEGER);
+		_SET(dst, SS_DATATYPE_INTEGER);
+		return 1;
+	case BC_OP_INT_EQUALS ... BC_OP_INT_GREATERTHANEQ:
+		_EXPECT(r2, SS_DATATYPE_INTEGER);
+		_EXPECT(r3, SS_DATATYPE_INTEGER);
+		_SET(dst, SS_DATATYPE_BOOLEAN);
+		return 1;
+	case BC_OP_REAL_ADD ... BC_OP_REAL_DIVIDE:
+		_EXPECT(r2, SS_DATATYPE_REAL);
+		_EXPECT(r3, SS_DATATYPE_REAL);
+		_SET(dst, SS_DATATYPE_REAL);
+		return 1;
+	case BC_OP_REAL_EQUALS ... BC_OP_REAL_GREATERTHANEQ:
+		_EXPECT(r2, SS_DATATYPE_REAL);
+		_EXPECT(r3, SS_DATATYPE_REAL);
+		_SET(dst, SS_DATATYPE_BOOLEAN);
+		return 1;
+
+	case BC_OP_JUMPIF_INT_EQ ... BC_OP_JUMPIF_INT_GE:
+	case BC_OP_INT_INC_JUMPIF_EQ ... BC_OP_INT_INC_JUMPIF_GE:
+		_EXPECT(r2, SS_DATATYPE_INTEGER);
+		_EXPECT(r3, SS_DATATYPE_INTEGER);
+		return 1;
+	case BC_OP_JUMPIF_REAL_EQ ... BC_OP_JUMPIFNOT_REAL_GE:
+		_EXPECT(r2, SS_DATATYPE_REAL);
+		_EXPECT(r3, SS_DATATYPE_REAL);
+		return 1;
+
+	default:
+		return 0;
+	}
+
+	#undef _SET
+	#undef _EXPECT
+	#undef _REG
+}
+
+/**
+ * \brief Propagate register types through a function's instructions
+ * \param BCFcn	Code to check (normally Fcn->BCFcn)
+ * \return Register types on entry to each instruction (InstructionCount * MaxRegisters, free()
+ *         when done), or NULL if the operand types can't be proven
+ *
+ * Propagates the type of each register along all paths through the function, unreachable
+ * instructions are left as TYPE_UNVISITED.
+ */
+int *Bytecode_int_InferTypes(tSpiderScript *Script, tScript_Function *Fcn, tBC_Function *BCFcn)
+{
+	if( !BCFcn || !BCFcn->Instructions )
+		return NULL;
+
+	const int	count = BCFcn->InstructionCount;
+	const int	nregs = BCFcn->MaxRegisters;
+	const tBC_Insn	*insns = BCFcn->Instructions;
+
+	BCFcn->ReturnTypeId = Bytecode_int_GetTypeIdx(Script, Fcn->ReturnType);
+	if( BCFcn->ReturnTypeId < 0 )
+		return NULL;
+	if( Fcn->ArgumentCount > nregs )
+		return NULL;
+
+	// Register types on entry to each instruction
+	int	*states = malloc( count * nregs * sizeof(int) );
+	 int	*worklist = malloc( count * sizeof(int) );
+	bool	*queued = calloc( count, sizeof(bool) );
+	 int	regs[nregs];
+	 int	n_work = 0;
+	if( !states || !worklist || !queued )
+		goto _err;
+	for( int i = 0; i < count * nregs; i ++ )
+		states[i] = TYPE_UNVISITED;
+
+	// Merge a register state into an instruction's entry state, queueing it on change
+	bool _merge(int idx, const int *state)
+	{
+		if( idx < 0 || idx >= count )
+			return false;
+		int *dst = &states[idx * nregs];
+		bool	changed = false;
+		for( int r = 0; r < nregs; r ++ )
+		{
+			if( dst[r] == state[r] )
+				continue ;
+			if( dst[r] == TYPE_UNKNOWN )
+				continue ;
+			dst[r] = (dst[r] == TYPE_UNVISITED ? state[r] : TYPE_UNKNOWN);
+			changed = true;
+		}
+		if( changed && !queued[idx] ) {
+			queued[idx] = true;
+			worklist[n_work++] = idx;
+		}
+		return true;
+	}
+
+	// Arguments are checked against the stated types when a verified function is called
+	for( int r = 0; r < nregs; r ++ )
+		regs[r] = SS_DATATYPE_NOVALUE;
+	for( int i = 0; i < Fcn->ArgumentCount; i ++ )
+	{
+		regs[i] = Bytecode_int_GetTypeIdx(Script, Fcn->Arguments[i].Type);
+		if( regs[i] == SS_DATATYPE_UNDEF )
+			regs[i] = TYPE_UNKNOWN;
+	}
+	_merge(0, regs);
+
+	while( n_work > 0 )
+	{
+		 int	idx = worklist[--n_work];
+		const tBC_Insn	*insn = &insns[idx];
+		queued[idx] = false;
+		memcpy(regs, &states[idx * nregs], sizeof(regs));
+
+		// Any instruction in a handler's range can enter it, before or after its destination
+		// is written (it can also be left released)
+		const tBC_HandlerEnt	*handler = NULL;
+		for( int h = 0; h < BCFcn->HandlerCount && !handler; h ++ )
+		{
+			const tBC_HandlerEnt	*ent = &BCFcn->InsnHandlers[h];
+			if( ent->Start <= idx && idx < ent->End )
+				handler = ent;
+		}
+		if( handler ) {
+			 int	caught[nregs];
+			memcpy(caught, regs, sizeof(regs));
+			caught[handler->CatchReg] = handler->CatchType;
+			if( !_merge(handler->Handler, caught) )
+				goto _err;
+		}
+
+		// FOREACH_NEXT only loads the value when it doesn't jump
+		const int	val_reg = insn->Content.RegInt.RegInt3;
+		const bool	is_next = (insn->Operation == BC_OP_FOREACH_NEXT && 0 <= val_reg && val_reg < nregs);
+		const int	val_type = (is_next ? regs[val_reg] : TYPE_UNKNOWN);
+
+		if( !Bytecode_int_VerifyInsn(Script, BCFcn, insn, regs) ) {
+			DEBUGS1("%s: Can't verify instruction %i (op %i)", Fcn->Name, idx, insn->Operation);
+			goto _err;
+		}
+
+		if( handler ) {
+			 int	caught[nregs];
+			memcpy(caught, regs, sizeof(regs));
+			if( 0 <= insn->DstReg && insn->DstReg < nregs
+			 && Bytecode_int_InsnRegUse(insn, insn->DstReg) == BC_REGUSE_WRITE )
+				caught[insn->DstReg] = TYPE_UNKNOWN;
+			caught[handler->CatchReg] = handler->CatchType;
+			if( !_merge(handler->Handler, caught) )
+				goto _err;
+		}
+
+		if( insn->Operation == BC_OP_RETURN )
+			continue ;
+		switch( Bytecode_int_InsnIsJump(insn) )
+		{
+		case 1:
+			if( !_merge(insn->DstReg, regs) )
+				goto _err;
+			break;
+		case 2:
+			if( !_merge(idx + 1, regs) )
+				goto _err;
+			if( is_next )
+				regs[val_reg] = val_type;
+			if( !_merge(insn->DstReg, regs) )
+				goto _err;
+			break;
+		default:
+			if( !_merge(idx + 1, regs) )
+				goto _err;
+			break;
+		}
+	}
+
+	free(worklist);
+	free(queued);
+	return states;
+_err:
+	free(states);
+	free(worklist);
+	free(queued);
+	return NULL;
+}
+
+/**
+ * \brief Prove the operand types of every reachable instruction in a function
+ * \return Boolean verified
+ *
+ * A verified function is executed without the per-operation type checks.
+ */
+int Bytecode_VerifyFunction(tSpiderScript *Script, tScript_Function *Fcn)
+{
+	tBC_Function	*bcfcn = Fcn->BCFcn;
+	if( !bcfcn || !bcfcn->Instructions )
+		return 0;
+
+	int	*states = Bytecode_int_InferTypes(Script, Fcn, bcfcn);
+	bcfcn->IsVerified = (states != NULL);
+	free(states);
+	DEBUGS1("%s: %s", Fcn->Name, (bcfcn->IsVerified ? "verified" : "not verified"));
+	return bcfcn->IsVerified;
+}
+
+/**
+ * \brief Verify all functions and methods in a script
+ * \return Number of functions that passed verification
+ */
+int Bytecode_VerifyScript(tSpiderScript *Script)
+{
+	 int	ret = 0;
+	for( tScript_Function *fcn = Script->Functions; fcn; fcn = fcn->Next )
+		ret += Bytecode_VerifyFunction(Script, fcn);
+	for( tScript_Class *sc = Script->FirstClass; sc; sc = sc->Next )
+	{
+		for( tScript_Function *fcn = sc->FirstFunction; fcn; fcn = fcn->Next )
+			ret += Bytecode_VerifyFunction(Script, fcn);
+	}
+	return ret;
+}
@@ -33,6 +33,9 @@ static int dbg_indent = 0;
 #define MAX_BACKTRACE_SIZE	8
 #define CONSTRUCTOR_NAME	"__constructor"
 #define BC_NS_SEPARATOR	'@'
+// Default per-frame budgets (see SpiderScript_SetExecLimit), also bound functions being compiled
+#define DEF_MAX_FRAME_REGISTERS	4096
+#define DEF_MAX_FRAME_GLOBALS	1024
 
 typedef struct sScript_Function	tScript_Function;
 typedef struct sScript_Arg	tScript_Arg;
@@ -46,6 +49,9 @@ struct sSpiderScript
 	
 	tScript_Function	*Functions;
 	tScript_Function	*LastFunction;
+	// Functions indexed by ID (see SpiderScript_int_BuildTables)
+	 int	nFunctions;
+	tScript_Function	**FunctionTable;
 	
 	tScript_Class	*FirstClass;
 	tScript_Class	*LastClass;
@@ -61,6 +67,25 @@ struct sSpiderScript
 	 int	BCTypeCount;
 	 int	BCTypeSpace;
 	tSpiderTypeRef	*BCTypes;
+
+	// Execution budgets (0 = default, see SpiderScript_SetExecLimit)
+	 int	MaxFrameRegisters;
+	 int	MaxFrameGlobals;
+	size_t	MaxStackSize;
+
+	enum eSpiderScript_OptimiseLevel	OptimiseLevel;	// Applied to compiled and loaded bytecode
+
+	// Bytecode VM stack (see exec_bytecode.c)
+	struct sBC_StackChunk	*BCStack;
+	struct sBC_StackChunk	*BCRegStack;	// Registers, kept apart so frames can share argument windows
+	size_t	BCStackUsed;	// Bytes used on both stacks
+
+	// Re-optimisation of hot functions (see bytecode_tier.c)
+	 int	TierThreshold;	// Calls before a function is re-optimised, 0 = default, -1 = off
+
+	// Native code (see bytecode_jit.c)
+	 int	JitThreshold;	// Calls plus loop iterations before a function is compiled, 0 = off
+	struct sBC_JitArena	*JitArena;
 };
 
 struct sScript_Arg
@@ -80,6 +105,8 @@ struct sScript_Function
 	
 	struct sAST_Node	*ASTFcn;
 	struct sBC_Function	*BCFcn;
+	// Compiled version, run in place of the bytecode (see SpiderScript_RegisterNative)
+	 int	(*Native)(tSpiderScript *Script, void *RetData, int nArgs, const tSpiderTypeRef *ArgTypes, const void * const Args[]);
 
 	bool	IsVariable;
 	 int	ArgumentCount;
@@ -110,6 +137,7 @@ struct sScript_Class
 	tScript_Var	**Properties;
 	 int	nFunctions;
 	tScript_Function	**Functions;
+	tScript_Function	*Constructor;	// Set by SpiderScript_int_BuildTables
 
 	char	Name[];
 };
@@ -118,6 +146,8 @@ extern char	*mkstr(const char *Format, ...);
 extern char	*mkstrv(const char *format, va_list args);
 
 extern int	SpiderScript_BytecodeScript(tSpiderScript *Script);
+extern int	SpiderScript_int_BuildTables(tSpiderScript *Script);
+extern int	SpiderScript_Link(tSpiderScript *Script);
 extern tSpiderClass *SpiderScript_GetClass_Native(tSpiderScript *Script, int Type);
 extern tScript_Class *SpiderScript_GetClass_Script(tSpiderScript *Script, int Type);
 
@@ -128,6 +158,7 @@ extern int	giNumExportedClasses;
 
 extern int	Bytecode_ExecuteFunction(tSpiderScript *Script, tScript_Function *Fcn,
 	void *RetValue, int NArgs, const tSpiderTypeRef *ArgTypes, const void * const Args[]);
+extern void	Bytecode_FreeStack(tSpiderScript *Script);
 
 extern tSpiderScript_TypeDef	*SpiderScript_ResolveObject(tSpiderScript *Script, const char *Namespaces[], const char *Name);
 extern int	SpiderScript_ResolveFunction(tSpiderScript *Script, const char *Namespaces[], const char *Name, void **Ident);
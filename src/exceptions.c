@@ -117,6 +117,7 @@ void SpiderScript_ClearException(tSpiderScript *Script)
 	Script->CurException = 0;
 	if( Script->CurExceptionString )
 		free( Script->CurExceptionString );
+	Script->CurExceptionString = NULL;
 }
 
 
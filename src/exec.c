@@ -234,8 +234,8 @@ int SpiderScript_int_ExecuteFunction(tSpiderScript *Script, int FunctionID,
 		switch( FunctionID >> 16 )
 		{
 		case 0:	// Script
-			for( sfcn = Script->Functions; sfcn && i --; sfcn = sfcn->Next )
-				;
+			if( i < Script->nFunctions )
+				sfcn = Script->FunctionTable[i];
 			break;
 		case 1:	// Exports
 			if( i < giNumExportedFunctions )
@@ -333,12 +333,8 @@ int SpiderScript_int_ExecuteMethod(tSpiderScript *Script, int MethodID,
 		if( Object->TypeDef->Class == SS_TYPECLASS_SCLASS )
 		{
 			sc = Object->TypeDef->SClass;
-			for( i = 0, sf = sc->FirstFunction; sf; sf = sf->Next )
-			{
-				if( i == MethodID )
-					break ;
-				i ++;
-			}
+			if( MethodID >= 0 && MethodID < sc->nFunctions )
+				sf = sc->Functions[MethodID];
 			if( !sf )
 			{
 				SpiderScript_ThrowException(Script, SS_EXCEPTION_NAMEERROR,
@@ -510,11 +506,7 @@ int SpiderScript_int_ConstructObject(tSpiderScript *Script, const tSpiderScript_
 		obj = SpiderScript_AllocateScriptObject(Script, sc);
 
 		// Call constructor?
-		for( f = sc->FirstFunction; f; f = f->Next )
-		{
-			if( strcmp(f->Name, CONSTRUCTOR_NAME) == 0 )
-				break;
-		}
+		f = sc->Constructor;
 		
 		*RetData = obj;
 			
@@ -551,8 +543,7 @@ const char *SpiderScript_int_GetFunctionName(tSpiderScript *Script, int Function
 	switch( FunctionID >> 16 )
 	{
 	case 0:	// Script
-		for( sf = Script->Functions; sf && i --; sf = sf->Next )
-			;
+		sf = (i < Script->nFunctions ? Script->FunctionTable[i] : NULL);
 		return sf ? sf->Name : "-BADID-";
 	case 1:	// Exports
 		if( i < giNumExportedFunctions )
@@ -573,10 +564,9 @@ const char *SpiderScript_int_GetMethodName(tSpiderScript *Script, tSpiderTypeRef
 	if( ObjType.Def->Class == SS_TYPECLASS_SCLASS )
 	{
 		tScript_Class	*sc = ObjType.Def->SClass;
-		tScript_Function	*sf = sc->FirstFunction;
-		for( int i = 0; sf && i != MethodID; sf = sf->Next, i ++ )
-			;
-		return sf ? sf->Name : "-BADID-";
+		if( MethodID < 0 || MethodID >= sc->nFunctions )
+			return "-BADID-";
+		return sc->Functions[MethodID]->Name;
 	}
 	else if( ObjType.Def->Class == SS_TYPECLASS_NCLASS )
 	{
@@ -325,7 +325,8 @@ int AST_ExecuteNode_Index(tSpiderScript *Script, void *RetData,
 		return -1;
 	}
 
-	if( NewData )
+	// Stores have no destination (the value may be a null reference)
+	if( !RetData )
 	{
 		if( !SS_TYPESEQUAL(NewType, Array->Type) ) {
 			// TODO: Implicit casting?
@@ -438,7 +439,8 @@ tSpiderTypeRef AST_ExecuteNode_Element(tSpiderScript *Script, void *RetData,
 	}
 	
 	void	**attr_ptr = &Object->Attributes[ElementIndex];
-	if( NewData )
+	// Stores have no destination (the value may be a null reference)
+	if( !RetData )
 	{
 		if( !SS_TYPESEQUAL(type, NewType) ) {
 			SpiderScript_ThrowException(Script, SS_EXCEPTION_TYPEMISMATCH,
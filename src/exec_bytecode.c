@@ -15,37 +15,99 @@
 #include "ast.h"
 #include <inttypes.h>
 #include <stdarg.h>
+#include <assert.h>
 
 
 #define DEREF_BEFORE_SET	1
 
+// Default execution budgets (see SpiderScript_SetExecLimit, and common.h for the frame budgets)
+#define DEF_MAX_STACK_SIZE	(16*1024*1024)
+#define DEF_TIER_THRESHOLD	1000	// Calls before a function is re-optimised
+#define TIER_LOOP_SCALE	16	// Loop back-edges counted as one call
+// Minimum size of a VM stack chunk
+#define STACK_CHUNK_SIZE	(64*1024)
+
+// Dispatch using GCC's labels-as-values (threaded code)
+#ifdef __GNUC__
+# define USE_THREADED_DISPATCH	1
+#else
+# define USE_THREADED_DISPATCH	0
+#endif
+
 // Values for BytecodeTraceLevel
 // 1: Opcode trace
 // 2: Register trace
-#define TRACECOND(code)	do{ if(Script->BytecodeTraceLevel>=SS_TRACE_OPCODES){code;} }while(0)
+// - TRACE_COMPILED is 0 in the untraced interpreter loop (see exec_bytecode_loop.h)
+#define TRACE_COMPILED	1
+#define TRACECOND(code)	do{ if(TRACE_COMPILED && Script->BytecodeTraceLevel>=SS_TRACE_OPCODES){code;} }while(0)
 #define DEBUG_F(v...)	TRACECOND(printf(v))
 
 #define TODO(str)	SpiderScript_RuntimeError(Script, "TODO: Impliment bytecode"str); bError = 1; break
 
 // === TYPES ===
-typedef struct sBC_StackEnt	tBC_StackEnt;
+typedef struct sBC_StackChunk	tBC_StackChunk;
+typedef struct sBC_Frame	tBC_Frame;
 
-struct sBC_StackEnt
+/**
+ * \brief Segment of the VM stack (or register stack)
+ * \note Frames never span chunks, emptied chunks are kept (as ->Next) for reuse
+ */
+struct sBC_StackChunk
 {
-	tSpiderTypeRef	Type;
-	union {
-		tSpiderBool	Boolean;
-		tSpiderInteger	Integer;
-		tSpiderReal 	Real;
-		tSpiderString	*String;
-		tSpiderArray	*Array;
-		tSpiderObject	*Object;
-	};
+	tBC_StackChunk	*Prev;
+	tBC_StackChunk	*Next;
+	size_t	Size;
+	size_t	Used;
+	char	Data[] __attribute__((aligned(16)));
+};
+
+/**
+ * \brief Activation record of a script function
+ * \note Allocated from the VM stack, followed by the globals and variable arguments
+ *
+ * Registers are on the register stack, where a call with an argument window (see
+ * Bytecode_AppendWindowCall) places the callee's registers over the caller's window.
+ */
+struct sBC_Frame
+{
+	tBC_Frame	*Caller;	//!< NULL for the first frame of an ExecuteFunction call
+	tScript_Function	*Fcn;
+	size_t	FrameSize;
+	tBC_StackEnt	*RetVal;	//!< Destination of the return value (may be NULL)
+	const tBC_Insn	*CurOp;	//!< Current instruction while a callee runs
+	
+	 int	VArgC;
+	const tBC_StackEnt	**VArgs;
+	
+	tBC_StackEnt	*Registers;
+	tScript_Var	**Globals;
+
+	// Register stack state to restore on return
+	tBC_StackChunk	*RegChunk;
+	size_t	RegUsed;
+	size_t	RegBytes;	//!< Bytes added to BCStackUsed
 };
 
 // === PROTOTYPES ===
+static inline int	Bytecode_int_GetTypeId(tSpiderScript *Script, tSpiderTypeRef Type);
+static void	*Bytecode_int_StackAlloc(tSpiderScript *Script, tBC_StackChunk **Stack, size_t Bytes);
+static void	Bytecode_int_StackFree(tSpiderScript *Script, void *Ptr, size_t Bytes);
+static tBC_StackEnt	*Bytecode_int_RegAlloc(tSpiderScript *Script, tBC_Frame *Frame, int Count, tBC_StackEnt *Window);
+static void	Bytecode_int_RegFree(tSpiderScript *Script, tBC_Frame *Frame);
+static tBC_Frame	*Bytecode_int_PushFrame(tSpiderScript *Script, tScript_Function *Fcn, int ArgCount, const tBC_StackEnt *Args[], tBC_StackEnt *Window, tBC_Frame *Caller, tBC_StackEnt *RetVal);
+static tBC_Frame	*Bytecode_int_PopFrame(tSpiderScript *Script, tBC_Frame *Frame);
+static inline int	Bytecode_int_TierThreshold(tSpiderScript *Script);
+static inline void	Bytecode_int_CountLoop(tSpiderScript *Script, tBC_Frame *Frame);
+static inline int	Bytecode_int_JitEnter(tSpiderScript *Script, tBC_Frame *Frame, int Index);
+static int	Bytecode_int_FindHandler(tSpiderScript *Script, tBC_Frame **FramePtr, const tBC_Insn *Op);
+static inline tBC_InlineCacheEnt	*Bytecode_int_CacheLookup(tBC_InlineCache *Cache, const tSpiderScript_TypeDef *TypeDef);
+static tBC_InlineCacheEnt	*Bytecode_int_CacheInsert(tBC_InlineCache *Cache, const tSpiderScript_TypeDef *TypeDef);
+void	Bytecode_FreeStack(tSpiderScript *Script);
  int	Bytecode_ExecuteFunction(tSpiderScript *Script, tScript_Function *Fcn,
 	void *RetData, int NArgs, const tSpiderTypeRef *ArgTypes, const void * const *Args);
+static int	Bytecode_int_CallNative(tSpiderScript *Script, tScript_Function *Fcn, const int arg_count, const tBC_StackEnt *Args[], tBC_StackEnt *RV);
+static int	Bytecode_int_ExecuteFunction_Fast(tSpiderScript *Script, tScript_Function *Fcn, int ArgCount, const tBC_StackEnt *Args[], tBC_StackEnt *RetVal);
+static int	Bytecode_int_ExecuteFunction_Traced(tSpiderScript *Script, tScript_Function *Fcn, int ArgCount, const tBC_StackEnt *Args[], tBC_StackEnt *RetVal);
  int	Bytecode_int_ExecuteFunction(tSpiderScript *Script, tScript_Function *Fcn, int ArgCount, const tBC_StackEnt *Args[], tBC_StackEnt *RetVal);
 
 // === CONSTANTS ===
@@ -55,35 +117,182 @@ struct sBC_StackEnt
 #define TYPE_INTEGER	((tSpiderTypeRef){.ArrayDepth=0,.Def=&gSpiderScript_IntegerType})
 #define TYPE_BOOLEAN	((tSpiderTypeRef){.ArrayDepth=0,.Def=&gSpiderScript_BoolType})
 
+// Type of a register, and reference type check (anything that isn't a primitive)
+#define ENT_TYPE(ent)	(Script->BCTypes[(ent).TypeId])
+#define TYPEID_ISREFERENCE(id)	((id) >= SS_DATATYPE_STRING)
+
 // === GLOBALS ===
 // === CODE ===
-int Bytecode_int_IsStackEntTrue(tSpiderScript *Script, tBC_StackEnt *Ent)
+/**
+ * \brief Get the register type ID for a type
+ */
+static inline int Bytecode_int_GetTypeId(tSpiderScript *Script, tSpiderTypeRef Type)
 {
-	if( Ent->Type.Def == NULL ) {
-		SpiderScript_RuntimeError(Script, "_IsStackEntTrue on void");
-		return -1;
+	if( Type.ArrayDepth == 0 && (!Type.Def || Type.Def->Class == SS_TYPECLASS_CORE) )
+		return (Type.Def ? Type.Def->Core : SS_DATATYPE_NOVALUE);
+	return Bytecode_int_GetTypeIdx(Script, Type);
+}
+
+/**
+ * \brief Allocate a frame from the top of the VM stack (or register stack)
+ * \return NULL if the stack budget has been used up
+ */
+static void *Bytecode_int_StackAlloc(tSpiderScript *Script, tBC_StackChunk **Stack, size_t Bytes)
+{
+	const size_t	limit = (Script->MaxStackSize ? Script->MaxStackSize : DEF_MAX_STACK_SIZE);
+	tBC_StackChunk	*chunk = *Stack;
+
+	Bytes = (Bytes + 15) & ~(size_t)15;
+	if( Script->BCStackUsed + Bytes > limit )
+		return NULL;
+	
+	if( !chunk || chunk->Used + Bytes > chunk->Size )
+	{
+		tBC_StackChunk	*next = (chunk ? chunk->Next : NULL);
+		// - Cached chunk too small, release it (and anything after it)
+		if( next && next->Size < Bytes ) {
+			chunk->Next = NULL;
+			while( next ) {
+				tBC_StackChunk	*n = next->Next;
+				free(next);
+				next = n;
+			}
+		}
+		if( !next )
+		{
+			size_t	size = (Bytes > STACK_CHUNK_SIZE ? Bytes : STACK_CHUNK_SIZE);
+			next = malloc( sizeof(tBC_StackChunk) + size );
+			if( !next )
+				return NULL;
+			next->Prev = chunk;
+			next->Next = NULL;
+			next->Size = size;
+			next->Used = 0;
+			if( chunk )
+				chunk->Next = next;
+		}
+		chunk = next;
+		*Stack = chunk;
 	}
-	if( SS_GETARRAYDEPTH(Ent->Type) )
-		return SpiderScript_CastValueToBool(Ent->Type, Ent->Array);
-	else if( SS_ISTYPEOBJECT(Ent->Type) )
-		return SpiderScript_CastValueToBool(Ent->Type, Ent->Object);
-	else if( Ent->Type.Def->Class == SS_TYPECLASS_CORE ) {
-		switch(Ent->Type.Def->Core)
+
+	void *ret = chunk->Data + chunk->Used;
+	chunk->Used += Bytes;
+	Script->BCStackUsed += Bytes;
+	return ret;
+}
+
+/**
+ * \brief Release the frame at the top of the VM stack
+ */
+static void Bytecode_int_StackFree(tSpiderScript *Script, void *Ptr, size_t Bytes)
+{
+	tBC_StackChunk	*chunk = Script->BCStack;
+
+	Bytes = (Bytes + 15) & ~(size_t)15;
+	assert( (char*)Ptr + Bytes == chunk->Data + chunk->Used );
+	chunk->Used -= Bytes;
+	Script->BCStackUsed -= Bytes;
+	if( chunk->Used == 0 && chunk->Prev )
+		Script->BCStack = chunk->Prev;
+}
+
+/**
+ * \brief Allocate a frame's registers from the register stack
+ * \param Window	Caller's argument registers, used as the first registers if the frame fits
+ * \return NULL if the stack budget has been used up
+ *
+ * Registers of the new frame that were already on the stack (i.e. a window) are not cleared.
+ */
+static tBC_StackEnt *Bytecode_int_RegAlloc(tSpiderScript *Script, tBC_Frame *Frame, int Count, tBC_StackEnt *Window)
+{
+	const size_t	limit = (Script->MaxStackSize ? Script->MaxStackSize : DEF_MAX_STACK_SIZE);
+	tBC_StackChunk	*chunk = Script->BCRegStack;
+	
+	Frame->RegChunk = chunk;
+	Frame->RegUsed = (chunk ? chunk->Used : 0);
+	// - The caller is the top frame, so a window is always in the current chunk
+	if( Window )
+	{
+		size_t	end = ((char*)(Window + Count) - chunk->Data + 15) & ~(size_t)15;
+		size_t	extra = (end > chunk->Used ? end - chunk->Used : 0);
+		if( end <= chunk->Size && Script->BCStackUsed + extra <= limit )
 		{
-		case SS_DATATYPE_BOOLEAN:
-			return !!Ent->Boolean;
-		case SS_DATATYPE_INTEGER:
-			return !!Ent->Integer;
-		case SS_DATATYPE_REAL:
-			return !(-.5f < Ent->Real && Ent->Real < 0.5f);
-		case SS_DATATYPE_STRING:
-			return SpiderScript_CastValueToBool(TYPE_STRING, Ent->String);
-		default:
-			break;
+			chunk->Used += extra;
+			Script->BCStackUsed += extra;
+			Frame->RegBytes = extra;
+			return Window;
 		}
 	}
+	
+	const size_t	used = Script->BCStackUsed;
+	tBC_StackEnt	*ret = Bytecode_int_StackAlloc(Script, &Script->BCRegStack, Count * sizeof(tBC_StackEnt));
+	Frame->RegBytes = Script->BCStackUsed - used;
+	return ret;
+}
+
+/**
+ * \brief Return the register stack to the state before the frame's registers were allocated
+ */
+static void Bytecode_int_RegFree(tSpiderScript *Script, tBC_Frame *Frame)
+{
+	tBC_StackChunk	*chunk = Script->BCRegStack;
+	while( chunk != Frame->RegChunk && chunk->Prev )
+	{
+		chunk->Used = 0;
+		chunk = chunk->Prev;
+	}
+	chunk->Used = (chunk == Frame->RegChunk ? Frame->RegUsed : 0);
+	Script->BCRegStack = chunk;
+	Script->BCStackUsed -= Frame->RegBytes;
+}
+
+/**
+ * \brief Release all memory used by the VM stack
+ */
+void Bytecode_FreeStack(tSpiderScript *Script)
+{
+	void _free(tBC_StackChunk *chunk) {
+		if( !chunk )
+			return ;
+		while( chunk->Prev )
+			chunk = chunk->Prev;
+		while( chunk )
+		{
+			tBC_StackChunk	*next = chunk->Next;
+			free(chunk);
+			chunk = next;
+		}
+	}
+	_free(Script->BCStack);
+	_free(Script->BCRegStack);
+	Script->BCStack = NULL;
+	Script->BCRegStack = NULL;
+	Script->BCStackUsed = 0;
+}
+
+int Bytecode_int_IsStackEntTrue(tSpiderScript *Script, tBC_StackEnt *Ent)
+{
+	switch(Ent->TypeId)
+	{
+	case SS_DATATYPE_NOVALUE:
+		SpiderScript_RuntimeError(Script, "_IsStackEntTrue on void");
+		return -1;
+	case SS_DATATYPE_BOOLEAN:
+		return !!Ent->Boolean;
+	case SS_DATATYPE_INTEGER:
+		return !!Ent->Integer;
+	case SS_DATATYPE_REAL:
+		return !(-.5f < Ent->Real && Ent->Real < 0.5f);
+	case SS_DATATYPE_STRING:
+		return SpiderScript_CastValueToBool(TYPE_STRING, Ent->String);
+	case SS_DATATYPE_UNDEF:
+		break;
+	default:
+		// Arrays and objects
+		return SpiderScript_CastValueToBool(ENT_TYPE(*Ent), Ent->Object);
+	}
 	SpiderScript_RuntimeError(Script, "_IsStackEntTrue on unknown type %s",
-		SpiderScript_GetTypeName(Script, Ent->Type));
+		SpiderScript_GetTypeName(Script, ENT_TYPE(*Ent)));
 	return -1;
 }
 
@@ -93,19 +302,16 @@ int Bytecode_int_IsStackEntTrue(tSpiderScript *Script, tBC_StackEnt *Ent)
  */
 tSpiderTypeRef Bytecode_int_GetSpiderValue(tSpiderScript *Script, tBC_StackEnt *Ent, void **Dest)
 {
-	if( Ent->Type.Def == NULL ) {
+	if( Ent->TypeId == SS_DATATYPE_NOVALUE ) {
 		SpiderScript_RuntimeError(Script, "_GetSpiderValue on SS_DATATYPE_NOVALUE");
-		return Ent->Type;
+		return ENT_TYPE(*Ent);
 	}
-	if( Ent->Type.ArrayDepth ) {
-		*Dest = Ent->Array;
-	}
-	else if( Ent->Type.Def->Class != SS_TYPECLASS_CORE ) {
-		// Objects/other
+	if( Ent->TypeId >= NUM_SS_DATATYPES ) {
+		// Arrays/Objects/other
 		*Dest = Ent->Object;
 	}
 	else {
-		switch(Ent->Type.Def->Core)
+		switch(Ent->TypeId)
 		{
 		// Direct types
 		case SS_DATATYPE_BOOLEAN:
@@ -121,11 +327,11 @@ tSpiderTypeRef Bytecode_int_GetSpiderValue(tSpiderScript *Script, tBC_StackEnt *
 			break;
 		default:
 			SpiderScript_RuntimeError(Script, "BUG - Type %s unhandled in _GetSpiderValue",
-				SpiderScript_GetTypeName(Script, Ent->Type));
+				SpiderScript_GetTypeName(Script, ENT_TYPE(*Ent)));
 			return (tSpiderTypeRef){0,0};
 		}
 	}
-	return Ent->Type;
+	return ENT_TYPE(*Ent);
 }
 
 tSpiderTypeRef Bytecode_int_GetSpiderValueC(tSpiderScript *Script, const tBC_StackEnt *Ent, const void **Dest)
@@ -175,10 +381,10 @@ void Bytecode_int_SetFromSpiderValue(tSpiderScript *Script, tBC_StackEnt *Ent, t
 {
 	if( Type.Def == NULL ) {
 		SpiderScript_RuntimeError(Script, "_SetSpiderValue with void");
-		Ent->Type.Def = NULL;
+		Ent->TypeId = SS_DATATYPE_NOVALUE;
 		return ;
 	}
-	Ent->Type = Type;
+	Ent->TypeId = Bytecode_int_GetTypeId(Script, Type);
 	if( SS_ISTYPEREFERENCE(Type) ) {
 		Ent->Object = (void*)Source;
 		Bytecode_int_ReferenceValue(Type, (void*)Source);
@@ -188,7 +394,7 @@ void Bytecode_int_SetFromSpiderValue(tSpiderScript *Script, tBC_StackEnt *Ent, t
 	if( Type.Def->Class != SS_TYPECLASS_CORE ) {
 		SpiderScript_RuntimeError(Script, "BUG - Type %s unhandled in _SetSpiderValue",
 			SpiderScript_GetTypeName(Script, Type));
-		Ent->Type.Def = NULL;
+		Ent->TypeId = SS_DATATYPE_NOVALUE;
 		return ;
 	}
 	switch(Type.Def->Core)
@@ -212,33 +418,21 @@ void Bytecode_int_SetFromSpiderValue(tSpiderScript *Script, tBC_StackEnt *Ent, t
 	default:
 		SpiderScript_RuntimeError(Script, "BUG - Type %s unhandled in _SetSpiderValue",
 			SpiderScript_GetTypeName(Script, Type));
-		Ent->Type.Def = NULL;
+		Ent->TypeId = SS_DATATYPE_NOVALUE;
 		break;
 	}
 }
 
 void Bytecode_int_DerefStackValue(tSpiderScript *Script, tBC_StackEnt *Ent)
 {
-	if( SS_GETARRAYDEPTH(Ent->Type) )
-		SpiderScript_DereferenceArray(Ent->Array);
-	else if( SS_ISTYPEOBJECT(Ent->Type) )
-		SpiderScript_DereferenceObject(Ent->Object);
-	else if( SS_ISCORETYPE(Ent->Type, SS_DATATYPE_STRING) )
-		SpiderScript_DereferenceString(Ent->String);
-	else {
-	}
-	Ent->Type = (tSpiderTypeRef){0,0};
+	if( TYPEID_ISREFERENCE(Ent->TypeId) )
+		Bytecode_int_DereferenceValue(ENT_TYPE(*Ent), Ent->Object);
+	Ent->TypeId = SS_DATATYPE_NOVALUE;
 }
 void Bytecode_int_RefStackValue(tSpiderScript *Script, tBC_StackEnt *Ent)
 {
-	if( SS_GETARRAYDEPTH(Ent->Type) )
-		SpiderScript_ReferenceArray(Ent->Array);
-	else if( SS_ISTYPEOBJECT(Ent->Type) )
-		SpiderScript_ReferenceObject(Ent->Object);
-	else if( SS_ISCORETYPE(Ent->Type, SS_DATATYPE_STRING) )
-		SpiderScript_ReferenceString(Ent->String);
-	else {
-	}
+	if( TYPEID_ISREFERENCE(Ent->TypeId) )
+		Bytecode_int_ReferenceValue(ENT_TYPE(*Ent), Ent->Object);
 }
 
 static int Bytecode_int_PrintEscapedString(size_t len, const char *src)
@@ -264,16 +458,17 @@ static int Bytecode_int_PrintEscapedString(size_t len, const char *src)
 
 void Bytecode_int_PrintStackValue(tSpiderScript *Script, const tBC_StackEnt *Ent)
 {
-	if( SS_GETARRAYDEPTH(Ent->Type) )
-		printf("Array %s %p", SpiderScript_GetTypeName(Script, Ent->Type), Ent->Array);
-	else if( SS_ISTYPEOBJECT(Ent->Type) )
-		printf("Object %s %p", SpiderScript_GetTypeName(Script, Ent->Type), Ent->Object);
-	else if( Ent->Type.Def == NULL )
+	const tSpiderTypeRef	type = ENT_TYPE(*Ent);
+	if( SS_GETARRAYDEPTH(type) )
+		printf("Array %s %p", SpiderScript_GetTypeName(Script, type), Ent->Array);
+	else if( SS_ISTYPEOBJECT(type) )
+		printf("Object %s %p", SpiderScript_GetTypeName(Script, type), Ent->Object);
+	else if( type.Def == NULL )
 		printf("_NOVALUE");
-	else if( Ent->Type.Def->Class != SS_TYPECLASS_CORE )
-		printf("UNKCLASS(%i)", Ent->Type.Def->Class);
+	else if( type.Def->Class != SS_TYPECLASS_CORE )
+		printf("UNKCLASS(%i)", type.Def->Class);
 	else {
-		switch(Ent->Type.Def->Core)
+		switch(type.Def->Core)
 		{
 		case SS_DATATYPE_NOVALUE:
 			printf("void");
@@ -298,7 +493,7 @@ void Bytecode_int_PrintStackValue(tSpiderScript *Script, const tBC_StackEnt *Ent
 			break;
 		default:
 			SpiderScript_RuntimeError(Script, "BUG - Type %s unhandled in _PrintStackValue",
-				SpiderScript_GetTypeName(Script, Ent->Type));
+				SpiderScript_GetTypeName(Script, type));
 			break;
 		}
 	}
@@ -317,10 +512,10 @@ void Bytecode_int_PrintStackValue(tSpiderScript *Script, const tBC_StackEnt *Ent
 #define DEREF_STACKVAL(val)	Bytecode_int_DerefStackValue(Script, &val)
 #define REF_STACKVAL(val)	Bytecode_int_RefStackValue(Script, &val)
 #define _BC_ASSERTTYPE(have, exp, name) \
-	if(!SS_TYPESEQUAL(have,exp)) {\
+	if( (have) != (exp) ) {\
 		SpiderScript_RuntimeError(Script, "Type mismatch expected %s, got %s for "name, \
-			SpiderScript_GetTypeName(Script, exp),\
-			SpiderScript_GetTypeName(Script, have) \
+			SpiderScript_GetTypeName(Script, Script->BCTypes[exp]),\
+			SpiderScript_GetTypeName(Script, Script->BCTypes[have]) \
 			); \
 		bError = 1; \
 		break ; \
@@ -334,6 +529,13 @@ int Bytecode_ExecuteFunction(tSpiderScript *Script, tScript_Function *Fcn,
 {
 	tBC_StackEnt	args[NArguments];
 	const tBC_StackEnt	*argps[NArguments];
+	
+	// Compiled functions check their own arguments (see SpiderScript_RegisterNative)
+	if( Fcn->Native )
+		return (Fcn->Native(Script, RetData, NArguments, ArgTypes, Args) < 0 ? -1 : 0);
+
+	Bytecode_int_InitTypes(Script);
+
 	// Push arguments in order (so top is last arg)
 	for( int i = 0; i < NArguments; i ++ )
 	{
@@ -341,7 +543,7 @@ int Bytecode_ExecuteFunction(tSpiderScript *Script, tScript_Function *Fcn,
 		argps[i] = &args[i];
 	}
 
-	tBC_StackEnt	retval;
+	tBC_StackEnt	retval = {.TypeId = SS_DATATYPE_NOVALUE};
 	// Call
 	int ret = Bytecode_int_ExecuteFunction(Script, Fcn, NArguments, argps, &retval);
 
@@ -351,20 +553,20 @@ int Bytecode_ExecuteFunction(tSpiderScript *Script, tScript_Function *Fcn,
 
 	if( ret == 0 && Fcn->ReturnType.Def != NULL )
 	{
-		if( !SS_TYPESEQUAL(Fcn->ReturnType, retval.Type) )
+		if( !SS_TYPESEQUAL(Fcn->ReturnType, ENT_TYPE(retval)) )
 		{
 			SpiderScript_RuntimeError(Script, "'%s' returned type %s not stated %s",
 				Fcn->Name,
-				SpiderScript_GetTypeName(Script, retval.Type),
+				SpiderScript_GetTypeName(Script, ENT_TYPE(retval)),
 				SpiderScript_GetTypeName(Script, Fcn->ReturnType)
 				);
 			return -1;
 		}
 		DEBUG_F("# Return "); PRINT_STACKVAL(retval); DEBUG_F("\n");
-		if( SS_ISTYPEREFERENCE(retval.Type) )
+		if( TYPEID_ISREFERENCE(retval.TypeId) )
 			*(void**)RetData = retval.String;	// Or object, or array
 		else
-			memcpy(RetData, &retval.Boolean, SpiderScript_int_GetTypeSize(retval.Type));
+			memcpy(RetData, &retval.Boolean, SpiderScript_int_GetTypeSize(ENT_TYPE(retval)));
 	}
 	if(ret != 0)
 	{
@@ -375,10 +577,41 @@ int Bytecode_ExecuteFunction(tSpiderScript *Script, tScript_Function *Fcn,
 	return ret;
 }
 
+/**
+ * \brief Find the inline cache entry for an object type
+ */
+static inline tBC_InlineCacheEnt *Bytecode_int_CacheLookup(tBC_InlineCache *Cache, const tSpiderScript_TypeDef *TypeDef)
+{
+	for( int i = 0; i < Cache->NEntries; i ++ )
+	{
+		if( Cache->Entries[i].TypeDef == TypeDef )
+			return &Cache->Entries[i];
+	}
+	return NULL;
+}
+
+/**
+ * \brief Add an entry to an inline cache, replacing an older one when full
+ */
+static tBC_InlineCacheEnt *Bytecode_int_CacheInsert(tBC_InlineCache *Cache, const tSpiderScript_TypeDef *TypeDef)
+{
+	tBC_InlineCacheEnt	*ent;
+	if( Cache->NEntries < BC_INLINECACHE_WAYS ) {
+		ent = &Cache->Entries[Cache->NEntries++];
+	}
+	else {
+		ent = &Cache->Entries[Cache->NextReplace];
+		Cache->NextReplace = (Cache->NextReplace + 1) % BC_INLINECACHE_WAYS;
+	}
+	ent->TypeDef = TypeDef;
+	return ent;
+}
+
 /**
  * \brief Call an external function (may recurse into Bytecode_ExecuteFunction, but may not)
+ * \param Cache	Inline cache for method calls (can be NULL)
  */
-int Bytecode_int_CallExternFunction(tSpiderScript *Script, tBC_Op *op, const int arg_count, const tBC_StackEnt *Args[], tBC_StackEnt *RV)
+int Bytecode_int_CallExternFunction(tSpiderScript *Script, tBC_Op *op, tBC_InlineCache *Cache, const int arg_count, const tBC_StackEnt *Args[], tBC_StackEnt *RV)
 {
 	 int	id = op->Content.Function.ID;
 	 int	rv = 0;
@@ -405,7 +638,7 @@ int Bytecode_int_CallExternFunction(tSpiderScript *Script, tBC_Op *op, const int
 	}
 	
 	// Call the function etc.
-	if( op->Operation == BC_OP_CALLFUNCTION )
+	if( op->Operation == BC_OP_CALLFUNCTION || op->Operation == BC_OP_TAILCALLFUNCTION )
 	{
 		rv = SpiderScript_int_ExecuteFunction(Script, id, &rettype,
 			&ret.Boolean, arg_count, arg_types, args, &op->CacheEnt);
@@ -436,7 +669,7 @@ int Bytecode_int_CallExternFunction(tSpiderScript *Script, tBC_Op *op, const int
 			SpiderScript_RuntimeError(Script, "Creating object %s failed",
 				SpiderScript_GetTypeName(Script, rettype));
 	}
-	else if( op->Operation == BC_OP_CALLMETHOD )
+	else if( op->Operation == BC_OP_CALLMETHOD || op->Operation == BC_OP_TAILCALLMETHOD )
 	{
 		if( arg_count <= 0 || !SS_ISTYPEOBJECT(arg_types[0]) ) {
 			SpiderScript_RuntimeError(Script, "OP_CALLMETHOD(%i)+%i on non object (%s)",
@@ -449,8 +682,15 @@ int Bytecode_int_CallExternFunction(tSpiderScript *Script, tBC_Op *op, const int
 			
 			DEBUG_F("- Object %s %p\n", SpiderScript_GetTypeName(Script, arg_types[0]), obj);
 			if( obj ) {
+				// A cached ident skips the method lookup and argument validation
+				tBC_InlineCacheEnt	*ce = (Cache ? Bytecode_int_CacheLookup(Cache, obj->TypeDef) : NULL);
+				void	*ident = (ce ? ce->MethodIdent : NULL);
 				rv = SpiderScript_int_ExecuteMethod(Script, id, &rettype,
-					&ret.Boolean, arg_count, arg_types, args, &op->CacheEnt);
+					&ret.Boolean, arg_count, arg_types, args, &ident);
+				if( !ce && Cache && ident ) {
+					ce = Bytecode_int_CacheInsert(Cache, obj->TypeDef);
+					ce->MethodIdent = ident;
+				}
 				if(rv < 0 && SpiderScript_GetException(Script,NULL)!=SS_EXCEPTION_FORCEEXIT)
 					SpiderScript_RuntimeError(Script, "Calling method %s->%s failed",
 						SpiderScript_GetTypeName(Script, arg_types[0]),
@@ -475,7 +715,7 @@ cleanup:
 	}
 	// Get and push return
 	if( rettype.Def ) {
-		ret.Type = rettype;
+		ret.TypeId = Bytecode_int_GetTypeId(Script, rettype);
 		*RV = ret;
 		DEBUG_F("- Return value "); PRINT_STACKVAL(ret); DEBUG_F("\n");
 	}
@@ -483,840 +723,363 @@ cleanup:
 	return 0;
 }
 
+/**
+ * \brief Call the compiled version of a script function from the interpreter
+ */
+static int Bytecode_int_CallNative(tSpiderScript *Script, tScript_Function *Fcn, const int arg_count, const tBC_StackEnt *Args[], tBC_StackEnt *RV)
+{
+	const void	*args[arg_count];
+	tSpiderTypeRef	arg_types[arg_count];
+	tBC_StackEnt	ret;
+
+	for( int i = 0; i < arg_count; i ++ )
+	{
+		arg_types[i] = Bytecode_int_GetSpiderValueC(Script, Args[i], &args[i]);
+		if( arg_types[i].Def == NULL ) {
+			SpiderScript_RuntimeError(Script, "Argument %i popped void", i);
+			return -1;
+		}
+	}
+
+	if( Fcn->Native(Script, &ret.Boolean, arg_count, arg_types, args) < 0 )
+		return -1;
+	if( Fcn->ReturnType.Def ) {
+		ret.TypeId = Bytecode_int_GetTypeId(Script, Fcn->ReturnType);
+		*RV = ret;
+	}
+	return 0;
+}
+
 #define STATE_HDR()	do { \
-	op_valid = 1; \
-	DEBUG_F("%p %02i ", op, op->Operation);\
+	DEBUG_F("%4i %02i ", (int)(op - code), op->Operation);\
 } while(0)
 
 #define REG(idx)	(registers[idx])
 
+#define OP_PREPARE()	do { \
+	if( TRACE_COMPILED && Script->BytecodeTraceLevel >= SS_TRACE_REGDUMP ) \
+		Bytecode_int_DumpRegisters(Script, registers, num_registers); \
+	reg_dst = &REG(op->DstReg); \
+	reg1 = &REG(OP_REG2(op)); \
+	reg2 = &REG(OP_REG3(op)); \
+} while(0)
+
+// Handlers leave the switch only on error or return, otherwise they dispatch
+// the next instruction themselves.
+// Handlers with operand type checks mark the end of the checks with OPVERIFIED, verified
+// functions (see bytecode_verify.c) dispatch straight to that point.
+#if USE_THREADED_DISPATCH
+# define OPCASE(_op)	case _op: _lbl_##_op:
+# define OPVERIFIED(_op)	_lbl_verified_##_op:
+# define OPDEFAULT()	default: _lbl_invalid:
+# define JUMP_OP(idx)	{ op = code + (idx); OP_PREPARE(); goto *dispatch[op->Operation]; }
+#else
+# define OPCASE(_op)	case _op:
+# define OPVERIFIED(_op)
+# define OPDEFAULT()	default:
+# define JUMP_OP(idx)	{ op = code + (idx); continue; }
+#endif
+#define NEXT_OP()	JUMP_OP(op - code + 1)
+// Taken branch of a jump instruction, loop back-edges count towards re-optimisation and
+// native compilation
+#define JUMP_BRANCH()	JUMP_OP(op->DstReg <= op - code ? (Bytecode_int_CountLoop(Script, frame), JIT_ENTER(op->DstReg)) : op->DstReg)
+// Continue at an instruction, in native code if the function has been compiled (never when tracing)
+#define JIT_ENTER(idx)	(TRACE_COMPILED ? (idx) : Bytecode_int_JitEnter(Script, frame, (idx)))
+// Quickening rewrites the current instruction in place (see bytecode_ops.h), a failed guard
+// restores the generic op with DEOPTIMISE and re-executes it
+#define QUICKEN(_op)	(((tBC_Insn*)op)->Operation = (_op))
+#define DEOPTIMISE(_op)	{ QUICKEN(_op); JUMP_OP(op - code); }
+
+static void Bytecode_int_DumpRegisters(tSpiderScript *Script, const tBC_StackEnt *Registers, int Count)
+{
+	for( int i = 0; i < Count; i ++ )
+	{
+		if( Registers[i].TypeId == SS_DATATYPE_NOVALUE )
+			continue ;
+		DEBUG_F("R%i = ", i); PRINT_STACKVAL(Registers[i]); DEBUG_F("\n");
+	}
+}
+
 /**
- * \brief Execute a bytecode function with a stack
+ * \brief Push a frame for a script function and load its arguments
+ * \param Window	Caller's registers holding the arguments (Args[i] == &Window[i]), moved to
+ *              	the callee instead of referenced. Left untouched if the call fails.
+ * \return New frame, or NULL on error (exception/error already set)
  */
-int Bytecode_int_ExecuteFunction(tSpiderScript *Script, tScript_Function *Fcn, int ArgCount, const tBC_StackEnt *Args[], tBC_StackEnt *RetVal)
+static tBC_Frame *Bytecode_int_PushFrame(tSpiderScript *Script, tScript_Function *Fcn, int ArgCount, const tBC_StackEnt *Args[], tBC_StackEnt *Window, tBC_Frame *Caller, tBC_StackEnt *RetVal)
 {
-	static const int MAX_REGISTERS = 100;
-	static const int MAX_GLOBALS = 16;
-	 int	ast_op, i, rv;
-	tBC_Op	*op;
-	const int	imp_global_count = Fcn->BCFcn->MaxGlobalCount;
-	const int	num_registers = Fcn->BCFcn->MaxRegisters;
-	tSpiderTypeRef	type;
-	void	*ptr;
-	 int	bError = 0, function_offset = 0;
-	const char	*last_file = NULL;
-	 int	last_line = 0;
-	 int	itype;
-	tBC_StackEnt	*reg_dst, *reg1, *reg2;
-
-	if( num_registers > MAX_REGISTERS ) {
+	const int	max_registers = (Script->MaxFrameRegisters ? Script->MaxFrameRegisters : DEF_MAX_FRAME_REGISTERS);
+	const int	max_globals = (Script->MaxFrameGlobals ? Script->MaxFrameGlobals : DEF_MAX_FRAME_GLOBALS);
+	tBC_Function	*bcfcn = Fcn->BCFcn;
+	 int	i;
+
+	if( !bcfcn->Instructions ) {
+		SpiderScript_RuntimeError(Script, "Function '%s' has not been committed", Fcn->Name);
+		return NULL;
+	}
+
+	// Hot functions are re-optimised, the new code is installed once no frame uses the old
+	if( bcfcn->Tier == 0 && ++bcfcn->CallCount == Bytecode_int_TierThreshold(Script) )
+		Bytecode_int_TierUp(Script, Fcn, max_registers);
+	if( bcfcn->Optimised && bcfcn->ActiveFrames == 0 )
+		Bytecode_int_InstallTier(bcfcn);
+
+	const int	imp_global_count = bcfcn->MaxGlobalCount;
+	const int	num_registers = bcfcn->MaxRegisters;
+	if( num_registers > max_registers || num_registers < Fcn->ArgumentCount ) {
 		SpiderScript_RuntimeError(Script, "Function requested %i registers, %i max",
-			num_registers, MAX_REGISTERS);
-		return -1;
+			num_registers, max_registers);
+		return NULL;
 	}
-	if( imp_global_count > MAX_GLOBALS ) {
+	if( imp_global_count > max_globals ) {
 		SpiderScript_RuntimeError(Script, "Function requested %i globals, %i max",
-			imp_global_count, MAX_GLOBALS);
-		return -1;
+			imp_global_count, max_globals);
+		return NULL;
 	}
-	
 
 	if( ArgCount < Fcn->ArgumentCount || (!Fcn->IsVariable && ArgCount != Fcn->ArgumentCount) ) {
-		return SpiderScript_ThrowException_ArgCount(Script, Fcn->Name,
+		SpiderScript_ThrowException_ArgCount(Script, Fcn->Name,
 			(Fcn->IsVariable ? -Fcn->ArgumentCount : Fcn->ArgumentCount), ArgCount);
+		return NULL;
 	}
 	const int	VArgC = ArgCount - Fcn->ArgumentCount;
-	const tBC_StackEnt	**VArgs = Args + Fcn->ArgumentCount;
-	DEBUG_F("--- ExecuteFunction %s (%i args)\n", Fcn->Name, Fcn->ArgumentCount);
-	
-	// Initialise stack and globals
-	tBC_StackEnt	registers[num_registers];
-	memset(registers, 0, sizeof(registers));
-	tScript_Var *globals[imp_global_count];
-	memset(globals, 0, sizeof(globals));
 	
-	// Pop off arguments
-	// - Handle optional arguments
-	for( i = Fcn->ArgumentCount; i > ArgCount; )
+	// Verified code relies on the argument types
+	// - Checked first, so a failed call leaves the arguments with the caller
+	// TODO: Type checks / enforcing for unverified functions
+	if( bcfcn->IsVerified )
 	{
-		i --;
-		registers[i].Integer = 0;
-		registers[i].Type = Fcn->Arguments[i].Type;
-	}
-	for( ; i --; )
-	{
-		registers[i] = *Args[i];
-		// TODO: Type checks / enforcing
-	}
-	for( i = 0; i < Fcn->ArgumentCount; i ++ )
-	{
-		DEBUG_F("Arg %i = ",i); PRINT_STACKVAL(registers[i]); DEBUG_F("\n");
-		REF_STACKVAL(registers[i]);
+		for( i = 0; i < Fcn->ArgumentCount; i ++ )
+		{
+			 int	exp = Bytecode_int_GetTypeId(Script, Fcn->Arguments[i].Type);
+			if( exp != SS_DATATYPE_UNDEF && Args[i]->TypeId != exp ) {
+				SpiderScript_RuntimeError(Script, "Argument %i of '%s' should be %s, given %s",
+					i, Fcn->Name,
+					SpiderScript_GetTypeName(Script, Fcn->Arguments[i].Type),
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*Args[i])));
+				return NULL;
+			}
+		}
 	}
-
-	// Execute!
-	op = Fcn->BCFcn->Operations;
-	while(op)
+	// - Unverified code still relies on typed arguments holding a value (see Bytecode_int_SSAVersion)
+	else
 	{
-		 int	op_valid = 0;
-		if( Script->BytecodeTraceLevel >= SS_TRACE_REGDUMP )
+		for( i = 0; i < Fcn->ArgumentCount; i ++ )
 		{
-			for( int i = 0; i < num_registers; i ++ )
-			{
-				if( registers[i].Type.Def )
-					DEBUG_F("R%i = ", i); PRINT_STACKVAL(registers[i]); DEBUG_F("\n");
+			if( Args[i]->TypeId == SS_DATATYPE_NOVALUE
+			 && Bytecode_int_GetTypeId(Script, Fcn->Arguments[i].Type) != SS_DATATYPE_UNDEF ) {
+				SpiderScript_RuntimeError(Script, "Argument %i of '%s' should be %s, given %s",
+					i, Fcn->Name,
+					SpiderScript_GetTypeName(Script, Fcn->Arguments[i].Type),
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*Args[i])));
+				return NULL;
 			}
 		}
+	}
 
-		reg_dst = &REG(op->DstReg);
-		reg1 = &REG(OP_REG2(op));
-		reg2 = &REG(OP_REG3(op));
-		
-		const char	*opstr = "";
-		tBC_Op	*nextop = op->Next, *jmp_target;
-		ast_op = 0;
-		switch(op->Operation)
+	// Allocate the frame from the VM stack
+	// - Variable arguments are copied, the caller's argument array is temporary
+	const size_t	frame_size = sizeof(tBC_Frame)
+		+ imp_global_count * sizeof(tScript_Var*) + VArgC * sizeof(tBC_StackEnt*);
+	tBC_Frame	*frame = Bytecode_int_StackAlloc(Script, &Script->BCStack, frame_size);
+	tBC_StackEnt	*registers = NULL;
+	if( frame ) {
+		registers = Bytecode_int_RegAlloc(Script, frame, num_registers, Window);
+		if( !registers )
+			Bytecode_int_StackFree(Script, frame, frame_size);
+	}
+	if( !registers ) {
+		SpiderScript_ThrowException(Script, SS_EXCEPTION_MEMORY,
+			"VM stack exhausted calling '%s' (%zi bytes used)", Fcn->Name, Script->BCStackUsed);
+		return NULL;
+	}
+	frame->Caller = Caller;
+	frame->Fcn = Fcn;
+	frame->FrameSize = frame_size;
+	frame->RetVal = RetVal;
+	frame->CurOp = NULL;
+	frame->Registers = registers;
+	frame->Globals = (void*)(frame + 1);
+	frame->VArgC = VArgC;
+	frame->VArgs = (void*)(frame->Globals + imp_global_count);
+	memcpy(frame->VArgs, Args + Fcn->ArgumentCount, VArgC * sizeof(tBC_StackEnt*));
+	memset(frame->Globals, 0, imp_global_count * sizeof(tScript_Var*));
+	
+	DEBUG_F("--- ExecuteFunction %s (%i args%s)\n", Fcn->Name, Fcn->ArgumentCount,
+		(registers == Window ? ", window" : ""));
+	
+	if( registers == Window )
+	{
+		// Arguments are already in place, the rest of the window is dead in the caller
+		// but may still hold references (e.g. variables of a loop left with break)
+		const tBC_StackEnt	*caller_end = (void*)(frame->RegChunk->Data + frame->RegUsed);
+		for( i = Fcn->ArgumentCount; i < num_registers && &registers[i] < caller_end; i ++ )
+			DEREF_STACKVAL(registers[i]);
+		memset(registers + i, 0, (num_registers - i) * sizeof(tBC_StackEnt));
+	}
+	else
+	{
+		// - Only registers not filled by arguments need clearing
+		memset(registers + Fcn->ArgumentCount, 0, (num_registers - Fcn->ArgumentCount) * sizeof(tBC_StackEnt));
+		for( i = 0; i < Fcn->ArgumentCount; i ++ )
 		{
-		case BC_OP_NOP:
-			STATE_HDR();
-			DEBUG_F("NOP\n");
-			break;
-		case BC_OP_NOTEPOSITION:
-			STATE_HDR();
-			DEBUG_F("NOTEPOSITION %s:%i\n", op->Content.RefStr->Data, op->DstReg);
-			last_file = op->Content.RefStr->Data;
-			last_line = op->DstReg;
-			break;
-		// Jumps
-		case BC_OP_JUMP:
-			STATE_HDR();
-			jmp_target = Fcn->BCFcn->Labels[ op->DstReg ]->Next;
-			DEBUG_F("JUMP #%i %p\n", op->DstReg, jmp_target);
-			nextop = jmp_target;
-			break;
-		case BC_OP_JUMPIF:
-			STATE_HDR();
-			jmp_target = Fcn->BCFcn->Labels[ op->DstReg ]->Next;
-			DEBUG_F("JUMPIF #%i R%i - ", op->DstReg, OP_REG2(op));
-			PRINT_STACKVAL(*reg1); DEBUG_F("\n");
-			if( Bytecode_int_IsStackEntTrue(Script, reg1) )
-				nextop = jmp_target;
-			break;
-		case BC_OP_JUMPIFNOT:
-			STATE_HDR();
-			jmp_target = Fcn->BCFcn->Labels[ op->DstReg ]->Next;
-			DEBUG_F("JUMPIFNOT #%i R%i - ", op->DstReg, OP_REG2(op));
-			PRINT_STACKVAL(*reg1); DEBUG_F("\n");
-			if( !Bytecode_int_IsStackEntTrue(Script, reg1) )
-				nextop = jmp_target;
-			break;
-
-		case BC_OP_IMPORTGLOBAL: {
-			STATE_HDR();
-			DEBUG_F("IMPORTGLOBAL #%i '%s'\n", op->DstReg,
-				op->Content.String.Data);
-			int slot = op->DstReg;
-			if(slot < 0 || slot >= imp_global_count ) {
-				SpiderScript_RuntimeError(Script, "Global slot %i out of 0..%i",
-					slot, imp_global_count);
-				bError = 1;
-				break;
-			}
-
-			globals[slot] = NULL;
-			const char *name = op->Content.String.Data;
-			for( tScript_Var *v = Script->FirstGlobal; v; v = v->Next )
-			{
-				if( strcmp(v->Name, name) == 0 ) {
-					globals[slot] = v;
-					break;
-				}
-			}
-			if( !globals[slot] ) {
-				SpiderScript_RuntimeError(Script, "Reference to undefined global variable '%s'",
-					name);
-				bError = 1;
-				break;
-			}
-
-			} break;
-
-		case BC_OP_TAGREGISTER:
-			STATE_HDR();
-			DEBUG_F("TAGREGISTER %i %s\n", op->DstReg, op->Content.String.Data);
-			break;
-
-		// Create an array
-		case BC_OP_CREATEARRAY:
-			STATE_HDR();
-			i = OP_REG2(op);
-			if( i < 0 || i >= Script->BCTypeCount ) {
-				SpiderScript_RuntimeError(Script, "Type index out of range (%i >= %i)",
-					i, Script->BCTypeCount);
-				bError = 1;
-				break;
-			}
-			
-			PRESET_DEREF(*reg_dst);
-			reg_dst->Type = Script->BCTypes[i];
-			if( reg_dst->Type.ArrayDepth == 0 ) {
-				SpiderScript_RuntimeError(Script, "Invalid type when creating an array");
-				bError = 1;
-				break;
-			}
-			reg_dst->Type.ArrayDepth --;
-			DEBUG_F("CREATEARRAY R%i = %s ",
-				op->DstReg,
-				SpiderScript_GetTypeName(Script, reg_dst->Type));
-			if( !SS_ISCORETYPE(reg2->Type, SS_DATATYPE_INTEGER) ) {
-				SpiderScript_RuntimeError(Script, "Array size is not integer");
-				bError = 1;
-				break;
-			}
-			// TODO: Range checks?
-			DEBUG_F("[%i]", (int)reg2->Integer);
-			if( reg2->Integer < 0 ) {
-				SpiderScript_ThrowException(Script, SS_EXCEPTION_INDEX_OOB,
-					"Array size is <0 (%i)", (int)reg2->Integer);
-				bError = 1;
-				break;
-			}
-			reg_dst->Array = SpiderScript_CreateArray(reg_dst->Type, reg2->Integer );
-			reg_dst->Type.ArrayDepth ++;
-			DEBUG_F("\n");
-			break;
-
-		// Enter/Leave context
-		// - NOP now		
-		case BC_OP_ENTERCONTEXT:
-			STATE_HDR();
-			DEBUG_F("ENTERCONTEXT\n");
-			break;
-		case BC_OP_LEAVECONTEXT:
-			STATE_HDR();
-			DEBUG_F("LEAVECONTEXT\n");
-			break;
-
-		// Variables
-		case BC_OP_GETGLOBAL: {
-			 int	slot = OP_REG2(op);
-			STATE_HDR();
-			if( slot >= imp_global_count ) {
-				SpiderScript_RuntimeError(Script, "Global slot %i invalid (%i slots) - '%s'",
-					slot, imp_global_count, Fcn->Name);
-				bError = 1; break;
-			}
-			if( !globals[slot] ) {
-				SpiderScript_RuntimeError(Script, "Global slot %i empty", slot);
-				bError = 1; break;
-			}
-			DEBUG_F("GETGLOBAL R%i = #%i %s [%p=", op->DstReg, slot, globals[slot]->Name,
-				globals[slot]->Ptr);
-			
-			PRESET_DEREF(*reg_dst);
-			Bytecode_int_SetFromSpiderValue(Script, reg_dst, globals[slot]->Type, globals[slot]->Ptr);
-			PRINT_STACKVAL(*reg_dst);
-			DEBUG_F("]\n");
-			} break;
-		case BC_OP_SETGLOBAL: {
-			 int	slot = OP_REG2(op);
-			STATE_HDR();
-			
-			if( slot >= imp_global_count ) {
-				SpiderScript_RuntimeError(Script, "Loading from invalid slot %i (%i max) - %s",
-					slot, imp_global_count, Fcn->Name);
-				bError = 1; break;
-			}
-			if( !globals[slot] ) {
-				SpiderScript_RuntimeError(Script, "Global slot %i empty", slot);
-				bError = 1; break;
-			}
-			DEBUG_F("SETGLOBAL #%i %s = R%i ", slot, globals[slot]->Name, op->DstReg);
-			PRINT_STACKVAL(*reg_dst);
-			DEBUG_F("\n");
-		
-			if( !SS_TYPESEQUAL(reg_dst->Type, globals[slot]->Type) ) {
-				SpiderScript_RuntimeError(Script,
-					"Saving to global, types don't match (src %s dst %s)",
-					SpiderScript_GetTypeName(Script, reg_dst->Type),
-					SpiderScript_GetTypeName(Script, globals[slot]->Type)
-					);
-				bError = 1;
-				break;
-			}
-			
-			// Deref existing
-			Bytecode_int_DereferenceValue(globals[slot]->Type, globals[slot]->Ptr);
-			Bytecode_int_RefStackValue(Script, reg_dst);
-			if( SS_ISTYPEREFERENCE(globals[slot]->Type) )
-				globals[slot]->Ptr = reg_dst->String;
-			else {
-				void *ptr = globals[slot]->Ptr;
-				switch(globals[slot]->Type.Def->Core)
-				{
-				case SS_DATATYPE_REAL:    *(tSpiderReal*)ptr    = reg_dst->Real;	break;
-				case SS_DATATYPE_INTEGER: *(tSpiderInteger*)ptr = reg_dst->Integer;	break;
-				case SS_DATATYPE_BOOLEAN: *(tSpiderBool*)ptr    = reg_dst->Integer;	break;
-				default:
-					SpiderScript_RuntimeError(Script,
-						"Saving to global, unhandled type %s",
-						SpiderScript_GetTypeName(Script, globals[slot]->Type)
-						);
-					bError = 1;
-					break;
-				}
-			}
-			} break;
-
-		// Array index (get or set)
-		case BC_OP_GETINDEX:
-		case BC_OP_SETINDEX:
-			STATE_HDR();
-			
-			// Check that index is an integer
-			if( !SS_ISCORETYPE(reg2->Type, SS_DATATYPE_INTEGER) ) {
-				SpiderScript_RuntimeError(Script, "Array index is not an integer");
-				bError = 1;
-				break;
-			}
-
-			if( SS_GETARRAYDEPTH(reg1->Type) == 0 ) {
-				SpiderScript_RuntimeError(Script, "Indexing non-array (%s)",
-					SpiderScript_GetTypeName(Script, reg1->Type));
-				bError = 1;
-				break;
-			}
-
-			if( op->Operation == BC_OP_SETINDEX )
-			{
-				tSpiderArray	*array = reg1->Array;
-				
-				DEBUG_F("SETINDEX R%i [ R%i=%li ] = R%i ",
-					OP_REG2(op), OP_REG3(op),
-					reg2->Integer, op->DstReg);
-				PRINT_STACKVAL(*reg_dst);
-				DEBUG_F("\n");
-				type = Bytecode_int_GetSpiderValue(Script, reg_dst, &ptr);
-				if(type.Def == NULL ) { bError = 1; break; }
-			
-				rv = AST_ExecuteNode_Index(Script, NULL, array, reg2->Integer, type, ptr);
-				if( rv < 0 ) { bError = 1; break; }
-			}
-			else {
-				tSpiderArray	*array = reg1->Array;
-				DEBUG_F("INDEX R%i = %li ", op->DstReg, reg2->Integer);
-				PRESET_DEREF(*reg_dst);
-				rv = AST_ExecuteNode_Index(Script, &reg_dst->Boolean, array, reg2->Integer,
-					TYPE_VOID, NULL);
-				if( rv < 0 ) { bError = 1; break; }
-				reg_dst->Type = reg1->Type;
-				reg_dst->Type.ArrayDepth --;
-				
-				DEBUG_F("[Got "); PRINT_STACKVAL(*reg_dst); DEBUG_F("]\n");
-			}
-			break;
-		
-		// Object element (get or set)
-		case BC_OP_GETELEMENT:
-			STATE_HDR();
-			DEBUG_F("GETELEMENT R%i = R%i->#%i [", op->DstReg, OP_REG2(op), OP_REG3(op));
-			// - Core types can't have elements :)
-			if( !SS_ISTYPEOBJECT(reg1->Type) ) {
-				SpiderScript_RuntimeError(Script, "GETELEMENT on non-object %s\n",
-					SpiderScript_GetTypeName(Script, reg1->Type));
-				bError = 1;
-				break;
-			}
-			PRESET_DEREF(*reg_dst);
-			type = AST_ExecuteNode_Element(Script, &reg_dst->Boolean,
-				reg1->Object, OP_REG3(op), TYPE_VOID, NULL);
-			if( type.Def == NULL ) {
-				SpiderScript_RuntimeError(Script, "Error getting element %i of %p",
-					OP_REG3(op), reg1->Object);
-				bError = 1;
-				break;
-			}
-			reg_dst->Type = type;
-			PRINT_STACKVAL(*reg_dst); DEBUG_F("]\n");
-			break;
-
-		case BC_OP_SETELEMENT:
-			STATE_HDR();
-			DEBUG_F("SETELEMENT R%i->#%i = R%i [", OP_REG2(op), OP_REG3(op), op->DstReg);
-			PRINT_STACKVAL(*reg_dst); DEBUG_F("]\n");
-			
-			// - Core types can't have elements
-			if( !SS_ISTYPEOBJECT(reg1->Type) ) {
-				SpiderScript_RuntimeError(Script, "SETELEMENT on non-object %s\n",
-					SpiderScript_GetTypeName(Script, reg1->Type));
-				bError = 1;
-				break;
-			}
-			type = Bytecode_int_GetSpiderValue(Script, reg_dst, &ptr);
-			if( type.Def == NULL ) { bError = 1; break; }
-
-			AST_ExecuteNode_Element(Script, NULL, reg1->Object, OP_REG3(op), type, ptr);
-			break;
-
-		// Constants:
-		case BC_OP_LOADINT:
-			STATE_HDR();
-			DEBUG_F("LOADINT R%i = 0x%lx\n", op->DstReg, op->Content.Integer);
-			PRESET_DEREF(*reg_dst);
-			reg_dst->Type = TYPE_INTEGER;
-			reg_dst->Integer = op->Content.Integer;
-			break;
-		case BC_OP_LOADREAL:
-			STATE_HDR();
-			DEBUG_F("LOADREAL R%i = %lf\n", op->DstReg, op->Content.Real);
-			PRESET_DEREF(*reg_dst);
-			reg_dst->Type = TYPE_REAL;
-			reg_dst->Real = op->Content.Real;
-			break;
-		case BC_OP_LOADSTRING:
-			STATE_HDR();
-			DEBUG_F("LOADSTR R%i = %zi \"", op->DstReg, op->Content.String.Length);
-			PRINT_STR(op->Content.String.Length, op->Content.String.Data);
-			DEBUG_F("\"\n");
-			PRESET_DEREF(*reg_dst);
-			reg_dst->Type = TYPE_STRING;
-			reg_dst->String = SpiderScript_CreateString(
-				op->Content.String.Length, op->Content.String.Data);
-			break;
-		case BC_OP_LOADNULLREF:
-			STATE_HDR();
-			type = Script->BCTypes[OP_REG2(op)];
-			DEBUG_F("LOADNULL R%i = %s\n", op->DstReg, SpiderScript_GetTypeName(Script, type));
-			if( SS_ISTYPEREFERENCE( type ) )
-				;
-			else {
-				SpiderScript_RuntimeError(Script, "LOADNULL with non-object %s",
-					SpiderScript_GetTypeName(Script, type));
-				bError = 1;
-				break;
-			}
-			PRESET_DEREF(*reg_dst);
-			reg_dst->Type = type;
-			reg_dst->String = NULL;
-			break;
-
-		case BC_OP_CLEARREG:
-			STATE_HDR();
-			DEBUG_F("CLEAR R%i [", op->DstReg); PRINT_STACKVAL(*reg_dst); DEBUG_F("]\n");
-			DEREF_STACKVAL(*reg_dst);
-			reg_dst->Type = TYPE_VOID;
-			reg_dst->Integer = 0;
-			break;
-		case BC_OP_MOV:
-			STATE_HDR();
-			DEBUG_F("MOV R%i := R%i\n", op->DstReg, OP_REG2(op));
-			if( op->DstReg != OP_REG2(op) ) {
-				PRESET_DEREF(*reg_dst);
-				*reg_dst = *reg1;
-				REF_STACKVAL(*reg_dst);
-			}
-			break;
-
-		case BC_OP_CAST:
-			STATE_HDR();
-			itype = OP_REG2(op);
-			PRESET_DEREF(*reg_dst);
-			reg_dst->Type.ArrayDepth = 0;
-			reg_dst->Type.Def = SpiderScript_GetCoreType(itype);
-			DEBUG_F("CAST R%i(%s) = R%i(%s)\n",
-				op->DstReg,
-				SpiderScript_GetTypeName(Script, reg_dst->Type),
-				OP_REG3(op),
-				SpiderScript_GetTypeName(Script, reg2->Type)
-				);
-			if( SS_TYPESEQUAL(reg_dst->Type, reg2->Type) ) {
-				// Warn?
-				memcpy(reg_dst, reg2, sizeof(*reg_dst));
-			}
-			else if( itype == SS_DATATYPE_INTEGER && SS_ISCORETYPE(reg2->Type, SS_DATATYPE_REAL) ) {
-				reg_dst->Integer = reg2->Real;
-			}
-			else if( itype == SS_DATATYPE_REAL && SS_ISCORETYPE(reg2->Type, SS_DATATYPE_INTEGER) ) {
-				reg_dst->Real = reg2->Integer;
-			}
+			registers[i] = *Args[i];
+			// - Window arguments are moved, everything else is shared
+			if( Window )
+				Window[i].TypeId = SS_DATATYPE_NOVALUE;
 			else
-			{
-				tSpiderTypeRef	type;
-				type = Bytecode_int_GetSpiderValue(Script, reg2, &ptr);
-				if( type.Def == NULL ) { bError = 1; break; }
-				switch(itype)
-				{
-				case SS_DATATYPE_BOOLEAN:
-					reg_dst->Boolean = SpiderScript_CastValueToBool(type, ptr);
-					break;
-				case SS_DATATYPE_INTEGER:
-					reg_dst->Integer = SpiderScript_CastValueToInteger(type, ptr);
-					break;
-				case SS_DATATYPE_REAL:
-					reg_dst->Real = SpiderScript_CastValueToReal(type, ptr);
-					break;
-				case SS_DATATYPE_STRING:
-					reg_dst->String = SpiderScript_CastValueToString(type, ptr);
-					break;
-				default:
-					SpiderScript_RuntimeError(Script, "No cast for type %s",
-						SpiderScript_GetTypeName(Script, reg_dst->Type));
-					bError = 1;
-					break;
-				}
-			}
-			DEBUG_F(" = "); PRINT_STACKVAL(*reg_dst); DEBUG_F("\n");
-			break;
-
-		// Unary Operations
-		case BC_OP_BOOL_LOGICNOT:
-			STATE_HDR();
-			DEBUG_F("BC_OP_BOOL_LOGICNOT R%i := R%i", op->DstReg, OP_REG2(op));
-			PRESET_DEREF(*reg_dst);
-			reg_dst->Type = TYPE_BOOLEAN;
-			reg_dst->Boolean = !Bytecode_int_IsStackEntTrue(Script, reg1);
-			break;
-		
-		case BC_OP_INT_BITNOT:
-			STATE_HDR();
-			DEBUG_F("BC_OP_INT_BITNOT R%i := R%i", op->DstReg, OP_REG2(op));
-			_BC_ASSERTTYPE(reg1->Type, TYPE_INTEGER, "reg1");
-			
-			PRESET_DEREF(*reg_dst);
-			reg_dst->Type = TYPE_INTEGER;
-			reg_dst->Integer = ~reg1->Integer;
-			break;
-		case BC_OP_INT_NEG:
-			STATE_HDR();
-			DEBUG_F("BC_OP_INT_NEG R%i := R%i", op->DstReg, OP_REG2(op));
-			_BC_ASSERTTYPE(reg1->Type, TYPE_INTEGER, "reg1");
-			
-			PRESET_DEREF(*reg_dst);
-			reg_dst->Type = TYPE_INTEGER;
-			reg_dst->Integer = -reg1->Integer;
-			break;
-		
-		case BC_OP_REAL_NEG:
-			STATE_HDR();
-			DEBUG_F("BC_OP_REAL_NEG R%i := R%i", op->DstReg, OP_REG2(op));
-			_BC_ASSERTTYPE(reg1->Type, TYPE_REAL, "reg1");
-			
-			PRESET_DEREF(*reg_dst);
-			reg_dst->Type = TYPE_REAL;
-			reg_dst->Real = -reg1->Real;
-			break;
-
-#define BINOPHDR(opcode) \
-		case opcode: \
-			STATE_HDR();\
-			DEBUG_F(#opcode" R%i := R%i [", op->DstReg, OP_REG2(op)); \
-			PRINT_STACKVAL(*reg1);\
-			DEBUG_F("], R%i [", OP_REG3(op));\
-			PRINT_STACKVAL(*reg2);\
-			DEBUG_F("]\n");
-#define BINOPHDR_TYPE(opcode, srctype, dsttype) \
-			BINOPHDR(opcode) \
-			_BC_ASSERTTYPE(reg1->Type, srctype, "reg1");\
-			_BC_ASSERTTYPE(reg2->Type, srctype, "reg2");\
-			PRESET_DEREF(*reg_dst); \
-			reg_dst->Type = dsttype;
-#define BINOPI(opcode, opr, dsttype, dstfld) \
-			BINOPHDR_TYPE(opcode, TYPE_INTEGER, dsttype)\
-			reg_dst->dstfld = reg1->Integer opr reg2->Integer; \
-			break;
-#define BINOPR(opcode, opr, dsttype, dstfld) \
-			BINOPHDR_TYPE(opcode, TYPE_REAL, dsttype)\
-			reg_dst->dstfld = reg1->Real opr reg2->Real; \
-			DEBUG_F(" = "); PRINT_STACKVAL(*reg_dst); DEBUG_F("\n"); \
-			break;
-
-		// Reference comparisons
-		BINOPHDR(BC_OP_REFEQ)
-			if( !SS_TYPESEQUAL(reg1->Type, reg2->Type) ) {
-				SpiderScript_RuntimeError(Script, "Type mismatch in REFEQ (%s != %s)",
-					reg1->Type, reg2->Type);
-				bError = 1;
-				break;
-			}
-			reg_dst->Type = TYPE_BOOLEAN;
-			reg_dst->Boolean = reg1->String == reg2->String;
-			break;
-		BINOPHDR(BC_OP_REFNEQ)
-			if( !SS_TYPESEQUAL(reg1->Type, reg2->Type) ) {
-				SpiderScript_RuntimeError(Script, "Type mismatch in REFNEQ (%s != %s)",
-					reg1->Type, reg2->Type);
-				bError = 1;
-				break;
-			}
-			reg_dst->Type = TYPE_BOOLEAN;
-			reg_dst->Boolean = reg1->String != reg2->String;
-			break;
-	
-		BINOPHDR(BC_OP_BOOL_EQUALS)
-			reg_dst->Type = TYPE_BOOLEAN;
-			reg_dst->Boolean = Bytecode_int_IsStackEntTrue(Script, reg1)
-				== Bytecode_int_IsStackEntTrue(Script, reg2);
-			break;
-		BINOPHDR(BC_OP_BOOL_LOGICAND)
-			reg_dst->Type = TYPE_BOOLEAN;
-			reg_dst->Boolean = Bytecode_int_IsStackEntTrue(Script, reg1)
-				&& Bytecode_int_IsStackEntTrue(Script, reg2);
-			break;
-		BINOPHDR(BC_OP_BOOL_LOGICOR)
-			reg_dst->Type = TYPE_BOOLEAN;
-			reg_dst->Boolean = Bytecode_int_IsStackEntTrue(Script, reg1)
-				|| Bytecode_int_IsStackEntTrue(Script, reg2);
-			break;
-		BINOPHDR(BC_OP_BOOL_LOGICXOR)
-			reg_dst->Type = TYPE_BOOLEAN;
-			reg_dst->Boolean = Bytecode_int_IsStackEntTrue(Script, reg1)
-				!= Bytecode_int_IsStackEntTrue(Script, reg2);
-			break;
-		
-		BINOPI(BC_OP_INT_BITAND, &, TYPE_INTEGER, Integer)
-		BINOPI(BC_OP_INT_BITOR,  |, TYPE_INTEGER, Integer)
-		BINOPI(BC_OP_INT_BITXOR, ^, TYPE_INTEGER, Integer)
-				
-		BINOPI(BC_OP_INT_ADD,      +, TYPE_INTEGER, Integer)
-		BINOPI(BC_OP_INT_SUBTRACT, -, TYPE_INTEGER, Integer)
-		BINOPI(BC_OP_INT_MULTIPLY, *, TYPE_INTEGER, Integer)
-		BINOPHDR_TYPE(BC_OP_INT_DIVIDE, TYPE_INTEGER, TYPE_INTEGER)
-			if( reg2->Integer == 0 ) {
-				bError = 1;
-				SpiderScript_ThrowException(Script, SS_EXCEPTION_ARITH, "Divide by zero");
-			}
-			else {
-				reg_dst->Integer = reg1->Integer / reg2->Integer;
-			}
-			break;
-		BINOPI(BC_OP_INT_MODULO,   %, TYPE_INTEGER, Integer)
-
-		BINOPI(BC_OP_INT_BITSHIFTLEFT,  <<, TYPE_INTEGER, Integer)
-		BINOPI(BC_OP_INT_BITSHIFTRIGHT, >>, TYPE_INTEGER, Integer)
-		
-		BINOPHDR_TYPE(BC_OP_INT_BITROTATELEFT, TYPE_INTEGER, TYPE_INTEGER)
-			reg_dst->Integer = (reg1->Integer << reg2->Integer) | (reg1->Integer >> (64-reg2->Integer));
-			break;
-		
-		BINOPI(BC_OP_INT_EQUALS,       ==, TYPE_BOOLEAN, Boolean)
-		BINOPI(BC_OP_INT_NOTEQUALS,    !=, TYPE_BOOLEAN, Boolean)
-		BINOPI(BC_OP_INT_LESSTHAN,     < , TYPE_BOOLEAN, Boolean)
-		BINOPI(BC_OP_INT_LESSTHANEQ,   <=, TYPE_BOOLEAN, Boolean)
-		BINOPI(BC_OP_INT_GREATERTHAN,  > , TYPE_BOOLEAN, Boolean)
-		BINOPI(BC_OP_INT_GREATERTHANEQ,>=, TYPE_BOOLEAN, Boolean)
-		
-		BINOPR(BC_OP_REAL_ADD,      +, TYPE_REAL, Real)
-		BINOPR(BC_OP_REAL_SUBTRACT, -, TYPE_REAL, Real)
-		BINOPR(BC_OP_REAL_MULTIPLY, *, TYPE_REAL, Real)
-		BINOPR(BC_OP_REAL_DIVIDE,   /, TYPE_REAL, Real)
+				REF_STACKVAL(registers[i]);
+		}
+	}
+	for( i = 0; i < Fcn->ArgumentCount; i ++ )
+	{
+		DEBUG_F("Arg %i = ",i); PRINT_STACKVAL(registers[i]); DEBUG_F("\n");
+	}
 	
-		BINOPR(BC_OP_REAL_EQUALS,       ==, TYPE_BOOLEAN, Boolean)
-		BINOPR(BC_OP_REAL_NOTEQUALS,    !=, TYPE_BOOLEAN, Boolean)
-		BINOPR(BC_OP_REAL_LESSTHAN,     < , TYPE_BOOLEAN, Boolean)
-		BINOPR(BC_OP_REAL_LESSTHANEQ,   <=, TYPE_BOOLEAN, Boolean)
-		BINOPR(BC_OP_REAL_GREATERTHAN,  > , TYPE_BOOLEAN, Boolean)
-		BINOPR(BC_OP_REAL_GREATERTHANEQ,>=, TYPE_BOOLEAN, Boolean)
-
-#undef BINOP
-
-		case BC_OP_STR_EQUALS:
-			if(!ast_op)	ast_op = NODETYPE_EQUALS,	opstr = "EQUALS";
-		case BC_OP_STR_NOTEQUALS:
-			if(!ast_op)	ast_op = NODETYPE_NOTEQUALS,	opstr = "NOTEQUALS";
-		case BC_OP_STR_LESSTHAN:
-			if(!ast_op)	ast_op = NODETYPE_LESSTHAN,	opstr = "LESSTHAN";
-		case BC_OP_STR_LESSTHANEQ:
-			if(!ast_op)	ast_op = NODETYPE_LESSTHANEQUAL, opstr = "LESSTHANOREQUAL";
-		case BC_OP_STR_GREATERTHAN:
-			if(!ast_op)	ast_op = NODETYPE_GREATERTHAN,	opstr = "GREATERTHAN";
-		case BC_OP_STR_GREATERTHANEQ:
-			if(!ast_op)	ast_op = NODETYPE_GREATERTHANEQUAL, opstr = "GREATERTHANOREQUAL";
-		case BC_OP_STR_ADD:
-			if(!ast_op)	ast_op = NODETYPE_ADD, opstr = "ADD";
-
-			STATE_HDR();
-			DEBUG_F("BINOP_STR_%s R%i = ", opstr, op->DstReg);
-			
-			_BC_ASSERTTYPE(reg1->Type, TYPE_STRING, "reg1");
-
-			DEBUG_F("R%i [", OP_REG2(op)); PRINT_STACKVAL(*reg1); DEBUG_F("] ");
-			DEBUG_F("R%i [", OP_REG3(op)); PRINT_STACKVAL(*reg2); DEBUG_F("]\n");
-
-			// Get RVal
-			Bytecode_int_GetSpiderValue(Script, reg2, &ptr);
-			
-			PRESET_DEREF(*reg_dst);
-			itype = AST_ExecuteNode_BinOp_String(Script, &reg_dst->Boolean, ast_op,
-				reg1->String, reg2->Type.Def->Core, ptr);
-			if( itype == -1 ) {
-				SpiderScript_RuntimeError(Script,
-					"_ExecuteNode_BinOp[%s] for types %s<op>%s returned -1",
-					opstr,
-					SpiderScript_GetTypeName(Script, reg1->Type),
-					SpiderScript_GetTypeName(Script, reg2->Type));
-				bError = 1;
-				break;
-			}
-			reg_dst->Type.ArrayDepth = 0;
-			reg_dst->Type.Def = SpiderScript_GetCoreType(itype);
-			DEBUG_F(" = ("); PRINT_STACKVAL(*reg_dst); DEBUG_F(")\n");
-			break;
+	bcfcn->ActiveFrames ++;
+	return frame;
+}
 
-		// Functions etc
-		case BC_OP_CREATEOBJ:    opstr = "CREATEOBJ"; if(0)
-		case BC_OP_CALLFUNCTION: opstr = "CALLFCN"; if(0)
-		case BC_OP_CALLMETHOD:   opstr = "CALLMETHOD";
-			{
-			STATE_HDR();
-			
-			tScript_Function	*fcn = NULL;
-			 int	id = op->Content.Function.ID;
-			 int	arg_count = op->Content.Function.ArgCount & 0xFF;
-			bool	is_varg_passthrough = !!((op->Content.Function.ArgCount >> 8)&1);
-			
-			if( arg_count >= 1 )
-				reg1 = &REG( op->Content.Function.ArgRegs[0] );
-			else
-				reg1 = NULL;
-
-			if( op->Operation == BC_OP_CALLFUNCTION && (id >> 16) == 0 )
-			{
-				// Check current script functions (for fast call)
-				DEBUG_F("CALL (local) 0x%x %i args\n", id, arg_count);
-				for(fcn = Script->Functions; fcn && id --; fcn = fcn->Next)
-					;
-				if( !fcn ) {
-					SpiderScript_RuntimeError(Script,
-						"Function ID #%i is invalid", id);
-					bError = 1;
-					break;
-				}
-			}
-			else if( op->Operation == BC_OP_CALLMETHOD
-				&& reg1->Type.Def && reg1->Type.Def->Class == SS_TYPECLASS_SCLASS )
-			{
-				DEBUG_F("MCALL (local) %s 0x%x %i args\n",
-					SpiderScript_GetTypeName(Script, reg1->Type), id, arg_count);
-				if( id >= reg1->Type.Def->SClass->nFunctions ) {
-					SpiderScript_RuntimeError(Script,
-						"Method #%i of %s is invalid", id,
-						SpiderScript_GetTypeName(Script, reg1->Type));
-					bError = 1;
-					break;
-				}
-				fcn = reg1->Type.Def->SClass->Functions[id];
-			}
-			else
-			{
-				fcn = NULL;
-			}
+/**
+ * \brief Release a frame's registers and pop it off the VM stack
+ * \return Calling frame
+ */
+static tBC_Frame *Bytecode_int_PopFrame(tSpiderScript *Script, tBC_Frame *Frame)
+{
+	tBC_Frame	*caller = Frame->Caller;
+	for( int i = 0; i < Frame->Fcn->BCFcn->MaxRegisters; i ++ )
+	{
+		DEREF_STACKVAL( Frame->Registers[i] );
+	}
+	Frame->Fcn->BCFcn->ActiveFrames --;
+	Bytecode_int_RegFree(Script, Frame);
+	Bytecode_int_StackFree(Script, Frame, Frame->FrameSize);
+	return caller;
+}
 
-			int extra_args = (is_varg_passthrough ? VArgC : 0);
-			const tBC_StackEnt	*args[arg_count+extra_args];
-			for(int i = 0; i < arg_count; i ++ ) {
-				args[i] = &REG( op->Content.Function.ArgRegs[i] );
-			}
-			for( int i = 0; i < extra_args; i ++ ) {
-				args[arg_count+i] = VArgs[i];
-			}
-			
-			// Either a local call, or a remote call
-			PRESET_DEREF(*reg_dst);
+/**
+ * \brief Get the number of calls before a function is re-optimised
+ * \return Threshold, 0 if re-optimisation is disabled
+ */
+static inline int Bytecode_int_TierThreshold(tSpiderScript *Script)
+{
+	if( Script->TierThreshold < 0 )
+		return 0;
+	return (Script->TierThreshold ? Script->TierThreshold : DEF_TIER_THRESHOLD);
+}
 
-			DEBUG_F("%s.%s R%i, 0x%x,", opstr, (fcn?"L":"R"), op->DstReg, id);
-			for(int i = 0; i < arg_count; i ++ ) {
-				DEBUG_F(" R%i", op->Content.Function.ArgRegs[i]);
-			}
-			if( is_varg_passthrough )
-				DEBUG_F(" ...(%i)", extra_args);
-			DEBUG_F("\n");
-
-			if( fcn )
-			{
-				if( !fcn->BCFcn ) {
-					SpiderScript_RuntimeError(Script,
-						"Function #%i %s is not compiled", id, fcn->Name);
-					bError = 1;
-					break;
-				}
-				rv = Bytecode_int_ExecuteFunction(Script, fcn,
-					arg_count+extra_args, args, reg_dst);
-				if( rv ) {
-					bError = 1;
-					break;
-				}
-			}
-			else
-			{
-				rv = Bytecode_int_CallExternFunction( Script, op,
-					arg_count+extra_args, args, reg_dst );
-				if( rv ) {
-					bError = 1;
-					break;
-				}
-			}
-			break; }
+/**
+ * \brief Count a loop back-edge towards re-optimising the current function
+ */
+static inline void Bytecode_int_CountLoop(tSpiderScript *Script, tBC_Frame *Frame)
+{
+	tBC_Function	*bcfcn = Frame->Fcn->BCFcn;
+	if( bcfcn->Tier == 0 && ++bcfcn->LoopCount == Bytecode_int_TierThreshold(Script) * TIER_LOOP_SCALE )
+	{
+		const int	max_registers = (Script->MaxFrameRegisters ? Script->MaxFrameRegisters : DEF_MAX_FRAME_REGISTERS);
+		Bytecode_int_TierUp(Script, Frame->Fcn, max_registers);
+	}
+}
 
-		case BC_OP_RETURN:
-			STATE_HDR();
-	
-			if( RetVal ) {
-				Bytecode_int_RefStackValue(Script, reg_dst);
-				*RetVal = *reg_dst;
-			}
+/**
+ * \brief Count a function entry or loop iteration, and run native code from an instruction
+ * \return Index of the instruction to interpret next
+ */
+static inline int Bytecode_int_JitEnter(tSpiderScript *Script, tBC_Frame *Frame, int Index)
+{
+	#if BC_JIT_AVAILABLE
+	tBC_Function	*bcfcn = Frame->Fcn->BCFcn;
+	if( !Script->JitThreshold )
+		return Index;
+	if( !bcfcn->JitCode )
+	{
+		// Compilation is attempted once
+		if( bcfcn->HotCount > Script->JitThreshold )
+			return Index;
+		if( ++bcfcn->HotCount <= Script->JitThreshold )
+			return Index;
+		if( Bytecode_JIT_Compile(Script, bcfcn) )
+			return Index;
+	}
+	const void	*entry = bcfcn->JitCode->Entries[Index];
+	if( !entry )
+		return Index;
+	return bcfcn->JitCode->Enter(Frame->Registers, entry);
+	#else
+	return Index;
+	#endif
+}
 
-			DEBUG_F("RETURN R%i\n", op->DstReg);
-			nextop = NULL;	// non-error stop
-			break;
-	
-		case BC_OP_EXCEPTION_PUSH:
-			STATE_HDR();
-			DEBUG_F("EXCEPTION PUSH %i\n", op->DstReg);
-			TODO("BC_OP_EXCEPTION_PUSH");
-			break;
-		case BC_OP_EXCEPTION_CHECK:
-			STATE_HDR();
-			DEBUG_F("EXCEPTION CHECK %i %i\n", op->DstReg, OP_REG2(op));
-			TODO("BC_OP_EXCEPTION_CHECK");
-			break;
-		case BC_OP_EXCEPTION_POP:
-			STATE_HDR();
-			DEBUG_F("EXCEPTION POP\n");
-			TODO("BC_OP_EXCEPTION_POP");
-			break;
-		}
+/**
+ * \brief Find the handler for the current exception and unwind to it
+ * \param FramePtr	Frame that raised the exception, updated to the handler's frame
+ * \param Op	Instruction that raised the exception
+ * \return Index of the handler's first instruction, or -1 if the exception isn't caught by
+ *         the frames of this call (*FramePtr is unchanged)
+ *
+ * Only exceptions (see SpiderScript_ThrowException) are caught, errors that have already
+ * been reported and exit() are left to unwind. The handler tables are only consulted here,
+ * so code that doesn't raise an exception runs as if there were no handlers.
+ */
+static int Bytecode_int_FindHandler(tSpiderScript *Script, tBC_Frame **FramePtr, const tBC_Insn *Op)
+{
+	if( Script->CurException == SS_EXCEPTION_NONE || Script->CurException == SS_EXCEPTION_FORCEEXIT )
+		return -1;
 
-		if( !op_valid )
+	(*FramePtr)->CurOp = Op;
+	const tBC_HandlerEnt	*handler = NULL;
+	tBC_Frame	*frame;
+	for( frame = *FramePtr; frame && !handler; frame = (handler ? frame : frame->Caller) )
+	{
+		const tBC_Function	*bcfcn = frame->Fcn->BCFcn;
+		const int	pc = frame->CurOp - bcfcn->Instructions;
+		for( int i = 0; i < bcfcn->HandlerCount && !handler; i ++ )
 		{
-			// TODO:
-			STATE_HDR();
-			SpiderScript_RuntimeError(Script, "Unknown operation %i\n", op->Operation);
-			bError = 1;
+			const tBC_HandlerEnt	*ent = &bcfcn->InsnHandlers[i];
+			if( ent->Start <= pc && pc < ent->End )
+				handler = ent;
 		}
-		// TODO: Handle exceptions by allowing a script to push/pop exception handlers
-		if( bError )
-			break ;
-		op = nextop;
-		function_offset ++;
-	}
-	
-	// Clean up
-	DEBUG_F("> Cleaning up\n");
-	// - Restore stack
-	for( int i = 0; i < num_registers; i ++ )
-	{
-		DEREF_STACKVAL( registers[i] );
 	}
+	if( !handler )
+		return -1;
 
-	if( bError ) {
-		SpiderScript_PushBacktrace(
-			Script,
-			Fcn->Name, function_offset,
-			last_file, last_line
-			);
-	}
+	// Release the frames above the handler
+	while( *FramePtr != frame )
+		*FramePtr = Bytecode_int_PopFrame(Script, *FramePtr);
 
-	DEBUG_F("--- Return %i\n", bError);
-	return bError;
+	tBC_StackEnt	*dst = &frame->Registers[handler->CatchReg];
+	DEREF_STACKVAL(*dst);
+	if( handler->CatchType == SS_DATATYPE_STRING ) {
+		const char	*msg = Script->CurExceptionString;
+		dst->TypeId = SS_DATATYPE_STRING;
+		dst->String = SpiderScript_CreateString(msg ? strlen(msg) : 0, msg);
+	}
+	else {
+		dst->TypeId = SS_DATATYPE_INTEGER;
+		dst->Integer = Script->CurException;
+	}
+	SpiderScript_ClearException(Script);
+	return handler->Handler;
 }
 
+// The interpreter loop is built twice, tracing is compiled out of the variant used
+// when the trace level is SS_TRACE_NONE (see SpiderScript_SetTraceLevel)
+#define BC_LOOP_NAME	Bytecode_int_ExecuteFunction_Fast
+#define BC_LOOP_TRACE	0
+#include "exec_bytecode_loop.h"
+#define BC_LOOP_NAME	Bytecode_int_ExecuteFunction_Traced
+#define BC_LOOP_TRACE	1
+#include "exec_bytecode_loop.h"
+
+/**
+ * \brief Execute a bytecode function with a stack
+ * \note Calls to other script functions run in the loop, each with a frame on the VM stack
+ * \note The trace level is sampled on entry, changes take effect on the next call from native code
+ */
+int Bytecode_int_ExecuteFunction(tSpiderScript *Script, tScript_Function *Fcn, int ArgCount, const tBC_StackEnt *Args[], tBC_StackEnt *RetVal)
+{
+	if( Script->BytecodeTraceLevel != SS_TRACE_NONE )
+		return Bytecode_int_ExecuteFunction_Traced(Script, Fcn, ArgCount, Args, RetVal);
+	else
+		return Bytecode_int_ExecuteFunction_Fast(Script, Fcn, ArgCount, Args, RetVal);
+}
@@ -0,0 +1,1436 @@
+/*
+ * SpiderScript Library
+ * by John Hodge (thePowersGang)
+ *
+ * exec_bytecode_loop.h
+ * - Bytecode interpreter loop
+ *
+ * Included by exec_bytecode.c once for each variant, with BC_LOOP_NAME (function name) and
+ * BC_LOOP_TRACE (0 compiles out all tracing) defined.
+ */
+#undef TRACE_COMPILED
+#define TRACE_COMPILED	BC_LOOP_TRACE
+
+/**
+ * \brief Execute a bytecode function with a stack
+ * \note Calls to other script functions run in this loop, each with a frame on the VM stack
+ */
+static int BC_LOOP_NAME(tSpiderScript *Script, tScript_Function *Fcn, int ArgCount, const tBC_StackEnt *Args[], tBC_StackEnt *RetVal)
+{
+	 int	ast_op, i, rv;
+	tBC_Frame	*frame;
+	const tBC_Insn	*code;
+	const tBC_Insn	*op;
+	 int	imp_global_count;
+	 int	num_registers;
+	tBC_StackEnt	*registers;
+	tScript_Var	**globals;
+	tSpiderTypeRef	type;
+	void	*ptr;
+	 int	bError = 0;
+	 int	itype;
+	tBC_StackEnt	*reg_dst, *reg1, *reg2;
+	const char	*opstr;
+	
+	#if USE_THREADED_DISPATCH
+	// Typed handlers are entered past their checks (at OPVERIFIED) in the verified table
+	#define _DISPATCH(_op)	[_op] = &&_lbl_##_op
+	#define _DISPATCH_V(vpfx, _op)	[_op] = &&vpfx##_op
+	#define DISPATCH_TABLE(vpfx) \
+		[0 ... BC_OP_COUNT-1] = &&_lbl_invalid, \
+		_DISPATCH(BC_OP_NOP), \
+		_DISPATCH(BC_OP_IMPORTGLOBAL), \
+		_DISPATCH(BC_OP_GETGLOBAL), \
+		_DISPATCH(BC_OP_SETGLOBAL), \
+		_DISPATCH(BC_OP_LOADNULLREF), \
+		_DISPATCH(BC_OP_LOADINT), \
+		_DISPATCH(BC_OP_LOADREAL), \
+		_DISPATCH(BC_OP_LOADSTRING), \
+		_DISPATCH_V(vpfx, BC_OP_RETURN), \
+		_DISPATCH(BC_OP_CLEARREG), \
+		_DISPATCH(BC_OP_MOV), \
+		_DISPATCH(BC_OP_MOV_MOVE), \
+		_DISPATCH_V(vpfx, BC_OP_FOREACH_INIT), \
+		_DISPATCH_V(vpfx, BC_OP_FOREACH_NEXT), \
+		_DISPATCH(BC_OP_REFEQ), \
+		_DISPATCH(BC_OP_REFNEQ), \
+		_DISPATCH(BC_OP_JUMP), \
+		_DISPATCH(BC_OP_JUMPIF), \
+		_DISPATCH(BC_OP_JUMPIFNOT), \
+		_DISPATCH_V(vpfx, BC_OP_CREATEARRAY), \
+		_DISPATCH(BC_OP_CREATEOBJ), \
+		_DISPATCH(BC_OP_CALLFUNCTION), \
+		_DISPATCH(BC_OP_CALLMETHOD), \
+		_DISPATCH_V(vpfx, BC_OP_GETINDEX), \
+		_DISPATCH_V(vpfx, BC_OP_SETINDEX), \
+		_DISPATCH_V(vpfx, BC_OP_GETINDEX_INRANGE), \
+		_DISPATCH_V(vpfx, BC_OP_SETINDEX_INRANGE), \
+		_DISPATCH(BC_OP_GETELEMENT), \
+		_DISPATCH(BC_OP_SETELEMENT), \
+		_DISPATCH(BC_OP_CAST), \
+		_DISPATCH(BC_OP_BOOL_EQUALS), \
+		_DISPATCH(BC_OP_BOOL_LOGICNOT), \
+		_DISPATCH(BC_OP_BOOL_LOGICAND), \
+		_DISPATCH(BC_OP_BOOL_LOGICOR), \
+		_DISPATCH(BC_OP_BOOL_LOGICXOR), \
+		_DISPATCH_V(vpfx, BC_OP_INT_BITNOT), \
+		_DISPATCH_V(vpfx, BC_OP_INT_NEG), \
+		_DISPATCH_V(vpfx, BC_OP_INT_BITAND), \
+		_DISPATCH_V(vpfx, BC_OP_INT_BITOR), \
+		_DISPATCH_V(vpfx, BC_OP_INT_BITXOR), \
+		_DISPATCH_V(vpfx, BC_OP_INT_BITSHIFTLEFT), \
+		_DISPATCH_V(vpfx, BC_OP_INT_BITSHIFTRIGHT), \
+		_DISPATCH_V(vpfx, BC_OP_INT_BITROTATELEFT), \
+		_DISPATCH_V(vpfx, BC_OP_INT_ADD), \
+		_DISPATCH_V(vpfx, BC_OP_INT_SUBTRACT), \
+		_DISPATCH_V(vpfx, BC_OP_INT_MULTIPLY), \
+		_DISPATCH_V(vpfx, BC_OP_INT_DIVIDE), \
+		_DISPATCH_V(vpfx, BC_OP_INT_MODULO), \
+		_DISPATCH_V(vpfx, BC_OP_INT_EQUALS), \
+		_DISPATCH_V(vpfx, BC_OP_INT_NOTEQUALS), \
+		_DISPATCH_V(vpfx, BC_OP_INT_LESSTHAN), \
+		_DISPATCH_V(vpfx, BC_OP_INT_LESSTHANEQ), \
+		_DISPATCH_V(vpfx, BC_OP_INT_GREATERTHAN), \
+		_DISPATCH_V(vpfx, BC_OP_INT_GREATERTHANEQ), \
+		_DISPATCH_V(vpfx, BC_OP_REAL_NEG), \
+		_DISPATCH_V(vpfx, BC_OP_REAL_ADD), \
+		_DISPATCH_V(vpfx, BC_OP_REAL_SUBTRACT), \
+		_DISPATCH_V(vpfx, BC_OP_REAL_MULTIPLY), \
+		_DISPATCH_V(vpfx, BC_OP_REAL_DIVIDE), \
+		_DISPATCH_V(vpfx, BC_OP_REAL_EQUALS), \
+		_DISPATCH_V(vpfx, BC_OP_REAL_NOTEQUALS), \
+		_DISPATCH_V(vpfx, BC_OP_REAL_LESSTHAN), \
+		_DISPATCH_V(vpfx, BC_OP_REAL_LESSTHANEQ), \
+		_DISPATCH_V(vpfx, BC_OP_REAL_GREATERTHAN), \
+		_DISPATCH_V(vpfx, BC_OP_REAL_GREATERTHANEQ), \
+		_DISPATCH(BC_OP_STR_EQUALS), \
+		_DISPATCH(BC_OP_STR_NOTEQUALS), \
+		_DISPATCH(BC_OP_STR_LESSTHAN), \
+		_DISPATCH(BC_OP_STR_LESSTHANEQ), \
+		_DISPATCH(BC_OP_STR_GREATERTHAN), \
+		_DISPATCH(BC_OP_STR_GREATERTHANEQ), \
+		_DISPATCH(BC_OP_STR_ADD), \
+		_DISPATCH(BC_OP_TAILCALLFUNCTION), \
+		_DISPATCH(BC_OP_TAILCALLMETHOD), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIF_INT_EQ), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIF_INT_NE), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIF_INT_LT), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIF_INT_LE), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIF_INT_GT), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIF_INT_GE), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIF_REAL_EQ), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIF_REAL_NE), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIF_REAL_LT), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIF_REAL_LE), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIF_REAL_GT), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIF_REAL_GE), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIFNOT_REAL_EQ), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIFNOT_REAL_NE), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIFNOT_REAL_LT), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIFNOT_REAL_LE), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIFNOT_REAL_GT), \
+		_DISPATCH_V(vpfx, BC_OP_JUMPIFNOT_REAL_GE), \
+		_DISPATCH_V(vpfx, BC_OP_INT_ADDI), \
+		_DISPATCH_V(vpfx, BC_OP_INT_INC_JUMPIF_EQ), \
+		_DISPATCH_V(vpfx, BC_OP_INT_INC_JUMPIF_NE), \
+		_DISPATCH_V(vpfx, BC_OP_INT_INC_JUMPIF_LT), \
+		_DISPATCH_V(vpfx, BC_OP_INT_INC_JUMPIF_LE), \
+		_DISPATCH_V(vpfx, BC_OP_INT_INC_JUMPIF_GT), \
+		_DISPATCH_V(vpfx, BC_OP_INT_INC_JUMPIF_GE), \
+		_DISPATCH(BC_OP_IMPORTGLOBAL_LINKED), \
+		_DISPATCH(BC_OP_CALLLOCAL), \
+		_DISPATCH(BC_OP_TAILCALLLOCAL), \
+		_DISPATCH(BC_OP_JUMPIF_BOOL), \
+		_DISPATCH(BC_OP_JUMPIFNOT_BOOL), \
+		_DISPATCH(BC_OP_JUMPIF_INT), \
+		_DISPATCH(BC_OP_JUMPIFNOT_INT), \
+		_DISPATCH(BC_OP_CAST_INT_TO_REAL), \
+		_DISPATCH(BC_OP_CAST_REAL_TO_INT), \
+		_DISPATCH(BC_OP_FOREACH_NEXT_INTARRAY), \
+		_DISPATCH(BC_OP_FOREACH_NEXT_REALARRAY), \
+		_DISPATCH(BC_OP_FOREACH_NEXT_STRING), \
+		_DISPATCH(BC_OP_GETINDEX_INTARRAY), \
+		_DISPATCH(BC_OP_GETINDEX_REALARRAY), \
+		_DISPATCH(BC_OP_SETINDEX_INTARRAY), \
+		_DISPATCH(BC_OP_SETINDEX_REALARRAY), \
+		_DISPATCH(BC_OP_GETINDEX_INTARRAY_INRANGE), \
+		_DISPATCH(BC_OP_GETINDEX_REALARRAY_INRANGE), \
+		_DISPATCH(BC_OP_SETINDEX_INTARRAY_INRANGE), \
+		_DISPATCH(BC_OP_SETINDEX_REALARRAY_INRANGE)
+	static const void * const caDispatch[BC_OP_COUNT] = {
+		DISPATCH_TABLE(_lbl_)
+	};
+	static const void * const caDispatchVerified[BC_OP_COUNT] = {
+		DISPATCH_TABLE(_lbl_verified_)
+	};
+	#undef DISPATCH_TABLE
+	#undef _DISPATCH_V
+	#undef _DISPATCH
+	const void * const	*dispatch;
+	#endif
+	
+	// Cache the current frame's state in locals
+	#if USE_THREADED_DISPATCH
+	# define LOAD_FRAME_DISPATCH()	dispatch = (Fcn->BCFcn->IsVerified ? caDispatchVerified : caDispatch)
+	#else
+	# define LOAD_FRAME_DISPATCH()	do{}while(0)
+	#endif
+	#define LOAD_FRAME()	do { \
+		Fcn = frame->Fcn; \
+		code = Fcn->BCFcn->Instructions; \
+		num_registers = Fcn->BCFcn->MaxRegisters; \
+		imp_global_count = Fcn->BCFcn->MaxGlobalCount; \
+		registers = frame->Registers; \
+		globals = frame->Globals; \
+		LOAD_FRAME_DISPATCH(); \
+	} while(0)
+
+	frame = Bytecode_int_PushFrame(Script, Fcn, ArgCount, Args, NULL, NULL, RetVal);
+	if( !frame )
+		return -1;
+	LOAD_FRAME();
+
+	// Execute!
+	op = code + JIT_ENTER(0);
+	for(;;)
+	{
+		OP_PREPARE();
+		
+		switch(op->Operation)
+		{
+		OPCASE(BC_OP_NOP)
+			STATE_HDR();
+			DEBUG_F("NOP\n");
+			NEXT_OP();
+		// Jumps
+		OPCASE(BC_OP_JUMP)
+			STATE_HDR();
+			DEBUG_F("JUMP @%i\n", op->DstReg);
+			JUMP_BRANCH();
+		OPCASE(BC_OP_JUMPIF)
+			STATE_HDR();
+			DEBUG_F("JUMPIF @%i R%i - ", op->DstReg, OP_REG2(op));
+			PRINT_STACKVAL(*reg1); DEBUG_F("\n");
+			if( reg1->TypeId == SS_DATATYPE_BOOLEAN )
+				QUICKEN(BC_OP_JUMPIF_BOOL);
+			else if( reg1->TypeId == SS_DATATYPE_INTEGER )
+				QUICKEN(BC_OP_JUMPIF_INT);
+			if( Bytecode_int_IsStackEntTrue(Script, reg1) )
+				JUMP_BRANCH();
+			NEXT_OP();
+		OPCASE(BC_OP_JUMPIFNOT)
+			STATE_HDR();
+			DEBUG_F("JUMPIFNOT @%i R%i - ", op->DstReg, OP_REG2(op));
+			PRINT_STACKVAL(*reg1); DEBUG_F("\n");
+			if( reg1->TypeId == SS_DATATYPE_BOOLEAN )
+				QUICKEN(BC_OP_JUMPIFNOT_BOOL);
+			else if( reg1->TypeId == SS_DATATYPE_INTEGER )
+				QUICKEN(BC_OP_JUMPIFNOT_INT);
+			if( !Bytecode_int_IsStackEntTrue(Script, reg1) )
+				JUMP_BRANCH();
+			NEXT_OP();
+		OPCASE(BC_OP_JUMPIF_BOOL)
+			if( reg1->TypeId != SS_DATATYPE_BOOLEAN )
+				DEOPTIMISE(BC_OP_JUMPIF);
+			STATE_HDR();
+			DEBUG_F("JUMPIF_BOOL @%i R%i - %s\n", op->DstReg, OP_REG2(op), (reg1->Boolean ? "true" : "false"));
+			if( reg1->Boolean )
+				JUMP_BRANCH();
+			NEXT_OP();
+		OPCASE(BC_OP_JUMPIFNOT_BOOL)
+			if( reg1->TypeId != SS_DATATYPE_BOOLEAN )
+				DEOPTIMISE(BC_OP_JUMPIFNOT);
+			STATE_HDR();
+			DEBUG_F("JUMPIFNOT_BOOL @%i R%i - %s\n", op->DstReg, OP_REG2(op), (reg1->Boolean ? "true" : "false"));
+			if( !reg1->Boolean )
+				JUMP_BRANCH();
+			NEXT_OP();
+		OPCASE(BC_OP_JUMPIF_INT)
+			if( reg1->TypeId != SS_DATATYPE_INTEGER )
+				DEOPTIMISE(BC_OP_JUMPIF);
+			STATE_HDR();
+			DEBUG_F("JUMPIF_INT @%i R%i - %li\n", op->DstReg, OP_REG2(op), reg1->Integer);
+			if( reg1->Integer )
+				JUMP_BRANCH();
+			NEXT_OP();
+		OPCASE(BC_OP_JUMPIFNOT_INT)
+			if( reg1->TypeId != SS_DATATYPE_INTEGER )
+				DEOPTIMISE(BC_OP_JUMPIFNOT);
+			STATE_HDR();
+			DEBUG_F("JUMPIFNOT_INT @%i R%i - %li\n", op->DstReg, OP_REG2(op), reg1->Integer);
+			if( !reg1->Integer )
+				JUMP_BRANCH();
+			NEXT_OP();
+
+		OPCASE(BC_OP_IMPORTGLOBAL) {
+			const char *name = op->Content.Op->Content.String.Data;
+			STATE_HDR();
+			DEBUG_F("IMPORTGLOBAL #%i '%s'\n", op->DstReg, name);
+			int slot = op->DstReg;
+			if(slot < 0 || slot >= imp_global_count ) {
+				SpiderScript_RuntimeError(Script, "Global slot %i out of 0..%i",
+					slot, imp_global_count);
+				bError = 1;
+				break;
+			}
+
+			globals[slot] = NULL;
+			for( tScript_Var *v = Script->FirstGlobal; v; v = v->Next )
+			{
+				if( strcmp(v->Name, name) == 0 ) {
+					globals[slot] = v;
+					break;
+				}
+			}
+			if( !globals[slot] ) {
+				SpiderScript_RuntimeError(Script, "Reference to undefined global variable '%s'",
+					name);
+				bError = 1;
+				break;
+			}
+
+			NEXT_OP(); }
+		OPCASE(BC_OP_IMPORTGLOBAL_LINKED)
+			// Slot range and name were checked by SpiderScript_Link
+			STATE_HDR();
+			DEBUG_F("IMPORTGLOBAL #%i '%s' (linked)\n", op->DstReg, op->Content.Var->Name);
+			globals[op->DstReg] = op->Content.Var;
+			NEXT_OP();
+
+		// Create an array
+		OPCASE(BC_OP_CREATEARRAY)
+			i = OP_REG2(op);
+			if( i < 0 || i >= Script->BCTypeCount ) {
+				SpiderScript_RuntimeError(Script, "Type index out of range (%i >= %i)",
+					i, Script->BCTypeCount);
+				bError = 1;
+				break;
+			}
+			if( Script->BCTypes[i].ArrayDepth == 0 ) {
+				SpiderScript_RuntimeError(Script, "Invalid type when creating an array");
+				bError = 1;
+				break;
+			}
+			if( reg2->TypeId != SS_DATATYPE_INTEGER ) {
+				SpiderScript_RuntimeError(Script, "Array size is not integer");
+				bError = 1;
+				break;
+			}
+		OPVERIFIED(BC_OP_CREATEARRAY)
+			STATE_HDR();
+			i = OP_REG2(op);
+			PRESET_DEREF(*reg_dst);
+			type = Script->BCTypes[i];
+			type.ArrayDepth --;
+			DEBUG_F("CREATEARRAY R%i = %s ",
+				op->DstReg,
+				SpiderScript_GetTypeName(Script, type));
+			// TODO: Range checks?
+			DEBUG_F("[%i]", (int)reg2->Integer);
+			if( reg2->Integer < 0 ) {
+				SpiderScript_ThrowException(Script, SS_EXCEPTION_INDEX_OOB,
+					"Array size is <0 (%i)", (int)reg2->Integer);
+				bError = 1;
+				break;
+			}
+			reg_dst->Array = SpiderScript_CreateArray(type, reg2->Integer );
+			reg_dst->TypeId = i;
+			DEBUG_F("\n");
+			NEXT_OP();
+
+		// Variables
+		OPCASE(BC_OP_GETGLOBAL) {
+			 int	slot = OP_REG2(op);
+			STATE_HDR();
+			if( slot >= imp_global_count ) {
+				SpiderScript_RuntimeError(Script, "Global slot %i invalid (%i slots) - '%s'",
+					slot, imp_global_count, Fcn->Name);
+				bError = 1; break;
+			}
+			if( !globals[slot] ) {
+				SpiderScript_RuntimeError(Script, "Global slot %i empty", slot);
+				bError = 1; break;
+			}
+			DEBUG_F("GETGLOBAL R%i = #%i %s [%p=", op->DstReg, slot, globals[slot]->Name,
+				globals[slot]->Ptr);
+			
+			PRESET_DEREF(*reg_dst);
+			Bytecode_int_SetFromSpiderValue(Script, reg_dst, globals[slot]->Type, globals[slot]->Ptr);
+			PRINT_STACKVAL(*reg_dst);
+			DEBUG_F("]\n");
+			NEXT_OP(); }
+		OPCASE(BC_OP_SETGLOBAL) {
+			 int	slot = OP_REG2(op);
+			STATE_HDR();
+			
+			if( slot >= imp_global_count ) {
+				SpiderScript_RuntimeError(Script, "Loading from invalid slot %i (%i max) - %s",
+					slot, imp_global_count, Fcn->Name);
+				bError = 1; break;
+			}
+			if( !globals[slot] ) {
+				SpiderScript_RuntimeError(Script, "Global slot %i empty", slot);
+				bError = 1; break;
+			}
+			DEBUG_F("SETGLOBAL #%i %s = R%i ", slot, globals[slot]->Name, op->DstReg);
+			PRINT_STACKVAL(*reg_dst);
+			DEBUG_F("\n");
+		
+			if( !SS_TYPESEQUAL(ENT_TYPE(*reg_dst), globals[slot]->Type) ) {
+				SpiderScript_RuntimeError(Script,
+					"Saving to global, types don't match (src %s dst %s)",
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*reg_dst)),
+					SpiderScript_GetTypeName(Script, globals[slot]->Type)
+					);
+				bError = 1;
+				break;
+			}
+			
+			// Deref existing
+			Bytecode_int_DereferenceValue(globals[slot]->Type, globals[slot]->Ptr);
+			Bytecode_int_RefStackValue(Script, reg_dst);
+			if( SS_ISTYPEREFERENCE(globals[slot]->Type) )
+				globals[slot]->Ptr = reg_dst->String;
+			else {
+				void *ptr = globals[slot]->Ptr;
+				switch(globals[slot]->Type.Def->Core)
+				{
+				case SS_DATATYPE_REAL:    *(tSpiderReal*)ptr    = reg_dst->Real;	break;
+				case SS_DATATYPE_INTEGER: *(tSpiderInteger*)ptr = reg_dst->Integer;	break;
+				case SS_DATATYPE_BOOLEAN: *(tSpiderBool*)ptr    = reg_dst->Integer;	break;
+				default:
+					SpiderScript_RuntimeError(Script,
+						"Saving to global, unhandled type %s",
+						SpiderScript_GetTypeName(Script, globals[slot]->Type)
+						);
+					bError = 1;
+					break;
+				}
+				if( bError )
+					break;
+			}
+			NEXT_OP(); }
+
+		// Array index (get or set)
+		// - The _INRANGE forms are checked here too, the proof only lets the quickened ops skip it
+		OPCASE(BC_OP_GETINDEX)
+		OPCASE(BC_OP_SETINDEX)
+		OPCASE(BC_OP_GETINDEX_INRANGE)
+		OPCASE(BC_OP_SETINDEX_INRANGE)
+			// Check that index is an integer
+			if( reg2->TypeId != SS_DATATYPE_INTEGER ) {
+				SpiderScript_RuntimeError(Script, "Array index is not an integer");
+				bError = 1;
+				break;
+			}
+			if( SS_GETARRAYDEPTH(ENT_TYPE(*reg1)) == 0 ) {
+				SpiderScript_RuntimeError(Script, "Indexing non-array (%s)",
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*reg1)));
+				bError = 1;
+				break;
+			}
+		OPVERIFIED(BC_OP_GETINDEX)
+		OPVERIFIED(BC_OP_SETINDEX)
+		OPVERIFIED(BC_OP_GETINDEX_INRANGE)
+		OPVERIFIED(BC_OP_SETINDEX_INRANGE) {
+			STATE_HDR();
+			const bool	is_set = (op->Operation == BC_OP_SETINDEX || op->Operation == BC_OP_SETINDEX_INRANGE);
+			const bool	in_range = (op->Operation == BC_OP_GETINDEX_INRANGE || op->Operation == BC_OP_SETINDEX_INRANGE);
+			itype = reg1->TypeId;	// Saved, reg1 may be the destination
+			type = ENT_TYPE(*reg1);
+
+			if( is_set )
+			{
+				tSpiderArray	*array = reg1->Array;
+				
+				DEBUG_F("SETINDEX R%i [ R%i=%li ] = R%i ",
+					OP_REG2(op), OP_REG3(op),
+					reg2->Integer, op->DstReg);
+				PRINT_STACKVAL(*reg_dst);
+				DEBUG_F("\n");
+				type = Bytecode_int_GetSpiderValue(Script, reg_dst, &ptr);
+				if(type.Def == NULL ) { bError = 1; break; }
+			
+				rv = AST_ExecuteNode_Index(Script, NULL, array, reg2->Integer, type, ptr);
+				if( rv < 0 ) { bError = 1; break; }
+			}
+			else {
+				tSpiderArray	*array = reg1->Array;
+				DEBUG_F("INDEX R%i = %li ", op->DstReg, reg2->Integer);
+				PRESET_DEREF(*reg_dst);
+				rv = AST_ExecuteNode_Index(Script, &reg_dst->Boolean, array, reg2->Integer,
+					TYPE_VOID, NULL);
+				if( rv < 0 ) { bError = 1; break; }
+				type.ArrayDepth --;
+				reg_dst->TypeId = Bytecode_int_GetTypeId(Script, type);
+				
+				DEBUG_F("[Got "); PRINT_STACKVAL(*reg_dst); DEBUG_F("]\n");
+			}
+			// Quicken accesses to Integer[] and Real[]
+			type = Script->BCTypes[itype];
+			if( itype <= INT16_MAX && SS_GETARRAYDEPTH(type) == 1 )
+			{
+				type.ArrayDepth = 0;
+				if( SS_ISCORETYPE(type, SS_DATATYPE_INTEGER) ) {
+					((tBC_Insn*)op)->Aux = itype;
+					if( in_range )
+						QUICKEN(is_set ? BC_OP_SETINDEX_INTARRAY_INRANGE : BC_OP_GETINDEX_INTARRAY_INRANGE);
+					else
+						QUICKEN(is_set ? BC_OP_SETINDEX_INTARRAY : BC_OP_GETINDEX_INTARRAY);
+				}
+				else if( SS_ISCORETYPE(type, SS_DATATYPE_REAL) ) {
+					((tBC_Insn*)op)->Aux = itype;
+					if( in_range )
+						QUICKEN(is_set ? BC_OP_SETINDEX_REALARRAY_INRANGE : BC_OP_GETINDEX_REALARRAY_INRANGE);
+					else
+						QUICKEN(is_set ? BC_OP_SETINDEX_REALARRAY : BC_OP_GETINDEX_REALARRAY);
+				}
+			}
+			NEXT_OP(); }
+
+		// Quickened array index, the guards also cover NULL and out of bounds (the generic op
+		// raises the exception), the _INRANGE forms have a proven index (see bytecode_ops.h)
+		// - Not wrapped in do{}while(0), JUMP_OP can be a `continue`
+		#define INDEX_GUARD(_generic, _valtype, _checkbounds) \
+			if( reg1->TypeId != op->Aux || reg2->TypeId != SS_DATATYPE_INTEGER || (_valtype) || !reg1->Array \
+			 || ((_checkbounds) && (reg2->Integer < 0 || reg2->Integer >= reg1->Array->Length)) ) \
+				DEOPTIMISE(_generic)
+		OPCASE(BC_OP_GETINDEX_INTARRAY_INRANGE)
+			INDEX_GUARD(BC_OP_GETINDEX_INRANGE, 0, false);
+			goto _getindex_intarray;
+		OPCASE(BC_OP_GETINDEX_INTARRAY)
+			INDEX_GUARD(BC_OP_GETINDEX, 0, true);
+		_getindex_intarray: {
+			STATE_HDR();
+			tSpiderInteger	val = reg1->Array->Integers[reg2->Integer];
+			DEBUG_F("INDEX_INTARRAY R%i = R%i[%li] (%li)\n", op->DstReg, OP_REG2(op), reg2->Integer, val);
+			PRESET_DEREF(*reg_dst);
+			reg_dst->TypeId = SS_DATATYPE_INTEGER;
+			reg_dst->Integer = val;
+			NEXT_OP(); }
+		OPCASE(BC_OP_GETINDEX_REALARRAY_INRANGE)
+			INDEX_GUARD(BC_OP_GETINDEX_INRANGE, 0, false);
+			goto _getindex_realarray;
+		OPCASE(BC_OP_GETINDEX_REALARRAY)
+			INDEX_GUARD(BC_OP_GETINDEX, 0, true);
+		_getindex_realarray: {
+			STATE_HDR();
+			tSpiderReal	val = reg1->Array->Reals[reg2->Integer];
+			DEBUG_F("INDEX_REALARRAY R%i = R%i[%li] (%lf)\n", op->DstReg, OP_REG2(op), reg2->Integer, val);
+			PRESET_DEREF(*reg_dst);
+			reg_dst->TypeId = SS_DATATYPE_REAL;
+			reg_dst->Real = val;
+			NEXT_OP(); }
+		OPCASE(BC_OP_SETINDEX_INTARRAY_INRANGE)
+			INDEX_GUARD(BC_OP_SETINDEX_INRANGE, reg_dst->TypeId != SS_DATATYPE_INTEGER, false);
+			goto _setindex_intarray;
+		OPCASE(BC_OP_SETINDEX_INTARRAY)
+			INDEX_GUARD(BC_OP_SETINDEX, reg_dst->TypeId != SS_DATATYPE_INTEGER, true);
+		_setindex_intarray:
+			STATE_HDR();
+			DEBUG_F("SETINDEX_INTARRAY R%i[%li] = R%i (%li)\n", OP_REG2(op), reg2->Integer, op->DstReg, reg_dst->Integer);
+			reg1->Array->Integers[reg2->Integer] = reg_dst->Integer;
+			NEXT_OP();
+		OPCASE(BC_OP_SETINDEX_REALARRAY_INRANGE)
+			INDEX_GUARD(BC_OP_SETINDEX_INRANGE, reg_dst->TypeId != SS_DATATYPE_REAL, false);
+			goto _setindex_realarray;
+		OPCASE(BC_OP_SETINDEX_REALARRAY)
+			INDEX_GUARD(BC_OP_SETINDEX, reg_dst->TypeId != SS_DATATYPE_REAL, true);
+		_setindex_realarray:
+			STATE_HDR();
+			DEBUG_F("SETINDEX_REALARRAY R%i[%li] = R%i (%lf)\n", OP_REG2(op), reg2->Integer, op->DstReg, reg_dst->Real);
+			reg1->Array->Reals[reg2->Integer] = reg_dst->Real;
+			NEXT_OP();
+		#undef INDEX_GUARD
+
+		// foreach, the iterator is a register pair holding the collection and the current index
+		// - The index variable can be assigned by the body, the unsigned compare ends the loop on a
+		//   negative index (and the increment wraps instead of overflowing)
+		#define FOREACH_ADVANCE()	(uint64_t)(reg1[1].Integer = (tSpiderInteger)((uint64_t)reg1[1].Integer + 1))
+		OPCASE(BC_OP_FOREACH_INIT)
+			if( reg1->TypeId != SS_DATATYPE_STRING && SS_GETARRAYDEPTH(ENT_TYPE(*reg1)) == 0 ) {
+				SpiderScript_RuntimeError(Script, "foreach on %s",
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*reg1)));
+				bError = 1;
+				break;
+			}
+		OPVERIFIED(BC_OP_FOREACH_INIT)
+			STATE_HDR();
+			DEBUG_F("FOREACH_INIT R%i = R%i\n", op->DstReg, OP_REG2(op));
+			// - The pair holds its own reference, the source variable can be reassigned by the body
+			PRESET_DEREF(reg_dst[0]);
+			PRESET_DEREF(reg_dst[1]);
+			reg_dst[0] = *reg1;
+			REF_STACKVAL(reg_dst[0]);
+			reg_dst[1].TypeId = SS_DATATYPE_INTEGER;
+			reg_dst[1].Integer = -1;
+			NEXT_OP();
+		OPCASE(BC_OP_FOREACH_NEXT)
+			if( reg1[1].TypeId != SS_DATATYPE_INTEGER
+			 || (reg1->TypeId != SS_DATATYPE_STRING && SS_GETARRAYDEPTH(ENT_TYPE(*reg1)) == 0) ) {
+				SpiderScript_RuntimeError(Script, "FOREACH_NEXT on a corrupted iterator");
+				bError = 1;
+				break;
+			}
+		OPVERIFIED(BC_OP_FOREACH_NEXT) {
+			STATE_HDR();
+			const uint64_t	idx = FOREACH_ADVANCE();
+			DEBUG_F("FOREACH_NEXT R%i [%li] ", OP_REG2(op), reg1[1].Integer);
+			if( reg1->TypeId == SS_DATATYPE_STRING )
+			{
+				const tSpiderString	*str = reg1->String;
+				if( !str || idx >= str->Length ) {
+					DEBUG_F("done\n");
+					JUMP_BRANCH();
+				}
+				PRESET_DEREF(*reg2);
+				reg2->TypeId = SS_DATATYPE_INTEGER;
+				reg2->Integer = (uint8_t)str->Data[idx];
+				DEBUG_F("= R%i (%li)\n", OP_REG3(op), reg2->Integer);
+				QUICKEN(BC_OP_FOREACH_NEXT_STRING);
+				NEXT_OP();
+			}
+			tSpiderArray	*array = reg1->Array;
+			itype = reg1->TypeId;
+			type = ENT_TYPE(*reg1);
+			if( !array || idx >= array->Length ) {
+				DEBUG_F("done\n");
+				JUMP_BRANCH();
+			}
+			PRESET_DEREF(*reg2);
+			rv = AST_ExecuteNode_Index(Script, &reg2->Boolean, array, idx, TYPE_VOID, NULL);
+			if( rv < 0 ) { bError = 1; break; }
+			type.ArrayDepth --;
+			reg2->TypeId = Bytecode_int_GetTypeId(Script, type);
+			DEBUG_F("= R%i [Got ", OP_REG3(op)); PRINT_STACKVAL(*reg2); DEBUG_F("]\n");
+			// Quicken iteration over Integer[] and Real[]
+			if( itype <= INT16_MAX && SS_GETARRAYDEPTH(type) == 0 )
+			{
+				if( SS_ISCORETYPE(type, SS_DATATYPE_INTEGER) ) {
+					((tBC_Insn*)op)->Aux = itype;
+					QUICKEN(BC_OP_FOREACH_NEXT_INTARRAY);
+				}
+				else if( SS_ISCORETYPE(type, SS_DATATYPE_REAL) ) {
+					((tBC_Insn*)op)->Aux = itype;
+					QUICKEN(BC_OP_FOREACH_NEXT_REALARRAY);
+				}
+			}
+			NEXT_OP(); }
+
+		// Quickened foreach, the guards cover a NULL collection (which the generic op treats as empty)
+		// - Not wrapped in do{}while(0), JUMP_OP can be a `continue`
+		#define FOREACH_GUARD(_coltype, _col) \
+			if( reg1->TypeId != (_coltype) || reg1[1].TypeId != SS_DATATYPE_INTEGER || !reg1->_col ) \
+				DEOPTIMISE(BC_OP_FOREACH_NEXT)
+		#define FOREACH_QUICK(_name, _col, _valtype, _field, _load) \
+			STATE_HDR(); { \
+			const uint64_t	idx = FOREACH_ADVANCE(); \
+			if( idx >= reg1->_col->Length ) { \
+				DEBUG_F(_name " R%i done\n", OP_REG2(op)); \
+				JUMP_BRANCH(); \
+			} \
+			DEBUG_F(_name " R%i = R%i[%li]\n", OP_REG3(op), OP_REG2(op), (long)idx); \
+			PRESET_DEREF(*reg2); \
+			reg2->TypeId = (_valtype); \
+			reg2->_field = (_load); \
+			NEXT_OP(); }
+		OPCASE(BC_OP_FOREACH_NEXT_INTARRAY)
+			FOREACH_GUARD(op->Aux, Array);
+			FOREACH_QUICK("FOREACH_NEXT_INTARRAY", Array, SS_DATATYPE_INTEGER, Integer, reg1->Array->Integers[idx]);
+		OPCASE(BC_OP_FOREACH_NEXT_REALARRAY)
+			FOREACH_GUARD(op->Aux, Array);
+			FOREACH_QUICK("FOREACH_NEXT_REALARRAY", Array, SS_DATATYPE_REAL, Real, reg1->Array->Reals[idx]);
+		OPCASE(BC_OP_FOREACH_NEXT_STRING)
+			FOREACH_GUARD(SS_DATATYPE_STRING, String);
+			FOREACH_QUICK("FOREACH_NEXT_STRING", String, SS_DATATYPE_INTEGER, Integer, (uint8_t)reg1->String->Data[idx]);
+		#undef FOREACH_QUICK
+		#undef FOREACH_GUARD
+		#undef FOREACH_ADVANCE
+		
+		// Object element (get or set)
+		OPCASE(BC_OP_GETELEMENT) {
+			STATE_HDR();
+			DEBUG_F("GETELEMENT R%i = R%i->#%i [", op->DstReg, OP_REG2(op), OP_REG3(op));
+			// - Core types can't have elements :)
+			if( !SS_ISTYPEOBJECT(ENT_TYPE(*reg1)) ) {
+				SpiderScript_RuntimeError(Script, "GETELEMENT on non-object %s\n",
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*reg1)));
+				bError = 1;
+				break;
+			}
+			tBC_InlineCache	*cache = (op->Aux >= 0 ? &Fcn->BCFcn->InlineCaches[op->Aux] : NULL);
+			tBC_InlineCacheEnt	*ce = NULL;
+			if( cache && reg1->Object )
+				ce = Bytecode_int_CacheLookup(cache, reg1->Object->TypeDef);
+			PRESET_DEREF(*reg_dst);
+			if( ce )
+			{
+				// Element index was range checked when the entry was added
+				void	*attr = reg1->Object->Attributes[OP_REG3(op)];
+				reg_dst->TypeId = ce->Element.TypeId;
+				if( TYPEID_ISREFERENCE(ce->Element.TypeId) ) {
+					reg_dst->Object = attr;
+					REF_STACKVAL(*reg_dst);
+				}
+				else {
+					memcpy(&reg_dst->Boolean, attr, ce->Element.Size);
+				}
+			}
+			else
+			{
+				type = AST_ExecuteNode_Element(Script, &reg_dst->Boolean,
+					reg1->Object, OP_REG3(op), TYPE_VOID, NULL);
+				if( type.Def == NULL ) {
+					SpiderScript_RuntimeError(Script, "Error getting element %i of %p",
+						OP_REG3(op), reg1->Object);
+					bError = 1;
+					break;
+				}
+				reg_dst->TypeId = Bytecode_int_GetTypeId(Script, type);
+				if( cache ) {
+					ce = Bytecode_int_CacheInsert(cache, reg1->Object->TypeDef);
+					ce->Element.TypeId = reg_dst->TypeId;
+					ce->Element.Size = SpiderScript_int_GetTypeSize(type);
+				}
+			}
+			PRINT_STACKVAL(*reg_dst); DEBUG_F("]\n");
+			NEXT_OP(); }
+
+		OPCASE(BC_OP_SETELEMENT) {
+			STATE_HDR();
+			DEBUG_F("SETELEMENT R%i->#%i = R%i [", OP_REG2(op), OP_REG3(op), op->DstReg);
+			PRINT_STACKVAL(*reg_dst); DEBUG_F("]\n");
+			
+			// - Core types can't have elements
+			if( !SS_ISTYPEOBJECT(ENT_TYPE(*reg1)) ) {
+				SpiderScript_RuntimeError(Script, "SETELEMENT on non-object %s\n",
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*reg1)));
+				bError = 1;
+				break;
+			}
+			tBC_InlineCache	*cache = (op->Aux >= 0 ? &Fcn->BCFcn->InlineCaches[op->Aux] : NULL);
+			tBC_InlineCacheEnt	*ce = NULL;
+			if( cache && reg1->Object )
+				ce = Bytecode_int_CacheLookup(cache, reg1->Object->TypeDef);
+			if( ce && reg_dst->TypeId == ce->Element.TypeId )
+			{
+				void	**attr_ptr = &reg1->Object->Attributes[OP_REG3(op)];
+				if( TYPEID_ISREFERENCE(ce->Element.TypeId) ) {
+					REF_STACKVAL(*reg_dst);
+					Bytecode_int_DereferenceValue(ENT_TYPE(*reg_dst), *attr_ptr);
+					*attr_ptr = reg_dst->Object;
+				}
+				else {
+					memcpy(*attr_ptr, &reg_dst->Boolean, ce->Element.Size);
+				}
+			}
+			else
+			{
+				type = Bytecode_int_GetSpiderValue(Script, reg_dst, &ptr);
+				if( type.Def == NULL ) { bError = 1; break; }
+
+				type = AST_ExecuteNode_Element(Script, NULL, reg1->Object, OP_REG3(op), type, ptr);
+				// - Successful stores check the value type matches the element
+				if( cache && !ce && type.Def ) {
+					ce = Bytecode_int_CacheInsert(cache, reg1->Object->TypeDef);
+					ce->Element.TypeId = reg_dst->TypeId;
+					ce->Element.Size = SpiderScript_int_GetTypeSize(type);
+				}
+			}
+			NEXT_OP(); }
+
+		// Constants:
+		OPCASE(BC_OP_LOADINT)
+			STATE_HDR();
+			DEBUG_F("LOADINT R%i = 0x%lx\n", op->DstReg, op->Content.Integer);
+			PRESET_DEREF(*reg_dst);
+			reg_dst->TypeId = SS_DATATYPE_INTEGER;
+			reg_dst->Integer = op->Content.Integer;
+			NEXT_OP();
+		OPCASE(BC_OP_LOADREAL)
+			STATE_HDR();
+			DEBUG_F("LOADREAL R%i = %lf\n", op->DstReg, op->Content.Real);
+			PRESET_DEREF(*reg_dst);
+			reg_dst->TypeId = SS_DATATYPE_REAL;
+			reg_dst->Real = op->Content.Real;
+			NEXT_OP();
+		OPCASE(BC_OP_LOADSTRING) {
+			const tBC_Op	*sop = op->Content.Op;
+			STATE_HDR();
+			DEBUG_F("LOADSTR R%i = %zi \"", op->DstReg, sop->Content.String.Length);
+			PRINT_STR(sop->Content.String.Length, sop->Content.String.Data);
+			DEBUG_F("\"\n");
+			PRESET_DEREF(*reg_dst);
+			reg_dst->TypeId = SS_DATATYPE_STRING;
+			reg_dst->String = SpiderScript_CreateString(
+				sop->Content.String.Length, sop->Content.String.Data);
+			NEXT_OP(); }
+		OPCASE(BC_OP_LOADNULLREF)
+			STATE_HDR();
+			type = Script->BCTypes[OP_REG2(op)];
+			DEBUG_F("LOADNULL R%i = %s\n", op->DstReg, SpiderScript_GetTypeName(Script, type));
+			if( SS_ISTYPEREFERENCE( type ) )
+				;
+			else {
+				SpiderScript_RuntimeError(Script, "LOADNULL with non-object %s",
+					SpiderScript_GetTypeName(Script, type));
+				bError = 1;
+				break;
+			}
+			PRESET_DEREF(*reg_dst);
+			reg_dst->TypeId = OP_REG2(op);
+			reg_dst->String = NULL;
+			NEXT_OP();
+
+		OPCASE(BC_OP_CLEARREG)
+			STATE_HDR();
+			DEBUG_F("CLEAR R%i [", op->DstReg); PRINT_STACKVAL(*reg_dst); DEBUG_F("]\n");
+			DEREF_STACKVAL(*reg_dst);
+			reg_dst->TypeId = SS_DATATYPE_NOVALUE;
+			reg_dst->Integer = 0;
+			NEXT_OP();
+		OPCASE(BC_OP_MOV)
+			STATE_HDR();
+			DEBUG_F("MOV R%i := R%i\n", op->DstReg, OP_REG2(op));
+			if( op->DstReg != OP_REG2(op) ) {
+				PRESET_DEREF(*reg_dst);
+				*reg_dst = *reg1;
+				REF_STACKVAL(*reg_dst);
+			}
+			NEXT_OP();
+		OPCASE(BC_OP_MOV_MOVE)
+			STATE_HDR();
+			DEBUG_F("MOV R%i := R%i (move)\n", op->DstReg, OP_REG2(op));
+			if( op->DstReg != OP_REG2(op) ) {
+				PRESET_DEREF(*reg_dst);
+				*reg_dst = *reg1;
+				reg1->TypeId = SS_DATATYPE_NOVALUE;
+			}
+			NEXT_OP();
+
+		OPCASE(BC_OP_CAST)
+			STATE_HDR();
+			itype = OP_REG2(op);
+			PRESET_DEREF(*reg_dst);
+			reg_dst->TypeId = itype;
+			DEBUG_F("CAST R%i(%s) = R%i(%s)\n",
+				op->DstReg,
+				SpiderScript_GetTypeName(Script, ENT_TYPE(*reg_dst)),
+				OP_REG3(op),
+				SpiderScript_GetTypeName(Script, ENT_TYPE(*reg2))
+				);
+			if( reg_dst->TypeId == reg2->TypeId ) {
+				// Warn?
+				memcpy(reg_dst, reg2, sizeof(*reg_dst));
+			}
+			else if( itype == SS_DATATYPE_INTEGER && reg2->TypeId == SS_DATATYPE_REAL ) {
+				reg_dst->Integer = reg2->Real;
+				QUICKEN(BC_OP_CAST_REAL_TO_INT);
+			}
+			else if( itype == SS_DATATYPE_REAL && reg2->TypeId == SS_DATATYPE_INTEGER ) {
+				reg_dst->Real = reg2->Integer;
+				QUICKEN(BC_OP_CAST_INT_TO_REAL);
+			}
+			else
+			{
+				tSpiderTypeRef	type;
+				type = Bytecode_int_GetSpiderValue(Script, reg2, &ptr);
+				if( type.Def == NULL ) { bError = 1; break; }
+				switch(itype)
+				{
+				case SS_DATATYPE_BOOLEAN:
+					reg_dst->Boolean = SpiderScript_CastValueToBool(type, ptr);
+					break;
+				case SS_DATATYPE_INTEGER:
+					reg_dst->Integer = SpiderScript_CastValueToInteger(type, ptr);
+					break;
+				case SS_DATATYPE_REAL:
+					reg_dst->Real = SpiderScript_CastValueToReal(type, ptr);
+					break;
+				case SS_DATATYPE_STRING:
+					reg_dst->String = SpiderScript_CastValueToString(type, ptr);
+					break;
+				default:
+					SpiderScript_RuntimeError(Script, "No cast for type %s",
+						SpiderScript_GetTypeName(Script, ENT_TYPE(*reg_dst)));
+					bError = 1;
+					break;
+				}
+				if( bError )
+					break;
+			}
+			DEBUG_F(" = "); PRINT_STACKVAL(*reg_dst); DEBUG_F("\n");
+			NEXT_OP();
+		OPCASE(BC_OP_CAST_INT_TO_REAL) {
+			if( reg2->TypeId != SS_DATATYPE_INTEGER )
+				DEOPTIMISE(BC_OP_CAST);
+			STATE_HDR();
+			tSpiderInteger	val = reg2->Integer;
+			DEBUG_F("CAST_INT_TO_REAL R%i = R%i (%li)\n", op->DstReg, OP_REG3(op), val);
+			PRESET_DEREF(*reg_dst);
+			reg_dst->TypeId = SS_DATATYPE_REAL;
+			reg_dst->Real = val;
+			NEXT_OP(); }
+		OPCASE(BC_OP_CAST_REAL_TO_INT) {
+			if( reg2->TypeId != SS_DATATYPE_REAL )
+				DEOPTIMISE(BC_OP_CAST);
+			STATE_HDR();
+			tSpiderReal	val = reg2->Real;
+			DEBUG_F("CAST_REAL_TO_INT R%i = R%i (%lf)\n", op->DstReg, OP_REG3(op), val);
+			PRESET_DEREF(*reg_dst);
+			reg_dst->TypeId = SS_DATATYPE_INTEGER;
+			reg_dst->Integer = val;
+			NEXT_OP(); }
+
+		// Unary Operations
+		OPCASE(BC_OP_BOOL_LOGICNOT)
+			STATE_HDR();
+			DEBUG_F("BC_OP_BOOL_LOGICNOT R%i := R%i", op->DstReg, OP_REG2(op));
+			PRESET_DEREF(*reg_dst);
+			reg_dst->TypeId = SS_DATATYPE_BOOLEAN;
+			reg_dst->Boolean = !Bytecode_int_IsStackEntTrue(Script, reg1);
+			NEXT_OP();
+		
+		OPCASE(BC_OP_INT_BITNOT)
+			_BC_ASSERTTYPE(reg1->TypeId, SS_DATATYPE_INTEGER, "reg1");
+		OPVERIFIED(BC_OP_INT_BITNOT)
+			STATE_HDR();
+			DEBUG_F("BC_OP_INT_BITNOT R%i := R%i", op->DstReg, OP_REG2(op));
+			PRESET_DEREF(*reg_dst);
+			reg_dst->TypeId = SS_DATATYPE_INTEGER;
+			reg_dst->Integer = ~reg1->Integer;
+			NEXT_OP();
+		OPCASE(BC_OP_INT_NEG)
+			_BC_ASSERTTYPE(reg1->TypeId, SS_DATATYPE_INTEGER, "reg1");
+		OPVERIFIED(BC_OP_INT_NEG)
+			STATE_HDR();
+			DEBUG_F("BC_OP_INT_NEG R%i := R%i", op->DstReg, OP_REG2(op));
+			PRESET_DEREF(*reg_dst);
+			reg_dst->TypeId = SS_DATATYPE_INTEGER;
+			reg_dst->Integer = -reg1->Integer;
+			NEXT_OP();
+		
+		OPCASE(BC_OP_REAL_NEG)
+			_BC_ASSERTTYPE(reg1->TypeId, SS_DATATYPE_REAL, "reg1");
+		OPVERIFIED(BC_OP_REAL_NEG)
+			STATE_HDR();
+			DEBUG_F("BC_OP_REAL_NEG R%i := R%i", op->DstReg, OP_REG2(op));
+			PRESET_DEREF(*reg_dst);
+			reg_dst->TypeId = SS_DATATYPE_REAL;
+			reg_dst->Real = -reg1->Real;
+			NEXT_OP();
+
+#define BINOPTRACE(opcode) \
+			STATE_HDR();\
+			DEBUG_F(#opcode" R%i := R%i [", op->DstReg, OP_REG2(op)); \
+			PRINT_STACKVAL(*reg1);\
+			DEBUG_F("], R%i [", OP_REG3(op));\
+			PRINT_STACKVAL(*reg2);\
+			DEBUG_F("]\n");
+#define BINOPHDR(opcode) \
+		OPCASE(opcode) \
+			BINOPTRACE(opcode)
+#define BINOPHDR_TYPE(opcode, srctype, dsttype) \
+		OPCASE(opcode) \
+			_BC_ASSERTTYPE(reg1->TypeId, srctype, "reg1");\
+			_BC_ASSERTTYPE(reg2->TypeId, srctype, "reg2");\
+		OPVERIFIED(opcode) \
+			BINOPTRACE(opcode) \
+			PRESET_DEREF(*reg_dst); \
+			reg_dst->TypeId = dsttype;
+#define BINOPI(opcode, opr, dsttype, dstfld) \
+			BINOPHDR_TYPE(opcode, SS_DATATYPE_INTEGER, dsttype)\
+			reg_dst->dstfld = reg1->Integer opr reg2->Integer; \
+			NEXT_OP();
+#define BINOPR(opcode, opr, dsttype, dstfld) \
+			BINOPHDR_TYPE(opcode, SS_DATATYPE_REAL, dsttype)\
+			reg_dst->dstfld = reg1->Real opr reg2->Real; \
+			DEBUG_F(" = "); PRINT_STACKVAL(*reg_dst); DEBUG_F("\n"); \
+			NEXT_OP();
+
+		// Reference comparisons
+		BINOPHDR(BC_OP_REFEQ)
+			if( reg1->TypeId != reg2->TypeId ) {
+				SpiderScript_RuntimeError(Script, "Type mismatch in REFEQ (%s != %s)",
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*reg1)),
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*reg2)));
+				bError = 1;
+				break;
+			}
+			reg_dst->TypeId = SS_DATATYPE_BOOLEAN;
+			reg_dst->Boolean = reg1->String == reg2->String;
+			NEXT_OP();
+		BINOPHDR(BC_OP_REFNEQ)
+			if( reg1->TypeId != reg2->TypeId ) {
+				SpiderScript_RuntimeError(Script, "Type mismatch in REFNEQ (%s != %s)",
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*reg1)),
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*reg2)));
+				bError = 1;
+				break;
+			}
+			reg_dst->TypeId = SS_DATATYPE_BOOLEAN;
+			reg_dst->Boolean = reg1->String != reg2->String;
+			NEXT_OP();
+	
+		BINOPHDR(BC_OP_BOOL_EQUALS)
+			reg_dst->TypeId = SS_DATATYPE_BOOLEAN;
+			reg_dst->Boolean = Bytecode_int_IsStackEntTrue(Script, reg1)
+				== Bytecode_int_IsStackEntTrue(Script, reg2);
+			NEXT_OP();
+		BINOPHDR(BC_OP_BOOL_LOGICAND)
+			reg_dst->TypeId = SS_DATATYPE_BOOLEAN;
+			reg_dst->Boolean = Bytecode_int_IsStackEntTrue(Script, reg1)
+				&& Bytecode_int_IsStackEntTrue(Script, reg2);
+			NEXT_OP();
+		BINOPHDR(BC_OP_BOOL_LOGICOR)
+			reg_dst->TypeId = SS_DATATYPE_BOOLEAN;
+			reg_dst->Boolean = Bytecode_int_IsStackEntTrue(Script, reg1)
+				|| Bytecode_int_IsStackEntTrue(Script, reg2);
+			NEXT_OP();
+		BINOPHDR(BC_OP_BOOL_LOGICXOR)
+			reg_dst->TypeId = SS_DATATYPE_BOOLEAN;
+			reg_dst->Boolean = Bytecode_int_IsStackEntTrue(Script, reg1)
+				!= Bytecode_int_IsStackEntTrue(Script, reg2);
+			NEXT_OP();
+		
+		BINOPI(BC_OP_INT_BITAND, &, SS_DATATYPE_INTEGER, Integer)
+		BINOPI(BC_OP_INT_BITOR,  |, SS_DATATYPE_INTEGER, Integer)
+		BINOPI(BC_OP_INT_BITXOR, ^, SS_DATATYPE_INTEGER, Integer)
+				
+		BINOPI(BC_OP_INT_ADD,      +, SS_DATATYPE_INTEGER, Integer)
+		BINOPI(BC_OP_INT_SUBTRACT, -, SS_DATATYPE_INTEGER, Integer)
+		BINOPI(BC_OP_INT_MULTIPLY, *, SS_DATATYPE_INTEGER, Integer)
+		BINOPHDR_TYPE(BC_OP_INT_DIVIDE, SS_DATATYPE_INTEGER, SS_DATATYPE_INTEGER)
+			if( reg2->Integer == 0 ) {
+				bError = 1;
+				SpiderScript_ThrowException(Script, SS_EXCEPTION_ARITH, "Divide by zero");
+				break;
+			}
+			reg_dst->Integer = reg1->Integer / reg2->Integer;
+			NEXT_OP();
+		BINOPI(BC_OP_INT_MODULO,   %, SS_DATATYPE_INTEGER, Integer)
+
+		BINOPI(BC_OP_INT_BITSHIFTLEFT,  <<, SS_DATATYPE_INTEGER, Integer)
+		BINOPI(BC_OP_INT_BITSHIFTRIGHT, >>, SS_DATATYPE_INTEGER, Integer)
+		
+		BINOPHDR_TYPE(BC_OP_INT_BITROTATELEFT, SS_DATATYPE_INTEGER, SS_DATATYPE_INTEGER)
+			reg_dst->Integer = (reg1->Integer << reg2->Integer) | (reg1->Integer >> (64-reg2->Integer));
+			NEXT_OP();
+		
+		BINOPI(BC_OP_INT_EQUALS,       ==, SS_DATATYPE_BOOLEAN, Boolean)
+		BINOPI(BC_OP_INT_NOTEQUALS,    !=, SS_DATATYPE_BOOLEAN, Boolean)
+		BINOPI(BC_OP_INT_LESSTHAN,     < , SS_DATATYPE_BOOLEAN, Boolean)
+		BINOPI(BC_OP_INT_LESSTHANEQ,   <=, SS_DATATYPE_BOOLEAN, Boolean)
+		BINOPI(BC_OP_INT_GREATERTHAN,  > , SS_DATATYPE_BOOLEAN, Boolean)
+		BINOPI(BC_OP_INT_GREATERTHANEQ,>=, SS_DATATYPE_BOOLEAN, Boolean)
+		
+		BINOPR(BC_OP_REAL_ADD,      +, SS_DATATYPE_REAL, Real)
+		BINOPR(BC_OP_REAL_SUBTRACT, -, SS_DATATYPE_REAL, Real)
+		BINOPR(BC_OP_REAL_MULTIPLY, *, SS_DATATYPE_REAL, Real)
+		BINOPR(BC_OP_REAL_DIVIDE,   /, SS_DATATYPE_REAL, Real)
+	
+		BINOPR(BC_OP_REAL_EQUALS,       ==, SS_DATATYPE_BOOLEAN, Boolean)
+		BINOPR(BC_OP_REAL_NOTEQUALS,    !=, SS_DATATYPE_BOOLEAN, Boolean)
+		BINOPR(BC_OP_REAL_LESSTHAN,     < , SS_DATATYPE_BOOLEAN, Boolean)
+		BINOPR(BC_OP_REAL_LESSTHANEQ,   <=, SS_DATATYPE_BOOLEAN, Boolean)
+		BINOPR(BC_OP_REAL_GREATERTHAN,  > , SS_DATATYPE_BOOLEAN, Boolean)
+		BINOPR(BC_OP_REAL_GREATERTHANEQ,>=, SS_DATATYPE_BOOLEAN, Boolean)
+
+#undef BINOP
+
+		// Fused instructions (see bytecode_fuse.c)
+#define FUSEDHDR(opcode, type) \
+		OPCASE(opcode) \
+			_BC_ASSERTTYPE(reg1->TypeId, type, "reg1");\
+			_BC_ASSERTTYPE(reg2->TypeId, type, "reg2");\
+		OPVERIFIED(opcode) \
+			STATE_HDR();\
+			DEBUG_F(#opcode" @%i R%i [", op->DstReg, OP_REG2(op)); \
+			PRINT_STACKVAL(*reg1);\
+			DEBUG_F("], R%i [", OP_REG3(op));\
+			PRINT_STACKVAL(*reg2);\
+			DEBUG_F("]\n");
+#define JUMPI(opcode, opr) \
+		FUSEDHDR(opcode, SS_DATATYPE_INTEGER) \
+			if( reg1->Integer opr reg2->Integer ) \
+				JUMP_BRANCH(); \
+			NEXT_OP();
+#define JUMPR(opcode, opr) \
+		FUSEDHDR(opcode, SS_DATATYPE_REAL) \
+			if( reg1->Real opr reg2->Real ) \
+				JUMP_BRANCH(); \
+			NEXT_OP();
+#define JUMPNOTR(opcode, opr) \
+		FUSEDHDR(opcode, SS_DATATYPE_REAL) \
+			if( !(reg1->Real opr reg2->Real) ) \
+				JUMP_BRANCH(); \
+			NEXT_OP();
+#define INCJUMPI(opcode, opr) \
+		FUSEDHDR(opcode, SS_DATATYPE_INTEGER) \
+			reg1->Integer += op->Aux; \
+			if( reg1->Integer opr reg2->Integer ) \
+				JUMP_BRANCH(); \
+			NEXT_OP();
+
+		JUMPI(BC_OP_JUMPIF_INT_EQ, ==)
+		JUMPI(BC_OP_JUMPIF_INT_NE, !=)
+		JUMPI(BC_OP_JUMPIF_INT_LT, < )
+		JUMPI(BC_OP_JUMPIF_INT_LE, <=)
+		JUMPI(BC_OP_JUMPIF_INT_GT, > )
+		JUMPI(BC_OP_JUMPIF_INT_GE, >=)
+		
+		JUMPR(BC_OP_JUMPIF_REAL_EQ, ==)
+		JUMPR(BC_OP_JUMPIF_REAL_NE, !=)
+		JUMPR(BC_OP_JUMPIF_REAL_LT, < )
+		JUMPR(BC_OP_JUMPIF_REAL_LE, <=)
+		JUMPR(BC_OP_JUMPIF_REAL_GT, > )
+		JUMPR(BC_OP_JUMPIF_REAL_GE, >=)
+		JUMPNOTR(BC_OP_JUMPIFNOT_REAL_EQ, ==)
+		JUMPNOTR(BC_OP_JUMPIFNOT_REAL_NE, !=)
+		JUMPNOTR(BC_OP_JUMPIFNOT_REAL_LT, < )
+		JUMPNOTR(BC_OP_JUMPIFNOT_REAL_LE, <=)
+		JUMPNOTR(BC_OP_JUMPIFNOT_REAL_GT, > )
+		JUMPNOTR(BC_OP_JUMPIFNOT_REAL_GE, >=)
+
+		INCJUMPI(BC_OP_INT_INC_JUMPIF_EQ, ==)
+		INCJUMPI(BC_OP_INT_INC_JUMPIF_NE, !=)
+		INCJUMPI(BC_OP_INT_INC_JUMPIF_LT, < )
+		INCJUMPI(BC_OP_INT_INC_JUMPIF_LE, <=)
+		INCJUMPI(BC_OP_INT_INC_JUMPIF_GT, > )
+		INCJUMPI(BC_OP_INT_INC_JUMPIF_GE, >=)
+
+		OPCASE(BC_OP_INT_ADDI)
+			_BC_ASSERTTYPE(reg1->TypeId, SS_DATATYPE_INTEGER, "reg1");
+		OPVERIFIED(BC_OP_INT_ADDI)
+			STATE_HDR();
+			DEBUG_F("BC_OP_INT_ADDI R%i := R%i [", op->DstReg, OP_REG2(op));
+			PRINT_STACKVAL(*reg1);
+			DEBUG_F("], %i\n", OP_REG3(op));
+			PRESET_DEREF(*reg_dst);
+			reg_dst->TypeId = SS_DATATYPE_INTEGER;
+			reg_dst->Integer = reg1->Integer + OP_REG3(op);
+			NEXT_OP();
+
+		OPCASE(BC_OP_STR_EQUALS)
+			ast_op = NODETYPE_EQUALS;	opstr = "EQUALS";
+			goto _str_binop;
+		OPCASE(BC_OP_STR_NOTEQUALS)
+			ast_op = NODETYPE_NOTEQUALS;	opstr = "NOTEQUALS";
+			goto _str_binop;
+		OPCASE(BC_OP_STR_LESSTHAN)
+			ast_op = NODETYPE_LESSTHAN;	opstr = "LESSTHAN";
+			goto _str_binop;
+		OPCASE(BC_OP_STR_LESSTHANEQ)
+			ast_op = NODETYPE_LESSTHANEQUAL; opstr = "LESSTHANOREQUAL";
+			goto _str_binop;
+		OPCASE(BC_OP_STR_GREATERTHAN)
+			ast_op = NODETYPE_GREATERTHAN;	opstr = "GREATERTHAN";
+			goto _str_binop;
+		OPCASE(BC_OP_STR_GREATERTHANEQ)
+			ast_op = NODETYPE_GREATERTHANEQUAL; opstr = "GREATERTHANOREQUAL";
+			goto _str_binop;
+		OPCASE(BC_OP_STR_ADD)
+			ast_op = NODETYPE_ADD; opstr = "ADD";
+		_str_binop:
+			STATE_HDR();
+			DEBUG_F("BINOP_STR_%s R%i = ", opstr, op->DstReg);
+			
+			_BC_ASSERTTYPE(reg1->TypeId, SS_DATATYPE_STRING, "reg1");
+
+			DEBUG_F("R%i [", OP_REG2(op)); PRINT_STACKVAL(*reg1); DEBUG_F("] ");
+			DEBUG_F("R%i [", OP_REG3(op)); PRINT_STACKVAL(*reg2); DEBUG_F("]\n");
+
+			// Get RVal
+			Bytecode_int_GetSpiderValue(Script, reg2, &ptr);
+			
+			PRESET_DEREF(*reg_dst);
+			itype = AST_ExecuteNode_BinOp_String(Script, &reg_dst->Boolean, ast_op,
+				reg1->String, reg2->TypeId, ptr);
+			if( itype == -1 ) {
+				SpiderScript_RuntimeError(Script,
+					"_ExecuteNode_BinOp[%s] for types %s<op>%s returned -1",
+					opstr,
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*reg1)),
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*reg2)));
+				bError = 1;
+				break;
+			}
+			reg_dst->TypeId = itype;
+			DEBUG_F(" = ("); PRINT_STACKVAL(*reg_dst); DEBUG_F(")\n");
+			NEXT_OP();
+
+		// Functions etc
+		OPCASE(BC_OP_CREATEOBJ)
+			opstr = "CREATEOBJ";
+			goto _call;
+		OPCASE(BC_OP_CALLFUNCTION)
+			opstr = "CALLFCN";
+			goto _call;
+		OPCASE(BC_OP_CALLMETHOD)
+			opstr = "CALLMETHOD";
+			goto _call;
+		OPCASE(BC_OP_TAILCALLFUNCTION)
+			opstr = "TAILCALLFCN";
+			goto _call;
+		OPCASE(BC_OP_TAILCALLMETHOD)
+			opstr = "TAILCALLMETHOD";
+			goto _call;
+		OPCASE(BC_OP_CALLLOCAL)
+			opstr = "CALLLOCAL";
+			goto _call;
+		OPCASE(BC_OP_TAILCALLLOCAL)
+			opstr = "TAILCALLLOCAL";
+		_call: {
+			STATE_HDR();
+			
+			tBC_Op	*cop = op->Content.Op;
+			tScript_Function	*fcn = NULL;
+			tBC_Frame	*fcn_frame = NULL;
+			 int	id = cop->Content.Function.ID;
+			 int	arg_count = cop->Content.Function.ArgCount & BC_CALL_ARGCOUNT_MASK;
+			bool	is_varg_passthrough = !!(cop->Content.Function.ArgCount & BC_CALL_VARGS_PASSTHROUGH);
+			bool	is_window = !!(cop->Content.Function.ArgCount & BC_CALL_WINDOW);
+			bool	is_tail = (op->Operation == BC_OP_TAILCALLFUNCTION || op->Operation == BC_OP_TAILCALLMETHOD
+				|| op->Operation == BC_OP_TAILCALLLOCAL);
+			bool	is_method = (op->Operation == BC_OP_CALLMETHOD || op->Operation == BC_OP_TAILCALLMETHOD);
+			
+			if( arg_count >= 1 )
+				reg1 = &REG( cop->Content.Function.ArgRegs[0] );
+			else
+				reg1 = NULL;
+
+			if( op->Operation == BC_OP_CALLLOCAL || op->Operation == BC_OP_TAILCALLLOCAL )
+			{
+				// Resolved by SpiderScript_Link
+				fcn = cop->CacheEnt;
+				DEBUG_F("CALL (linked) %s %i args\n", fcn->Name, arg_count);
+			}
+			else if( (op->Operation == BC_OP_CALLFUNCTION || op->Operation == BC_OP_TAILCALLFUNCTION) && (id >> 16) == 0 )
+			{
+				// Check current script functions (for fast call)
+				DEBUG_F("CALL (local) 0x%x %i args\n", id, arg_count);
+				if( id >= Script->nFunctions ) {
+					SpiderScript_RuntimeError(Script,
+						"Function ID #%i is invalid", id);
+					bError = 1;
+					break;
+				}
+				fcn = Script->FunctionTable[id];
+			}
+			else if( is_method
+				&& SS_ISTYPEOBJECT(ENT_TYPE(*reg1))
+				&& ENT_TYPE(*reg1).Def->Class == SS_TYPECLASS_SCLASS )
+			{
+				const tSpiderScript_TypeDef	*def = ENT_TYPE(*reg1).Def;
+				DEBUG_F("MCALL (local) %s 0x%x %i args\n",
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*reg1)), id, arg_count);
+				if( id >= def->SClass->nFunctions ) {
+					SpiderScript_RuntimeError(Script,
+						"Method #%i of %s is invalid", id,
+						SpiderScript_GetTypeName(Script, ENT_TYPE(*reg1)));
+					bError = 1;
+					break;
+				}
+				fcn = def->SClass->Functions[id];
+			}
+			else
+			{
+				fcn = NULL;
+			}
+			
+			if( fcn && !fcn->BCFcn ) {
+				SpiderScript_RuntimeError(Script,
+					"Function #%i %s is not compiled", id, fcn->Name);
+				bError = 1;
+				break;
+			}
+
+			// (Argument array is scoped so the threaded dispatch below never leaves a VLA)
+			{
+				int extra_args = (is_varg_passthrough ? frame->VArgC : 0);
+				const tBC_StackEnt	*args[arg_count+extra_args];
+				for(int i = 0; i < arg_count; i ++ ) {
+					args[i] = &REG( cop->Content.Function.ArgRegs[i] );
+				}
+				for( int i = 0; i < extra_args; i ++ ) {
+					args[arg_count+i] = frame->VArgs[i];
+				}
+				
+				DEBUG_F("%s.%s R%i, 0x%x,", opstr, (fcn?"L":"R"), op->DstReg, id);
+				for(int i = 0; i < arg_count; i ++ ) {
+					DEBUG_F(" R%i", cop->Content.Function.ArgRegs[i]);
+				}
+				if( is_varg_passthrough )
+					DEBUG_F(" ...(%i)", extra_args);
+				DEBUG_F("\n");
+
+				// A script callee of a tail call takes over this frame's stack space
+				// - Variable arguments would be left pointing into this frame, so those are normal calls
+				if( is_tail && fcn && !fcn->Native && arg_count+extra_args == fcn->ArgumentCount
+				 && SS_TYPESEQUAL(fcn->ReturnType, Fcn->ReturnType) )
+				{
+					const int	n = arg_count+extra_args;
+					tBC_Frame	*caller = frame->Caller;
+					tBC_StackEnt	*retval = frame->RetVal;
+					// Arguments may be this frame's registers, hold them across the pop
+					tBC_StackEnt	argvals[n];
+					for( int i = 0; i < n; i ++ ) {
+						argvals[i] = *args[i];
+						REF_STACKVAL(argvals[i]);
+						args[i] = &argvals[i];
+					}
+					Bytecode_int_PopFrame(Script, frame);
+					fcn_frame = Bytecode_int_PushFrame(Script, fcn, n, args, NULL, caller, retval);
+					for( int i = 0; i < n; i ++ )
+						DEREF_STACKVAL(argvals[i]);
+					if( !fcn_frame ) {
+						// Report against the caller, this frame is gone
+						frame = caller;
+						if( frame )
+							op = frame->CurOp;
+						bError = 1;
+						break;
+					}
+					rv = 0;
+				}
+				// Compiled script functions run natively, then this frame continues
+				else if( fcn && fcn->Native )
+				{
+					PRESET_DEREF(*reg_dst);
+					rv = Bytecode_int_CallNative(Script, fcn, arg_count+extra_args, args, reg_dst);
+					fcn = NULL;
+				}
+				// Either a local call, or a remote call
+				else if( fcn )
+				{
+					PRESET_DEREF(*reg_dst);
+					// Script functions run in this loop, resumed by RETURN
+					// - An argument window becomes the start of the callee's registers
+					frame->CurOp = op;
+					fcn_frame = Bytecode_int_PushFrame(Script, fcn, arg_count+extra_args, args,
+						(is_window && !fcn->IsVariable ? reg1 : NULL), frame, reg_dst);
+					rv = (fcn_frame ? 0 : -1);
+				}
+				else
+				{
+					PRESET_DEREF(*reg_dst);
+					rv = Bytecode_int_CallExternFunction( Script, cop,
+						(op->Aux >= 0 && is_method ? &Fcn->BCFcn->InlineCaches[op->Aux] : NULL),
+						arg_count+extra_args, args, reg_dst );
+				}
+				// Window arguments belong to the call, release any the callee didn't take
+				if( is_window && !(fcn_frame && fcn_frame->Registers == reg1) ) {
+					for( int i = 0; i < arg_count; i ++ )
+						DEREF_STACKVAL( REG(cop->Content.Function.ArgRegs[i]) );
+				}
+				if( rv ) {
+					bError = 1;
+					break;
+				}
+			}
+			if( fcn ) {
+				frame = fcn_frame;
+				LOAD_FRAME();
+				JUMP_OP(JIT_ENTER(0));
+			}
+			JUMP_OP(JIT_ENTER(op - code + 1)); }
+
+		OPCASE(BC_OP_RETURN)
+			// Callers rely on script functions returning the stated type
+			if( op->DstReg >= 0 && Fcn->BCFcn->ReturnTypeId != SS_DATATYPE_NOVALUE
+			 && reg_dst->TypeId != Fcn->BCFcn->ReturnTypeId )
+			{
+				SpiderScript_RuntimeError(Script, "'%s' returned type %s not stated %s",
+					Fcn->Name,
+					SpiderScript_GetTypeName(Script, ENT_TYPE(*reg_dst)),
+					SpiderScript_GetTypeName(Script, Fcn->ReturnType)
+					);
+				bError = 1;
+				break;
+			}
+		OPVERIFIED(BC_OP_RETURN)
+			STATE_HDR();
+	
+			// The destination can be one of this frame's registers (see Bytecode_AppendWindowCall),
+			// so it is only written once the frame is gone
+			// - The value is moved out, the register would be released by the pop
+			tBC_StackEnt	*retval = frame->RetVal;
+			tBC_StackEnt	retent = {.TypeId = Fcn->BCFcn->ReturnTypeId};
+			if( op->DstReg >= 0 ) {
+				retent = *reg_dst;
+				reg_dst->TypeId = SS_DATATYPE_NOVALUE;
+			}
+			// - Falling off the end of a non-void function returns zero/null
+			else if( retent.TypeId != SS_DATATYPE_NOVALUE ) {
+				retent.Integer = 0;
+			}
+
+			DEBUG_F("RETURN R%i\n", op->DstReg);
+			DEBUG_F("--- Return %s\n", Fcn->Name);
+			frame = Bytecode_int_PopFrame(Script, frame);
+			if( retval )
+				*retval = retent;
+			else if( op->DstReg >= 0 )
+				DEREF_STACKVAL(retent);
+			if( !frame )
+				break;	// non-error stop
+			// Resume the caller after its call instruction
+			LOAD_FRAME();
+			JUMP_OP(JIT_ENTER(frame->CurOp - code + 1));
+	
+		OPDEFAULT()
+			STATE_HDR();
+			SpiderScript_RuntimeError(Script, "Unknown operation %i\n", op->Operation);
+			bError = 1;
+			break;
+		}
+		// Continue in a handler if one covers the instruction (or a caller's call)
+		if( bError && frame && (i = Bytecode_int_FindHandler(Script, &frame, op)) >= 0 ) {
+			DEBUG_F("--- Caught in %s, continuing at %i\n", frame->Fcn->Name, i);
+			bError = 0;
+			LOAD_FRAME();
+			JUMP_OP(i);
+		}
+		break;
+	}
+	
+	// Clean up
+	// - On error, unwind all frames pushed by this call (innermost first)
+	DEBUG_F("> Cleaning up\n");
+	if( bError )
+	{
+		if( frame )
+			frame->CurOp = op;
+		while( frame )
+		{
+			// Positions are only looked up now, see Bytecode_AppendPos
+			const char	*file;
+			 int	line;
+			const int	pc = frame->CurOp - frame->Fcn->BCFcn->Instructions;
+			Bytecode_int_GetPosition(frame->Fcn->BCFcn, pc, &file, &line);
+			SpiderScript_PushBacktrace(Script, frame->Fcn->Name, pc, file, line);
+			frame = Bytecode_int_PopFrame(Script, frame);
+		}
+	}
+	#undef LOAD_FRAME
+	#undef LOAD_FRAME_DISPATCH
+
+	DEBUG_F("--- Return %i\n", bError);
+	return bError;
+}
+
+#undef BINOPTRACE
+#undef BINOPHDR
+#undef BINOPHDR_TYPE
+#undef BINOPI
+#undef BINOPR
+#undef FUSEDHDR
+#undef JUMPI
+#undef JUMPR
+#undef JUMPNOTR
+#undef INCJUMPI
+
+#undef TRACE_COMPILED
+#define TRACE_COMPILED	1
+#undef BC_LOOP_NAME
+#undef BC_LOOP_TRACE
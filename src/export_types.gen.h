@@ -0,0 +1,2 @@
+SS_EXPORT extern tSpiderClass gExports_class_Lang_StringMap;
+#define TYPE_Lang_z_StringMap &gExports_class_Lang_StringMap.TypeDef
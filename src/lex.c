@@ -54,6 +54,8 @@ const struct {
 	{TOK_RWD_SWITCH, "switch"},
 	{TOK_RWD_CASE, "case"},
 	{TOK_RWD_DEFAULT, "default"},
+	{TOK_RWD_TRY, "try"},
+	{TOK_RWD_CATCH, "catch"},
 	
 	{TOK_RWD_NULL, "null"},
 	{TOK_RWD_TRUE, "true"},
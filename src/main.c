@@ -9,6 +9,7 @@
 #include "common.h"
 #include "ast.h"
 #include "bytecode_gen.h"
+#include "bytecode.h"
 #include <stdarg.h>
 
 // === IMPORTS ===
@@ -29,6 +30,12 @@ int SoMain()
  * \brief Parse a script
  */
 tSpiderScript *SpiderScript_ParseFile(tSpiderVariant *Variant, const char *Filename)
+{
+	return SpiderScript_ParseFileEx(Variant, Filename, SS_OPTIMISE_DEFAULT);
+}
+
+tSpiderScript *SpiderScript_ParseFileEx(tSpiderVariant *Variant, const char *Filename,
+	enum eSpiderScript_OptimiseLevel Level)
 {
 	char	*data;
 	 int	fLen;
@@ -59,6 +66,7 @@ tSpiderScript *SpiderScript_ParseFile(tSpiderVariant *Variant, const char *Filen
 	// Create the script
 	ret = calloc(1,sizeof(tSpiderScript));
 	ret->Variant = Variant;
+	ret->OptimiseLevel = Level;
 	
 	if( Parse_Buffer(ret, data, Filename) ) {
 		free(data);
@@ -67,21 +75,35 @@ tSpiderScript *SpiderScript_ParseFile(tSpiderVariant *Variant, const char *Filen
 	}
 	free(data);
 
-	// TODO: Create function/class arrays (instead of linked lists)
+	if( SpiderScript_int_BuildTables(ret) ) {
+		SpiderScript_Free(ret);
+		return NULL;
+	}
 
 	// Convert the script into (parsed) bytecode	
 	if( SpiderScript_BytecodeScript(ret) != 0 ) {
 		SpiderScript_Free(ret);
 		return NULL;
 	}
+	if( SpiderScript_Link(ret) ) {
+		SpiderScript_Free(ret);
+		return NULL;
+	}
 	
 	return ret;
 }
 
 tSpiderScript *SpiderScript_LoadBytecode(tSpiderVariant *Variant, const char *Filename)
+{
+	return SpiderScript_LoadBytecodeEx(Variant, Filename, SS_OPTIMISE_DEFAULT);
+}
+
+tSpiderScript *SpiderScript_LoadBytecodeEx(tSpiderVariant *Variant, const char *Filename,
+	enum eSpiderScript_OptimiseLevel Level)
 {
 	tSpiderScript *ret = calloc(sizeof(tSpiderScript), 1);
 	ret->Variant = Variant;
+	ret->OptimiseLevel = Level;
 
 	if( SpiderScript_int_LoadBytecode(ret, Filename) ) {
 		SpiderScript_Free(ret);
@@ -92,9 +114,16 @@ tSpiderScript *SpiderScript_LoadBytecode(tSpiderVariant *Variant, const char *Fi
 }
 
 tSpiderScript *SpiderScript_LoadBytecodeBuf(tSpiderVariant *Variant, const void *Data, size_t Length)
+{
+	return SpiderScript_LoadBytecodeBufEx(Variant, Data, Length, SS_OPTIMISE_DEFAULT);
+}
+
+tSpiderScript *SpiderScript_LoadBytecodeBufEx(tSpiderVariant *Variant, const void *Data, size_t Length,
+	enum eSpiderScript_OptimiseLevel Level)
 {
 	tSpiderScript *ret = calloc(sizeof(tSpiderScript), 1);
 	ret->Variant = Variant;
+	ret->OptimiseLevel = Level;
 
 	if( SpiderScript_int_LoadBytecodeMem(ret, Data, Length) ) {
 		SpiderScript_Free(ret);
@@ -104,6 +133,40 @@ tSpiderScript *SpiderScript_LoadBytecodeBuf(tSpiderVariant *Variant, const void
 	return ret;
 }
 
+/**
+ * \brief Build the ID-indexed function and method tables
+ * \note Called once all functions and classes are defined (after parse/load)
+ */
+int SpiderScript_int_BuildTables(tSpiderScript *Script)
+{
+	 int	i;
+
+	free(Script->FunctionTable);
+	Script->nFunctions = 0;
+	for( tScript_Function *fcn = Script->Functions; fcn; fcn = fcn->Next )
+		Script->nFunctions ++;
+	Script->FunctionTable = malloc( Script->nFunctions * sizeof(void*) );
+	if( !Script->FunctionTable && Script->nFunctions )
+		return -1;
+	i = 0;
+	for( tScript_Function *fcn = Script->Functions; fcn; fcn = fcn->Next )
+		Script->FunctionTable[i++] = fcn;
+
+	for( tScript_Class *sc = Script->FirstClass; sc; sc = sc->Next )
+	{
+		sc->Constructor = NULL;
+		for( i = 0; i < sc->nFunctions; i ++ )
+		{
+			if( strcmp(sc->Functions[i]->Name, CONSTRUCTOR_NAME) == 0 ) {
+				sc->Constructor = sc->Functions[i];
+				break;
+			}
+		}
+	}
+	
+	return 0;
+}
+
 /**
  * \brief Free a script
  */
@@ -161,8 +224,11 @@ void SpiderScript_Free(tSpiderScript *Script)
 	Script->FirstGlobal = NULL;
 	Script->LastGlobal = NULL;
 
+	free(Script->FunctionTable);
 	if( Script->BCTypes )
 		free(Script->BCTypes);
+	Bytecode_FreeStack(Script);
+	Bytecode_JIT_Free(Script);
 
 	free(Script);
 }
@@ -172,6 +238,29 @@ void SpiderScript_SetTraceLevel(tSpiderScript *Script, enum eSpiderScript_TraceL
 	Script->BytecodeTraceLevel = Level;
 }
 
+void SpiderScript_SetExecLimit(tSpiderScript *Script, enum eSpiderScript_ExecLimit Limit, size_t Value)
+{
+	switch(Limit)
+	{
+	case SS_LIMIT_FRAMEREGISTERS:	Script->MaxFrameRegisters = Value;	break;
+	case SS_LIMIT_FRAMEGLOBALS:	Script->MaxFrameGlobals = Value;	break;
+	case SS_LIMIT_STACKSIZE:	Script->MaxStackSize = Value;	break;
+	}
+}
+
+int SpiderScript_SetJITThreshold(tSpiderScript *Script, int Threshold)
+{
+	if( !BC_JIT_AVAILABLE )
+		return 1;
+	Script->JitThreshold = (Threshold > 0 ? Threshold : 0);
+	return 0;
+}
+
+void SpiderScript_SetTierThreshold(tSpiderScript *Script, int Threshold)
+{
+	Script->TierThreshold = (Threshold < 0 ? -1 : Threshold);
+}
+
 void SpiderScript_RuntimeError(tSpiderScript *Script, const char *Format, ...)
 {
 	va_list	args;
@@ -765,6 +765,44 @@ tAST_Node *Parse_DoBlockLine(tParser *Parser, tAST_Node *CodeNode)
 		return NULL;
 		}
 
+	// Exception handler
+	// "try <code> catch(String $message) <code>"
+	case TOK_RWD_TRY:
+		{
+		tAST_Node	*code = NULL, *var = NULL, *handler = NULL;
+		GetToken(Parser);	// Eat 'try'
+
+		DEBUGS2("Try block");
+
+		if( !(code = Parse_DoCodeBlock(Parser, CodeNode)) )
+			goto _try_err_ret;
+		if( SyntaxAssert(Parser, GetToken(Parser), TOK_RWD_CATCH) )
+			goto _try_err_ret;
+		if( SyntaxAssert(Parser, GetToken(Parser), TOK_PAREN_OPEN) )
+			goto _try_err_ret;
+		if( SyntaxAssert(Parser, LookAhead(Parser), TOK_IDENT) )
+			goto _try_err_ret;
+		var = Parse_GetIdent(Parser, GETIDENTMODE_FUNCTIONDEF, NULL);
+		if( !var || var == SS_ERRPTR ) {
+			var = NULL;
+			goto _try_err_ret;
+		}
+		if( var->Type != NODETYPE_DEFVAR || var->DefVar.InitialValue ) {
+			SyntaxError(Parser, "Expected a variable definition in catch");
+			goto _try_err_ret;
+		}
+		if( SyntaxAssert(Parser, GetToken(Parser), TOK_PAREN_CLOSE) )
+			goto _try_err_ret;
+		if( !(handler = Parse_DoCodeBlock(Parser, CodeNode)) )
+			goto _try_err_ret;
+		return AST_NewTryCatch(Parser, code, var, handler);
+	_try_err_ret:
+		if(code)	AST_FreeNode(code);
+		if(var)	AST_FreeNode(var);
+		if(handler)	AST_FreeNode(handler);
+		return NULL;
+		}
+
 	// Switch statement
 	case TOK_RWD_SWITCH:
 		{
@@ -1480,17 +1518,16 @@ tAST_Node *Parse_GetNumeric(tParser *Parser)
 			pos ++;
 			for( ;; pos++)
 			{
-				value *= 16;
 				if( '0' <= *pos && *pos <= '9' ) {
-					value += *pos - '0';
+					value = value*16 + *pos - '0';
 					continue;
 				}
 				if( 'A' <= *pos && *pos <= 'F' ) {
-					value += *pos - 'A' + 10;
+					value = value*16 + *pos - 'A' + 10;
 					continue;
 				}
 				if( 'a' <= *pos && *pos <= 'f' ) {
-					value += *pos - 'a' + 10;
+					value = value*16 + *pos - 'a' + 10;
 					continue;
 				}
 				break;
@@ -38,6 +38,7 @@ typedef struct sSpiderBacktrace	tSpiderBacktrace;
 typedef struct sSpiderNamespace	tSpiderNamespace;
 typedef struct sSpiderFcnProto	tSpiderFcnProto;
 typedef struct sSpiderFunction	tSpiderFunction;
+typedef struct sSpiderNativeFunction	tSpiderNativeFunction;
 typedef struct sSpiderClass	tSpiderClass;
 
 typedef char	tSpiderBool;
@@ -117,6 +118,28 @@ enum eSpiderValueOps
 	SS_VALUEOP_ROTATELEFT
 };
 
+/**
+ * \brief Bytecode optimisation level
+ *
+ * SS_OPTIMISE_BASIC cleans up the operation list: jump chains are threaded, and unreachable
+ * code, redundant moves and unused labels are removed.
+ *
+ * SS_OPTIMISE_FULL adds constant propagation and dead store removal, then the passes on the
+ * SSA form of the function:
+ * - value numbering (recomputed values are reused) and copy propagation
+ * - strength reduction (multiplication, division and modulo by powers of two)
+ * - array bounds check elimination, where the index is proven to be in range
+ * - loop-invariant code motion
+ * - loop versioning, running a copy of a loop without bounds checks after one range check
+ */
+enum eSpiderScript_OptimiseLevel
+{
+	SS_OPTIMISE_DEFAULT,	//!< Currently SS_OPTIMISE_FULL
+	SS_OPTIMISE_NONE,	//!< Bytecode is executed as generated/loaded
+	SS_OPTIMISE_BASIC,	//!< Operation list clean-up only (see above)
+	SS_OPTIMISE_FULL,	//!< As above, plus constant propagation, dead stores and the SSA passes
+};
+
 /**
  * \brief Variant of SpiderScript
  */
@@ -135,6 +158,7 @@ struct sSpiderVariant
 	
 	 int	(*GetConstant)(void **Dest, int Index);
 	 int	NConstants;	//!< Number of constants
+	
 	struct {
 		const char *Name;
 		tSpiderTypeRef	Type;
@@ -281,6 +305,16 @@ struct sSpiderFunction
 	tSpiderFcnProto	*Prototype;
 };
 
+/**
+ * \brief Compiled version of a script function (generated by SpiderScript_SaveC)
+ */
+struct sSpiderNativeFunction
+{
+	const char	*Name;	//!< Script function name
+	uint32_t	Hash;	//!< Fingerprint of the bytecode it was translated from
+	 int	(*Handler)(tSpiderScript *Script, void *RetData, int nArgs, const tSpiderTypeRef *ArgTypes, const void * const Args[]);
+};
+
 
 // === FUNCTIONS ===
 /**
@@ -295,6 +329,19 @@ SS_EXPORT extern tSpiderScript	*SpiderScript_ParseFile(tSpiderVariant *Variant,
  */
 SS_EXPORT extern tSpiderScript	*SpiderScript_LoadBytecode(tSpiderVariant *Variant, const char *Filename);
 SS_EXPORT extern tSpiderScript	*SpiderScript_LoadBytecodeBuf(tSpiderVariant *Variant, const void *Buf, size_t Len);
+/**
+ * \brief Parse a file into a script, choosing how far the bytecode is optimised
+ * \note SpiderScript_ParseFile is this with SS_OPTIMISE_DEFAULT
+ */
+SS_EXPORT extern tSpiderScript	*SpiderScript_ParseFileEx(tSpiderVariant *Variant, const char *Filename,
+	enum eSpiderScript_OptimiseLevel Level);
+/**
+ * \brief Load a script from bytecode, choosing how far the bytecode is optimised
+ */
+SS_EXPORT extern tSpiderScript	*SpiderScript_LoadBytecodeEx(tSpiderVariant *Variant, const char *Filename,
+	enum eSpiderScript_OptimiseLevel Level);
+SS_EXPORT extern tSpiderScript	*SpiderScript_LoadBytecodeBufEx(tSpiderVariant *Variant, const void *Buf, size_t Len,
+	enum eSpiderScript_OptimiseLevel Level);
 /**
  * \brief Convert a script to bytecode and save to a file
  */
@@ -304,6 +351,20 @@ SS_EXPORT extern int	SpiderScript_SaveBytecodeMem(tSpiderScript *Script, void **
  * \brief Save the AST of a script to a file
  */
 SS_EXPORT extern int	SpiderScript_SaveAST(tSpiderScript *Script, const char *Filename);
+/**
+ * \brief Translate a script's functions to C, for building into the host program
+ * \param Prefix	Prefix for the generated symbols, the function table is \a Prefix_Functions
+ * \return Number of functions translated, or -1 on error
+ * \note Only functions working on Boolean, Integer, Real and String values are translated
+ * \see SpiderScript_RegisterNative
+ */
+SS_EXPORT extern int	SpiderScript_SaveC(tSpiderScript *Script, const char *DestFile, const char *Prefix);
+/**
+ * \brief Run the compiled versions of a script's functions
+ * \param Functions	Table from SpiderScript_SaveC (terminated by a NULL name)
+ * \return Number of functions replaced, entries that don't match the loaded bytecode are skipped
+ */
+SS_EXPORT extern int	SpiderScript_RegisterNative(tSpiderScript *Script, const tSpiderNativeFunction *Functions);
 
 /**
  * \brief Free a script
@@ -326,6 +387,34 @@ enum eSpiderScript_TraceLevel
  */
 SS_EXPORT extern void	SpiderScript_SetTraceLevel(tSpiderScript *Script, enum eSpiderScript_TraceLevel Level);
 
+enum eSpiderScript_ExecLimit
+{
+	SS_LIMIT_FRAMEREGISTERS,	// Maximum registers used by a single function
+	SS_LIMIT_FRAMEGLOBALS,	// Maximum globals imported by a single function
+	SS_LIMIT_STACKSIZE,	// Maximum size of the VM stack (in bytes)
+};
+
+/**
+ * \brief Set an execution budget
+ * \param Limit	Budget to change, see eSpiderScript_ExecLimit
+ * \param Value	New limit (0 restores the default)
+ */
+SS_EXPORT extern void	SpiderScript_SetExecLimit(tSpiderScript *Script, enum eSpiderScript_ExecLimit Limit, size_t Value);
+
+/**
+ * \brief Compile hot bytecode functions to native code
+ * \param Threshold	Calls plus loop iterations before a function is compiled (0 disables)
+ * \return Non-zero if native code is not supported on this platform
+ */
+SS_EXPORT extern int	SpiderScript_SetJITThreshold(tSpiderScript *Script, int Threshold);
+
+/**
+ * \brief Set how hot a function must be before it is re-optimised
+ * \param Threshold	Calls before a function is re-optimised (0 restores the default, -1 disables)
+ * \note Loop iterations count towards the threshold, the optimised code is used from the next call
+ */
+SS_EXPORT extern void	SpiderScript_SetTierThreshold(tSpiderScript *Script, int Threshold);
+
 
 /**
  * \name Execution
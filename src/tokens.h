@@ -52,6 +52,8 @@ enum eTokens
 	TOK_RWD_SWITCH,
 	TOK_RWD_CASE,
 	TOK_RWD_DEFAULT,
+	TOK_RWD_TRY,
+	TOK_RWD_CATCH,
 	// - Value
 	TOK_RWD_NULL,
 	TOK_RWD_TRUE,
@@ -168,6 +170,8 @@ const char * const csaTOKEN_NAMES[] = {
 	"TOK_RWD_SWITCH",
 	"TOK_RWD_CASE",
 	"TOK_RWD_DEFAULT",
+	"TOK_RWD_TRY",
+	"TOK_RWD_CATCH",
 	
 	"TOK_RWD_NULL",
 	"TOK_RWD_TRUE",